@@ -0,0 +1,486 @@
+#include "Animation.h"
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <xmmintrin.h>
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <map>
+
+namespace fs = std::filesystem;
+
+static glm::mat4 ToGlm(const aiMatrix4x4& m) {
+    return glm::transpose(glm::make_mat4(&m.a1));
+}
+
+static glm::mat4 ComposeTransform(const glm::vec3& t, const glm::quat& r, const glm::vec3& s) {
+    glm::mat3 rotation = glm::mat3_cast(r);
+    return glm::mat4(glm::vec4(rotation[0] * s.x, 0.0f), glm::vec4(rotation[1] * s.y, 0.0f), glm::vec4(rotation[2] * s.z, 0.0f), glm::vec4(t, 1.0f));
+}
+
+// Preorder walk, so parents are always added before their children
+static void FlattenNodes(const aiNode* node, int parent, Skeleton& skeleton, std::map<std::string, int>& jointByName, std::vector<const aiNode*>& nodes) {
+    int index = (int)skeleton.names.size();
+    aiVector3D scaling, position;
+    aiQuaternion rotation;
+    node->mTransformation.Decompose(scaling, rotation, position);
+    skeleton.names.push_back(node->mName.C_Str());
+    skeleton.parents.push_back(parent);
+    skeleton.bindTranslations.push_back(glm::vec3(position.x, position.y, position.z));
+    skeleton.bindRotations.push_back(glm::quat(rotation.w, rotation.x, rotation.y, rotation.z));
+    skeleton.bindScales.push_back(glm::vec3(scaling.x, scaling.y, scaling.z));
+    jointByName[node->mName.C_Str()] = index;
+    nodes.push_back(node);
+    for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+        FlattenNodes(node->mChildren[i], index, skeleton, jointByName, nodes);
+    }
+}
+
+// Keeps the strongest influences when a vertex has more than SKIN_MAX_INFLUENCES
+static void AddInfluence(VertexSkin& skin, unsigned int joint, float weight) {
+    int weakest = 0;
+    for (int i = 1; i < SKIN_MAX_INFLUENCES; ++i) {
+        if (skin.weights[i] < skin.weights[weakest]) {
+            weakest = i;
+        }
+    }
+    if (weight > skin.weights[weakest]) {
+        skin.joints[weakest] = joint;
+        skin.weights[weakest] = weight;
+    }
+}
+
+bool LoadSkinnedModel(const std::string& path, SkinnedModel& model, std::function<GLuint(const std::string&)> loadTexture) {
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path,
+        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_LimitBoneWeights);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cerr << "ERROR::ASSIMP: " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+
+    model = SkinnedModel();
+    Skeleton& skeleton = model.skeleton;
+    std::map<std::string, int> jointByName;
+    std::vector<const aiNode*> nodes;
+    FlattenNodes(scene->mRootNode, -1, skeleton, jointByName, nodes);
+
+    // Bind pose world matrices; joints no bone refers to keep their inverse
+    std::vector<glm::mat4> bindWorld(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        glm::mat4 local = ToGlm(nodes[i]->mTransformation);
+        bindWorld[i] = skeleton.parents[i] < 0 ? local : bindWorld[skeleton.parents[i]] * local;
+    }
+    skeleton.inverseBind.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        skeleton.inverseBind[i] = glm::inverse(bindWorld[i]);
+    }
+
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        for (unsigned int m = 0; m < nodes[n]->mNumMeshes; ++m) {
+            const aiMesh* mesh = scene->mMeshes[nodes[n]->mMeshes[m]];
+            unsigned int base = (unsigned int)model.vertices.size();
+            // Meshes without bones ride rigidly on their node, so bring them into model space first
+            glm::mat4 rigid = mesh->HasBones() ? glm::mat4(1.0f) : bindWorld[n];
+            glm::mat3 rigidNormal = glm::transpose(glm::inverse(glm::mat3(rigid)));
+            for (unsigned int v = 0; v < mesh->mNumVertices; ++v) {
+                glm::vec3 p = glm::vec3(rigid * glm::vec4(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z, 1.0f));
+                glm::vec3 normal = mesh->HasNormals() ? glm::normalize(rigidNormal * glm::vec3(mesh->mNormals[v].x, mesh->mNormals[v].y, mesh->mNormals[v].z)) : glm::vec3(0.0f, 1.0f, 0.0f);
+                Vertex vertex = { { p.x, p.y, p.z }, { normal.x, normal.y, normal.z }, { 0.0f, 0.0f } };
+                if (mesh->mTextureCoords[0]) {
+                    vertex.TexCoords[0] = mesh->mTextureCoords[0][v].x;
+                    vertex.TexCoords[1] = mesh->mTextureCoords[0][v].y;
+                }
+                model.vertices.push_back(vertex);
+                VertexSkin skin = {};
+                if (!mesh->HasBones()) {
+                    skin.joints[0] = (unsigned int)n;
+                    skin.weights[0] = 1.0f;
+                }
+                model.skin.push_back(skin);
+            }
+            for (unsigned int b = 0; b < mesh->mNumBones; ++b) {
+                const aiBone* bone = mesh->mBones[b];
+                auto joint = jointByName.find(bone->mName.C_Str());
+                if (joint == jointByName.end()) {
+                    continue;
+                }
+                skeleton.inverseBind[joint->second] = ToGlm(bone->mOffsetMatrix);
+                for (unsigned int w = 0; w < bone->mNumWeights; ++w) {
+                    AddInfluence(model.skin[base + bone->mWeights[w].mVertexId], joint->second, bone->mWeights[w].mWeight);
+                }
+            }
+            // Vertices no bone weights ride on the node, like meshes without bones
+            glm::mat3 nodeNormal = glm::transpose(glm::inverse(glm::mat3(bindWorld[n])));
+            for (unsigned int v = base; mesh->HasBones() && v < model.vertices.size(); ++v) {
+                VertexSkin& skin = model.skin[v];
+                if (skin.weights[0] + skin.weights[1] + skin.weights[2] + skin.weights[3] > 0.0f) {
+                    continue;
+                }
+                skin.joints[0] = (unsigned int)n;
+                skin.weights[0] = 1.0f;
+                Vertex& vertex = model.vertices[v];
+                glm::vec3 p = glm::vec3(bindWorld[n] * glm::vec4(vertex.Position[0], vertex.Position[1], vertex.Position[2], 1.0f));
+                glm::vec3 normal = glm::normalize(nodeNormal * glm::vec3(vertex.Normal[0], vertex.Normal[1], vertex.Normal[2]));
+                vertex.Position[0] = p.x; vertex.Position[1] = p.y; vertex.Position[2] = p.z;
+                vertex.Normal[0] = normal.x; vertex.Normal[1] = normal.y; vertex.Normal[2] = normal.z;
+            }
+            for (unsigned int f = 0; f < mesh->mNumFaces; ++f) {
+                for (unsigned int i = 0; i < mesh->mFaces[f].mNumIndices; ++i) {
+                    model.indices.push_back(base + mesh->mFaces[f].mIndices[i]);
+                }
+            }
+
+            aiString texturePath;
+            if (model.textureID == 0 && scene->mMaterials[mesh->mMaterialIndex]->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == AI_SUCCESS) {
+                model.textureID = loadTexture((fs::path(path).parent_path() / texturePath.C_Str()).string());
+            }
+        }
+    }
+    for (VertexSkin& skin : model.skin) {
+        float total = skin.weights[0] + skin.weights[1] + skin.weights[2] + skin.weights[3];
+        for (float& weight : skin.weights) {
+            weight = total > 0.0f ? weight / total : 0.0f;
+        }
+    }
+
+    for (unsigned int a = 0; a < scene->mNumAnimations; ++a) {
+        const aiAnimation* animation = scene->mAnimations[a];
+        float ticksPerSecond = animation->mTicksPerSecond > 0.0 ? (float)animation->mTicksPerSecond : 25.0f;
+        AnimationClip clip;
+        clip.name = animation->mName.C_Str();
+        clip.duration = std::max((float)animation->mDuration / ticksPerSecond, 1e-3f);
+        for (unsigned int c = 0; c < animation->mNumChannels; ++c) {
+            const aiNodeAnim* source = animation->mChannels[c];
+            auto joint = jointByName.find(source->mNodeName.C_Str());
+            if (joint == jointByName.end()) {
+                continue;
+            }
+            AnimationChannel channel;
+            channel.joint = joint->second;
+            for (unsigned int k = 0; k < source->mNumPositionKeys; ++k) {
+                const aiVectorKey& key = source->mPositionKeys[k];
+                channel.positionTimes.push_back((float)key.mTime / ticksPerSecond);
+                channel.positions.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+            for (unsigned int k = 0; k < source->mNumRotationKeys; ++k) {
+                const aiQuatKey& key = source->mRotationKeys[k];
+                channel.rotationTimes.push_back((float)key.mTime / ticksPerSecond);
+                channel.rotations.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+            for (unsigned int k = 0; k < source->mNumScalingKeys; ++k) {
+                const aiVectorKey& key = source->mScalingKeys[k];
+                channel.scaleTimes.push_back((float)key.mTime / ticksPerSecond);
+                channel.scales.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+            clip.channels.push_back(std::move(channel));
+        }
+        model.clips.push_back(std::move(clip));
+    }
+    return !model.vertices.empty();
+}
+
+// Procedural parts are rigid: every vertex follows one joint. 'material' is added to u so one
+// texture and a few flat colors can share a draw.
+static void AddBox(SkinnedModel& model, glm::vec3 center, glm::vec3 size, unsigned int joint, float material = 0.0f) {
+    static const glm::vec3 normals[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+    for (const glm::vec3& n : normals) {
+        glm::vec3 u = glm::abs(n.y) > 0.5f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+        glm::vec3 v = glm::cross(n, u);
+        unsigned int base = (unsigned int)model.vertices.size();
+        for (int corner = 0; corner < 4; ++corner) {
+            glm::vec2 c = glm::vec2(corner & 1, corner >> 1);
+            glm::vec3 p = center + (n + u * (c.x * 2.0f - 1.0f) + v * (c.y * 2.0f - 1.0f)) * size * 0.5f;
+            model.vertices.push_back({ { p.x, p.y, p.z }, { n.x, n.y, n.z }, { c.x + material, c.y } });
+            model.skin.push_back({ { joint, 0, 0, 0 }, { 1.0f, 0.0f, 0.0f, 0.0f } });
+        }
+        model.indices.insert(model.indices.end(), { base, base + 1, base + 2, base + 2, base + 1, base + 3 });
+    }
+}
+
+static void AddSphere(SkinnedModel& model, glm::vec3 center, float radius, unsigned int joint, float material = 0.0f) {
+    const int rings = 10, segments = 16;
+    unsigned int base = (unsigned int)model.vertices.size();
+    for (int r = 0; r <= rings; ++r) {
+        for (int s = 0; s <= segments; ++s) {
+            glm::vec2 uv = glm::vec2((float)s / segments, (float)r / rings);
+            float theta = uv.y * glm::pi<float>(), phi = uv.x * glm::two_pi<float>();
+            glm::vec3 n = glm::vec3(std::sin(theta) * std::sin(phi), std::cos(theta), std::sin(theta) * std::cos(phi));
+            glm::vec3 p = center + n * radius;
+            model.vertices.push_back({ { p.x, p.y, p.z }, { n.x, n.y, n.z }, { uv.x + material, uv.y } });
+            model.skin.push_back({ { joint, 0, 0, 0 }, { 1.0f, 0.0f, 0.0f, 0.0f } });
+        }
+    }
+    for (int r = 0; r < rings; ++r) {
+        for (int s = 0; s < segments; ++s) {
+            unsigned int a = base + r * (segments + 1) + s, b = a + segments + 1;
+            model.indices.insert(model.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+}
+
+// Open cone from a base circle to a tip
+static void AddCone(SkinnedModel& model, glm::vec3 base, glm::vec3 tip, float radius, unsigned int joint, float material = 0.0f) {
+    const int segments = 8;
+    glm::vec3 axis = glm::normalize(tip - base);
+    glm::vec3 u = glm::normalize(glm::cross(axis, std::abs(axis.y) > 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0)));
+    glm::vec3 v = glm::cross(axis, u);
+    float slope = radius / glm::length(tip - base);
+    for (int s = 0; s < segments; ++s) {
+        unsigned int first = (unsigned int)model.vertices.size();
+        for (int k = 0; k < 2; ++k) {
+            float phi = (float)(s + k) / segments * glm::two_pi<float>();
+            glm::vec3 radial = u * std::cos(phi) + v * std::sin(phi);
+            glm::vec3 n = glm::normalize(radial + axis * slope);
+            glm::vec3 p = base + radial * radius;
+            model.vertices.push_back({ { p.x, p.y, p.z }, { n.x, n.y, n.z }, { material + (float)k, 0.0f } });
+            model.skin.push_back({ { joint, 0, 0, 0 }, { 1.0f, 0.0f, 0.0f, 0.0f } });
+        }
+        glm::vec3 n = glm::normalize(u * std::cos((s + 0.5f) / segments * glm::two_pi<float>()) + v * std::sin((s + 0.5f) / segments * glm::two_pi<float>()) + axis * slope);
+        model.vertices.push_back({ { tip.x, tip.y, tip.z }, { n.x, n.y, n.z }, { material + 0.5f, 1.0f } });
+        model.skin.push_back({ { joint, 0, 0, 0 }, { 1.0f, 0.0f, 0.0f, 0.0f } });
+        model.indices.insert(model.indices.end(), { first, first + 1, first + 2 });
+    }
+}
+
+struct JointDefinition {
+    const char* name;
+    int parent;
+    glm::vec3 offset;   // From the parent, in the unrotated bind pose
+};
+
+static void BuildSkeleton(Skeleton& skeleton, const JointDefinition* joints, size_t count) {
+    std::vector<glm::vec3> bindPosition;
+    for (size_t i = 0; i < count; ++i) {
+        const JointDefinition& joint = joints[i];
+        skeleton.names.push_back(joint.name);
+        skeleton.parents.push_back(joint.parent);
+        skeleton.bindTranslations.push_back(joint.offset);
+        skeleton.bindRotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+        skeleton.bindScales.push_back(glm::vec3(1.0f));
+        bindPosition.push_back(joint.parent < 0 ? joint.offset : bindPosition[joint.parent] + joint.offset);
+        skeleton.inverseBind.push_back(glm::translate(glm::mat4(1.0f), -bindPosition.back()));
+    }
+}
+
+// A looping clip from evenly spaced keys of a periodic motion; poseAt gets the phase (0..1)
+// and a pose holding the bind translations and identity rotations
+static void AddPeriodicClip(SkinnedModel& model, const char* name, float duration, const std::function<void(float, Pose&)>& poseAt) {
+    const Skeleton& skeleton = model.skeleton;
+    AnimationClip clip;
+    clip.name = name;
+    clip.duration = duration;
+    const int keys = 9;
+    Pose pose;
+    for (int k = 0; k < keys; ++k) {
+        float phase = (float)k / (keys - 1);
+        ResizePose(pose, skeleton.names.size());
+        pose.translations = skeleton.bindTranslations;
+        poseAt(phase, pose);
+        for (size_t j = 0; j < skeleton.names.size(); ++j) {
+            if (k == 0) {
+                clip.channels.push_back(AnimationChannel());
+                clip.channels.back().joint = (int)j;
+            }
+            AnimationChannel& channel = clip.channels[j];
+            channel.positionTimes.push_back(phase * duration);
+            channel.positions.push_back(pose.translations[j]);
+            channel.rotationTimes.push_back(phase * duration);
+            channel.rotations.push_back(pose.rotations[j]);
+        }
+    }
+    model.clips.push_back(std::move(clip));
+}
+
+void BuildProceduralCharacter(SkinnedModel& model) {
+    model = SkinnedModel();
+    static const JointDefinition joints[] = {
+        { "Root", -1, { 0.0f, 0.0f, 0.0f } },
+        { "Hips", 0, { 0.0f, 0.55f, 0.0f } },
+        { "Spine", 1, { 0.0f, 0.25f, 0.0f } },
+        { "Head", 2, { 0.0f, 0.32f, 0.0f } },
+        { "LeftShoulder", 2, { 0.2f, 0.25f, 0.0f } },
+        { "RightShoulder", 2, { -0.2f, 0.25f, 0.0f } },
+        { "LeftHip", 1, { 0.09f, 0.0f, 0.0f } },
+        { "RightHip", 1, { -0.09f, 0.0f, 0.0f } },
+    };
+    BuildSkeleton(model.skeleton, joints, sizeof(joints) / sizeof(joints[0]));
+
+    AddBox(model, { 0.0f, 0.6f, 0.0f }, { 0.3f, 0.15f, 0.18f }, 1);
+    AddBox(model, { 0.0f, 0.88f, 0.0f }, { 0.34f, 0.4f, 0.2f }, 2);
+    AddBox(model, { 0.0f, 1.24f, 0.0f }, { 0.22f, 0.22f, 0.22f }, 3);
+    AddBox(model, { 0.23f, 0.86f, 0.0f }, { 0.08f, 0.42f, 0.08f }, 4);
+    AddBox(model, { -0.23f, 0.86f, 0.0f }, { 0.08f, 0.42f, 0.08f }, 5);
+    AddBox(model, { 0.09f, 0.28f, 0.0f }, { 0.11f, 0.56f, 0.11f }, 6);
+    AddBox(model, { -0.09f, 0.28f, 0.0f }, { 0.11f, 0.56f, 0.11f }, 7);
+
+    const float tau = glm::two_pi<float>();
+    AddPeriodicClip(model, "Walk", 1.0f, [&](float phase, Pose& pose) {
+        float swing = std::sin(tau * phase);
+        pose.translations[1].y += 0.03f * std::abs(std::cos(tau * phase));
+        pose.rotations[2] = glm::angleAxis(0.1f * swing, glm::vec3(0, 1, 0));
+        pose.rotations[4] = glm::angleAxis(-0.5f * swing, glm::vec3(1, 0, 0));
+        pose.rotations[5] = glm::angleAxis(0.5f * swing, glm::vec3(1, 0, 0));
+        pose.rotations[6] = glm::angleAxis(0.6f * swing, glm::vec3(1, 0, 0));
+        pose.rotations[7] = glm::angleAxis(-0.6f * swing, glm::vec3(1, 0, 0));
+    });
+    AddPeriodicClip(model, "Wave", 1.2f, [&](float phase, Pose& pose) {
+        float wave = std::sin(2.0f * tau * phase);
+        pose.rotations[3] = glm::angleAxis(0.15f * std::sin(tau * phase), glm::vec3(1, 0, 0));
+        pose.rotations[5] = glm::angleAxis(-2.6f + 0.35f * wave, glm::vec3(0, 0, 1));
+        pose.rotations[4] = glm::angleAxis(0.1f, glm::vec3(0, 0, 1));
+    });
+}
+
+void BuildProceduralSnowman(SkinnedModel& model) {
+    model = SkinnedModel();
+    static const JointDefinition joints[] = {
+        { "Root", -1, { 0.0f, 0.0f, 0.0f } },
+        { "Body", 0, { 0.0f, 0.0f, 0.0f } },        // Pivots on the ground to rock
+        { "Middle", 1, { 0.0f, 0.62f, 0.0f } },
+        { "Head", 2, { 0.0f, 0.42f, 0.0f } },
+        { "LeftArm", 2, { 0.26f, 0.28f, 0.0f } },
+        { "RightArm", 2, { -0.26f, 0.28f, 0.0f } },
+    };
+    BuildSkeleton(model.skeleton, joints, sizeof(joints) / sizeof(joints[0]));
+
+    // Faces +z. Materials: 0 snow texture, 2 carrot, 4 coal, 6 wood
+    AddSphere(model, { 0.0f, 0.36f, 0.0f }, 0.38f, 1);
+    AddSphere(model, { 0.0f, 0.86f, 0.0f }, 0.27f, 2);
+    AddSphere(model, { 0.0f, 1.24f, 0.0f }, 0.19f, 3);
+    AddCone(model, { 0.0f, 1.24f, 0.17f }, { 0.0f, 1.22f, 0.38f }, 0.04f, 3, 2.0f);
+    AddBox(model, { 0.07f, 1.3f, 0.17f }, glm::vec3(0.04f), 3, 4.0f);
+    AddBox(model, { -0.07f, 1.3f, 0.17f }, glm::vec3(0.04f), 3, 4.0f);
+    AddBox(model, { 0.0f, 1.41f, 0.0f }, { 0.34f, 0.03f, 0.34f }, 3, 4.0f);
+    AddBox(model, { 0.0f, 1.53f, 0.0f }, { 0.22f, 0.22f, 0.22f }, 3, 4.0f);
+    AddBox(model, { 0.0f, 0.95f, 0.26f }, glm::vec3(0.04f), 2, 4.0f);
+    AddBox(model, { 0.0f, 0.82f, 0.27f }, glm::vec3(0.04f), 2, 4.0f);
+    AddBox(model, { 0.46f, 0.92f, 0.0f }, { 0.4f, 0.035f, 0.035f }, 4, 6.0f);
+    AddBox(model, { -0.46f, 0.92f, 0.0f }, { 0.4f, 0.035f, 0.035f }, 5, 6.0f);
+
+    const float tau = glm::two_pi<float>();
+    AddPeriodicClip(model, "Waddle", 0.8f, [&](float phase, Pose& pose) {
+        float rock = std::sin(tau * phase);
+        pose.translations[1].y += 0.015f * (1.0f - std::cos(2.0f * tau * phase));
+        pose.rotations[1] = glm::angleAxis(0.12f * std::cos(tau * phase), glm::vec3(0, 1, 0)) * glm::angleAxis(0.2f * rock, glm::vec3(0, 0, 1));
+        pose.rotations[2] = glm::angleAxis(-0.1f * rock, glm::vec3(0, 0, 1));
+        pose.rotations[3] = glm::angleAxis(-0.08f * std::sin(tau * phase - 0.6f), glm::vec3(0, 0, 1));
+        pose.rotations[4] = glm::angleAxis(0.25f * rock, glm::vec3(0, 0, 1));
+        pose.rotations[5] = glm::angleAxis(0.25f * rock, glm::vec3(0, 0, 1));
+    });
+    AddPeriodicClip(model, "Wave", 1.0f, [&](float phase, Pose& pose) {
+        pose.rotations[1] = glm::angleAxis(0.05f * std::sin(tau * phase), glm::vec3(0, 0, 1));
+        pose.rotations[3] = glm::angleAxis(0.1f * std::sin(tau * phase), glm::vec3(0, 0, 1));
+        pose.rotations[5] = glm::angleAxis(-0.9f + 0.35f * std::sin(2.0f * tau * phase), glm::vec3(0, 0, 1));
+    });
+}
+
+void ResizePose(Pose& pose, size_t jointCount) {
+    pose.translations.resize(jointCount);
+    pose.rotations.assign(jointCount, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    pose.scales.assign(jointCount, glm::vec3(1.0f));
+}
+
+// The track's value at 'time', interpolated between the keys around it and held at the ends;
+// fallback when the track has no keys
+template <typename T>
+static T SampleKeys(const std::vector<float>& times, const std::vector<T>& values, float time, const T& fallback,
+    T (*interpolate)(const T&, const T&, float)) {
+    if (values.empty()) {
+        return fallback;
+    }
+    size_t next = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+    if (next == 0) {
+        return values.front();
+    }
+    if (next >= values.size()) {
+        return values.back();
+    }
+    float span = times[next] - times[next - 1];
+    float t = span > 0.0f ? (time - times[next - 1]) / span : 0.0f;
+    return interpolate(values[next - 1], values[next], t);
+}
+
+static glm::vec3 LerpVector(const glm::vec3& a, const glm::vec3& b, float t) {
+    return glm::mix(a, b, t);
+}
+
+static glm::quat SlerpRotation(const glm::quat& a, const glm::quat& b, float t) {
+    return glm::slerp(a, b, t);
+}
+
+void SampleClip(const AnimationClip& clip, const Skeleton& skeleton, float time, Pose& pose) {
+    pose.translations = skeleton.bindTranslations;
+    pose.rotations = skeleton.bindRotations;
+    pose.scales = skeleton.bindScales;
+    float t = std::fmod(std::max(time, 0.0f), clip.duration);
+    for (const AnimationChannel& channel : clip.channels) {
+        int j = channel.joint;
+        pose.translations[j] = SampleKeys(channel.positionTimes, channel.positions, t, skeleton.bindTranslations[j], LerpVector);
+        pose.rotations[j] = SampleKeys(channel.rotationTimes, channel.rotations, t, skeleton.bindRotations[j], SlerpRotation);
+        pose.scales[j] = SampleKeys(channel.scaleTimes, channel.scales, t, skeleton.bindScales[j], LerpVector);
+    }
+}
+
+void BlendPoses(const Pose& a, const Pose& b, float weight, Pose& result) {
+    size_t count = a.translations.size();
+    result.translations.resize(count);
+    result.rotations.resize(count);
+    result.scales.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        result.translations[i] = glm::mix(a.translations[i], b.translations[i], weight);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        // Normalized lerp along the shorter arc; plenty for blending nearby poses
+        glm::quat to = glm::dot(a.rotations[i], b.rotations[i]) < 0.0f ? -b.rotations[i] : b.rotations[i];
+        result.rotations[i] = glm::normalize(a.rotations[i] * (1.0f - weight) + to * weight);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        result.scales[i] = glm::mix(a.scales[i], b.scales[i], weight);
+    }
+}
+
+void ComputeSkinningMatrices(const Skeleton& skeleton, const Pose& pose, const glm::mat4& root,
+    std::vector<glm::mat4>& world, glm::mat4* skinning) {
+    size_t count = skeleton.parents.size();
+    world.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        glm::mat4 local = ComposeTransform(pose.translations[i], pose.rotations[i], pose.scales[i]);
+        int parent = skeleton.parents[i];
+        world[i] = (parent < 0 ? root : world[parent]) * local;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        skinning[i] = world[i] * skeleton.inverseBind[i];
+    }
+}
+
+void SkinVertices(const glm::mat4* palette, const VertexSkin* skin, const glm::vec4* rest, glm::vec4* out, int begin, int end) {
+    for (int v = begin; v < end; ++v) {
+        const VertexSkin& s = skin[v];
+        const float* m = glm::value_ptr(palette[s.joints[0]]);
+        __m128 w = _mm_set1_ps(s.weights[0]);
+        __m128 c0 = _mm_mul_ps(_mm_loadu_ps(m), w);
+        __m128 c1 = _mm_mul_ps(_mm_loadu_ps(m + 4), w);
+        __m128 c2 = _mm_mul_ps(_mm_loadu_ps(m + 8), w);
+        __m128 c3 = _mm_mul_ps(_mm_loadu_ps(m + 12), w);
+        for (int k = 1; k < SKIN_MAX_INFLUENCES; ++k) {
+            m = glm::value_ptr(palette[s.joints[k]]);
+            w = _mm_set1_ps(s.weights[k]);
+            c0 = _mm_add_ps(c0, _mm_mul_ps(_mm_loadu_ps(m), w));
+            c1 = _mm_add_ps(c1, _mm_mul_ps(_mm_loadu_ps(m + 4), w));
+            c2 = _mm_add_ps(c2, _mm_mul_ps(_mm_loadu_ps(m + 8), w));
+            c3 = _mm_add_ps(c3, _mm_mul_ps(_mm_loadu_ps(m + 12), w));
+        }
+        const float* p = &rest[v * 2].x;
+        const float* n = &rest[v * 2 + 1].x;
+        __m128 position = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p[0])), _mm_mul_ps(c1, _mm_set1_ps(p[1]))),
+            _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p[2])), c3));
+        __m128 normal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(n[0])), _mm_mul_ps(c1, _mm_set1_ps(n[1]))),
+            _mm_mul_ps(c2, _mm_set1_ps(n[2])));
+        _mm_storeu_ps(&out[v * 2].x, position);
+        _mm_storeu_ps(&out[v * 2 + 1].x, normal);
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+
+// Skeletal animation data and evaluation.
+// The node hierarchy is flattened into a joint array ordered so every parent comes before its
+// children, which turns local-to-world into one forward pass over a parent index array. Poses
+// are structure-of-arrays (translations, rotations, scales) so sampling and blending stream
+// through contiguous memory.
+const int SKIN_MAX_INFLUENCES = 4;
+
+struct Skeleton {
+    std::vector<std::string> names;
+    std::vector<int> parents;                  // -1 for roots, otherwise an earlier index
+    std::vector<glm::vec3> bindTranslations;   // Local bind pose, used for joints a clip doesn't animate
+    std::vector<glm::quat> bindRotations;
+    std::vector<glm::vec3> bindScales;
+    std::vector<glm::mat4> inverseBind;        // Mesh space to joint space
+};
+
+struct Pose {
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+};
+
+struct AnimationChannel {
+    int joint = 0;
+    std::vector<float> positionTimes;
+    std::vector<glm::vec3> positions;
+    std::vector<float> rotationTimes;
+    std::vector<glm::quat> rotations;
+    std::vector<float> scaleTimes;
+    std::vector<glm::vec3> scales;
+};
+
+struct AnimationClip {
+    std::string name;
+    float duration = 1.0f;                     // Seconds
+    std::vector<AnimationChannel> channels;
+};
+
+// Per vertex joint influences, parallel to the vertex array
+struct VertexSkin {
+    unsigned int joints[SKIN_MAX_INFLUENCES];
+    float weights[SKIN_MAX_INFLUENCES];
+};
+
+struct SkinnedModel {
+    std::vector<Vertex> vertices;              // Bind pose
+    std::vector<VertexSkin> skin;
+    std::vector<unsigned int> indices;
+    GLuint textureID = 0;
+    Skeleton skeleton;
+    std::vector<AnimationClip> clips;
+};
+
+// Imports a rigged model with its clips; all meshes are merged into one skinned mesh
+bool LoadSkinnedModel(const std::string& path, SkinnedModel& model, std::function<GLuint(const std::string&)> loadTexture);
+
+// A small rigged figure with "Walk" and "Wave" clips, for scenes without a rigged asset
+void BuildProceduralCharacter(SkinnedModel& model);
+
+// A snowman with "Waddle" and "Wave" clips. u is offset by 2 for the carrot, 4 for coal and
+// the hat and 6 for the stick arms, so a shader can color those without a texture.
+void BuildProceduralSnowman(SkinnedModel& model);
+
+void ResizePose(Pose& pose, size_t jointCount);
+
+// Samples a looping clip; joints without a channel take the bind pose
+void SampleClip(const AnimationClip& clip, const Skeleton& skeleton, float time, Pose& pose);
+void BlendPoses(const Pose& a, const Pose& b, float weight, Pose& result);
+
+// Joint world matrices under 'root', then skinning matrices (world * inverse bind) into 'skinning'
+void ComputeSkinningMatrices(const Skeleton& skeleton, const Pose& pose, const glm::mat4& root,
+    std::vector<glm::mat4>& world, glm::mat4* skinning);
+
+// Blends each vertex's four weighted skinning matrices with SSE and transforms its bind position
+// and normal. 'rest' and 'out' hold position, normal pairs; vertices [begin, end) are skinned.
+void SkinVertices(const glm::mat4* palette, const VertexSkin* skin, const glm::vec4* rest, glm::vec4* out, int begin, int end);
@@ -0,0 +1,698 @@
+#include "Bvh.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <emmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+const int BVH_PARALLEL_BINNING = 65536;   // Ranges at least this large are binned across the pool
+const int BVH_BINNING_CHUNK = 16384;
+const int BVH_MIN_LEAF = 4;               // Ranges this small are leaves without trying a split
+
+// What a tree is built over. Ranges are partitioned in place, so every pass reads them in order.
+struct BvhPrimitive {
+    glm::vec3 boundsMin;
+    int index;                // Triangle or instance
+    glm::vec3 boundsMax;
+    float padding;            // So each corner loads as one SSE register
+};
+typedef std::vector<BvhPrimitive> BvhPrimitives;
+
+// Twice the center of the bounds; only ever compared with others made the same way
+static glm::vec3 Centroid(const BvhPrimitive& primitive) {
+    return primitive.boundsMin + primitive.boundsMax;
+}
+
+struct BvhBin {
+    glm::vec3 boundsMin = glm::vec3(1e30f);
+    glm::vec3 boundsMax = glm::vec3(-1e30f);
+    int count = 0;
+};
+
+// A range's bounds and its centroids' bounds
+struct BvhRange {
+    glm::vec3 boundsMin = glm::vec3(1e30f), boundsMax = glm::vec3(-1e30f);
+    glm::vec3 centroidMin = glm::vec3(1e30f), centroidMax = glm::vec3(-1e30f);
+};
+
+struct BvhSplit {
+    int axis = -1;
+    int bin = 0;              // Last bin on the left
+    float cost = 1e30f;       // Left area * count + right area * count
+    glm::vec3 leftMin, leftMax, rightMin, rightMax;
+};
+
+struct BvhBuildTask {
+    int mesh, node, first, count;
+    BvhRange range;
+    int depth;
+};
+
+static float HalfArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 e = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+static int ChunkCount(int count, ThreadPool* pool) {
+    return pool && count >= BVH_PARALLEL_BINNING ? (count + BVH_BINNING_CHUNK - 1) / BVH_BINNING_CHUNK : 1;
+}
+
+// Runs body(begin, end) over the range, in chunks across the pool when it is large
+template <typename Body>
+static void ForChunks(ThreadPool* pool, int first, int count, Body body) {
+    int chunks = ChunkCount(count, pool);
+    if (chunks == 1) {
+        body(0, first, first + count);
+        return;
+    }
+    ParallelFor(*pool, chunks, 1, [&](int begin, int end) {
+        for (int c = begin; c < end; ++c) {
+            body(c, first + c * BVH_BINNING_CHUNK, std::min(first + (c + 1) * BVH_BINNING_CHUNK, first + count));
+        }
+    });
+}
+
+// Bounds of a root's primitives; below the root they come out of the split
+static BvhRange RangeBounds(const BvhPrimitives& p, int first, int count, ThreadPool* pool) {
+    // Per chunk results; most ranges are one chunk and stay off the heap
+    int chunks = ChunkCount(count, pool);
+    glm::vec3 single[4];
+    std::vector<glm::vec3> several(chunks > 1 ? chunks * 4 : 0);
+    glm::vec3* partial = chunks > 1 ? several.data() : single;
+    ForChunks(pool, first, count, [&](int chunk, int begin, int end) {
+        glm::vec3 lo(1e30f), hi(-1e30f), centroidLo(1e30f), centroidHi(-1e30f);
+        for (int i = begin; i < end; ++i) {
+            lo = glm::min(lo, p[i].boundsMin);
+            hi = glm::max(hi, p[i].boundsMax);
+            centroidLo = glm::min(centroidLo, Centroid(p[i]));
+            centroidHi = glm::max(centroidHi, Centroid(p[i]));
+        }
+        glm::vec3* out = &partial[chunk * 4];
+        out[0] = lo; out[1] = hi; out[2] = centroidLo; out[3] = centroidHi;
+    });
+    BvhRange range;
+    for (int c = 0; c < chunks * 4; c += 4) {
+        range.boundsMin = glm::min(range.boundsMin, partial[c]);
+        range.boundsMax = glm::max(range.boundsMax, partial[c + 1]);
+        range.centroidMin = glm::min(range.centroidMin, partial[c + 2]);
+        range.centroidMax = glm::max(range.centroidMax, partial[c + 3]);
+    }
+    return range;
+}
+
+// Bin along each axis, x y z in the first three lanes. Binning and partitioning both use this,
+// so a primitive always lands on the side whose bounds it was counted in.
+static __m128i BinsOf(const BvhPrimitive& primitive, __m128 centroidMin, __m128 scale) {
+    __m128 centroid = _mm_add_ps(_mm_loadu_ps(&primitive.boundsMin.x), _mm_loadu_ps(&primitive.boundsMax.x));
+    __m128i bins = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(centroid, centroidMin), scale));
+    __m128i last = _mm_set1_epi32(BVH_BINS - 1);
+    __m128i over = _mm_cmpgt_epi32(bins, last);
+    return _mm_or_si128(_mm_and_si128(over, last), _mm_andnot_si128(over, bins));
+}
+
+// Cheapest split over BVH_BINS bins per axis of the centroid bounds
+static BvhSplit FindSplit(const BvhPrimitives& p, int first, int count, const glm::vec3& centroidMin, const glm::vec3& centroidMax, ThreadPool* pool) {
+    glm::vec3 extent = centroidMax - centroidMin;
+    int chunks = ChunkCount(count, pool);
+    BvhBin single[3 * BVH_BINS];
+    std::vector<BvhBin> several(chunks > 1 ? chunks * 3 * BVH_BINS : 0);
+    BvhBin* bins = chunks > 1 ? several.data() : single;
+    // Flat axes put everything in their first bin, which never splits
+    glm::vec3 scale = glm::vec3(BVH_BINS) / glm::max(extent, glm::vec3(1e-30f));
+    __m128 origin = _mm_setr_ps(centroidMin.x, centroidMin.y, centroidMin.z, 0.0f);
+    __m128 binScale = _mm_setr_ps(scale.x, scale.y, scale.z, 0.0f);
+    ForChunks(pool, first, count, [&](int chunk, int begin, int end) {
+        // Bounds grow in SSE registers; the fourth lane is ignored
+        __m128 binMin[3 * BVH_BINS], binMax[3 * BVH_BINS];
+        int binCount[3 * BVH_BINS] = {};
+        for (int b = 0; b < 3 * BVH_BINS; ++b) {
+            binMin[b] = _mm_set1_ps(1e30f);
+            binMax[b] = _mm_set1_ps(-1e30f);
+        }
+        alignas(16) int lanes[4];
+        for (int i = begin; i < end; ++i) {
+            __m128 boundsMin = _mm_loadu_ps(&p[i].boundsMin.x), boundsMax = _mm_loadu_ps(&p[i].boundsMax.x);
+            _mm_store_si128((__m128i*)lanes, BinsOf(p[i], origin, binScale));
+            for (int axis = 0; axis < 3; ++axis) {
+                int b = axis * BVH_BINS + lanes[axis];
+                binMin[b] = _mm_min_ps(binMin[b], boundsMin);
+                binMax[b] = _mm_max_ps(binMax[b], boundsMax);
+                binCount[b]++;
+            }
+        }
+        BvhBin* chunkBins = &bins[chunk * 3 * BVH_BINS];
+        for (int b = 0; b < 3 * BVH_BINS; ++b) {
+            alignas(16) float lo[4], hi[4];
+            _mm_store_ps(lo, binMin[b]);
+            _mm_store_ps(hi, binMax[b]);
+            chunkBins[b] = { glm::vec3(lo[0], lo[1], lo[2]), glm::vec3(hi[0], hi[1], hi[2]), binCount[b] };
+        }
+    });
+    for (int chunk = 1; chunk < chunks; ++chunk) {
+        for (int b = 0; b < 3 * BVH_BINS; ++b) {
+            BvhBin& into = bins[b];
+            const BvhBin& from = bins[chunk * 3 * BVH_BINS + b];
+            into.boundsMin = glm::min(into.boundsMin, from.boundsMin);
+            into.boundsMax = glm::max(into.boundsMax, from.boundsMax);
+            into.count += from.count;
+        }
+    }
+
+    BvhSplit best;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (extent[axis] <= 0.0f) {
+            continue;
+        }
+        const BvhBin* axisBins = &bins[axis * BVH_BINS];
+        // Left side costs sweeping up, right side sweeping down
+        BvhBin left[BVH_BINS - 1];
+        BvhBin side;
+        for (int b = 0; b < BVH_BINS - 1; ++b) {
+            side.boundsMin = glm::min(side.boundsMin, axisBins[b].boundsMin);
+            side.boundsMax = glm::max(side.boundsMax, axisBins[b].boundsMax);
+            side.count += axisBins[b].count;
+            left[b] = side;
+        }
+        side = BvhBin();
+        for (int b = BVH_BINS - 1; b > 0; --b) {
+            side.boundsMin = glm::min(side.boundsMin, axisBins[b].boundsMin);
+            side.boundsMax = glm::max(side.boundsMax, axisBins[b].boundsMax);
+            side.count += axisBins[b].count;
+            const BvhBin& leftSide = left[b - 1];
+            if (side.count == 0 || leftSide.count == 0) {
+                continue;
+            }
+            float cost = HalfArea(leftSide.boundsMin, leftSide.boundsMax) * leftSide.count + HalfArea(side.boundsMin, side.boundsMax) * side.count;
+            if (cost < best.cost) {
+                best = { axis, b - 1, cost, leftSide.boundsMin, leftSide.boundsMax, side.boundsMin, side.boundsMax };
+            }
+        }
+    }
+    return best;
+}
+
+// Fills in nodes[index] over the range and splits it in two if that pays off by the SAH.
+// Returns where the right half starts, with the halves' ranges, or -1 if the node stays a leaf.
+// Nodes at depth BVH_STACK_SIZE - 1 always stay leaves, so traversal never runs out of stack.
+static int SplitRange(BvhPrimitives& p, std::vector<BvhNode>& nodes, int index, int first, int count, const BvhRange& range,
+    int depth, ThreadPool* pool, BvhRange halves[2]) {
+    nodes[index] = { range.boundsMin, first, range.boundsMax, count };
+    if (count <= BVH_MIN_LEAF || depth >= BVH_STACK_SIZE - 1) {
+        return -1;
+    }
+    BvhSplit split = FindSplit(p, first, count, range.centroidMin, range.centroidMax, pool);
+    if (split.axis < 0) {
+        return -1;
+    }
+    // In units of one triangle test, with a node visit costing the same
+    float splitCost = 1.0f + split.cost / std::max(HalfArea(range.boundsMin, range.boundsMax), 1e-20f);
+    if (count <= BVH_MAX_LEAF && splitCost >= (float)count) {
+        return -1;
+    }
+    // Partition, gathering each half's centroid bounds on the way
+    glm::vec3 scale = glm::vec3(BVH_BINS) / glm::max(range.centroidMax - range.centroidMin, glm::vec3(1e-30f));
+    __m128 origin = _mm_setr_ps(range.centroidMin.x, range.centroidMin.y, range.centroidMin.z, 0.0f);
+    __m128 binScale = _mm_setr_ps(scale.x, scale.y, scale.z, 0.0f);
+    halves[0] = { split.leftMin, split.leftMax };
+    halves[1] = { split.rightMin, split.rightMax };
+    auto goesLeft = [&](const BvhPrimitive& primitive, BvhRange& half) {
+        alignas(16) int lanes[4];
+        _mm_store_si128((__m128i*)lanes, BinsOf(primitive, origin, binScale));
+        bool left = lanes[split.axis] <= split.bin;
+        glm::vec3 centroid = Centroid(primitive);
+        if (left == (&half == &halves[0])) {
+            half.centroidMin = glm::min(half.centroidMin, centroid);
+            half.centroidMax = glm::max(half.centroidMax, centroid);
+        }
+        return left;
+    };
+    int i = first, j = first + count - 1;
+    for (;;) {
+        while (i <= j && goesLeft(p[i], halves[0])) {
+            ++i;
+        }
+        while (i <= j && !goesLeft(p[j], halves[1])) {
+            --j;
+        }
+        if (i >= j) {
+            break;
+        }
+        std::swap(p[i], p[j]);
+    }
+    if (i == first || i == first + count) {
+        return -1;
+    }
+    int left = (int)nodes.size();
+    nodes.resize(left + 2);
+    nodes[index].leftFirst = left;
+    nodes[index].count = 0;
+    return i;
+}
+
+static void BuildSubtree(BvhPrimitives& p, std::vector<BvhNode>& nodes, int index, int first, int count, const BvhRange& range, int depth) {
+    BvhRange halves[2];
+    int mid = SplitRange(p, nodes, index, first, count, range, depth, nullptr, halves);
+    if (mid < 0) {
+        return;
+    }
+    int left = nodes[index].leftFirst;
+    BuildSubtree(p, nodes, left, first, mid - first, halves[0], depth + 1);
+    BuildSubtree(p, nodes, left + 1, mid, first + count - mid, halves[1], depth + 1);
+}
+
+void BuildSceneBvh(SceneBvh& bvh, const std::vector<Mesh>& meshes, ThreadPool& pool) {
+    auto start = std::chrono::high_resolution_clock::now();
+    bvh.meshes.assign(meshes.size(), BvhMesh());
+    bvh.instances.assign(meshes.size(), BvhInstance());
+    std::vector<BvhPrimitives> primitives(meshes.size());
+    std::vector<BvhBuildTask> tasks;
+    bvh.triangleCount = 0;
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        const Mesh& mesh = meshes[m];
+        BvhPrimitives& p = primitives[m];
+        int count = (int)(mesh.indices.size() / 3);
+        p.resize(count);
+        ParallelFor(pool, count, 4096, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                glm::vec3 a = glm::make_vec3(mesh.vertices[mesh.indices[3 * i]].Position);
+                glm::vec3 b = glm::make_vec3(mesh.vertices[mesh.indices[3 * i + 1]].Position);
+                glm::vec3 c = glm::make_vec3(mesh.vertices[mesh.indices[3 * i + 2]].Position);
+                p[i] = { glm::min(glm::min(a, b), c), i, glm::max(glm::max(a, b), c), 0.0f };
+            }
+        });
+        bvh.instances[m].mesh = (int)m;
+        if (count > 0) {
+            bvh.meshes[m].nodes.resize(1);
+            tasks.push_back({ (int)m, 0, 0, count, RangeBounds(p, 0, count, &pool), 0 });
+        }
+        bvh.triangleCount += count;
+    }
+
+    // Split the largest ranges here, binning across the pool, until there are enough to hand out whole
+    int threshold = std::max(bvh.triangleCount / (8 * ((int)pool.workers.size() + 1)), 4096);
+    std::vector<BvhBuildTask> subtrees;
+    while (!tasks.empty()) {
+        BvhBuildTask task = tasks.back();
+        tasks.pop_back();
+        if (task.count <= threshold) {
+            subtrees.push_back(task);
+            continue;
+        }
+        std::vector<BvhNode>& nodes = bvh.meshes[task.mesh].nodes;
+        BvhRange halves[2];
+        int mid = SplitRange(primitives[task.mesh], nodes, task.node, task.first, task.count, task.range, task.depth, &pool, halves);
+        if (mid >= 0) {
+            int left = nodes[task.node].leftFirst;
+            tasks.push_back({ task.mesh, left, task.first, mid - task.first, halves[0], task.depth + 1 });
+            tasks.push_back({ task.mesh, left + 1, mid, task.first + task.count - mid, halves[1], task.depth + 1 });
+        }
+    }
+
+    // Then one subtree per task, largest first, each into its own nodes; ranges don't overlap
+    std::sort(subtrees.begin(), subtrees.end(), [](const BvhBuildTask& x, const BvhBuildTask& y) { return x.count > y.count; });
+    std::vector<std::vector<BvhNode>> subtreeNodes(subtrees.size());
+    ParallelFor(pool, (int)subtrees.size(), 1, [&](int begin, int end) {
+        for (int t = begin; t < end; ++t) {
+            subtreeNodes[t].resize(1);
+            const BvhBuildTask& task = subtrees[t];
+            BuildSubtree(primitives[task.mesh], subtreeNodes[t], 0, task.first, task.count, task.range, task.depth);
+        }
+    });
+    // Each subtree's root takes the node reserved for it, the rest go on the end
+    for (size_t t = 0; t < subtrees.size(); ++t) {
+        std::vector<BvhNode>& nodes = bvh.meshes[subtrees[t].mesh].nodes;
+        int offset = (int)nodes.size() - 1;
+        for (size_t i = 0; i < subtreeNodes[t].size(); ++i) {
+            BvhNode node = subtreeNodes[t][i];
+            if (node.count == 0) {
+                node.leftFirst += offset;
+            }
+            if (i == 0) {
+                nodes[subtrees[t].node] = node;
+            }
+            else {
+                nodes.push_back(node);
+            }
+        }
+    }
+
+    bvh.nodeCount = 0;
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        const Mesh& mesh = meshes[m];
+        BvhMesh& target = bvh.meshes[m];
+        const BvhPrimitives& p = primitives[m];
+        target.triangles.resize(p.size());
+        target.triangleIndex.resize(p.size());
+        ParallelFor(pool, (int)p.size(), 4096, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                int k = p[i].index;
+                target.triangleIndex[i] = k;
+                glm::vec3 a = glm::make_vec3(mesh.vertices[mesh.indices[3 * k]].Position);
+                glm::vec3 b = glm::make_vec3(mesh.vertices[mesh.indices[3 * k + 1]].Position);
+                glm::vec3 c = glm::make_vec3(mesh.vertices[mesh.indices[3 * k + 2]].Position);
+                target.triangles[i] = { a, b - a, c - a };
+            }
+        });
+        bvh.nodeCount += (int)target.nodes.size();
+    }
+    BuildBvhTopLevel(bvh);
+    bvh.buildMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void SetBvhInstanceTransform(SceneBvh& bvh, int instance, const glm::mat4& transform) {
+    bvh.instances[instance].transform = transform;
+    bvh.instances[instance].inverse = glm::inverse(transform);
+}
+
+void BuildBvhTopLevel(SceneBvh& bvh) {
+    BvhPrimitives p;
+    for (int i = 0; i < (int)bvh.instances.size(); ++i) {
+        const BvhInstance& instance = bvh.instances[i];
+        const std::vector<BvhNode>& nodes = bvh.meshes[instance.mesh].nodes;
+        if (nodes.empty()) {
+            continue;
+        }
+        BvhPrimitive primitive = { glm::vec3(1e30f), i, glm::vec3(-1e30f), 0.0f };
+        for (int corner = 0; corner < 8; ++corner) {
+            glm::vec3 local((corner & 1) ? nodes[0].boundsMax.x : nodes[0].boundsMin.x,
+                (corner & 2) ? nodes[0].boundsMax.y : nodes[0].boundsMin.y,
+                (corner & 4) ? nodes[0].boundsMax.z : nodes[0].boundsMin.z);
+            glm::vec3 world = glm::vec3(instance.transform * glm::vec4(local, 1.0f));
+            primitive.boundsMin = glm::min(primitive.boundsMin, world);
+            primitive.boundsMax = glm::max(primitive.boundsMax, world);
+        }
+        p.push_back(primitive);
+    }
+    bvh.topNodes.clear();
+    if (!p.empty()) {
+        bvh.topNodes.resize(1);
+        BuildSubtree(p, bvh.topNodes, 0, 0, (int)p.size(), RangeBounds(p, 0, (int)p.size(), nullptr), 0);
+    }
+    bvh.topOrder.resize(p.size());
+    for (size_t i = 0; i < p.size(); ++i) {
+        bvh.topOrder[i] = p[i].index;
+    }
+}
+
+// Single rays
+
+static glm::vec3 SafeInverse(const glm::vec3& d) {
+    glm::vec3 inverse;
+    for (int axis = 0; axis < 3; ++axis) {
+        inverse[axis] = 1.0f / (std::abs(d[axis]) > 1e-20f ? d[axis] : std::copysign(1e-20f, d[axis]));
+    }
+    return inverse;
+}
+
+// Distance along the ray to the box, or 1e30 if it misses or starts past tMax
+static float BoxEntry(const BvhNode& node, const glm::vec3& origin, const glm::vec3& inverse, float tMax) {
+    glm::vec3 t1 = (node.boundsMin - origin) * inverse;
+    glm::vec3 t2 = (node.boundsMax - origin) * inverse;
+    glm::vec3 near = glm::min(t1, t2), far = glm::max(t1, t2);
+    float tNear = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+    float tFar = std::min(std::min(far.x, far.y), std::min(far.z, tMax));
+    return tNear <= tFar ? tNear : 1e30f;
+}
+
+static bool IntersectTriangle(const BvhTriangle& triangle, const glm::vec3& origin, const glm::vec3& direction, float& t, float& u, float& v) {
+    glm::vec3 p = glm::cross(direction, triangle.edge2);
+    float det = glm::dot(triangle.edge1, p);
+    if (det == 0.0f) {
+        return false;
+    }
+    float inverseDet = 1.0f / det;
+    glm::vec3 s = origin - triangle.v0;
+    u = glm::dot(s, p) * inverseDet;
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+    glm::vec3 q = glm::cross(s, triangle.edge1);
+    v = glm::dot(direction, q) * inverseDet;
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+    t = glm::dot(triangle.edge2, q) * inverseDet;
+    return t > 0.0f;
+}
+
+// Visits the leaves the ray reaches, nearest box first, skipping boxes beyond tMax as it shrinks.
+// leaf(node) returns true to stop.
+template <typename Leaf>
+static void Traverse(const std::vector<BvhNode>& nodes, const glm::vec3& origin, const glm::vec3& direction, const float& tMax, Leaf leaf) {
+    glm::vec3 inverse = SafeInverse(direction);
+    if (nodes.empty() || BoxEntry(nodes[0], origin, inverse, tMax) >= 1e30f) {
+        return;
+    }
+    int stack[BVH_STACK_SIZE];
+    float stackEntry[BVH_STACK_SIZE];
+    int top = 0;
+    int index = 0;
+    for (;;) {
+        const BvhNode& node = nodes[index];
+        if (node.count > 0) {
+            if (leaf(node)) {
+                return;
+            }
+        }
+        else {
+            int near = node.leftFirst, far = node.leftFirst + 1;
+            float nearEntry = BoxEntry(nodes[near], origin, inverse, tMax);
+            float farEntry = BoxEntry(nodes[far], origin, inverse, tMax);
+            if (farEntry < nearEntry) {
+                std::swap(near, far);
+                std::swap(nearEntry, farEntry);
+            }
+            if (nearEntry < 1e30f) {
+                if (farEntry < 1e30f) {
+                    stack[top] = far;
+                    stackEntry[top++] = farEntry;
+                }
+                index = near;
+                continue;
+            }
+        }
+        do {
+            if (top == 0) {
+                return;
+            }
+            index = stack[--top];
+        } while (stackEntry[top] > tMax);
+    }
+}
+
+bool TraceRay(const SceneBvh& bvh, const BvhRay& ray, BvhHit& hit, bool anyHit) {
+    hit = BvhHit();
+    hit.t = ray.tMax;
+    bool found = false;
+    Traverse(bvh.topNodes, ray.origin, ray.direction, hit.t, [&](const BvhNode& topLeaf) {
+        for (int i = topLeaf.leftFirst; i < topLeaf.leftFirst + topLeaf.count; ++i) {
+            int instanceIndex = bvh.topOrder[i];
+            const BvhInstance& instance = bvh.instances[instanceIndex];
+            const BvhMesh& mesh = bvh.meshes[instance.mesh];
+            // Directions aren't renormalized, so t means the same in both spaces
+            glm::vec3 origin = glm::vec3(instance.inverse * glm::vec4(ray.origin, 1.0f));
+            glm::vec3 direction = glm::mat3(instance.inverse) * ray.direction;
+            bool stop = false;
+            Traverse(mesh.nodes, origin, direction, hit.t, [&](const BvhNode& leaf) {
+                for (int k = leaf.leftFirst; k < leaf.leftFirst + leaf.count; ++k) {
+                    float t, u, v;
+                    if (IntersectTriangle(mesh.triangles[k], origin, direction, t, u, v) && t < hit.t) {
+                        hit = { t, instanceIndex, mesh.triangleIndex[k], u, v };
+                        found = true;
+                        if (anyHit) {
+                            stop = true;
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            });
+            if (stop) {
+                return true;
+            }
+        }
+        return false;
+    });
+    if (!found) {
+        hit.t = 1e30f;
+    }
+    return found;
+}
+
+// Packets of four rays, one per SSE lane
+
+struct BvhPacket {
+    __m128 origin[3], direction[3], inverse[3];
+    __m128 tMax;
+};
+
+// Lanes whose ray enters the box before their tMax, and where they enter
+static __m128 PacketEntry(const BvhPacket& p, const BvhNode& node, __m128& entry) {
+    __m128 near = _mm_setzero_ps();
+    __m128 far = p.tMax;
+    for (int axis = 0; axis < 3; ++axis) {
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin[axis]), p.origin[axis]), p.inverse[axis]);
+        __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax[axis]), p.origin[axis]), p.inverse[axis]);
+        near = _mm_max_ps(near, _mm_min_ps(t1, t2));
+        far = _mm_min_ps(far, _mm_max_ps(t1, t2));
+    }
+    entry = near;
+    return _mm_cmple_ps(near, far);
+}
+
+static float NearestEntry(__m128 mask, __m128 entry) {
+    __m128 masked = _mm_or_ps(_mm_and_ps(mask, entry), _mm_andnot_ps(mask, _mm_set1_ps(1e30f)));
+    masked = _mm_min_ps(masked, _mm_shuffle_ps(masked, masked, _MM_SHUFFLE(2, 3, 0, 1)));
+    masked = _mm_min_ps(masked, _mm_shuffle_ps(masked, masked, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(masked);
+}
+
+// As Traverse, while any lane still reaches the box; the box is tested again when popped since tMax may have shrunk
+template <typename Leaf>
+static void TraversePacket(const std::vector<BvhNode>& nodes, const BvhPacket& p, Leaf leaf) {
+    __m128 entry;
+    if (nodes.empty() || _mm_movemask_ps(PacketEntry(p, nodes[0], entry)) == 0) {
+        return;
+    }
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+    int index = 0;
+    for (;;) {
+        const BvhNode& node = nodes[index];
+        if (node.count > 0) {
+            leaf(node);
+        }
+        else {
+            int near = node.leftFirst, far = node.leftFirst + 1;
+            __m128 nearEntry, farEntry;
+            __m128 nearMask = PacketEntry(p, nodes[near], nearEntry);
+            __m128 farMask = PacketEntry(p, nodes[far], farEntry);
+            bool nearHit = _mm_movemask_ps(nearMask) != 0, farHit = _mm_movemask_ps(farMask) != 0;
+            if (nearHit && farHit) {
+                if (NearestEntry(farMask, farEntry) < NearestEntry(nearMask, nearEntry)) {
+                    std::swap(near, far);
+                }
+                stack[top++] = far;
+                index = near;
+                continue;
+            }
+            if (nearHit || farHit) {
+                index = nearHit ? near : far;
+                continue;
+            }
+        }
+        do {
+            if (top == 0) {
+                return;
+            }
+            index = stack[--top];
+        } while (_mm_movemask_ps(PacketEntry(p, nodes[index], entry)) == 0);
+    }
+}
+
+static void IntersectPacket(BvhPacket& p, const BvhTriangle& triangle, int instance, int triangleIndex, BvhHit* hits) {
+    __m128 e1x = _mm_set1_ps(triangle.edge1.x), e1y = _mm_set1_ps(triangle.edge1.y), e1z = _mm_set1_ps(triangle.edge1.z);
+    __m128 e2x = _mm_set1_ps(triangle.edge2.x), e2y = _mm_set1_ps(triangle.edge2.y), e2z = _mm_set1_ps(triangle.edge2.z);
+    const __m128* d = p.direction;
+    // p = d x e2
+    __m128 px = _mm_sub_ps(_mm_mul_ps(d[1], e2z), _mm_mul_ps(d[2], e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(d[2], e2x), _mm_mul_ps(d[0], e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(d[0], e2y), _mm_mul_ps(d[1], e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    __m128 sx = _mm_sub_ps(p.origin[0], _mm_set1_ps(triangle.v0.x));
+    __m128 sy = _mm_sub_ps(p.origin[1], _mm_set1_ps(triangle.v0.y));
+    __m128 sz = _mm_sub_ps(p.origin[2], _mm_set1_ps(triangle.v0.z));
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDet);
+    // q = s x e1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], qx), _mm_mul_ps(d[1], qy)), _mm_mul_ps(d[2], qz)), inverseDet);
+    __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 mask = _mm_and_ps(_mm_cmpneq_ps(det, zero), _mm_cmpge_ps(u, zero));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(t, p.tMax));
+    int lanes = _mm_movemask_ps(mask);
+    if (lanes == 0) {
+        return;
+    }
+    p.tMax = _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, p.tMax));
+    alignas(16) float tLanes[4], uLanes[4], vLanes[4];
+    _mm_store_ps(tLanes, t);
+    _mm_store_ps(uLanes, u);
+    _mm_store_ps(vLanes, v);
+    for (int lane = 0; lane < 4; ++lane) {
+        if (lanes & (1 << lane)) {
+            hits[lane] = { tLanes[lane], instance, triangleIndex, uLanes[lane], vLanes[lane] };
+        }
+    }
+}
+
+static BvhPacket MakePacket(const glm::vec3 origins[4], const glm::vec3 directions[4], __m128 tMax) {
+    BvhPacket p;
+    glm::vec3 inverse[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        inverse[lane] = SafeInverse(directions[lane]);
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        p.origin[axis] = _mm_setr_ps(origins[0][axis], origins[1][axis], origins[2][axis], origins[3][axis]);
+        p.direction[axis] = _mm_setr_ps(directions[0][axis], directions[1][axis], directions[2][axis], directions[3][axis]);
+        p.inverse[axis] = _mm_setr_ps(inverse[0][axis], inverse[1][axis], inverse[2][axis], inverse[3][axis]);
+    }
+    p.tMax = tMax;
+    return p;
+}
+
+// Up to four rays; missing lanes start with a negative tMax so no box takes them
+static void TracePacket(const SceneBvh& bvh, const BvhRay* rays, BvhHit* hits, int count) {
+    glm::vec3 origins[4], directions[4];
+    alignas(16) float tMax[4];
+    BvhHit laneHits[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        const BvhRay& ray = rays[std::min(lane, count - 1)];
+        origins[lane] = ray.origin;
+        directions[lane] = ray.direction;
+        tMax[lane] = lane < count ? ray.tMax : -1.0f;
+        laneHits[lane].t = tMax[lane];
+    }
+    BvhPacket world = MakePacket(origins, directions, _mm_load_ps(tMax));
+    TraversePacket(bvh.topNodes, world, [&](const BvhNode& topLeaf) {
+        for (int i = topLeaf.leftFirst; i < topLeaf.leftFirst + topLeaf.count; ++i) {
+            int instanceIndex = bvh.topOrder[i];
+            const BvhInstance& instance = bvh.instances[instanceIndex];
+            const BvhMesh& mesh = bvh.meshes[instance.mesh];
+            glm::vec3 localOrigins[4], localDirections[4];
+            for (int lane = 0; lane < 4; ++lane) {
+                localOrigins[lane] = glm::vec3(instance.inverse * glm::vec4(origins[lane], 1.0f));
+                localDirections[lane] = glm::mat3(instance.inverse) * directions[lane];
+            }
+            BvhPacket local = MakePacket(localOrigins, localDirections, world.tMax);
+            TraversePacket(mesh.nodes, local, [&](const BvhNode& leaf) {
+                for (int k = leaf.leftFirst; k < leaf.leftFirst + leaf.count; ++k) {
+                    IntersectPacket(local, mesh.triangles[k], instanceIndex, mesh.triangleIndex[k], laneHits);
+                }
+            });
+            world.tMax = local.tMax;
+        }
+    });
+    for (int lane = 0; lane < count; ++lane) {
+        hits[lane] = laneHits[lane];
+        if (hits[lane].instance < 0) {
+            hits[lane].t = 1e30f;
+        }
+    }
+}
+
+void TraceRays(const SceneBvh& bvh, ThreadPool& pool, const BvhRay* rays, BvhHit* hits, int count) {
+    int packets = (count + 3) / 4;
+    ParallelFor(pool, packets, 64, [&](int begin, int end) {
+        for (int packet = begin; packet < end; ++packet) {
+            TracePacket(bvh, rays + 4 * packet, hits + 4 * packet, std::min(4, count - 4 * packet));
+        }
+    });
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+// Bounding volume hierarchy for ray casts against the loaded scene: picking, line of sight, placement.
+// Two levels: each mesh gets a tree over its triangles, and a small top tree over mesh instances
+// (a mesh and a transform) is rebuilt whenever a transform changes. Trees split where the binned
+// surface area heuristic is cheapest (Wald 2007). The build splits the largest ranges first,
+// binning their triangles across the thread pool, then builds the remaining subtrees one per task.
+// Rays are traced alone or in packets of four that share one SSE traversal, front to back.
+const int BVH_BINS = 16;
+const int BVH_MAX_LEAF = 8;          // Triangles; larger ranges are always split if they can be
+const int BVH_STACK_SIZE = 64;       // Traversal stack entries; trees stop splitting before they get deeper
+
+struct BvhNode {
+    glm::vec3 boundsMin;
+    int leftFirst;                   // Interior: left child, the right one follows it. Leaf: first primitive
+    glm::vec3 boundsMax;
+    int count;                       // Primitives in a leaf, 0 for interior nodes
+};
+
+// Stored the way the intersection test reads it (Moller & Trumbore 1997)
+struct BvhTriangle {
+    glm::vec3 v0, edge1, edge2;
+};
+
+struct BvhMesh {
+    std::vector<BvhNode> nodes;
+    std::vector<BvhTriangle> triangles;   // In leaf order
+    std::vector<int> triangleIndex;       // The mesh's own triangle number, per leaf slot
+};
+
+struct BvhInstance {
+    int mesh = 0;
+    glm::mat4 transform = glm::mat4(1.0f);
+    glm::mat4 inverse = glm::mat4(1.0f);
+};
+
+struct SceneBvh {
+    std::vector<BvhMesh> meshes;
+    std::vector<BvhInstance> instances;
+    std::vector<BvhNode> topNodes;
+    std::vector<int> topOrder;            // Instances in leaf order
+    int triangleCount = 0, nodeCount = 0;
+    float buildMilliseconds = 0.0f;
+};
+
+struct BvhRay {
+    glm::vec3 origin = glm::vec3(0.0f);
+    float tMax = 1e30f;                   // Hits past origin + direction * tMax are ignored
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+};
+
+struct BvhHit {
+    float t = 1e30f;                      // In units of the ray's direction
+    int instance = -1;                    // -1 for a miss
+    int triangle = -1;                    // Index into the mesh's triangles, as in Mesh::indices / 3
+    float u = 0.0f, v = 0.0f;             // Barycentrics of the second and third vertex
+};
+
+// One instance per mesh, at the identity
+void BuildSceneBvh(SceneBvh& bvh, const std::vector<Mesh>& meshes, ThreadPool& pool);
+
+// Moves an instance; call BuildBvhTopLevel after changing any
+void SetBvhInstanceTransform(SceneBvh& bvh, int instance, const glm::mat4& transform);
+void BuildBvhTopLevel(SceneBvh& bvh);
+
+// Closest hit, or with anyHit the first one found, which is enough for line of sight
+bool TraceRay(const SceneBvh& bvh, const BvhRay& ray, BvhHit& hit, bool anyHit = false);
+
+// Closest hits for a batch, in packets of four consecutive rays across the thread pool;
+// rays next to each other should start and point close together
+void TraceRays(const SceneBvh& bvh, ThreadPool& pool, const BvhRay* rays, BvhHit* hits, int count);
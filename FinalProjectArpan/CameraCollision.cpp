@@ -0,0 +1,327 @@
+#include "CameraCollision.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+const float COLLISION_MIN_CELL_SIZE = 0.1f;   // Mesh space; a query covers a few hundred cells at most
+const float COLLISION_MAX_CELL_SIZE = 2.0f;
+
+static unsigned int CellHash(int x, int y, int z) {
+    unsigned int h = (unsigned int)x * 0x8da6b343u + (unsigned int)y * 0xd8163841u + (unsigned int)z * 0xcb1ab31fu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    return h ^ (h >> 15);
+}
+
+static glm::ivec3 CellOf(const CollisionWorld& world, const glm::vec3& p) {
+    return glm::ivec3(glm::floor(p / world.cellSize));
+}
+
+// Calls visit with the hash entry of every cell the triangle's plane passes through within its bounds.
+// Cells are walked over the two axes the triangle faces least, and along the third only where the
+// plane crosses that column, so a large triangle costs its area in cells rather than its volume.
+template <typename Visit>
+static void ForEachTriangleCell(const CollisionWorld& world, const CollisionTriangle& t, Visit visit) {
+    glm::ivec3 lo = CellOf(world, glm::min(glm::min(t.a, t.b), t.c));
+    glm::ivec3 hi = CellOf(world, glm::max(glm::max(t.a, t.b), t.c));
+    glm::vec3 n = glm::abs(t.normal);
+    int w = n.x > n.y ? (n.x > n.z ? 0 : 2) : (n.y > n.z ? 1 : 2);   // Axis the normal leans along most
+    int u = (w + 1) % 3, v = (w + 2) % 3;
+    float halfCell = 0.5f * world.cellSize;
+    // Half the range of the plane's w across one column
+    float spread = halfCell * (n[u] + n[v]) / n[w];
+    glm::ivec3 cell;
+    for (cell[v] = lo[v]; cell[v] <= hi[v]; ++cell[v]) {
+        for (cell[u] = lo[u]; cell[u] <= hi[u]; ++cell[u]) {
+            float cu = (cell[u] + 0.5f) * world.cellSize - t.a[u];
+            float cv = (cell[v] + 0.5f) * world.cellSize - t.a[v];
+            float middle = t.a[w] - (t.normal[u] * cu + t.normal[v] * cv) / t.normal[w];
+            int first = std::max((int)std::floor((middle - spread) / world.cellSize), lo[w]);
+            int last = std::min((int)std::floor((middle + spread) / world.cellSize), hi[w]);
+            for (cell[w] = first; cell[w] <= last; ++cell[w]) {
+                visit(CellHash(cell.x, cell.y, cell.z) & world.tableMask);
+            }
+        }
+    }
+}
+
+void BuildCollisionWorld(CollisionWorld& world, const std::vector<Mesh>& meshes) {
+    auto start = std::chrono::high_resolution_clock::now();
+    world.triangles.clear();
+    double edgeSum = 0.0;
+    for (const Mesh& mesh : meshes) {
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            CollisionTriangle t;
+            t.a = glm::make_vec3(mesh.vertices[mesh.indices[i]].Position);
+            t.b = glm::make_vec3(mesh.vertices[mesh.indices[i + 1]].Position);
+            t.c = glm::make_vec3(mesh.vertices[mesh.indices[i + 2]].Position);
+            glm::vec3 normal = glm::cross(t.b - t.a, t.c - t.a);
+            float area = glm::length(normal);
+            if (area < 1e-12f) {
+                continue;
+            }
+            t.normal = normal / area;
+            world.triangles.push_back(t);
+            edgeSum += glm::distance(t.a, t.b) + glm::distance(t.b, t.c) + glm::distance(t.c, t.a);
+        }
+    }
+    world.visitStamp.assign(world.triangles.size(), 0);
+    world.stamp = 0;
+    if (world.triangles.empty()) {
+        world.cellStart.assign(2, 0);
+        world.cellTriangles.clear();
+        world.tableMask = 0;
+        return;
+    }
+    world.cellSize = glm::clamp(2.0f * (float)(edgeSum / (3.0 * world.triangles.size())), COLLISION_MIN_CELL_SIZE, COLLISION_MAX_CELL_SIZE);
+
+    // Size the table from the number of entries, then count, prefix sum and fill
+    world.tableMask = 0xffffffffu;
+    size_t entries = 0;
+    for (const CollisionTriangle& t : world.triangles) {
+        ForEachTriangleCell(world, t, [&](unsigned int) { ++entries; });
+    }
+    unsigned int tableSize = COLLISION_MIN_TABLE_SIZE;
+    while (tableSize < entries && tableSize < (1u << 24)) {
+        tableSize <<= 1;
+    }
+    world.tableMask = tableSize - 1;
+    world.cellStart.assign(tableSize + 1, 0);
+    for (const CollisionTriangle& t : world.triangles) {
+        ForEachTriangleCell(world, t, [&](unsigned int h) { ++world.cellStart[h + 1]; });
+    }
+    for (unsigned int h = 0; h < tableSize; ++h) {
+        world.cellStart[h + 1] += world.cellStart[h];
+    }
+    std::vector<unsigned int> cursor(world.cellStart.begin(), world.cellStart.end() - 1);
+    world.cellTriangles.resize(world.cellStart.back());
+    for (unsigned int i = 0; i < (unsigned int)world.triangles.size(); ++i) {
+        ForEachTriangleCell(world, world.triangles[i], [&](unsigned int h) { world.cellTriangles[cursor[h]++] = i; });
+    }
+    world.buildMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Collects the triangles listed in the cells overlapping [lo, hi] into world.nearby
+static void Gather(CollisionWorld& world, const glm::vec3& lo, const glm::vec3& hi) {
+    world.nearby.clear();
+    if (world.triangles.empty()) {
+        return;
+    }
+    if (++world.stamp == 0) {
+        std::fill(world.visitStamp.begin(), world.visitStamp.end(), 0u);
+        world.stamp = 1;
+    }
+    glm::ivec3 a = CellOf(world, lo), b = CellOf(world, hi);
+    for (int z = a.z; z <= b.z; ++z) {
+        for (int y = a.y; y <= b.y; ++y) {
+            for (int x = a.x; x <= b.x; ++x) {
+                unsigned int h = CellHash(x, y, z) & world.tableMask;
+                for (unsigned int k = world.cellStart[h]; k < world.cellStart[h + 1]; ++k) {
+                    unsigned int t = world.cellTriangles[k];
+                    if (world.visitStamp[t] == world.stamp) {
+                        continue;
+                    }
+                    world.visitStamp[t] = world.stamp;
+                    // Cells sharing a hash entry list triangles from elsewhere; drop those by bounds
+                    const CollisionTriangle& triangle = world.triangles[t];
+                    glm::vec3 triangleLo = glm::min(glm::min(triangle.a, triangle.b), triangle.c);
+                    glm::vec3 triangleHi = glm::max(glm::max(triangle.a, triangle.b), triangle.c);
+                    if (glm::all(glm::lessThanEqual(triangleLo, hi)) && glm::all(glm::lessThanEqual(lo, triangleHi))) {
+                        world.nearby.push_back((int)t);
+                    }
+                }
+            }
+        }
+    }
+    world.testedTriangles += (int)world.nearby.size();
+}
+
+// Ericson, Real-Time Collision Detection 5.1.5
+static glm::vec3 ClosestPointOnTriangle(const glm::vec3& p, const CollisionTriangle& t) {
+    glm::vec3 ab = t.b - t.a, ac = t.c - t.a, ap = p - t.a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return t.a;
+    glm::vec3 bp = p - t.b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return t.b;
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return t.a + ab * (d1 / (d1 - d3));
+    glm::vec3 cp = p - t.c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return t.c;
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return t.a + ac * (d2 / (d2 - d6));
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return t.b + (t.c - t.b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    float denominator = 1.0f / (va + vb + vc);
+    return t.a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Ericson 5.1.9; returns the squared distance
+static float ClosestSegmentSegment(const glm::vec3& p1, const glm::vec3& q1, const glm::vec3& p2, const glm::vec3& q2,
+    glm::vec3& c1, glm::vec3& c2) {
+    glm::vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+    float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+    float s = 0.0f, t = 0.0f;
+    if (a <= 1e-12f) {
+        t = glm::clamp(f / e, 0.0f, 1.0f);
+    }
+    else {
+        float c = glm::dot(d1, r);
+        float b = glm::dot(d1, d2);
+        float denominator = a * e - b * b;
+        s = denominator > 1e-12f ? glm::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+        t = (b * s + f) / e;
+        if (t < 0.0f) {
+            t = 0.0f;
+            s = glm::clamp(-c / a, 0.0f, 1.0f);
+        }
+        else if (t > 1.0f) {
+            t = 1.0f;
+            s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+        }
+    }
+    c1 = p1 + d1 * s;
+    c2 = p2 + d2 * t;
+    return glm::dot(c1 - c2, c1 - c2);
+}
+
+// Closest points between the segment p0-p1 and the triangle; returns the squared distance
+static float SegmentTriangle(const glm::vec3& p0, const glm::vec3& p1, const CollisionTriangle& t, glm::vec3& onSegment, glm::vec3& onTriangle) {
+    float s0 = glm::dot(t.normal, p0 - t.a), s1 = glm::dot(t.normal, p1 - t.a);
+    if ((s0 <= 0.0f) != (s1 <= 0.0f)) {
+        glm::vec3 crossing = p0 + (p1 - p0) * (s0 / (s0 - s1));
+        glm::vec3 closest = ClosestPointOnTriangle(crossing, t);
+        if (glm::dot(closest - crossing, closest - crossing) < 1e-10f) {
+            onSegment = onTriangle = crossing;
+            return 0.0f;
+        }
+    }
+    onSegment = p0;
+    onTriangle = ClosestPointOnTriangle(p0, t);
+    float best = glm::dot(onSegment - onTriangle, onSegment - onTriangle);
+    glm::vec3 q = ClosestPointOnTriangle(p1, t);
+    float d = glm::dot(p1 - q, p1 - q);
+    if (d < best) {
+        best = d;
+        onSegment = p1;
+        onTriangle = q;
+    }
+    const glm::vec3* corners[4] = { &t.a, &t.b, &t.c, &t.a };
+    for (int e = 0; e < 3; ++e) {
+        glm::vec3 c1, c2;
+        d = ClosestSegmentSegment(p0, p1, *corners[e], *corners[e + 1], c1, c2);
+        if (d < best) {
+            best = d;
+            onSegment = c1;
+            onTriangle = c2;
+        }
+    }
+    return best;
+}
+
+// Pushes the capsule from eye down to eye - below out of the gathered triangles, sideways only;
+// floors and ceilings are left to the ground following
+static void PushOut(CollisionWorld& world, glm::vec3& eye, float below, float radius) {
+    for (int pass = 0; pass < COLLISION_PASSES; ++pass) {
+        bool touched = false;
+        for (int index : world.nearby) {
+            const CollisionTriangle& t = world.triangles[index];
+            float s0 = glm::dot(t.normal, eye - t.a);
+            float s1 = s0 - t.normal.y * below;
+            if ((s0 > radius && s1 > radius) || (s0 < -radius && s1 < -radius)) {
+                continue;   // Both ends clear of the plane on the same side
+            }
+            glm::vec3 onSegment, onTriangle;
+            float distance2 = SegmentTriangle(eye - glm::vec3(0.0f, below, 0.0f), eye, t, onSegment, onTriangle);
+            if (distance2 >= radius * radius) {
+                continue;
+            }
+            glm::vec3 away = onSegment - onTriangle;
+            away.y = 0.0f;
+            float length = glm::length(away);
+            if (length < 1e-5f) {
+                away = glm::vec3(t.normal.x, 0.0f, t.normal.z) * (glm::dot(t.normal, eye - t.a) >= 0.0f ? 1.0f : -1.0f);
+                length = glm::length(away);
+                if (length < 1e-5f) {
+                    continue;
+                }
+            }
+            eye += away * ((radius - std::sqrt(distance2)) / length);
+            touched = true;
+        }
+        if (!touched) {
+            break;
+        }
+    }
+}
+
+// Highest walkable triangle under (x, z) between bottom and top, or bottom if there is none
+static float GroundBelow(CollisionWorld& world, float x, float z, float top, float bottom) {
+    Gather(world, glm::vec3(x, bottom, z), glm::vec3(x, top, z));
+    float ground = bottom;
+    for (int index : world.nearby) {
+        const CollisionTriangle& t = world.triangles[index];
+        if (std::abs(t.normal.y) < 0.5f) {
+            continue;
+        }
+        // Inside the triangle's xz projection, whichever way it winds
+        float e0 = (t.b.x - t.a.x) * (z - t.a.z) - (t.b.z - t.a.z) * (x - t.a.x);
+        float e1 = (t.c.x - t.b.x) * (z - t.b.z) - (t.c.z - t.b.z) * (x - t.b.x);
+        float e2 = (t.a.x - t.c.x) * (z - t.c.z) - (t.a.z - t.c.z) * (x - t.c.x);
+        if (!((e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) || (e0 <= 0.0f && e1 <= 0.0f && e2 <= 0.0f))) {
+            continue;
+        }
+        float y = t.a.y - (t.normal.x * (x - t.a.x) + t.normal.z * (z - t.a.z)) / t.normal.y;
+        if (y <= top && y > ground) {
+            ground = y;
+        }
+    }
+    return ground;
+}
+
+glm::vec3 MoveCamera(CollisionWorld& world, const CameraCollisionSettings& settings, const glm::mat4& model,
+    const glm::vec3& eye, const glm::vec3& displacement, Terrain& terrain, const TerrainSettings& terrainSettings, float deltaTime) {
+    auto start = std::chrono::high_resolution_clock::now();
+    world.testedTriangles = 0;
+
+    // Into mesh space, where lengths shrink by the model's scale
+    glm::mat4 inverseModel = glm::inverse(model);
+    float scale = glm::length(glm::vec3(model[0]));
+    glm::vec3 local = glm::vec3(inverseModel * glm::vec4(eye, 1.0f));
+    glm::vec3 move = glm::mat3(inverseModel) * glm::vec3(displacement.x, 0.0f, displacement.z);
+    move.y = 0.0f;
+    float radius = settings.radius / scale;
+    float eyeHeight = settings.eyeHeight / scale;
+    float stepHeight = settings.stepHeight / scale;
+    float below = std::max(eyeHeight - stepHeight - radius, 0.0f);   // Eye to the center of the capsule's lower end
+
+    // Sweep in sub-steps of half the radius, so no triangle can be crossed between two push-outs
+    glm::vec3 end = local + move;
+    Gather(world, glm::min(local, end) - glm::vec3(radius, below + radius, radius), glm::max(local, end) + radius);
+    int steps = glm::clamp((int)std::ceil(glm::length(move) / (0.5f * radius)), 1, COLLISION_MAX_SUBSTEPS);
+    for (int s = 0; s < steps; ++s) {
+        local += move / (float)steps;
+        PushOut(world, local, below, radius);
+    }
+
+    glm::vec3 result = glm::vec3(model * glm::vec4(local, 1.0f));
+    if (settings.followGround) {
+        float feet = local.y - eyeHeight;
+        float lowest = feet - 4.0f * eyeHeight;
+        float meshGround = GroundBelow(world, local.x, local.z, feet + stepHeight, lowest);
+        float ground = meshGround > lowest ? (model * glm::vec4(local.x, meshGround, local.z, 1.0f)).y : -1e30f;
+        if (terrainSettings.enabled) {
+            ground = std::max(ground, SampleTerrainHeight(terrain, terrainSettings, glm::vec2(result.x, result.z)));
+        }
+        if (ground > -1e30f) {
+            float target = ground + settings.eyeHeight;
+            // Straight up onto a step, eased down off one
+            result.y = target > result.y ? target : glm::mix(result.y, target, 1.0f - std::exp(-settings.fallSpeed * deltaTime));
+        }
+    }
+
+    world.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "Mesh.h"
+#include "Terrain.h"
+
+// Keeps the first person camera out of the scene's meshes and on the ground.
+// The loaded meshes' triangles are copied once into a spatial hash: every triangle is listed in
+// each cell its bounds overlap, cells are hashed into a fixed table, and the lists are packed
+// back to back (counting sort), so a query only reads the triangles in the cells it covers.
+// The camera is a vertical capsule from just above step height to the eye. A move is swept in
+// sub-steps shorter than the radius, each pushing the capsule out of the triangles it touches,
+// so it slides along walls and cannot tunnel through thin ones. The feet then follow the
+// highest walkable triangle below them, or the terrain where the meshes end.
+// Queries run in the meshes' own space; the scene model may rotate about y and scale uniformly.
+const int COLLISION_MIN_TABLE_SIZE = 4096;   // Hash table entries, grows to the next power of two above the cell count
+const int COLLISION_MAX_SUBSTEPS = 32;
+const int COLLISION_PASSES = 3;              // Push-out passes per sub-step
+
+struct CameraCollisionSettings {
+    bool enabled = true;
+    bool followGround = true;      // Otherwise the eye keeps its height
+    float radius = 0.3f;           // World units
+    float eyeHeight = 2.5f;        // Above the ground
+    float stepHeight = 0.4f;       // Ledges lower than this are stepped onto instead of blocking
+    float fallSpeed = 8.0f;        // Rate at which the eye settles down onto lower ground, per second
+};
+
+struct CollisionTriangle {
+    glm::vec3 a, b, c;
+    glm::vec3 normal;
+};
+
+struct CollisionWorld {
+    std::vector<CollisionTriangle> triangles;
+    std::vector<unsigned int> cellStart;       // Per hash entry, into cellTriangles; one extra at the end
+    std::vector<unsigned int> cellTriangles;
+    unsigned int tableMask = 0;
+    float cellSize = 1.0f;                     // Mesh space
+
+    std::vector<unsigned int> visitStamp;      // Per triangle, so one shared by several cells is gathered once
+    unsigned int stamp = 0;
+    std::vector<int> nearby;                   // Gathered by the last query
+
+    int testedTriangles = 0;                   // Last move, for the GUI
+    float buildMilliseconds = 0.0f;
+    float milliseconds = 0.0f;                 // CPU time of the last move
+};
+
+// Copies every mesh's triangles into the hash
+void BuildCollisionWorld(CollisionWorld& world, const std::vector<Mesh>& meshes);
+
+// Moves the eye by displacement (x and z only), sliding along the scene, and returns where it ends up.
+// model is the scene meshes' transform; the terrain, when enabled, is the ground past the meshes.
+glm::vec3 MoveCamera(CollisionWorld& world, const CameraCollisionSettings& settings, const glm::mat4& model,
+    const glm::vec3& eye, const glm::vec3& displacement, Terrain& terrain, const TerrainSettings& terrainSettings, float deltaTime);
@@ -0,0 +1,197 @@
+#include "Characters.h"
+#include "Shader.h"
+#include "VertexFormat.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+static int FindClip(const SkinnedModel& model, const char* name, int fallback) {
+    for (size_t i = 0; i < model.clips.size(); ++i) {
+        if (model.clips[i].name == name) {
+            return (int)i;
+        }
+    }
+    return std::min(fallback, (int)model.clips.size() - 1);
+}
+
+bool InitCharacters(Characters& characters, SkinnedModel&& model) {
+    characters.model = std::move(model);
+    SkinnedModel& m = characters.model;
+    characters.program = LoadShaderProgram("shaders/skinned.glsl");
+    InitGpuTimer(characters.timer);
+    if (!characters.program || m.vertices.empty() || m.skeleton.parents.empty()) {
+        return false;
+    }
+    if (m.clips.empty()) {
+        m.clips.push_back(AnimationClip());   // No channels: holds the bind pose
+    }
+    characters.walkClip = FindClip(m, "Walk", 0);
+    characters.waveClip = FindClip(m, "Wave", 1);
+
+    float minY = 1e30f, maxY = -1e30f;
+    for (const Vertex& v : m.vertices) {
+        minY = std::min(minY, v.Position[1]);
+        maxY = std::max(maxY, v.Position[1]);
+        characters.restVertices.push_back(glm::vec4(v.Position[0], v.Position[1], v.Position[2], 1.0f));
+        characters.restVertices.push_back(glm::vec4(v.Normal[0], v.Normal[1], v.Normal[2], 0.0f));
+    }
+    characters.bindMinY = minY;
+    characters.bindHeight = std::max(maxY - minY, 1e-3f);
+
+    std::mt19937 random(1510);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    characters.characters.resize(CHARACTER_MAX_COUNT);
+    for (Character& c : characters.characters) {
+        c.orbit = unit(random);
+        c.orbitAngle = unit(random) * glm::two_pi<float>();
+        c.direction = unit(random) < 0.5f ? -1.0f : 1.0f;
+        c.time = unit(random) * 10.0f;
+        c.wavePhase = unit(random) * glm::two_pi<float>();
+    }
+
+    glGenVertexArrays(1, &characters.VAO);
+    glGenBuffers(1, &characters.VBO);
+    glGenBuffers(1, &characters.skinVBO);
+    glGenBuffers(1, &characters.EBO);
+    glBindVertexArray(characters.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, characters.VBO);
+    glBufferData(GL_ARRAY_BUFFER, m.vertices.size() * sizeof(Vertex), m.vertices.data(), GL_STATIC_DRAW);
+    SetupVertexAttributes<FloatVertexLayout>();
+    glBindBuffer(GL_ARRAY_BUFFER, characters.skinVBO);
+    glBufferData(GL_ARRAY_BUFFER, m.skin.size() * sizeof(VertexSkin), m.skin.data(), GL_STATIC_DRAW);
+    glVertexAttribIPointer(3, 4, GL_UNSIGNED_INT, sizeof(VertexSkin), (void*)offsetof(VertexSkin, joints));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(VertexSkin), (void*)offsetof(VertexSkin, weights));
+    glEnableVertexAttribArray(4);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, characters.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m.indices.size() * sizeof(unsigned int), m.indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    glGenBuffers(2, characters.boneBuffer);
+    glGenBuffers(2, characters.vertexBuffer);
+    return true;
+}
+
+void DestroyCharacters(Characters& characters) {
+    glDeleteVertexArrays(1, &characters.VAO);
+    glDeleteBuffers(1, &characters.VBO);
+    glDeleteBuffers(1, &characters.skinVBO);
+    glDeleteBuffers(1, &characters.EBO);
+    glDeleteBuffers(2, characters.boneBuffer);
+    glDeleteBuffers(2, characters.vertexBuffer);
+    glDeleteTextures(1, &characters.model.textureID);
+    glDeleteProgram(characters.program);
+    DestroyGpuTimer(characters.timer);
+}
+
+void UpdateCharacters(Characters& characters, const CharacterSettings& settings, ThreadPool& pool, float deltaTime) {
+    if (!settings.enabled || characters.characters.empty()) {
+        return;
+    }
+    using Clock = std::chrono::high_resolution_clock;
+    auto start = Clock::now();
+
+    const SkinnedModel& model = characters.model;
+    const Skeleton& skeleton = model.skeleton;
+    int count = std::clamp(settings.count, 0, CHARACTER_MAX_COUNT);
+    int jointCount = (int)skeleton.parents.size();
+    characters.time += deltaTime;
+    characters.skinning.resize((size_t)count * jointCount);
+
+    float scale = settings.height / characters.bindHeight;
+    glm::mat4 modelTransform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -characters.bindMinY * scale, 0.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+
+    // 1. Move, sample, blend and build the matrix palette of every character
+    ParallelFor(pool, count, 16, [&](int begin, int end) {
+        thread_local Pose walk, wave, blended;
+        thread_local std::vector<glm::mat4> world;
+        for (int i = begin; i < end; ++i) {
+            Character& c = characters.characters[i];
+            // Characters stop now and then to wave
+            float waveWeight = glm::smoothstep(0.7f, 0.9f, 0.5f + 0.5f * std::sin(characters.time * 0.3f + c.wavePhase));
+            float radius = glm::mix(settings.innerRadius, settings.outerRadius, c.orbit);
+            c.orbitAngle += c.direction * settings.walkSpeed * (1.0f - waveWeight) * deltaTime / std::max(radius, 0.1f);
+            c.time += deltaTime;
+
+            SampleClip(model.clips[characters.walkClip], skeleton, c.time, walk);
+            SampleClip(model.clips[characters.waveClip], skeleton, c.time, wave);
+            BlendPoses(walk, wave, waveWeight, blended);
+
+            glm::vec3 position = glm::vec3(std::cos(c.orbitAngle), 0.0f, std::sin(c.orbitAngle)) * radius;
+            glm::vec3 tangent = glm::vec3(-std::sin(c.orbitAngle), 0.0f, std::cos(c.orbitAngle)) * c.direction;
+            glm::mat4 root = glm::translate(glm::mat4(1.0f), position) * glm::rotate(glm::mat4(1.0f), std::atan2(tangent.x, tangent.z), glm::vec3(0.0f, 1.0f, 0.0f)) * modelTransform;
+            ComputeSkinningMatrices(skeleton, blended, root, world, &characters.skinning[(size_t)i * jointCount]);
+        }
+    });
+    auto animated = Clock::now();
+    characters.animationMilliseconds = std::chrono::duration<float, std::milli>(animated - start).count();
+
+    // 2. CPU skinning, in chunks of vertices that never straddle two characters
+    if (settings.skinning == SKINNING_CPU) {
+        int vertexCount = (int)model.vertices.size();
+        int chunksPerCharacter = (vertexCount + 1023) / 1024;
+        characters.skinnedVertices.resize((size_t)count * vertexCount * 2);
+        ParallelFor(pool, count * chunksPerCharacter, 4, [&](int begin, int end) {
+            for (int chunk = begin; chunk < end; ++chunk) {
+                int i = chunk / chunksPerCharacter;
+                int first = (chunk % chunksPerCharacter) * 1024;
+                SkinVertices(&characters.skinning[(size_t)i * jointCount], model.skin.data(), characters.restVertices.data(),
+                    &characters.skinnedVertices[(size_t)i * vertexCount * 2], first, std::min(first + 1024, vertexCount));
+            }
+        });
+        characters.skinningMilliseconds = std::chrono::duration<float, std::milli>(Clock::now() - animated).count();
+    }
+    else {
+        characters.skinningMilliseconds = 0.0f;
+    }
+}
+
+void RenderCharacters(Characters& characters, const CharacterSettings& settings, const glm::mat4& view, const glm::mat4& projection,
+    const glm::mat4& prevViewProjection, const VolumetricFog& fog, const VolumetricFogSettings& fogSettings) {
+    int count = std::clamp(settings.count, 0, CHARACTER_MAX_COUNT);
+    if (!settings.enabled || count == 0 || characters.characters.empty()) {
+        characters.uploadedCount = 0;
+        return;
+    }
+    BeginGpuTimer(characters.timer);
+
+    // Upload this frame's data; after a change there is no matching history, so it is last frame's too
+    bool cpu = settings.skinning == SKINNING_CPU;
+    bool resetHistory = characters.uploadedCount != count || characters.uploadedSkinning != settings.skinning;
+    GLuint* buffers = cpu ? characters.vertexBuffer : characters.boneBuffer;
+    const void* data = cpu ? (const void*)characters.skinnedVertices.data() : (const void*)characters.skinning.data();
+    GLsizeiptr size = cpu ? characters.skinnedVertices.size() * sizeof(glm::vec4) : characters.skinning.size() * sizeof(glm::mat4);
+    int previous = 1 - characters.current;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[characters.current]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_STREAM_DRAW);
+    if (resetHistory) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[previous]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_STREAM_DRAW);
+    }
+    characters.uploadedCount = count;
+    characters.uploadedSkinning = settings.skinning;
+
+    GLuint program = characters.program;
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "uViewProjection"), 1, GL_FALSE, glm::value_ptr(projection * view));
+    glUniformMatrix4fv(glGetUniformLocation(program, "uPrevViewProjection"), 1, GL_FALSE, glm::value_ptr(prevViewProjection));
+    glUniform1i(glGetUniformLocation(program, "uCpuSkinning"), cpu);
+    glUniform1i(glGetUniformLocation(program, "uJointCount"), (GLint)characters.model.skeleton.parents.size());
+    glUniform1i(glGetUniformLocation(program, "uVertexCount"), (GLint)characters.model.vertices.size());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, cpu ? 2 : 0, buffers[characters.current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, cpu ? 3 : 1, buffers[previous]);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, characters.model.textureID);
+    glUniform1i(glGetUniformLocation(program, "uAlbedo"), 0);
+    BindVolumetricFog(fog, fogSettings, program, 2);
+
+    glEnable(GL_DEPTH_TEST);
+    glBindVertexArray(characters.VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)characters.model.indices.size(), GL_UNSIGNED_INT, 0, count);
+    glBindVertexArray(0);
+    characters.current = previous;
+    EndGpuTimer(characters.timer);
+}
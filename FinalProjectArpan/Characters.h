@@ -0,0 +1,74 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Animation.h"
+#include "GpuTimer.h"
+#include "ThreadPool.h"
+#include "VolumetricFog.h"
+
+// Animated characters walking around the scene.
+// Every character samples and blends two clips of a shared skinned model on the worker
+// threads, producing its skinning matrices with the model transform folded in. Skinning then
+// runs one of two ways, and both draw the whole crowd with one instanced call:
+//  - GPU: the matrices go to a storage buffer and the vertex shader blends its four influences.
+//  - CPU: SSE blends the matrices per vertex across the thread pool and the skinned positions
+//    and normals go to a storage buffer the vertex shader just reads.
+// Last frame's buffers are kept for motion vectors.
+const int CHARACTER_MAX_COUNT = 1024;
+
+enum SkinningMode { SKINNING_CPU = 0, SKINNING_GPU = 1 };
+
+struct CharacterSettings {
+    bool enabled = true;
+    int skinning = SKINNING_GPU;
+    int count = 64;
+    float height = 1.7f;            // World height the model is scaled to
+    float innerRadius = 4.0f;       // Characters walk circles between these distances from the scene center
+    float outerRadius = 25.0f;
+    float walkSpeed = 1.3f;
+};
+
+struct Character {
+    float orbit = 0.0f;             // 0..1 between the inner and outer radius
+    float orbitAngle = 0.0f;
+    float direction = 1.0f;         // +1 counter-clockwise, -1 clockwise
+    float time = 0.0f;              // Clip time
+    float wavePhase = 0.0f;         // Offsets the walk/wave blend cycle
+};
+
+struct Characters {
+    SkinnedModel model;
+    int walkClip = 0, waveClip = 0;
+    float bindMinY = 0.0f, bindHeight = 1.0f;     // Model bounds, to scale it to the set height and stand it on y = 0
+    float time = 0.0f;
+    std::vector<Character> characters;
+
+    std::vector<glm::mat4> skinning;       // jointCount matrices per character
+    std::vector<glm::vec4> restVertices;   // Bind pose position, normal pairs for CPU skinning
+    std::vector<glm::vec4> skinnedVertices;
+    int uploadedCount = 0;                 // Characters in the buffers last frame, 0 forces a history reset
+    int uploadedSkinning = -1;
+
+    GLuint VAO = 0, VBO = 0, skinVBO = 0, EBO = 0;
+    GLuint boneBuffer[2] = {};             // mat4 per joint per character: current, previous
+    GLuint vertexBuffer[2] = {};           // Skinned vec4 position, normal per vertex per character
+    int current = 0;
+    GLuint program = 0;
+
+    float animationMilliseconds = 0.0f;    // CPU time for sampling, blending and matrix palettes
+    float skinningMilliseconds = 0.0f;     // CPU time for vertex skinning, CPU path only
+    GpuTimer timer;
+};
+
+// Builds the crowd around 'model', which is taken over; it needs "Walk" and "Wave" clips or uses its first two
+bool InitCharacters(Characters& characters, SkinnedModel&& model);
+void DestroyCharacters(Characters& characters);
+
+// Animates every character and, on the CPU path, skins their vertices; no GL calls
+void UpdateCharacters(Characters& characters, const CharacterSettings& settings, ThreadPool& pool, float deltaTime);
+
+// Uploads this frame's matrices or vertices and draws the crowd into the bound scene target
+void RenderCharacters(Characters& characters, const CharacterSettings& settings, const glm::mat4& view, const glm::mat4& projection,
+    const glm::mat4& prevViewProjection, const VolumetricFog& fog, const VolumetricFogSettings& fogSettings);
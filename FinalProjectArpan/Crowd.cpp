@@ -0,0 +1,121 @@
+#include "Crowd.h"
+#include "Shader.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+bool InitCrowd(Crowd& crowd, const CrowdSettings& settings, const SkinnedModel& model, GLuint texture, Terrain& terrain, const TerrainSettings& terrainSettings) {
+    crowd.texture = texture;
+    crowd.program = LoadShaderProgram("shaders/crowd.glsl");
+    InitGpuTimer(crowd.timer);
+    if (!crowd.program) {
+        return false;
+    }
+
+    // Bake standing on y = 0 at the set height
+    float minY = 1e30f, maxY = -1e30f;
+    for (const Vertex& v : model.vertices) {
+        minY = std::min(minY, v.Position[1]);
+        maxY = std::max(maxY, v.Position[1]);
+    }
+    float scale = settings.height / std::max(maxY - minY, 1e-3f);
+    glm::mat4 root = glm::scale(glm::mat4(1.0f), glm::vec3(scale)) * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -minY, 0.0f));
+    if (!BakeVertexAnimation(model, root, 30.0f, crowd.animation)) {
+        return false;
+    }
+
+    std::mt19937 random(2024);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    crowd.instances.resize(CROWD_MAX_INSTANCES);
+    for (CrowdInstance& instance : crowd.instances) {
+        // Uniform over the ring's area
+        float r2 = glm::mix(settings.innerRadius * settings.innerRadius, settings.outerRadius * settings.outerRadius, unit(random));
+        float angle = unit(random) * glm::two_pi<float>();
+        glm::vec2 position = glm::vec2(std::cos(angle), std::sin(angle)) * std::sqrt(r2);
+        instance.position = glm::vec3(position.x, SampleTerrainHeight(terrain, terrainSettings, position), position.y);
+        instance.heading = unit(random) * glm::two_pi<float>();
+        instance.clip = crowd.animation.clips.size() > 1 && unit(random) < settings.waveFraction ? 1 : 0;
+        instance.timeOffset = unit(random) * 10.0f;
+        instance.playbackRate = glm::mix(0.85f, 1.15f, unit(random));
+        instance.scale = glm::mix(0.8f, 1.2f, unit(random));
+    }
+    glGenBuffers(2, crowd.instanceBuffer);
+    for (GLuint buffer : crowd.instanceBuffer) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, crowd.instances.size() * sizeof(CrowdInstance), crowd.instances.data(), GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    std::vector<glm::vec2> texCoords;
+    for (const Vertex& v : model.vertices) {
+        texCoords.push_back(glm::vec2(v.TexCoords[0], v.TexCoords[1]));
+    }
+    crowd.indexCount = (GLsizei)model.indices.size();
+    glGenVertexArrays(1, &crowd.VAO);
+    glGenBuffers(1, &crowd.VBO);
+    glGenBuffers(1, &crowd.EBO);
+    glBindVertexArray(crowd.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, crowd.VBO);
+    glBufferData(GL_ARRAY_BUFFER, texCoords.size() * sizeof(glm::vec2), texCoords.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, crowd.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, model.indices.size() * sizeof(unsigned int), model.indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    return true;
+}
+
+void DestroyCrowd(Crowd& crowd) {
+    DestroyVertexAnimation(crowd.animation);
+    glDeleteBuffers(2, crowd.instanceBuffer);
+    glDeleteVertexArrays(1, &crowd.VAO);
+    glDeleteBuffers(1, &crowd.VBO);
+    glDeleteBuffers(1, &crowd.EBO);
+    glDeleteProgram(crowd.program);
+    DestroyGpuTimer(crowd.timer);
+}
+
+void UploadCrowdInstances(Crowd& crowd, int count) {
+    count = std::min(count, (int)crowd.instances.size());
+    if (count <= 0) {
+        return;
+    }
+    crowd.currentInstances = 1 - crowd.currentInstances;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, crowd.instanceBuffer[crowd.currentInstances]);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(CrowdInstance), crowd.instances.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    crowd.instancesMoved = true;
+}
+
+void RenderCrowd(Crowd& crowd, const CrowdSettings& settings, const glm::mat4& view, const glm::mat4& projection,
+    const glm::mat4& prevViewProjection, float time, float deltaTime, const VolumetricFog& fog, const VolumetricFogSettings& fogSettings) {
+    int count = std::min(settings.count, (int)crowd.instances.size());
+    if (!settings.enabled || count <= 0) {
+        return;
+    }
+    BeginGpuTimer(crowd.timer);
+
+    GLuint program = crowd.program;
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "uViewProjection"), 1, GL_FALSE, glm::value_ptr(projection * view));
+    glUniformMatrix4fv(glGetUniformLocation(program, "uPrevViewProjection"), 1, GL_FALSE, glm::value_ptr(prevViewProjection));
+    glUniform1f(glGetUniformLocation(program, "uTime"), time);
+    glUniform1f(glGetUniformLocation(program, "uPrevTime"), time - deltaTime);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, crowd.texture);
+    glUniform1i(glGetUniformLocation(program, "uAlbedo"), 0);
+    BindVolumetricFog(fog, fogSettings, program, 2);
+    BindVertexAnimation(crowd.animation, program, 6);
+    // Without an upload this frame both buffers may be stale copies, so the current one is also the previous
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, crowd.instanceBuffer[crowd.currentInstances]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, crowd.instanceBuffer[crowd.instancesMoved ? 1 - crowd.currentInstances : crowd.currentInstances]);
+
+    glEnable(GL_DEPTH_TEST);
+    glBindVertexArray(crowd.VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, crowd.indexCount, GL_UNSIGNED_INT, 0, count);
+    glBindVertexArray(0);
+    crowd.instancesMoved = false;
+    EndGpuTimer(crowd.timer);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "GpuTimer.h"
+#include "Terrain.h"
+#include "VertexAnimation.h"
+#include "VolumetricFog.h"
+
+// Crowd of vertex-animated instances of one model, drawn with a single instanced call.
+// Each instance's placement, clip, time offset and playback rate live in a storage buffer and
+// the vertex shader plays its clip from the vertex animation textures, so no per-instance work
+// happens on the CPU.
+const int CROWD_MAX_INSTANCES = 16384;
+
+// Matches CrowdInstance in crowd.glsl (std430)
+struct CrowdInstance {
+    glm::vec3 position;
+    float heading;            // Radians about +y; the model faces +z
+    unsigned int clip;
+    float timeOffset;         // Seconds
+    float playbackRate;
+    float scale;
+};
+
+struct CrowdSettings {
+    bool enabled = true;
+    int count = 10000;
+    float height = 1.6f;          // World height the model is baked at, before per-instance scale
+    float innerRadius = 24.0f;    // Instances are scattered on the terrain between these distances from the scene
+    float outerRadius = 150.0f;
+    float waveFraction = 0.15f;   // Share of instances playing the second clip
+};
+
+struct Crowd {
+    VertexAnimation animation;
+    std::vector<CrowdInstance> instances;
+    GLuint instanceBuffer[2] = {};      // This frame's and last frame's instances, for motion vectors
+    int currentInstances = 0;
+    bool instancesMoved = false;        // Set by UploadCrowdInstances, cleared once drawn
+    GLuint VAO = 0, VBO = 0, EBO = 0;   // Texture coordinates only; positions and normals come from the VAT
+    GLsizei indexCount = 0;
+    GLuint texture = 0;
+    GLuint program = 0;
+    GpuTimer timer;
+};
+
+// Bakes the model's clips and scatters CROWD_MAX_INSTANCES instances over the terrain
+bool InitCrowd(Crowd& crowd, const CrowdSettings& settings, const SkinnedModel& model, GLuint texture, Terrain& terrain, const TerrainSettings& terrainSettings);
+void DestroyCrowd(Crowd& crowd);
+
+// Sends the first 'count' instances after they were moved on the CPU
+void UploadCrowdInstances(Crowd& crowd, int count);
+
+void RenderCrowd(Crowd& crowd, const CrowdSettings& settings, const glm::mat4& view, const glm::mat4& projection,
+    const glm::mat4& prevViewProjection, float time, float deltaTime, const VolumetricFog& fog, const VolumetricFogSettings& fogSettings);
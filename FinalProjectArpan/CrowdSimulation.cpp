@@ -0,0 +1,334 @@
+#include "CrowdSimulation.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+static unsigned int NextRandom(unsigned int& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static float RandomUnit(unsigned int& state) {
+    return (NextRandom(state) & 0xffffffu) / 16777215.0f;
+}
+
+// Goals stay within 60 degrees of the agent around the scene, so paths don't cut through the middle
+static void PickGoal(const CrowdSimulation& sim, unsigned int& seed, float x, float z, float& goalX, float& goalZ) {
+    float r2 = glm::mix(sim.innerRadius * sim.innerRadius, sim.outerRadius * sim.outerRadius, RandomUnit(seed));
+    float angle = std::atan2(z, x) + (RandomUnit(seed) * 2.0f - 1.0f) * glm::third<float>() * glm::pi<float>();
+    goalX = std::cos(angle) * std::sqrt(r2);
+    goalZ = std::sin(angle) * std::sqrt(r2);
+}
+
+static void ResizeAgents(CrowdAgents& agents, size_t count) {
+    for (std::vector<float>* field : { &agents.positionX, &agents.positionZ, &agents.velocityX, &agents.velocityZ,
+        &agents.goalX, &agents.goalZ, &agents.scale, &agents.speed, &agents.heading }) {
+        field->resize(count);
+    }
+    agents.seed.resize(count);
+    agents.id.resize(count);
+}
+
+bool InitCrowdSimulation(CrowdSimulation& sim, const Crowd& crowd, const CrowdSettings& crowdSettings, Terrain& terrain, const TerrainSettings& terrainSettings) {
+    size_t count = crowd.instances.size();
+    if (count == 0) {
+        return false;
+    }
+    sim.innerRadius = crowdSettings.innerRadius;
+    sim.outerRadius = crowdSettings.outerRadius;
+
+    // Agents move every frame, so cache the terrain rather than go through the streaming source
+    BuildTerrainHeightCache(sim.heights, terrain, terrainSettings, sim.outerRadius, CROWD_SIM_HEIGHT_SIZE);
+
+    for (CrowdAgents& agents : sim.agents) {
+        ResizeAgents(agents, count);
+    }
+    CrowdAgents& agents = sim.agents[0];
+    for (size_t i = 0; i < count; ++i) {
+        const CrowdInstance& instance = crowd.instances[i];
+        agents.positionX[i] = instance.position.x;
+        agents.positionZ[i] = instance.position.z;
+        agents.velocityX[i] = agents.velocityZ[i] = 0.0f;
+        agents.scale[i] = instance.scale;
+        agents.heading[i] = instance.heading;
+        agents.seed[i] = (unsigned int)i * 2654435761u + 1u;
+        agents.speed[i] = instance.clip == 0 ? glm::mix(0.8f, 1.2f, RandomUnit(agents.seed[i])) : 0.0f;
+        agents.id[i] = (int)i;
+        PickGoal(sim, agents.seed[i], agents.positionX[i], agents.positionZ[i], agents.goalX[i], agents.goalZ[i]);
+    }
+    sim.current = 0;
+    sim.nextVelocityX.resize(count);
+    sim.nextVelocityZ.resize(count);
+    sim.cellOf.resize(count);
+    return true;
+}
+
+void DestroyCrowdSimulation(CrowdSimulation& sim) {
+    for (CrowdAgents& agents : sim.agents) {
+        ResizeAgents(agents, 0);
+    }
+    sim.heights.heights.clear();
+}
+
+// Counting sort of all agents by cell into the other agent arrays, which become current.
+// Agents beyond the active count go to a cell past the grid so they trail the active ones.
+static void SortAgents(CrowdSimulation& sim, const CrowdSimulationSettings& settings, int activeCount) {
+    sim.cellSize = std::max(settings.neighborRadius, 0.5f);
+    sim.gridOrigin = -sim.outerRadius - sim.cellSize;
+    sim.gridSize = (int)std::ceil(2.0f * (sim.outerRadius + sim.cellSize) / sim.cellSize);
+    int cellCount = sim.gridSize * sim.gridSize;
+    sim.cellStart.assign(cellCount + 2, 0);
+
+    const CrowdAgents& from = sim.agents[sim.current];
+    CrowdAgents& to = sim.agents[1 - sim.current];
+    int count = (int)from.id.size();
+    float inverseCell = 1.0f / sim.cellSize;
+    for (int i = 0; i < count; ++i) {
+        int cell = cellCount;
+        if (from.id[i] < activeCount) {
+            int x = std::clamp((int)((from.positionX[i] - sim.gridOrigin) * inverseCell), 0, sim.gridSize - 1);
+            int z = std::clamp((int)((from.positionZ[i] - sim.gridOrigin) * inverseCell), 0, sim.gridSize - 1);
+            cell = z * sim.gridSize + x;
+        }
+        sim.cellOf[i] = cell;
+        sim.cellStart[cell + 1]++;
+    }
+    for (int cell = 0; cell <= cellCount; ++cell) {
+        sim.cellStart[cell + 1] += sim.cellStart[cell];
+    }
+    // Each agent's cell becomes its destination index, then every field is scattered there
+    std::vector<int> next(sim.cellStart.begin(), sim.cellStart.end() - 1);
+    for (int i = 0; i < count; ++i) {
+        sim.cellOf[i] = next[sim.cellOf[i]]++;
+    }
+    for (int i = 0; i < count; ++i) {
+        int d = sim.cellOf[i];
+        to.positionX[d] = from.positionX[i];
+        to.positionZ[d] = from.positionZ[i];
+        to.velocityX[d] = from.velocityX[i];
+        to.velocityZ[d] = from.velocityZ[i];
+        to.goalX[d] = from.goalX[i];
+        to.goalZ[d] = from.goalZ[i];
+        to.scale[d] = from.scale[i];
+        to.speed[d] = from.speed[i];
+        to.heading[d] = from.heading[i];
+        to.seed[d] = from.seed[i];
+        to.id[d] = from.id[i];
+    }
+    sim.current = 1 - sim.current;
+    sim.activeCount = sim.cellStart[cellCount];
+}
+
+const int CROWD_SIM_ROTATIONS = 64;
+
+// Candidate velocities at unit max speed, alternating full and half speed around the circle
+struct CandidatePattern {
+    glm::vec2 points[CROWD_SIM_CANDIDATES];
+    glm::vec2 rotations[CROWD_SIM_ROTATIONS];   // cos, sin
+    CandidatePattern() {
+        for (int k = 3; k < CROWD_SIM_CANDIDATES; ++k) {
+            float angle = (float)k / (CROWD_SIM_CANDIDATES - 3) * glm::two_pi<float>();
+            points[k] = glm::vec2(std::cos(angle), std::sin(angle)) * ((k & 1) ? 1.0f : 0.5f);
+        }
+        for (int r = 0; r < CROWD_SIM_ROTATIONS; ++r) {
+            float angle = (float)r / CROWD_SIM_ROTATIONS * glm::two_pi<float>();
+            rotations[r] = glm::vec2(std::cos(angle), std::sin(angle));
+        }
+    }
+};
+static const CandidatePattern candidatePattern;
+
+// Scores CROWD_SIM_CANDIDATES velocities for agent i against its closest neighbors and keeps the best
+static void SelectVelocity(CrowdSimulation& sim, const CrowdSimulationSettings& settings, int i) {
+    const CrowdAgents& a = sim.agents[sim.current];
+    float px = a.positionX[i], pz = a.positionZ[i];
+    float vx = a.velocityX[i], vz = a.velocityZ[i];
+    float radius = settings.agentRadius * a.scale[i];
+
+    // Neighbors in range from the 3x3 cells around the agent, appended without branching; in a
+    // crowd this sparse the closest-K cut rarely has anything to drop
+    const int maxGathered = 64;
+    int gathered[maxGathered];
+    float gatheredDistances[maxGathered];
+    int gatheredCount = 0;
+    float range2 = settings.neighborRadius * settings.neighborRadius;
+    float inverseCell = 1.0f / sim.cellSize;
+    int cx = std::clamp((int)((px - sim.gridOrigin) * inverseCell), 0, sim.gridSize - 1);
+    int cz = std::clamp((int)((pz - sim.gridOrigin) * inverseCell), 0, sim.gridSize - 1);
+    for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, sim.gridSize - 1); ++z) {
+        int rowStart = z * sim.gridSize;
+        int first = sim.cellStart[rowStart + std::max(cx - 1, 0)];
+        int last = std::min(sim.cellStart[rowStart + std::min(cx + 1, sim.gridSize - 1) + 1], first + maxGathered - gatheredCount);
+        for (int j = first; j < last; ++j) {
+            float dx = a.positionX[j] - px, dz = a.positionZ[j] - pz;
+            float d2 = dx * dx + dz * dz;
+            gathered[gatheredCount] = j;
+            gatheredDistances[gatheredCount] = d2;
+            gatheredCount += (d2 < range2) & (j != i);
+        }
+    }
+    int neighbors[CROWD_SIM_MAX_NEIGHBORS];
+    float distances[CROWD_SIM_MAX_NEIGHBORS];
+    int neighborCount = std::min(gatheredCount, CROWD_SIM_MAX_NEIGHBORS);
+    if (gatheredCount > CROWD_SIM_MAX_NEIGHBORS) {
+        int order[maxGathered];
+        for (int n = 0; n < gatheredCount; ++n) {
+            order[n] = n;
+        }
+        std::nth_element(order, order + CROWD_SIM_MAX_NEIGHBORS - 1, order + gatheredCount,
+            [&](int x, int y) { return gatheredDistances[x] < gatheredDistances[y]; });
+        for (int n = 0; n < neighborCount; ++n) {
+            neighbors[n] = gathered[order[n]];
+            distances[n] = gatheredDistances[order[n]];
+        }
+    }
+    else {
+        std::copy(gathered, gathered + neighborCount, neighbors);
+        std::copy(gatheredDistances, gatheredDistances + neighborCount, distances);
+    }
+
+    // Candidates: preferred, current, standing still, and a jittered pattern inside the speed limit
+    float prefX = 0.0f, prefZ = 0.0f;
+    float toGoalX = a.goalX[i] - px, toGoalZ = a.goalZ[i] - pz;
+    float toGoal = std::sqrt(toGoalX * toGoalX + toGoalZ * toGoalZ);
+    if (toGoal > 1e-3f) {
+        float prefSpeed = std::min(settings.preferredSpeed * a.speed[i], toGoal);
+        prefX = toGoalX / toGoal * prefSpeed;
+        prefZ = toGoalZ / toGoal * prefSpeed;
+    }
+    alignas(16) float candidateX[CROWD_SIM_CANDIDATES], candidateZ[CROWD_SIM_CANDIDATES];
+    candidateX[0] = prefX; candidateZ[0] = prefZ;
+    candidateX[1] = vx; candidateZ[1] = vz;
+    candidateX[2] = 0.0f; candidateZ[2] = 0.0f;
+    // The pattern is rotated by a per agent, per tick angle so no direction is always missed
+    const CandidatePattern& pattern = candidatePattern;
+    unsigned int jitter = (a.seed[i] ^ sim.tick * 747796405u) | 1u;
+    const glm::vec2& rotation = pattern.rotations[NextRandom(jitter) % CROWD_SIM_ROTATIONS];
+    for (int k = 3; k < CROWD_SIM_CANDIDATES; ++k) {
+        glm::vec2 p = pattern.points[k] * settings.maxSpeed;
+        candidateX[k] = p.x * rotation.x - p.y * rotation.y;
+        candidateZ[k] = p.x * rotation.y + p.y * rotation.x;
+    }
+
+    // Neighbor terms that don't depend on the candidate
+    float neighborX[CROWD_SIM_MAX_NEIGHBORS], neighborZ[CROWD_SIM_MAX_NEIGHBORS], neighborC[CROWD_SIM_MAX_NEIGHBORS];
+    float neighborVX[CROWD_SIM_MAX_NEIGHBORS], neighborVZ[CROWD_SIM_MAX_NEIGHBORS];
+    for (int n = 0; n < neighborCount; ++n) {
+        int j = neighbors[n];
+        float combined = radius + settings.agentRadius * a.scale[j];
+        neighborX[n] = a.positionX[j] - px;
+        neighborZ[n] = a.positionZ[j] - pz;
+        neighborC[n] = distances[n] - combined * combined;
+        neighborVX[n] = vx + a.velocityX[j];
+        neighborVZ[n] = vz + a.velocityZ[j];
+    }
+
+    // Neighbors outside, candidate groups inside, so the four groups' sqrt and divide overlap.
+    // Approximate reciprocals are plenty for ranking candidates.
+    const int groups = CROWD_SIM_CANDIDATES / 4;
+    const __m128 infinity = _mm_set1_ps(1e30f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 tiny = _mm_set1_ps(1e-6f);
+    __m128 twiceX[groups], twiceZ[groups], firstHit[groups];
+    for (int g = 0; g < groups; ++g) {
+        twiceX[g] = _mm_mul_ps(two, _mm_load_ps(candidateX + g * 4));
+        twiceZ[g] = _mm_mul_ps(two, _mm_load_ps(candidateZ + g * 4));
+        firstHit[g] = infinity;
+    }
+    for (int n = 0; n < neighborCount; ++n) {
+        __m128 rx = _mm_set1_ps(neighborX[n]), rz = _mm_set1_ps(neighborZ[n]);
+        __m128 c = _mm_set1_ps(neighborC[n]);
+        __m128 nvx = _mm_set1_ps(neighborVX[n]), nvz = _mm_set1_ps(neighborVZ[n]);
+        bool overlapping = neighborC[n] < 0.0f;
+        for (int g = 0; g < groups; ++g) {
+            // Reciprocal: each agent is assumed to take half the avoidance, so the relative velocity is 2c - vA - vB
+            __m128 relX = _mm_sub_ps(twiceX[g], nvx), relZ = _mm_sub_ps(twiceZ[g], nvz);
+            // Time t where |r - rel t| = combined radius: a t^2 - 2 b t + c = 0
+            __m128 qb = _mm_add_ps(_mm_mul_ps(relX, rx), _mm_mul_ps(relZ, rz));
+            __m128 approaching = _mm_cmpgt_ps(qb, zero);
+            __m128 t;
+            if (overlapping) {
+                // Already overlapping: anything that closes in collides now
+                t = _mm_andnot_ps(approaching, infinity);
+            }
+            else {
+                __m128 qa = _mm_add_ps(_mm_mul_ps(relX, relX), _mm_mul_ps(relZ, relZ));
+                __m128 discriminant = _mm_sub_ps(_mm_mul_ps(qb, qb), _mm_mul_ps(qa, c));
+                __m128 hit = _mm_and_ps(approaching, _mm_cmpgt_ps(discriminant, zero));
+                // The smaller root, as c / (b + sqrt(discriminant)) to stay stable for small a
+                __m128 sqrtDiscriminant = _mm_mul_ps(discriminant, _mm_rsqrt_ps(_mm_max_ps(discriminant, tiny)));
+                __m128 root = _mm_mul_ps(c, _mm_rcp_ps(_mm_max_ps(_mm_add_ps(qb, sqrtDiscriminant), tiny)));
+                t = _mm_or_ps(_mm_and_ps(hit, root), _mm_andnot_ps(hit, infinity));
+            }
+            firstHit[g] = _mm_min_ps(firstHit[g], t);
+        }
+    }
+
+    alignas(16) float penalties[CROWD_SIM_CANDIDATES];
+    __m128 weight = _mm_set1_ps(settings.collisionWeight);
+    for (int g = 0; g < groups; ++g) {
+        __m128 dX = _mm_sub_ps(_mm_load_ps(candidateX + g * 4), _mm_set1_ps(prefX));
+        __m128 dZ = _mm_sub_ps(_mm_load_ps(candidateZ + g * 4), _mm_set1_ps(prefZ));
+        __m128 deviation = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dX, dX), _mm_mul_ps(dZ, dZ)));
+        __m128 collision = _mm_mul_ps(weight, _mm_rcp_ps(_mm_max_ps(firstHit[g], _mm_set1_ps(1e-3f))));
+        _mm_store_ps(penalties + g * 4, _mm_add_ps(deviation, collision));
+    }
+    int best = 0;
+    for (int k = 1; k < CROWD_SIM_CANDIDATES; ++k) {
+        best = penalties[k] < penalties[best] ? k : best;
+    }
+    sim.nextVelocityX[i] = candidateX[best];
+    sim.nextVelocityZ[i] = candidateZ[best];
+}
+
+void UpdateCrowdSimulation(CrowdSimulation& sim, const CrowdSimulationSettings& settings, Crowd& crowd,
+    const CrowdSettings& crowdSettings, ThreadPool& pool, float deltaTime) {
+    if (!settings.enabled || !crowdSettings.enabled || sim.agents[0].id.empty()) {
+        return;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    float dt = std::min(deltaTime, settings.maxDeltaTime);
+    int activeCount = std::clamp(crowdSettings.count, 0, (int)crowd.instances.size());
+
+    sim.tick++;
+
+    // 1. Rebuild the grid
+    SortAgents(sim, settings, activeCount);
+
+    // 2. New velocities, from the positions and velocities every agent had at the start of the tick
+    ParallelFor(pool, sim.activeCount, 256, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            SelectVelocity(sim, settings, i);
+        }
+    });
+
+    // 3. Move, retarget and write back the instance placement
+    CrowdAgents& a = sim.agents[sim.current];
+    ParallelFor(pool, sim.activeCount, 512, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            a.velocityX[i] = sim.nextVelocityX[i];
+            a.velocityZ[i] = sim.nextVelocityZ[i];
+            a.positionX[i] += a.velocityX[i] * dt;
+            a.positionZ[i] += a.velocityZ[i] * dt;
+            float toGoalX = a.goalX[i] - a.positionX[i], toGoalZ = a.goalZ[i] - a.positionZ[i];
+            if (toGoalX * toGoalX + toGoalZ * toGoalZ < 1.0f) {
+                PickGoal(sim, a.seed[i], a.positionX[i], a.positionZ[i], a.goalX[i], a.goalZ[i]);
+            }
+            // Turn toward the direction of travel, not instantly
+            float speed2 = a.velocityX[i] * a.velocityX[i] + a.velocityZ[i] * a.velocityZ[i];
+            if (speed2 > 0.01f) {
+                float turn = std::atan2(a.velocityX[i], a.velocityZ[i]) - a.heading[i];
+                turn -= glm::two_pi<float>() * std::floor(turn / glm::two_pi<float>() + 0.5f);
+                a.heading[i] += turn * std::min(dt * 5.0f, 1.0f);
+            }
+            CrowdInstance& instance = crowd.instances[a.id[i]];
+            instance.position = glm::vec3(a.positionX[i], SampleTerrainHeightCache(sim.heights, a.positionX[i], a.positionZ[i]), a.positionZ[i]);
+            instance.heading = a.heading[i];
+        }
+    });
+    sim.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
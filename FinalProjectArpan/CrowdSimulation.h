@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "Crowd.h"
+#include "Terrain.h"
+#include "ThreadPool.h"
+
+// Local avoidance for the crowd's agents.
+// Agent state is kept structure-of-arrays and re-sorted by grid cell every tick with a counting
+// sort, so an agent's neighbors sit next to it in memory and a neighbor query only walks the
+// 3x3 cells around it. Each agent then picks a new velocity RVO style (van den Berg et al.
+// 2008): candidate velocities around its preferred one are scored by how soon they would
+// collide with a neighbor, assuming the neighbor takes half the avoiding, plus how far they
+// stray from the preferred velocity. Four candidates are scored per SSE operation, and agents
+// are split across the thread pool. The result is written back into the crowd's instances.
+const int CROWD_SIM_CANDIDATES = 16;      // Candidate velocities per agent, a multiple of 4
+const int CROWD_SIM_MAX_NEIGHBORS = 10;   // Closest neighbors considered
+const int CROWD_SIM_HEIGHT_SIZE = 512;    // Terrain height cache resolution
+
+struct CrowdSimulationSettings {
+    bool enabled = true;
+    float preferredSpeed = 0.9f;    // Walking speed toward the goal; agents playing the second clip stand still
+    float maxSpeed = 1.4f;
+    float agentRadius = 0.45f;      // At instance scale 1
+    float neighborRadius = 3.0f;    // Also the grid cell size
+    float collisionWeight = 1.5f;   // Penalty for a collision one second away, in m/s of deviation
+    float maxDeltaTime = 0.05f;
+};
+
+// Per agent state, one array per field
+struct CrowdAgents {
+    std::vector<float> positionX, positionZ;
+    std::vector<float> velocityX, velocityZ;
+    std::vector<float> goalX, goalZ;
+    std::vector<float> scale;       // Instance scale, multiplies the agent radius
+    std::vector<float> speed;       // Multiplies the preferred speed; 0 for agents standing still
+    std::vector<float> heading;
+    std::vector<unsigned int> seed; // Random state for picking goals
+    std::vector<int> id;            // Crowd instance index
+};
+
+struct CrowdSimulation {
+    CrowdAgents agents[2];          // Grid ordered agents and the scatter target of the next sort
+    int current = 0;
+    std::vector<float> nextVelocityX, nextVelocityZ;
+    std::vector<int> cellOf;
+    std::vector<int> cellStart;     // Prefix sums; inactive agents sort into one extra cell at the end
+    int gridSize = 0;               // Cells per side
+    float gridOrigin = 0.0f;        // World x and z of the grid's corner
+    float cellSize = 1.0f;
+    int activeCount = 0;
+    unsigned int tick = 0;
+
+    float innerRadius = 0.0f, outerRadius = 0.0f;   // Where goals are picked
+    TerrainHeightCache heights;     // Over the ring's bounding square
+
+    float milliseconds = 0.0f;      // CPU time of the last tick
+};
+
+// Takes the agents from the crowd's scattered instances; the second clip's instances stand still
+bool InitCrowdSimulation(CrowdSimulation& sim, const Crowd& crowd, const CrowdSettings& crowdSettings, Terrain& terrain, const TerrainSettings& terrainSettings);
+void DestroyCrowdSimulation(CrowdSimulation& sim);
+
+// Moves the first crowdSettings.count agents and writes their placement into crowd.instances;
+// no GL calls, UploadCrowdInstances sends them
+void UpdateCrowdSimulation(CrowdSimulation& sim, const CrowdSimulationSettings& settings, Crowd& crowd,
+    const CrowdSettings& crowdSettings, ThreadPool& pool, float deltaTime);
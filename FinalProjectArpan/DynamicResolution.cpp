@@ -0,0 +1,130 @@
+#include "DynamicResolution.h"
+#include "Shader.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+static void DestroyInputTarget(DynamicResolution& dr) {
+    glDeleteFramebuffers(1, &dr.inputFBO);
+    glDeleteTextures(1, &dr.inputTexture);
+    dr.inputFBO = dr.inputTexture = 0;
+    dr.inputWidth = dr.inputHeight = 0;
+}
+
+static void EnsureInputTarget(DynamicResolution& dr, int width, int height) {
+    if (dr.inputWidth == width && dr.inputHeight == height) {
+        return;
+    }
+    DestroyInputTarget(dr);
+    dr.inputWidth = width;
+    dr.inputHeight = height;
+
+    glGenTextures(1, &dr.inputTexture);
+    glBindTexture(GL_TEXTURE_2D, dr.inputTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &dr.inputFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, dr.inputFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dr.inputTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "ERROR::FRAMEBUFFER::DYNAMIC_RESOLUTION_INCOMPLETE" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool InitDynamicResolution(DynamicResolution& dr, int outputWidth, int outputHeight) {
+    dr.outputWidth = std::max(1, outputWidth);
+    dr.outputHeight = std::max(1, outputHeight);
+    dr.upscaleProgram = LoadShaderProgram("shaders/upscale_sharpen.glsl");
+    InitGpuTimer(dr.frameTimer);
+    return dr.upscaleProgram != 0;
+}
+
+void ResizeDynamicResolution(DynamicResolution& dr, int outputWidth, int outputHeight) {
+    // Minimized windows report a zero size; keep rendering at the last real size
+    if (outputWidth <= 0 || outputHeight <= 0) {
+        return;
+    }
+    dr.outputWidth = outputWidth;
+    dr.outputHeight = outputHeight;
+}
+
+void DestroyDynamicResolution(DynamicResolution& dr) {
+    DestroyInputTarget(dr);
+    glDeleteProgram(dr.upscaleProgram);
+    DestroyGpuTimer(dr.frameTimer);
+}
+
+GLuint BeginDynamicResolutionFrame(DynamicResolution& dr, const DynamicResolutionSettings& settings, PostProcess& pp) {
+    BeginGpuTimer(dr.frameTimer);
+
+    if (!settings.enabled) {
+        // Start from full quality the next time scaling is switched on
+        dr.scale = settings.maxScale;
+        ResizePostProcess(pp, dr.outputWidth, dr.outputHeight);
+        return 0;
+    }
+
+    int width = std::max(1, (int)std::lround(dr.outputWidth * dr.scale));
+    int height = std::max(1, (int)std::lround(dr.outputHeight * dr.scale));
+    ResizePostProcess(pp, width, height);
+    EnsureInputTarget(dr, pp.width, pp.height);
+    return dr.inputFBO;
+}
+
+static void UpdateScale(DynamicResolution& dr, const DynamicResolutionSettings& settings) {
+    if (dr.frameTimer.samples == dr.lastSample) {
+        return;
+    }
+    dr.lastSample = dr.frameTimer.samples;
+    float milliseconds = std::max(dr.frameTimer.milliseconds, 0.01f);
+    dr.filteredMilliseconds = dr.filteredMilliseconds > 0.0f ? dr.filteredMilliseconds + (milliseconds - dr.filteredMilliseconds) * 0.3f : milliseconds;
+    if (dr.cooldown > 0) {
+        dr.cooldown--;
+        return;
+    }
+
+    // GPU cost follows the pixel count, which goes with the square of the scale
+    float desired = dr.scale * std::sqrt(settings.targetMilliseconds / dr.filteredMilliseconds);
+    float scale = dr.scale;
+    if (dr.filteredMilliseconds > settings.targetMilliseconds) {
+        // Over budget: drop straight to the estimate
+        scale = std::floor(desired / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP;
+    }
+    else if (dr.filteredMilliseconds < settings.targetMilliseconds * 0.85f) {
+        // Clear headroom: climb back one step at a time so we do not overshoot
+        scale = std::min(desired, dr.scale + DYNAMIC_RESOLUTION_STEP);
+        scale = std::floor(scale / DYNAMIC_RESOLUTION_STEP + 1e-3f) * DYNAMIC_RESOLUTION_STEP;
+    }
+    scale = std::clamp(scale, settings.minScale, settings.maxScale);
+    if (std::fabs(scale - dr.scale) > 1e-3f) {
+        dr.scale = scale;
+        dr.cooldown = GPU_TIMER_LATENCY;
+    }
+}
+
+void EndDynamicResolutionFrame(DynamicResolution& dr, const DynamicResolutionSettings& settings, const PostProcess& pp) {
+    if (settings.enabled) {
+        glDisable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, dr.outputWidth, dr.outputHeight);
+        glUseProgram(dr.upscaleProgram);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, dr.inputTexture);
+        glUniform1i(glGetUniformLocation(dr.upscaleProgram, "uSource"), 0);
+        glUniform2f(glGetUniformLocation(dr.upscaleProgram, "uOutputSize"), (float)dr.outputWidth, (float)dr.outputHeight);
+        glUniform1f(glGetUniformLocation(dr.upscaleProgram, "uSharpness"), settings.sharpness);
+        DrawFullscreenTriangle(pp);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    EndGpuTimer(dr.frameTimer);
+    if (settings.enabled) {
+        UpdateScale(dr, settings);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "GpuTimer.h"
+#include "PostProcess.h"
+
+// Dynamic resolution scaling.
+// The scene and its post-processing run at outputSize * scale. A controller fed by a GPU timer
+// around the whole frame moves the scale toward the frame time budget, and a contrast adaptive
+// sharpening upscale presents the result at window resolution. ImGui is drawn afterwards at native size.
+const float DYNAMIC_RESOLUTION_STEP = 0.05f;   // Scale is quantized so targets are not rebuilt every frame
+
+struct DynamicResolutionSettings {
+    bool enabled = false;
+    float targetMilliseconds = 15.0f;   // GPU budget, with some headroom under 16.7 ms for 60 FPS
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float sharpness = 0.5f;             // 0: mild, 1: strong
+};
+
+struct DynamicResolution {
+    int outputWidth = 0, outputHeight = 0;
+    float scale = 1.0f;
+    float filteredMilliseconds = 0.0f;
+    unsigned int lastSample = 0;
+    int cooldown = 0;                   // Readings to skip after a change, they still measure the old scale
+
+    int inputWidth = 0, inputHeight = 0;
+    GLuint inputFBO = 0;
+    GLuint inputTexture = 0;            // RGBA8 post-processed scene at render resolution
+
+    GLuint upscaleProgram = 0;
+    GpuTimer frameTimer;
+};
+
+bool InitDynamicResolution(DynamicResolution& dr, int outputWidth, int outputHeight);
+void ResizeDynamicResolution(DynamicResolution& dr, int outputWidth, int outputHeight);
+void DestroyDynamicResolution(DynamicResolution& dr);
+
+// Starts the frame timer and sizes the post-process targets for this frame's scale.
+// Returns the framebuffer ApplyPostProcess should write to.
+GLuint BeginDynamicResolutionFrame(DynamicResolution& dr, const DynamicResolutionSettings& settings, PostProcess& pp);
+
+// Upscales to the default framebuffer, stops the timer and updates the scale from the latest reading
+void EndDynamicResolutionFrame(DynamicResolution& dr, const DynamicResolutionSettings& settings, const PostProcess& pp);
@@ -19,6 +19,36 @@
 #include <map>
 #include <filesystem>
 #include <functional>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include "Shader.h"
+#include "Mesh.h"
+#include "PostProcess.h"
+#include "SSAO.h"
+#include "Temporal.h"
+#include "DynamicResolution.h"
+#include "OIT.h"
+#include "VolumetricFog.h"
+#include "Snowfall.h"
+#include "SnowSurface.h"
+#include "Terrain.h"
+#include "Forest.h"
+#include "WindField.h"
+#include "ThreadPool.h"
+#include "Characters.h"
+#include "Crowd.h"
+#include "CrowdSimulation.h"
+#include "Physics.h"
+#include "CameraCollision.h"
+#include "Bvh.h"
+#include "OcclusionCulling.h"
+#include "OcclusionQueries.h"
+#include "Meshlets.h"
+#include "Pvs.h"
+#include "VertexFormat.h"
+#include "MeshOptimizer.h"
+#include "MeshCodec.h"
 
 namespace fs = std::filesystem;
 
@@ -51,6 +81,123 @@ bool moveBackward = false;
 bool moveLeft = false;
 bool moveRight = false;
 
+// Post-processing state
+PostProcess postProcess;
+PostProcessSettings postSettings;
+float emissiveStrength = 4.0f;         // Scales MTL Ke so emissive materials reach bloom range
+const char* tonemapperNames[] = { "Clamp", "Reinhard", "ACES" };
+
+// Ambient occlusion state
+SSAO ssao;
+SSAOSettings ssaoSettings;
+const char* temporalPatternNames[] = { "Every pixel", "Checkerboard", "Quarter" };
+
+// Temporal reprojection shared by screen-space effects
+Temporal temporal;
+TemporalSettings temporalSettings;
+
+// Dynamic resolution state
+DynamicResolution dynamicResolution;
+DynamicResolutionSettings dynamicSettings;
+
+// Order-independent transparency state
+OIT oit;
+
+// Volumetric fog state
+VolumetricFog volumetricFog;
+VolumetricFogSettings fogSettings;
+
+// Snowfall particle state
+Snowfall snowfall;
+SnowfallSettings snowSettings;
+OffscreenParticles offscreenParticles;
+
+// Deformable snow on the ground
+SnowSurface snowSurface;
+SnowSurfaceSettings snowSurfaceSettings;
+bool stampSledTrack = false;
+
+// Streamed clipmap terrain around the scene
+Terrain terrain;
+TerrainSettings terrainSettings;
+
+// Scattered forest on the terrain
+Forest forest;
+ForestSettings forestSettings;
+
+// Wind shared by trees and snow
+WindField windField;
+WindSettings windSettings;
+
+// Worker threads for CPU-side per-frame work
+ThreadPool threadPool;
+
+// Skinned, animated characters
+Characters characters;
+CharacterSettings characterSettings;
+
+// Vertex-animated snowman crowd
+Crowd crowd;
+CrowdSettings crowdSettings;
+CrowdSimulation crowdSimulation;
+CrowdSimulationSettings crowdSimulationSettings;
+
+// Rigid bodies: snowballs thrown from the camera and gifts dropped on the scene
+PhysicsWorld physics;
+PhysicsSettings physicsSettings;
+int snowballShape = -1;
+int giftShapes[2] = { -1, -1 };
+int pendingSnowballs = 0;
+int snowballsPerThrow = 20;
+bool dropGifts = false;
+std::mt19937 physicsRandom(520);
+
+// Keeps the first person camera out of the scene's meshes
+CollisionWorld collisionWorld;
+CameraCollisionSettings cameraCollisionSettings;
+
+// Ray casts against the loaded scene: mouse picking and a packet tracing benchmark
+SceneBvh sceneBvh;
+glm::mat4 sceneBvhModel = glm::mat4(0.0f);  // Transform the top level was last built for
+bool pendingPick = false;
+double pickX = 0.0, pickY = 0.0;             // Cursor at the click, in window coordinates
+BvhHit pickHit;
+glm::vec3 pickPoint(0.0f);
+float pickMicroseconds = 0.0f;
+bool benchmarkRays = false;
+int benchmarkSize = 256;                     // Rays per side of the benchmark grid
+float benchmarkMilliseconds = 0.0f;
+int benchmarkHits = 0;
+
+// CPU depth buffer of simplified scene occluders, tested by the scene meshes and the forest
+OcclusionCuller occlusion;
+OcclusionSettings occlusionSettings;
+
+// GPU occlusion queries and conditional rendering for the heavy scene meshes
+OcclusionQueries occlusionQueries;
+OcclusionQuerySettings occlusionQuerySettings;
+
+// Meshlet frustum and cone culling for the big scene meshes
+MeshletMeshes meshlets;
+MeshletSettings meshletSettings;
+
+// Baked potentially visible sets of the scene meshes, per column of the walkable area
+Pvs pvs;
+PvsSettings pvsSettings;
+bool rebakePvs = false;
+
+// Compact GPU vertex and index formats for the scene meshes
+VertexFormatSettings vertexFormatSettings;
+bool reuploadMeshes = false;
+size_t sceneBufferBytes = 0, sceneFloatBufferBytes = 0;   // Vertex and index buffers, as uploaded and as 32-bit floats and indices
+
+// Vertex cache, overdraw and vertex fetch ordering of the scene meshes at import
+MeshOptimizeStats meshOptimizeStats;
+VertexCacheStats drawnCacheStats;   // As drawn, after meshlets reorder the big meshes
+
+// Compressed cache of the imported scene geometry
+MeshCodecStats meshCodecStats;
+
 void draw_gui(GLFWwindow* window) {
     // Begin ImGui Frame
     ImGui_ImplOpenGL3_NewFrame();
@@ -76,6 +223,267 @@ void draw_gui(GLFWwindow* window) {
     //ImGui::SliderFloat("Scale", &scale, -10.0f, +10.0f);
     ImGui::RadioButton("None", &isFpp, 0); ImGui::SameLine();
     ImGui::RadioButton("FPP", &isFpp, 1);
+    ImGui::Checkbox("Snowfall", &snowSettings.enabled);
+    ImGui::SliderInt("Snowflakes", &snowSettings.particleCount, 0, SNOW_MAX_PARTICLES);
+    ImGui::SliderFloat("Fall speed", &snowSettings.fallSpeed, 0.1f, 4.0f);
+    ImGui::SliderFloat("Flake size", &snowSettings.flakeSize, 0.005f, 0.1f);
+    ImGui::RadioButton("Snow full res", &snowSettings.resolutionDivisor, 1); ImGui::SameLine();
+    ImGui::RadioButton("Half", &snowSettings.resolutionDivisor, 2); ImGui::SameLine();
+    ImGui::RadioButton("Quarter", &snowSettings.resolutionDivisor, 4);
+    ImGui::Text("Snowfall GPU time %.3f ms", snowfall.timer.milliseconds);
+    ImGui::Checkbox("Deformable snow", &snowSurfaceSettings.enabled);
+    ImGui::SliderFloat("Snow depth", &snowSurface.snowDepth, 0.0f, snowSurfaceSettings.maxDepth);
+    ImGui::SliderFloat("Accumulation rate", &snowSurfaceSettings.accumulationRate, 0.0f, 0.02f, "%.4f");
+    ImGui::SliderFloat("Refill time", &snowSurfaceSettings.refillTime, 1.0f, 120.0f);
+    if (ImGui::Button("Sled track")) {
+        stampSledTrack = true;
+    }
+    ImGui::Text("Snow tiles updated %d, GPU time %.3f ms", snowSurface.activeTileCount, snowSurface.timer.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 2 : Post Processing");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Bloom", &postSettings.bloom);
+    ImGui::SliderFloat("Bloom threshold", &postSettings.bloomThreshold, 0.0f, 4.0f);
+    ImGui::SliderFloat("Bloom knee", &postSettings.bloomKnee, 0.0f, 1.0f);
+    ImGui::SliderFloat("Bloom intensity", &postSettings.bloomIntensity, 0.0f, 1.0f);
+    ImGui::SliderFloat("Bloom radius", &postSettings.bloomRadius, 0.5f, 2.0f);
+    ImGui::SliderFloat("Emissive strength", &emissiveStrength, 0.0f, 16.0f);
+    ImGui::SliderFloat("Exposure", &postSettings.exposure, 0.1f, 4.0f);
+    ImGui::Combo("Tonemapper", &postSettings.tonemapper, tonemapperNames, IM_ARRAYSIZE(tonemapperNames));
+    ImGui::Checkbox("FXAA", &postSettings.fxaa);
+    ImGui::Text("Bloom GPU time %.3f ms", postProcess.bloomTimer.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 3 : Ambient Occlusion");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("SSAO", &ssaoSettings.enabled);
+    ImGui::RadioButton("Half res", &ssaoSettings.resolutionDivisor, 2); ImGui::SameLine();
+    ImGui::RadioButton("Quarter res", &ssaoSettings.resolutionDivisor, 4);
+    ImGui::SliderFloat("AO radius", &ssaoSettings.radius, 0.05f, 2.0f);
+    ImGui::SliderInt("AO samples", &ssaoSettings.sampleCount, 4, SSAO_MAX_SAMPLES);
+    ImGui::SliderFloat("AO intensity", &ssaoSettings.intensity, 0.5f, 4.0f);
+    ImGui::Checkbox("AO temporal accumulation", &ssaoSettings.temporal);
+    ImGui::Combo("AO pixels per frame", &ssaoSettings.temporalPattern, temporalPatternNames, IM_ARRAYSIZE(temporalPatternNames));
+    ImGui::SliderFloat("History blend", &temporalSettings.freshWeight, 0.05f, 1.0f);
+    ImGui::SliderFloat("History depth tolerance", &temporalSettings.depthTolerance, 0.01f, 0.2f);
+    ImGui::Text("SSAO GPU time %.3f ms", ssao.timer.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 4 : Dynamic Resolution");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Dynamic resolution", &dynamicSettings.enabled);
+    ImGui::SliderFloat("GPU budget (ms)", &dynamicSettings.targetMilliseconds, 4.0f, 33.0f);
+    ImGui::SliderFloat("Minimum scale", &dynamicSettings.minScale, 0.25f, 1.0f);
+    ImGui::SliderFloat("Sharpness", &dynamicSettings.sharpness, 0.0f, 1.0f);
+    ImGui::Text("Render scale %.2f (%d x %d)", dynamicSettings.enabled ? dynamicResolution.scale : 1.0f, postProcess.width, postProcess.height);
+    ImGui::Text("GPU frame time %.3f ms", dynamicResolution.frameTimer.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 5 : Volumetric Fog");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Fog", &fogSettings.enabled);
+    ImGui::SliderFloat("Fog density", &fogSettings.density, 0.0f, 0.2f);
+    ImGui::SliderFloat("Height falloff", &fogSettings.heightFalloff, 0.0f, 1.0f);
+    ImGui::SliderFloat("Fog anisotropy", &fogSettings.anisotropy, -0.9f, 0.9f);
+    ImGui::SliderFloat("Snow haze", &fogSettings.snowAmount, 0.0f, 2.0f);
+    ImGui::ColorEdit3("Moon light", &fogSettings.lightColor.x, ImGuiColorEditFlags_Float | ImGuiColorEditFlags_HDR);
+    ImGui::Text("Fog GPU time %.3f ms", volumetricFog.timer.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 6 : Terrain");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Clipmap terrain", &terrainSettings.enabled);
+    ImGui::Text("%d levels, %.0f units across", CLIPMAP_LEVELS, CLIPMAP_GRID * terrainSettings.sampleSpacing * (1 << (CLIPMAP_LEVELS - 1)));
+    ImGui::Text("Texels streamed this frame %d", terrain.uploadedTexels);
+    ImGui::Text("Terrain GPU time %.3f ms", terrain.timer.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 7 : Forest");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Forest", &forestSettings.enabled);
+    ImGui::SliderFloat("Mesh distance", &forestSettings.meshDistance, 10.0f, 300.0f);
+    ImGui::SliderFloat("Cross-fade range", &forestSettings.fadeRange, 0.0f, 60.0f);
+    ImGui::SliderFloat("Tree draw distance", &forestSettings.maxDistance, 100.0f, 1000.0f);
+    ImGui::Text("%d trees: %d meshes, %d impostors", forest.treeCount, forest.drawnMeshes, forest.drawnImpostors);
+    ImGui::SliderFloat("Tree sway", &forestSettings.sway, 0.0f, 0.1f);
+    ImGui::Text("Forest GPU time %.3f ms", forest.timer.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 8 : Wind");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Wind", &windSettings.enabled);
+    ImGui::SliderFloat3("Base wind", &windSettings.baseVelocity.x, -5.0f, 5.0f);
+    ImGui::SliderFloat("Gust strength", &windSettings.gustStrength, 0.0f, 6.0f);
+    ImGui::SliderFloat("Gust size", &windSettings.gustScale, 5.0f, 200.0f);
+    ImGui::SliderFloat("Wind updates per second", &windSettings.updateRate, 5.0f, 60.0f);
+    ImGui::Text("Wind %d updates/s, GPU time %.3f ms", windField.updatesPerSecond, windField.timer.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 9 : Characters");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Characters", &characterSettings.enabled);
+    ImGui::RadioButton("CPU skinning (SIMD)", &characterSettings.skinning, SKINNING_CPU); ImGui::SameLine();
+    ImGui::RadioButton("GPU skinning", &characterSettings.skinning, SKINNING_GPU);
+    ImGui::SliderInt("Character count", &characterSettings.count, 0, CHARACTER_MAX_COUNT);
+    ImGui::SliderFloat("Walk speed", &characterSettings.walkSpeed, 0.0f, 3.0f);
+    ImGui::Text("%d joints, %d vertices per character, %d worker threads", (int)characters.model.skeleton.parents.size(),
+        (int)characters.model.vertices.size(), (int)threadPool.workers.size());
+    ImGui::Text("Animation CPU time %.3f ms", characters.animationMilliseconds);
+    ImGui::Text("Skinning CPU time %.3f ms", characters.skinningMilliseconds);
+    ImGui::Text("Characters GPU time %.3f ms", characters.timer.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 10 : Snowman Crowd");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Snowman crowd", &crowdSettings.enabled);
+    ImGui::SliderInt("Snowmen", &crowdSettings.count, 0, CROWD_MAX_INSTANCES);
+    ImGui::Text("Animation textures %d vertices x %d frames, %d clips", crowd.animation.vertexCount, crowd.animation.frameCount, (int)crowd.animation.clips.size());
+    ImGui::Checkbox("Local avoidance", &crowdSimulationSettings.enabled);
+    ImGui::SliderFloat("Snowman speed", &crowdSimulationSettings.preferredSpeed, 0.0f, 1.4f);
+    ImGui::SliderFloat("Avoidance weight", &crowdSimulationSettings.collisionWeight, 0.0f, 5.0f);
+    ImGui::Text("Simulation CPU time %.3f ms", crowdSimulation.milliseconds);
+    ImGui::Text("Crowd GPU time %.3f ms", crowd.timer.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 11 : Physics");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Physics", &physicsSettings.enabled);
+    ImGui::SliderInt("Snowballs per throw", &snowballsPerThrow, 1, 200);
+    if (ImGui::Button("Throw snowballs")) {
+        pendingSnowballs += snowballsPerThrow;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Drop gifts")) {
+        dropGifts = true;
+    }
+    ImGui::Text("E throws a snowball in FPP");
+    ImGui::SliderInt("Solver iterations", &physicsSettings.iterations, 1, 20);
+    ImGui::Text("%d bodies, %d awake, %d contacts, %d islands", (int)physics.bodies.size(), physics.awakeCount, physics.contactCount, physics.islandCount);
+    ImGui::Text("Physics CPU time %.3f ms", physics.milliseconds);
+    ImGui::Text("Physics GPU time %.3f ms", physics.timer.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 12 : Camera Collision");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Camera collision", &cameraCollisionSettings.enabled);
+    ImGui::SameLine();
+    ImGui::Checkbox("Follow ground", &cameraCollisionSettings.followGround);
+    ImGui::SliderFloat("Camera radius", &cameraCollisionSettings.radius, 0.05f, 1.0f);
+    ImGui::SliderFloat("Eye height", &cameraCollisionSettings.eyeHeight, 0.5f, 5.0f);
+    ImGui::SliderFloat("Step height", &cameraCollisionSettings.stepHeight, 0.0f, 1.0f);
+    ImGui::Text("%d triangles, %d cell entries, cell size %.2f", (int)collisionWorld.triangles.size(),
+        (int)collisionWorld.cellTriangles.size(), collisionWorld.cellSize);
+    ImGui::Text("%d triangles tested last move", collisionWorld.testedTriangles);
+    ImGui::Text("Hash build %.1f ms, query CPU time %.3f ms", collisionWorld.buildMilliseconds, collisionWorld.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 13 : Ray Casts");
+    ImGui::PopStyleColor();
+    ImGui::Text("%d triangles, %d BVH nodes, built in %.1f ms", sceneBvh.triangleCount, sceneBvh.nodeCount, sceneBvh.buildMilliseconds);
+    ImGui::Text("Click to pick (screen center in FPP)");
+    if (pickHit.instance >= 0) {
+        ImGui::Text("Picked mesh %d, triangle %d at (%.2f, %.2f, %.2f)", pickHit.instance, pickHit.triangle, pickPoint.x, pickPoint.y, pickPoint.z);
+    }
+    else {
+        ImGui::Text("Picked nothing");
+    }
+    ImGui::Text("Pick CPU time %.1f us", pickMicroseconds);
+    ImGui::SliderInt("Benchmark rays per side", &benchmarkSize, 64, 1024);
+    if (ImGui::Button("Trace view rays")) {
+        benchmarkRays = true;
+    }
+    ImGui::Text("%d rays, %d hits, %.2f ms (%.2f Mrays/s)", benchmarkSize * benchmarkSize, benchmarkHits, benchmarkMilliseconds,
+        benchmarkMilliseconds > 0.0f ? benchmarkSize * benchmarkSize / benchmarkMilliseconds / 1000.0f : 0.0f);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 14 : Occlusion Culling");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Occlusion culling", &occlusionSettings.enabled);
+    ImGui::SliderFloat("Min occluder area", &occlusionSettings.minOccluderArea, 0.0f, 0.2f);
+    ImGui::Text("%d of %d occluders drawn, %d triangles rasterized", (int)occlusion.drawn.size(), (int)occlusion.occluders.size(),
+        occlusion.triangleCount);
+    ImGui::Text("%d of %d meshes occluded", occlusion.occludedMeshes, (int)occlusion.meshVisible.size());
+    ImGui::Text("CPU time %.3f ms", occlusion.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 15 : Occlusion Queries");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Occlusion queries", &occlusionQuerySettings.enabled);
+    ImGui::SliderInt("Min triangles", &occlusionQuerySettings.minTriangles, 0, 100000);
+    ImGui::SliderInt("Visible requery interval", &occlusionQuerySettings.visibleInterval, 1, 16);
+    ImGui::SliderFloat("Box margin", &occlusionQuerySettings.boundsMargin, 0.0f, 0.5f);
+    ImGui::Text("%d heavy meshes, %d hidden, %d queries issued", occlusionQueries.heavyMeshes, occlusionQueries.hiddenMeshes,
+        occlusionQueries.issuedQueries);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 16 : Meshlet Culling");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("Meshlets", &meshletSettings.enabled);
+    ImGui::SameLine();
+    ImGui::Checkbox("Frustum", &meshletSettings.frustumCulling);
+    ImGui::SameLine();
+    ImGui::Checkbox("Cone", &meshletSettings.coneCulling);
+    ImGui::Text("%d meshlets over %d meshes, %d drawn", (int)meshlets.meshlets.size(), (int)meshlets.meshes.size(), meshlets.drawnMeshlets);
+    ImGui::Text("%d of %d triangles drawn", meshlets.drawnTriangles, meshlets.totalTriangles);
+    ImGui::Text("Cull GPU time %.3f ms", meshlets.timer.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 17 : Potentially Visible Sets");
+    ImGui::PopStyleColor();
+    ImGui::Checkbox("PVS", &pvsSettings.enabled);
+    ImGui::SliderFloat("Max eye height", &pvsSettings.maxEyeHeight, 0.5f, 20.0f);
+    if (ImGui::Button("Rebake PVS")) {
+        rebakePvs = true;
+    }
+    ImGui::Text("%d distinct sets, %d bytes compressed, baked in %.0f ms", pvs.setBytes > 0 ? (int)pvs.sets.size() / pvs.setBytes : 0,
+        pvs.compressedBytes, pvs.bakeMilliseconds);
+    ImGui::Text("%d of %d meshes pruned", pvs.prunedMeshes, pvs.meshCount);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 18 : Compact Vertex Formats");
+    ImGui::PopStyleColor();
+    const char* vertexFormatNames[VERTEX_FORMAT_COUNT];
+    for (int i = 0; i < VERTEX_FORMAT_COUNT; ++i) {
+        vertexFormatNames[i] = VERTEX_FORMATS[i].name;
+    }
+    reuploadMeshes |= ImGui::Combo("Vertex format", &vertexFormatSettings.format, vertexFormatNames, VERTEX_FORMAT_COUNT);
+    reuploadMeshes |= ImGui::Checkbox("16-bit indices", &vertexFormatSettings.shortIndices);
+    ImGui::Text("Scene buffers %.2f MB (%.2f MB as floats)", sceneBufferBytes / 1048576.0f, sceneFloatBufferBytes / 1048576.0f);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 19 : Vertex Cache Optimization");
+    ImGui::PopStyleColor();
+    ImGui::Text("Imported: ACMR %.3f, ATVR %.3f", Acmr(meshOptimizeStats.before), Atvr(meshOptimizeStats.before));
+    ImGui::Text("Optimized: ACMR %.3f, ATVR %.3f", Acmr(meshOptimizeStats.after), Atvr(meshOptimizeStats.after));
+    ImGui::Text("As drawn: ACMR %.3f, ATVR %.3f", Acmr(drawnCacheStats), Atvr(drawnCacheStats));
+    ImGui::Text("Import pass %.1f ms", meshOptimizeStats.milliseconds);
+
+    ImGui::Text("");
+    ImGui::PushStyleColor(ImGuiCol_Text, greenColor);
+    ImGui::Text("Feature 20 : Compressed Mesh Cache");
+    ImGui::PopStyleColor();
+    ImGui::Text("Geometry %.2f MB, cached as %.2f MB (%.1fx)", meshCodecStats.rawBytes / 1048576.0f, meshCodecStats.encodedBytes / 1048576.0f,
+        meshCodecStats.encodedBytes > 0 ? (float)meshCodecStats.rawBytes / meshCodecStats.encodedBytes : 0.0f);
+    ImGui::Text("Load %.1f ms, of which decode %.2f ms", meshCodecStats.loadMilliseconds, meshCodecStats.decodeMilliseconds);
     if (ImGui::Button("Quit")) {
         glfwSetWindowShouldClose(window, GLFW_TRUE);
     }
@@ -98,6 +506,8 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             moveLeft = true;
         if (key == GLFW_KEY_D)
             moveRight = true;
+        if (key == GLFW_KEY_E && isFpp == 1)
+            pendingSnowballs++;
         if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
             isFpp=0; 
         }
@@ -114,26 +524,78 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     }
 }
 
-// Function to process camera movement based on input flags
-void processCameraMovement(float deltaTime) {
+// Function to process camera movement based on input flags; model is the scene meshes' transform
+void processCameraMovement(float deltaTime, const glm::mat4& model) {
     float velocity = movementSpeed * deltaTime;
+    glm::vec3 displacement(0.0f);
 
-    // Only update the x and z position to keep y constant
+    // Only move in x and z; y is kept, or follows the ground with collision on
     if (moveForward) {
-        position.x += front.x * velocity;  // Move along x based on front direction
-        position.z += front.z * velocity;  // Move along z based on front direction
+        displacement.x += front.x * velocity;  // Move along x based on front direction
+        displacement.z += front.z * velocity;  // Move along z based on front direction
     }
     if (moveBackward) {
-        position.x -= front.x * velocity;  // Move along x based on front direction
-        position.z -= front.z * velocity;  // Move along z based on front direction
+        displacement.x -= front.x * velocity;  // Move along x based on front direction
+        displacement.z -= front.z * velocity;  // Move along z based on front direction
     }
     if (moveLeft) {
-        position.x -= right.x * velocity;  // Move left along x based on right direction
-        position.z -= right.z * velocity;  // Move left along z based on right direction
+        displacement.x -= right.x * velocity;  // Move left along x based on right direction
+        displacement.z -= right.z * velocity;  // Move left along z based on right direction
     }
     if (moveRight) {
-        position.x += right.x * velocity;  // Move right along x based on right direction
-        position.z += right.z * velocity;  // Move right along z based on right direction
+        displacement.x += right.x * velocity;  // Move right along x based on right direction
+        displacement.z += right.z * velocity;  // Move right along z based on right direction
+    }
+
+    if (cameraCollisionSettings.enabled) {
+        position = MoveCamera(collisionWorld, cameraCollisionSettings, model, position, displacement, terrain, terrainSettings, deltaTime);
+    }
+    else {
+        position += displacement;
+    }
+}
+
+// Left click picks what is under the cursor, or under the screen center in FPP
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && (isFpp == 1 || !ImGui::GetIO().WantCaptureMouse)) {
+        glfwGetCursorPos(window, &pickX, &pickY);
+        pendingPick = true;
+    }
+}
+
+// Ray from the eye through a point in normalized device coordinates
+BvhRay viewRay(const glm::mat4& inverseViewProjection, glm::vec2 ndc) {
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+    BvhRay ray;
+    ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+    ray.direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - ray.origin);
+    return ray;
+}
+
+// Traces a grid of rays over the view in 2x2 blocks, so each packet of four stays together
+void traceBenchmarkRays(ThreadPool& pool, const glm::mat4& inverseViewProjection) {
+    int size = benchmarkSize & ~1;
+    std::vector<BvhRay> rays(size * size);
+    std::vector<BvhHit> hits(rays.size());
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            int index = ((y / 2) * (size / 2) + x / 2) * 4 + (y % 2) * 2 + x % 2;
+            rays[index] = viewRay(inverseViewProjection, (glm::vec2(x, y) + 0.5f) / (float)size * 2.0f - 1.0f);
+        }
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    TraceRays(sceneBvh, pool, rays.data(), hits.data(), (int)rays.size());
+    benchmarkMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    benchmarkHits = (int)std::count_if(hits.begin(), hits.end(), [](const BvhHit& hit) { return hit.instance >= 0; });
+}
+
+// Tallies the scene meshes' GPU buffers, and what they would take as floats and 32-bit indices
+void countSceneBufferBytes(const std::vector<Mesh>& meshes) {
+    sceneBufferBytes = sceneFloatBufferBytes = 0;
+    for (const Mesh& mesh : meshes) {
+        sceneBufferBytes += MeshVertexBytes(mesh) + MeshIndexBytes(mesh);
+        sceneFloatBufferBytes += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
     }
 }
 
@@ -180,19 +642,6 @@ void calculateDeltaTime() {
 // ImGui Function
 
 
-// Importing 3D Obj File Parameters
-struct Vertex {
-    float Position[3];
-    float Normal[3];
-    float TexCoords[2];
-};
-
-struct Mesh {
-    unsigned int VAO, VBO, EBO;
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    unsigned int textureID;  // To store texture ID for the mesh
-};
 
 // Additional Skybox Code
 float skyboxVertices[] = {
@@ -329,7 +778,8 @@ GLuint LoadTexture(const std::string& path) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, FreeImage_GetWidth(image32bit), FreeImage_GetHeight(image32bit), 0, GL_BGRA, GL_UNSIGNED_BYTE, data);
+    // Color textures are sRGB encoded; sampling returns linear values for lighting and blending
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, FreeImage_GetWidth(image32bit), FreeImage_GetHeight(image32bit), 0, GL_BGRA, GL_UNSIGNED_BYTE, data);
     glGenerateMipmap(GL_TEXTURE_2D);
 
     FreeImage_Unload(image32bit);
@@ -339,8 +789,8 @@ GLuint LoadTexture(const std::string& path) {
 }
 
 // Helper function to process individual meshes
-Mesh processMesh(aiMesh* mesh, const aiScene* scene, std::function<GLuint(const std::string&)> loadTexture) {
-    Mesh myMesh;
+Mesh processMesh(aiMesh* mesh, const aiScene* scene, std::string& textureName) {
+    Mesh myMesh = {};
 
     // Process vertices
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
@@ -376,11 +826,33 @@ Mesh processMesh(aiMesh* mesh, const aiScene* scene, std::function<GLuint(const
         }
     }
 
-    // Load material and associated textures
+    // Load material; the texture itself is loaded by finishMesh
     aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
     aiString texturePath;
+    textureName.clear();
     if (material->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == AI_SUCCESS) {
-        std::string fullPath = (fs::current_path() / "assets" / std::string(texturePath.C_Str())).string();
+        textureName = texturePath.C_Str();
+    }
+
+    aiColor3D emissive(0.0f, 0.0f, 0.0f);
+    material->Get(AI_MATKEY_COLOR_EMISSIVE, emissive);
+    myMesh.emissive = glm::vec3(emissive.r, emissive.g, emissive.b);
+
+    float opacity = 1.0f;
+    material->Get(AI_MATKEY_OPACITY, opacity);
+    myMesh.opacity = opacity;
+
+    // Reorder for the vertex cache, overdraw and vertex fetch
+    OptimizeMesh(myMesh, meshOptimizeStats);
+
+    return myMesh;
+}
+
+// Texture and OpenGL buffers for a mesh from the model file or its cache
+void finishMesh(Mesh& myMesh, const std::string& textureName) {
+    myMesh.deformableSnow = textureName.find("snow_grass") != std::string::npos;
+    if (!textureName.empty()) {
+        std::string fullPath = (fs::current_path() / "assets" / textureName).string();
         std::cout << "Texture Path: " << fullPath << std::endl;
         myMesh.textureID = LoadTexture(fullPath);
         if (myMesh.textureID == 0) {
@@ -391,157 +863,70 @@ Mesh processMesh(aiMesh* mesh, const aiScene* scene, std::function<GLuint(const
         std::cerr << "WARNING::Mesh has no diffuse texture!" << std::endl;
     }
 
-    // Generate OpenGL buffers for the mesh
-    glGenVertexArrays(1, &myMesh.VAO);
-    glGenBuffers(1, &myMesh.VBO);
-    glGenBuffers(1, &myMesh.EBO);
-
-    glBindVertexArray(myMesh.VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, myMesh.VBO);
-    glBufferData(GL_ARRAY_BUFFER, myMesh.vertices.size() * sizeof(Vertex), myMesh.vertices.data(), GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, myMesh.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, myMesh.indices.size() * sizeof(unsigned int), myMesh.indices.data(), GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Position));
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-    glEnableVertexAttribArray(2);
-
-    glBindVertexArray(0);
-
-    return myMesh;
+    // Generate OpenGL buffers for the mesh in the selected vertex format
+    UploadMeshBuffers(myMesh, vertexFormatSettings.format, vertexFormatSettings.shortIndices);
 }
 
 // Main LoadModel function
 std::vector<Mesh> LoadModel(const std::string& path) {
-    Assimp::Importer importer;
-
-    // Import the model file
-    const aiScene* scene = importer.ReadFile(path,
-        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals);
-
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        std::cerr << "ERROR::ASSIMP: " << importer.GetErrorString() << std::endl;
-        throw std::runtime_error("Failed to load model.");
-    }
-
     std::vector<Mesh> meshes;           // Container for all meshes
-    std::map<std::string, GLuint> textures_loaded; // Track loaded textures
-
-    // Helper lambda to load a texture from the file system
-    auto loadTexture = [&](const std::string& filePath) -> GLuint {
-        if (textures_loaded.find(filePath) != textures_loaded.end()) {
-            return textures_loaded[filePath];
-        }
+    std::vector<std::string> textureNames;
+
+    // The imported, optimized geometry is cached compressed next to the model, and used while the
+    // model and its material libraries are unchanged
+    std::string cachePath = fs::path(path).replace_extension(".msc").string();
+    std::vector<uint64_t> sources = MeshCacheSources(path);
+    if (!sources.empty() && fs::exists(cachePath) && LoadMeshCache(cachePath, sources, meshes, textureNames, meshOptimizeStats, meshCodecStats)) {
+        std::cout << "Mesh cache: " << meshes.size() << " meshes from " << cachePath << ", " << meshCodecStats.encodedBytes << " bytes, decoded in "
+            << meshCodecStats.decodeMilliseconds << " ms, loaded in " << meshCodecStats.loadMilliseconds << " ms" << std::endl;
+    }
+    else {
+        auto importStart = std::chrono::high_resolution_clock::now();
+        Assimp::Importer importer;
 
-        GLuint textureID = LoadTexture(filePath);
-        if (textureID != 0) {
-            textures_loaded[filePath] = textureID;
-        }
-        return textureID;
-        };
-
-    // Recursive function to process all nodes in the scene
-    std::function<void(aiNode*, const aiScene*)> processNode;
-    processNode = [&](aiNode* node, const aiScene* scene) {
-        // Process each mesh in the node
-        for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene, loadTexture));
-        }
+        // Import the model file
+        const aiScene* scene = importer.ReadFile(path,
+            aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_JoinIdenticalVertices);
 
-        // Process each child node recursively
-        for (unsigned int i = 0; i < node->mNumChildren; i++) {
-            processNode(node->mChildren[i], scene);
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            std::cerr << "ERROR::ASSIMP: " << importer.GetErrorString() << std::endl;
+            throw std::runtime_error("Failed to load model.");
         }
-        };
 
-    // Start processing from the root node
-    processNode(scene->mRootNode, scene);
-
-    return meshes;
-}
-
-
-// Linking Shader Files
-struct ShaderProgramSource {
-    std::string VertexSource;
-    std::string FragmentSource;
-};
-
-static ShaderProgramSource ParseShader(const std::string& filepath) {
-    std::ifstream stream(filepath);
-    std::stringstream ss[2];
-    std::string line;
-    enum class ShaderType { NONE = -1, VERTEX = 0, FRAGMENT = 1 } type = ShaderType::NONE;
-
-    while (getline(stream, line)) {
-        if (line.find("#shader") != std::string::npos) {
-            if (line.find("vertex") != std::string::npos) {
-                type = ShaderType::VERTEX;
+        // Recursive function to process all nodes in the scene
+        std::function<void(aiNode*, const aiScene*)> processNode;
+        processNode = [&](aiNode* node, const aiScene* scene) {
+            // Process each mesh in the node
+            for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+                aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+                textureNames.emplace_back();
+                meshes.push_back(processMesh(mesh, scene, textureNames.back()));
             }
-            else if (line.find("fragment") != std::string::npos) {
-                type = ShaderType::FRAGMENT;
+
+            // Process each child node recursively
+            for (unsigned int i = 0; i < node->mNumChildren; i++) {
+                processNode(node->mChildren[i], scene);
             }
-        }
-        else {
-            ss[(int)type] << line << '\n';
+            };
+
+        // Start processing from the root node
+        processNode(scene->mRootNode, scene);
+        std::cout << "Mesh optimization: ACMR " << Acmr(meshOptimizeStats.before) << " -> " << Acmr(meshOptimizeStats.after)
+            << ", ATVR " << Atvr(meshOptimizeStats.before) << " -> " << Atvr(meshOptimizeStats.after)
+            << " in " << meshOptimizeStats.milliseconds << " ms" << std::endl;
+        meshCodecStats.loadMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - importStart).count();
+        if (!sources.empty() && SaveMeshCache(cachePath, sources, meshes, textureNames, meshOptimizeStats, meshCodecStats)) {
+            std::cout << "Mesh cache: " << meshCodecStats.rawBytes << " bytes of geometry written as " << meshCodecStats.encodedBytes
+                << " to " << cachePath << std::endl;
         }
     }
 
-    return { ss[0].str(), ss[1].str() };
-}
-
-static unsigned int CompileShader(unsigned int type, const std::string& source) {
-    unsigned int id = glCreateShader(type);
-    const char* src = source.c_str();
-    glShaderSource(id, 1, &src, nullptr);
-    glCompileShader(id);
-
-    int result;
-    glGetShaderiv(id, GL_COMPILE_STATUS, &result);
-    if (result == GL_FALSE) {
-        int length;
-        glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
-        char* message = (char*)alloca(length * sizeof(char));
-        glGetShaderInfoLog(id, length, &length, message);
-        std::cerr << "Failed to compile shader\n" << message << std::endl;
-        glDeleteShader(id);
-        return 0;
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        finishMesh(meshes[i], textureNames[i]);
     }
-
-    return id;
+    return meshes;
 }
 
-static unsigned int CreateShader(const std::string& vertexShader, const std::string& fragmentShader) {
-    unsigned int program = glCreateProgram();
-    unsigned int vs = CompileShader(GL_VERTEX_SHADER, vertexShader);
-    unsigned int fs = CompileShader(GL_FRAGMENT_SHADER, fragmentShader);
-
-    glAttachShader(program, vs);
-    glAttachShader(program, fs);
-    glLinkProgram(program);
-    glValidateProgram(program);
-
-    GLint success;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(program, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-    }
-
-    glDeleteShader(vs);
-    glDeleteShader(fs);
-
-    return program;
-}
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 
@@ -551,6 +936,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
         height = 1;
     }
     windowAspectRatio = (float)width / (float)height;
+    ResizeDynamicResolution(dynamicResolution, width, height);
     std::cout << "frame size changed!" << std::endl;
 }
 
@@ -577,6 +963,7 @@ int main() {
     glfwSetWindowSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);  
     glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
 
     glEnable(GL_DEPTH_TEST);
 
@@ -610,18 +997,132 @@ int main() {
    
 
     std::vector<Mesh> meshes = LoadModel("assets/snowman.obj");
+    if (!InitMeshlets(meshlets, meshes)) {
+        std::cerr << "WARNING::Meshlet cull shader failed to load, meshlet culling disabled" << std::endl;
+        meshletSettings.enabled = false;
+    }
+    countSceneBufferBytes(meshes);
+    for (const Mesh& mesh : meshes) {
+        AddVertexCacheStats(drawnCacheStats, AnalyzeVertexCache(mesh.indices, mesh.vertices.size()));
+    }
+    BuildCollisionWorld(collisionWorld, meshes);
 
     // Prepare shaders
     ShaderProgramSource source = ParseShader("shaders/shader_final.glsl");
     unsigned int shader = CreateShader(source.VertexSource, source.FragmentSource);
 
+    // HDR scene target and post-processing chain
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    windowAspectRatio = (float)framebufferWidth / (float)std::max(framebufferHeight, 1);
+    if (!InitPostProcess(postProcess, framebufferWidth, framebufferHeight)) {
+        glfwTerminate();
+        return -1;
+    }
+    if (!InitDynamicResolution(dynamicResolution, framebufferWidth, framebufferHeight)) {
+        std::cerr << "WARNING::Upscale shader failed to load, dynamic resolution disabled" << std::endl;
+    }
+    if (!InitSSAO(ssao)) {
+        std::cerr << "WARNING::SSAO shaders failed to load, ambient occlusion disabled" << std::endl;
+        ssaoSettings.enabled = false;
+    }
+    if (!InitVolumetricFog(volumetricFog)) {
+        std::cerr << "WARNING::Fog shaders failed to load, volumetric fog disabled" << std::endl;
+        fogSettings.enabled = false;
+    }
+    if (!InitTerrain(terrain, terrainSettings)) {
+        std::cerr << "WARNING::Terrain shader failed to load, terrain disabled" << std::endl;
+        terrainSettings.enabled = false;
+    }
+    terrain.surfaceTexture = LoadTexture((fs::current_path() / "assets" / "snow01.png").string());
+    GLuint barkTexture = LoadTexture((fs::current_path() / "assets" / "pine bark dense_albedo.jpg").string());
+    if (!InitForest(forest, forestSettings, terrain, terrainSettings, barkTexture)) {
+        std::cerr << "WARNING::Forest shaders failed to load, forest disabled" << std::endl;
+        forestSettings.enabled = false;
+    }
+    SkinnedModel snowmanModel;
+    BuildProceduralSnowman(snowmanModel);
+    if (!InitCrowd(crowd, crowdSettings, snowmanModel, terrain.surfaceTexture, terrain, terrainSettings)) {
+        std::cerr << "WARNING::Crowd shader failed to load or model could not be baked, snowman crowd disabled" << std::endl;
+        crowdSettings.enabled = false;
+    }
+    else if (!InitCrowdSimulation(crowdSimulation, crowd, crowdSettings, terrain, terrainSettings)) {
+        crowdSimulationSettings.enabled = false;
+    }
+    if (!InitPhysics(physics, terrain, terrainSettings)) {
+        std::cerr << "WARNING::Physics shader failed to load, physics disabled" << std::endl;
+        physicsSettings.enabled = false;
+    }
+    else {
+        GLuint giftTexture = LoadTexture((fs::current_path() / "assets" / "giftwrapper.jpg").string());
+        snowballShape = AddSphereShape(physics, 0.12f, terrain.surfaceTexture);
+        giftShapes[0] = AddGiftShape(physics, glm::vec3(0.3f, 0.2f, 0.25f), false, giftTexture);
+        giftShapes[1] = AddGiftShape(physics, glm::vec3(0.2f, 0.2f, 0.2f), true, giftTexture);
+    }
+    if (!InitWindField(windField)) {
+        std::cerr << "WARNING::Wind shader failed to load, wind disabled" << std::endl;
+        windSettings.enabled = false;
+    }
+    InitThreadPool(threadPool);
+    BuildSceneBvh(sceneBvh, meshes, threadPool);
+    if (!LoadPvs(pvs, "assets/snowman.pvs", meshes)) {
+        BakePvs(pvs, pvsSettings, sceneBvh, threadPool, meshes, glm::mat4(1.0f));
+        SavePvs(pvs, "assets/snowman.pvs");
+    }
+    // A rigged asset if there is one, otherwise the built-in figure
+    SkinnedModel characterModel;
+    bool riggedAsset = fs::exists("assets/character.fbx") && LoadSkinnedModel("assets/character.fbx", characterModel,
+        [](const std::string& texturePath) { return LoadTexture(texturePath); });
+    if (!riggedAsset) {
+        BuildProceduralCharacter(characterModel);
+    }
+    if (characterModel.textureID == 0) {
+        characterModel.textureID = LoadTexture((fs::current_path() / "assets" / "cloth_Base_Color.png").string());
+    }
+    if (!InitCharacters(characters, std::move(characterModel))) {
+        std::cerr << "WARNING::Skinning shader failed to load, characters disabled" << std::endl;
+        characterSettings.enabled = false;
+    }
+    if (!InitOffscreenParticles(offscreenParticles)) {
+        std::cerr << "WARNING::Offscreen particle shaders failed to load, particles stay at full resolution" << std::endl;
+        snowSettings.resolutionDivisor = 1;
+    }
+    if (!InitSnowfall(snowfall)) {
+        std::cerr << "WARNING::Snowfall shaders failed to load, snowfall disabled" << std::endl;
+        snowSettings.enabled = false;
+    }
+    auto groundMesh = std::find_if(meshes.begin(), meshes.end(), [](const Mesh& mesh) { return mesh.deformableSnow; });
+    if (groundMesh == meshes.end() || !InitSnowSurface(snowSurface, *groundMesh, snowSurfaceSettings)) {
+        std::cerr << "WARNING::No snow_grass ground or snow stamp shader failed to load, deformable snow disabled" << std::endl;
+        snowSurfaceSettings.enabled = false;
+    }
+    if (!InitOcclusion(occlusion, meshes)) {
+        std::cerr << "WARNING::No opaque scene meshes to occlude with, occlusion culling disabled" << std::endl;
+        occlusionSettings.enabled = false;
+    }
+    if (!InitOcclusionQueries(occlusionQueries, meshes)) {
+        std::cerr << "WARNING::Occlusion box shader failed to load, occlusion queries disabled" << std::endl;
+        occlusionQuerySettings.enabled = false;
+    }
+    if (!InitOIT(oit)) {
+        std::cerr << "WARNING::OIT composite shader failed to load, transparent meshes will not show" << std::endl;
+    }
+    bool hasTransparentMeshes = std::any_of(meshes.begin(), meshes.end(), [](const Mesh& mesh) { return mesh.opacity < 1.0f; });
+    if (!InitTemporal(temporal)) {
+        std::cerr << "WARNING::Temporal resolve shader failed to load, temporal accumulation disabled" << std::endl;
+        ssaoSettings.temporal = false;
+    }
+    glm::mat4 prevModel = glm::mat4(1.0f);  // Last frame's model matrix, for motion vectors
+
     glUseProgram(shader);
 
     // Main loop
     while (!glfwWindowShouldClose(window)) {
         calculateDeltaTime();  // Calculate deltaTime for smooth movement
 
-        processCameraMovement(deltaTime);  // Move the camera based on input flags
+        GLuint sceneOutputFBO = BeginDynamicResolutionFrame(dynamicResolution, dynamicSettings, postProcess);
+        BeginScenePass(postProcess);
+        glUseProgram(shader);
         glClearColor(0.0f, 0.0f, 0.2f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -635,6 +1136,7 @@ int main() {
        glm::mat4 s_sky = glm::scale(glm::vec3(scale * 500.0f));
 
         glm::mat4 model = T * R * S;
+        processCameraMovement(deltaTime, model);  // Move the camera based on input flags
         glm::mat4 view;
         
         if (isFpp == 1)
@@ -650,11 +1152,83 @@ int main() {
         }
         
         glm::mat4 projection = glm::perspective(glm::radians(45.0f), windowAspectRatio, 0.01f, 1000.0f);
+
+        // The ray cast top level follows the scene transform; then this frame's clicks are answered
+        if (model != sceneBvhModel) {
+            for (int i = 0; i < (int)sceneBvh.instances.size(); ++i) {
+                SetBvhInstanceTransform(sceneBvh, i, model);
+            }
+            BuildBvhTopLevel(sceneBvh);
+            sceneBvhModel = model;
+        }
+        glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+        if (pendingPick) {
+            int windowWidth, windowHeight;
+            glfwGetWindowSize(window, &windowWidth, &windowHeight);
+            glm::vec2 cursor = glm::vec2(2.0f * (float)pickX / std::max(windowWidth, 1) - 1.0f, 1.0f - 2.0f * (float)pickY / std::max(windowHeight, 1));
+            BvhRay ray = viewRay(inverseViewProjection, isFpp == 1 ? glm::vec2(0.0f) : cursor);
+            auto pickStart = std::chrono::high_resolution_clock::now();
+            TraceRay(sceneBvh, ray, pickHit);
+            pickMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - pickStart).count();
+            pickPoint = ray.origin + ray.direction * pickHit.t;
+            pendingPick = false;
+        }
+        if (benchmarkRays) {
+            traceBenchmarkRays(threadPool, inverseViewProjection);
+            benchmarkRays = false;
+        }
+        if (rebakePvs) {
+            BakePvs(pvs, pvsSettings, sceneBvh, threadPool, meshes, sceneBvhModel);
+            SavePvs(pvs, "assets/snowman.pvs");
+            rebakePvs = false;
+        }
+        if (reuploadMeshes) {
+            for (Mesh& mesh : meshes) {
+                UploadMeshBuffers(mesh, vertexFormatSettings.format, vertexFormatSettings.shortIndices);
+            }
+            countSceneBufferBytes(meshes);
+            reuploadMeshes = false;
+        }
+        BeginTemporalFrame(temporal, view, projection);
+        UpdateVolumetricFog(volumetricFog, fogSettings, view, projection, (float)glfwGetTime());
+        UpdateWindField(windField, windSettings, glm::vec3(glm::inverse(view)[3]), deltaTime);
+
+        // Footprints follow the first person camera; a sled track runs ahead of the camera
+        glm::mat4 inverseModel = glm::inverse(model);
+        glm::vec3 groundPosition = glm::vec3(inverseModel * glm::vec4(position, 1.0f));
+        if (isFpp == 1) {
+            UpdateFootprints(snowSurface, snowSurfaceSettings, groundPosition);
+        }
+        if (stampSledTrack) {
+            glm::vec3 viewerPosition = glm::vec3(inverseModel * glm::inverse(view)[3]);
+            glm::vec3 viewerFront = glm::vec3(inverseModel * glm::vec4(-glm::vec3(glm::inverse(view)[2]), 0.0f));
+            glm::vec2 direction = glm::normalize(glm::vec2(viewerFront.x, viewerFront.z) + glm::vec2(1e-4f, 0.0f));
+            glm::vec2 side = glm::vec2(-direction.y, direction.x) * 0.25f;
+            glm::vec2 start = glm::vec2(viewerPosition.x, viewerPosition.z) + direction * 1.0f;
+            glm::vec2 end = start + direction * 8.0f;
+            StampSnow(snowSurface, { start - side, end - side, 0.05f, 0.04f });
+            StampSnow(snowSurface, { start + side, end + side, 0.05f, 0.04f });
+            stampSledTrack = false;
+        }
+        UpdateSnowSurface(snowSurface, snowSurfaceSettings, deltaTime, snowSettings.enabled);
+
+        // This frame's occluders, before anything is submitted
+        UpdateOcclusion(occlusion, occlusionSettings, threadPool, model, projection * view);
+        BeginOcclusionQueries(occlusionQueries, occlusionQuerySettings, model, view);
+        CullMeshlets(meshlets, meshletSettings, model, view, projection);
+        const unsigned char* pvsSet = pvsSettings.enabled ? FindPvsSet(pvs, glm::vec3(inverseModel * glm::inverse(view)[3])) : nullptr;
+        pvs.prunedMeshes = 0;
+
+        glUseProgram(shader);
+        BindVolumetricFog(volumetricFog, fogSettings, shader, 2);
+        BindSnowSurface(snowSurface, shader, 3);
+        glUniformMatrix4fv(glGetUniformLocation(shader, "uPrevProjection"), 1, GL_FALSE, glm::value_ptr(temporal.prevProjection));
         glDepthFunc(GL_LEQUAL);  // Draw skybox last
         glUniform1i(glGetUniformLocation(shader, "isSkybox"), true);  // Set skybox mode
 
         glm::mat4 viewNoTranslation = glm::mat4(glm::mat3(view));  // Remove translation part
         glUniformMatrix4fv(glGetUniformLocation(shader, "uView"), 1, GL_FALSE, glm::value_ptr(s_sky*viewNoTranslation));
+        glUniformMatrix4fv(glGetUniformLocation(shader, "uPrevView"), 1, GL_FALSE, glm::value_ptr(s_sky*glm::mat4(glm::mat3(temporal.prevView))));
         glUniformMatrix4fv(glGetUniformLocation(shader, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
 
         glBindVertexArray(skyboxVAO);
@@ -670,13 +1244,26 @@ int main() {
         glUniformMatrix4fv(glGetUniformLocation(shader, "uModel"), 1, GL_FALSE, glm::value_ptr(model));
         glUniformMatrix4fv(glGetUniformLocation(shader, "uView"), 1, GL_FALSE, glm::value_ptr(view));
         glUniformMatrix4fv(glGetUniformLocation(shader, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
+        glUniformMatrix4fv(glGetUniformLocation(shader, "uPrevModel"), 1, GL_FALSE, glm::value_ptr(prevModel));
+        glUniformMatrix4fv(glGetUniformLocation(shader, "uPrevView"), 1, GL_FALSE, glm::value_ptr(temporal.prevView));
 
         glUniform3fv(glGetUniformLocation(shader, "uLightPos"), 1, glm::value_ptr(lightPos));
         glUniform3fv(glGetUniformLocation(shader, "uViewPos"), 1, glm::value_ptr(cameraPos));
         glUniform3f(glGetUniformLocation(shader, "uLightColor"), 1.0f, 1.0f, 1.0f);
         glUniform3f(glGetUniformLocation(shader, "uObjectColor"), 1.0f, 0.5f, 0.31f);
 
-        for (auto & mesh : meshes) {
+        for (size_t meshIndex = 0; meshIndex < meshes.size(); ++meshIndex) {
+            Mesh& mesh = meshes[meshIndex];
+            if (mesh.opacity < 1.0f) {
+                continue;  // Drawn in the transparent pass after SSAO
+            }
+            if (!IsPvsVisible(pvsSet, (int)meshIndex)) {
+                pvs.prunedMeshes++;
+                continue;
+            }
+            if (!occlusion.meshVisible[meshIndex]) {
+                continue;
+            }
 
             //std::cout << "Rendering mesh with texture ID: " << mesh.textureID << std::endl;
             // Bind the VAO for the mesh
@@ -688,19 +1275,130 @@ int main() {
 
             // Pass the texture unit to the shader sampler
             glUniform1i(glGetUniformLocation(shader, "texture1"), 0);
-
-            // Draw the mesh
-            glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
+            glUniform3fv(glGetUniformLocation(shader, "uEmissive"), 1, glm::value_ptr(mesh.emissive * emissiveStrength));
+
+            // Draw the mesh, or the displaced snow grid in place of the snow_grass ground
+            if (mesh.deformableSnow && snowSurfaceSettings.enabled) {
+                BindFloatVertexDecode(shader);
+                glUniform1i(glGetUniformLocation(shader, "uSnowSurface"), true);
+                DrawSnowSurface(snowSurface);
+                glUniform1i(glGetUniformLocation(shader, "uSnowSurface"), false);
+            }
+            else {
+                BindVertexDecode(shader, mesh);
+                BeginConditionalMesh(occlusionQueries, (int)meshIndex);
+                if (!DrawMeshlets(meshlets, meshletSettings, (int)meshIndex, mesh.indexType)) {
+                    glDrawElements(GL_TRIANGLES, mesh.indices.size(), mesh.indexType, 0);
+                }
+                EndConditionalMesh(occlusionQueries, (int)meshIndex);
+            }
 
             // Unbind the VAO (optional for clarity)
             glBindVertexArray(0);
         }
 
+        glm::vec3 eyePosition = glm::vec3(glm::inverse(view)[3]);
+        UpdateTerrain(terrain, terrainSettings, eyePosition);
+        DrawTerrain(terrain, terrainSettings, view, projection, temporal.prevProjection * temporal.prevView, volumetricFog, fogSettings);
+        RenderForest(forest, forestSettings, view, projection, temporal.prevProjection * temporal.prevView, volumetricFog, fogSettings,
+            windField, windSettings, occlusion, occlusionSettings);
+        UpdateCharacters(characters, characterSettings, threadPool, deltaTime);
+        RenderCharacters(characters, characterSettings, view, projection, temporal.prevProjection * temporal.prevView, volumetricFog, fogSettings);
+        if (crowdSettings.enabled && crowdSimulationSettings.enabled) {
+            UpdateCrowdSimulation(crowdSimulation, crowdSimulationSettings, crowd, crowdSettings, threadPool, deltaTime);
+            UploadCrowdInstances(crowd, crowdSettings.count);
+        }
+        RenderCrowd(crowd, crowdSettings, view, projection, temporal.prevProjection * temporal.prevView, (float)glfwGetTime(), deltaTime,
+            volumetricFog, fogSettings);
+
+        // Snowballs leave from just in front of the viewer; gifts fall onto the scene
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        glm::vec3 viewerForward = -glm::vec3(glm::inverse(view)[2]);
+        for (; pendingSnowballs > 0 && physicsSettings.enabled; --pendingSnowballs) {
+            glm::vec3 spread = glm::vec3(unit(physicsRandom), unit(physicsRandom), unit(physicsRandom)) * 1.5f;
+            AddRigidBody(physics, snowballShape, 0.2f, eyePosition + viewerForward * 0.6f, glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                viewerForward * 14.0f + glm::vec3(0.0f, 2.0f, 0.0f) + spread);
+        }
+        if (dropGifts && physicsSettings.enabled) {
+            for (int i = 0; i < 100; ++i) {
+                glm::vec3 drop = glm::vec3(unit(physicsRandom) * 5.0f, 4.0f + 8.0f * (0.5f + 0.5f * unit(physicsRandom)), unit(physicsRandom) * 5.0f);
+                glm::quat tumble = glm::normalize(glm::quat(1.0f, unit(physicsRandom), unit(physicsRandom), unit(physicsRandom)));
+                AddRigidBody(physics, giftShapes[i % 2], 1.0f, drop, tumble, glm::vec3(0.0f),
+                    glm::vec3(unit(physicsRandom), unit(physicsRandom), unit(physicsRandom)) * 3.0f);
+            }
+        }
+        dropGifts = false;
+        StepPhysics(physics, physicsSettings, threadPool, deltaTime);
+        RenderPhysics(physics, physicsSettings, view, projection, temporal.prevProjection * temporal.prevView, volumetricFog, fogSettings);
+
+        // The opaque depth is complete: query the heavy meshes' boxes for next frame's conditional draws
+        IssueOcclusionQueries(occlusionQueries, occlusionQuerySettings, model, projection * view);
+
+        ApplySSAO(ssao, ssaoSettings, postProcess, view, projection, temporal, temporalSettings);
+        RenderSnowfall(snowfall, snowSettings, postProcess, view, projection, deltaTime, (float)glfwGetTime(), volumetricFog, fogSettings, offscreenParticles,
+            windField, windSettings);
+
+        // Transparent meshes in submission order; weighted blended OIT needs no sorting
+        if (hasTransparentMeshes) {
+            BeginTransparentPass(oit, postProcess);
+            glUseProgram(shader);
+            BindVolumetricFog(volumetricFog, fogSettings, shader, 2);
+            glUniform1i(glGetUniformLocation(shader, "uTransparent"), true);
+            glActiveTexture(GL_TEXTURE0);
+            for (size_t meshIndex = 0; meshIndex < meshes.size(); ++meshIndex) {
+                Mesh& mesh = meshes[meshIndex];
+                if (mesh.opacity >= 1.0f) {
+                    continue;
+                }
+                if (!IsPvsVisible(pvsSet, (int)meshIndex)) {
+                    pvs.prunedMeshes++;
+                    continue;
+                }
+                if (!occlusion.meshVisible[meshIndex]) {
+                    continue;
+                }
+                glBindVertexArray(mesh.VAO);
+                glBindTexture(GL_TEXTURE_2D, mesh.textureID);
+                glUniform3fv(glGetUniformLocation(shader, "uEmissive"), 1, glm::value_ptr(mesh.emissive * emissiveStrength));
+                glUniform1f(glGetUniformLocation(shader, "uOpacity"), mesh.opacity);
+                BindVertexDecode(shader, mesh);
+                BeginConditionalMesh(occlusionQueries, (int)meshIndex);
+                glDrawElements(GL_TRIANGLES, mesh.indices.size(), mesh.indexType, 0);
+                EndConditionalMesh(occlusionQueries, (int)meshIndex);
+            }
+            glBindVertexArray(0);
+            glUniform1i(glGetUniformLocation(shader, "uTransparent"), false);
+            CompositeOIT(oit, postProcess);
+        }
+
+        ApplyPostProcess(postProcess, postSettings, sceneOutputFBO);
+        EndDynamicResolutionFrame(dynamicResolution, dynamicSettings, postProcess);
         draw_gui(window);
+        prevModel = model;
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
+    DestroySSAO(ssao);
+    DestroyTemporal(temporal);
+    DestroyDynamicResolution(dynamicResolution);
+    DestroyOIT(oit);
+    DestroyVolumetricFog(volumetricFog);
+    DestroySnowfall(snowfall);
+    DestroyOffscreenParticles(offscreenParticles);
+    DestroySnowSurface(snowSurface);
+    DestroyTerrain(terrain);
+    DestroyForest(forest);
+    DestroyWindField(windField);
+    DestroyCharacters(characters);
+    DestroyCrowd(crowd);
+    DestroyCrowdSimulation(crowdSimulation);
+    DestroyPhysics(physics);
+    DestroyOcclusion(occlusion);
+    DestroyOcclusionQueries(occlusionQueries);
+    DestroyMeshlets(meshlets);
+    DestroyThreadPool(threadPool);
+    DestroyPostProcess(postProcess);
     glDeleteProgram(shader);
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVBO);
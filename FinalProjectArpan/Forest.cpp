@@ -0,0 +1,384 @@
+#include "Forest.h"
+#include "Shader.h"
+#include "VertexFormat.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Matches DrawElementsIndirectCommand
+struct IndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+static float Hash(unsigned int x, unsigned int z, unsigned int seed) {
+    unsigned int h = x * 374761393u + z * 668265263u + seed * 2246822519u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return (float)((h ^ (h >> 16)) & 0xffffu) / 65535.0f;
+}
+
+static float ValueNoise(float x, float z) {
+    int xi = (int)std::floor(x), zi = (int)std::floor(z);
+    float fx = x - xi, fz = z - zi;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fz = fz * fz * (3.0f - 2.0f * fz);
+    float a = glm::mix(Hash(xi, zi, 7), Hash(xi + 1, zi, 7), fx);
+    float b = glm::mix(Hash(xi, zi + 1, 7), Hash(xi + 1, zi + 1, 7), fx);
+    return glm::mix(a, b, fz);
+}
+
+// Stands, glades and the clearing around the scene; a painted map could replace this
+static std::vector<float> BuildDensityMap(const ForestSettings& settings) {
+    std::vector<float> density(FOREST_DENSITY_SIZE * FOREST_DENSITY_SIZE);
+    for (int j = 0; j < FOREST_DENSITY_SIZE; ++j) {
+        for (int i = 0; i < FOREST_DENSITY_SIZE; ++i) {
+            glm::vec2 position = (glm::vec2(i, j) / (float)(FOREST_DENSITY_SIZE - 1) * 2.0f - 1.0f) * settings.extent;
+            float noise = 0.0f, amplitude = 0.5f, frequency = 1.0f / 250.0f;
+            for (int octave = 0; octave < 4; ++octave) {
+                noise += amplitude * ValueNoise(position.x * frequency, position.y * frequency);
+                amplitude *= 0.5f;
+                frequency *= 2.0f;
+            }
+            float clearing = glm::smoothstep(settings.clearingRadius, settings.clearingRadius * 2.0f, glm::length(position));
+            density[j * FOREST_DENSITY_SIZE + i] = glm::smoothstep(0.3f, 0.6f, noise) * clearing;
+        }
+    }
+    return density;
+}
+
+static float SampleDensity(const std::vector<float>& density, const ForestSettings& settings, glm::vec2 position) {
+    glm::vec2 texel = (position / settings.extent * 0.5f + 0.5f) * (float)(FOREST_DENSITY_SIZE - 1);
+    glm::ivec2 cell = glm::clamp(glm::ivec2(glm::floor(texel)), 0, FOREST_DENSITY_SIZE - 2);
+    glm::vec2 f = glm::clamp(texel - glm::vec2(cell), 0.0f, 1.0f);
+    const float* row = &density[cell.y * FOREST_DENSITY_SIZE + cell.x];
+    return glm::mix(glm::mix(row[0], row[1], f.x), glm::mix(row[FOREST_DENSITY_SIZE], row[FOREST_DENSITY_SIZE + 1], f.x), f.y);
+}
+
+// A 1 unit tall pine: a bark trunk and stacked foliage cones. Foliage texture coordinates are
+// offset by 2 in u so the shaders can tell the two materials apart within one draw.
+static void BuildTreeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    const int sides = 10;
+    auto addVertex = [&](glm::vec3 p, glm::vec3 n, glm::vec2 uv) {
+        Vertex v = { { p.x, p.y, p.z }, { n.x, n.y, n.z }, { uv.x, uv.y } };
+        vertices.push_back(v);
+        return (unsigned int)vertices.size() - 1;
+    };
+    auto addCone = [&](float bottom, float top, float bottomRadius, float topRadius, float uOffset) {
+        float slope = (bottomRadius - topRadius) / (top - bottom);
+        for (int s = 0; s < sides; ++s) {
+            float a0 = glm::two_pi<float>() * s / sides, a1 = glm::two_pi<float>() * (s + 1) / sides;
+            glm::vec3 d0(std::cos(a0), 0.0f, std::sin(a0)), d1(std::cos(a1), 0.0f, std::sin(a1));
+            glm::vec3 n0 = glm::normalize(d0 + glm::vec3(0.0f, slope, 0.0f));
+            glm::vec3 n1 = glm::normalize(d1 + glm::vec3(0.0f, slope, 0.0f));
+            float u0 = uOffset + (float)s / sides, u1 = uOffset + (float)(s + 1) / sides;
+            unsigned int b0 = addVertex(d0 * bottomRadius + glm::vec3(0.0f, bottom, 0.0f), n0, glm::vec2(u0, bottom * 4.0f));
+            unsigned int b1 = addVertex(d1 * bottomRadius + glm::vec3(0.0f, bottom, 0.0f), n1, glm::vec2(u1, bottom * 4.0f));
+            unsigned int t0 = addVertex(d0 * topRadius + glm::vec3(0.0f, top, 0.0f), n0, glm::vec2(u0, top * 4.0f));
+            unsigned int t1 = addVertex(d1 * topRadius + glm::vec3(0.0f, top, 0.0f), n1, glm::vec2(u1, top * 4.0f));
+            indices.insert(indices.end(), { b0, t0, b1, b1, t0, t1 });
+            // Underside, so the tiers read as solid from below
+            if (bottomRadius > topRadius) {
+                unsigned int c = addVertex(glm::vec3(0.0f, bottom, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(uOffset + 0.5f, 0.0f));
+                unsigned int u = addVertex(d0 * bottomRadius + glm::vec3(0.0f, bottom, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(u0, 0.5f));
+                unsigned int w = addVertex(d1 * bottomRadius + glm::vec3(0.0f, bottom, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(u1, 0.5f));
+                indices.insert(indices.end(), { c, u, w });
+            }
+        }
+    };
+    addCone(-0.05f, 0.3f, 0.035f, 0.03f, 0.0f);
+    for (int tier = 0; tier < 4; ++tier) {
+        float bottom = 0.18f + tier * 0.18f;
+        addCone(bottom, bottom + 0.34f - tier * 0.03f, 0.26f - tier * 0.05f, 0.0f, 2.0f);
+    }
+}
+
+static glm::vec3 HemiOctDecode(glm::vec2 uv) {
+    glm::vec2 e = uv * 2.0f - 1.0f;
+    glm::vec2 p = glm::vec2(e.x + e.y, e.x - e.y) * 0.5f;
+    return glm::normalize(glm::vec3(p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y));
+}
+
+// Renders the tree from every hemi-octahedral direction into its frame of the atlases
+static void BakeImpostors(Forest& forest) {
+    const int atlasSize = FOREST_IMPOSTOR_FRAMES * FOREST_IMPOSTOR_FRAME_SIZE;
+    GLuint* atlases[] = { &forest.impostorAlbedo, &forest.impostorNormal };
+    for (GLuint* atlas : atlases) {
+        glGenTextures(1, atlas);
+        glBindTexture(GL_TEXTURE_2D, *atlas);
+        glTexStorage2D(GL_TEXTURE_2D, 5, GL_RGBA8, atlasSize, atlasSize);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    GLuint depth, fbo;
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, forest.impostorAlbedo, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, forest.impostorNormal, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    static const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+
+    // Empty texels carry a foliage color so mipmaps don't fringe the silhouettes dark
+    static const GLfloat albedoClear[] = { 0.1f, 0.2f, 0.12f, 0.0f };
+    static const GLfloat normalClear[] = { 0.5f, 1.0f, 0.5f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, albedoClear);
+    glClearBufferfv(GL_COLOR, 1, normalClear);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    glUseProgram(forest.meshProgram);
+    glUniform1i(glGetUniformLocation(forest.meshProgram, "uBake"), true);
+    glUniform1i(glGetUniformLocation(forest.meshProgram, "uBark"), 0);
+    glUniform1i(glGetUniformLocation(forest.meshProgram, "uFogVolume"), 2);  // Samplers of different types can't share a unit
+    glUniform1i(glGetUniformLocation(forest.meshProgram, "uWindCurrent"), 4);
+    glUniform1i(glGetUniformLocation(forest.meshProgram, "uWindPrevious"), 5);
+    glUniform1i(glGetUniformLocation(forest.meshProgram, "uWindEnabled"), false);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, forest.barkTexture);
+    glBindVertexArray(forest.meshVAO);
+    float r = forest.boundsRadius;
+    glm::mat4 projection = glm::ortho(-r, r, -r, r, 0.0f, 4.0f * r);
+    for (int j = 0; j < FOREST_IMPOSTOR_FRAMES; ++j) {
+        for (int i = 0; i < FOREST_IMPOSTOR_FRAMES; ++i) {
+            glm::vec3 direction = HemiOctDecode(glm::vec2(i, j) / (float)(FOREST_IMPOSTOR_FRAMES - 1));
+            glm::vec3 up = std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::mat4 view = glm::lookAt(forest.boundsCenter + direction * 2.0f * r, forest.boundsCenter, up);
+            glm::mat4 viewProjection = projection * view;
+            glUniformMatrix4fv(glGetUniformLocation(forest.meshProgram, "uViewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+            glViewport(i * FOREST_IMPOSTOR_FRAME_SIZE, j * FOREST_IMPOSTOR_FRAME_SIZE, FOREST_IMPOSTOR_FRAME_SIZE, FOREST_IMPOSTOR_FRAME_SIZE);
+            glDrawElements(GL_TRIANGLES, forest.meshIndexCount, GL_UNSIGNED_INT, 0);
+        }
+    }
+    glBindVertexArray(0);
+    glUniform1i(glGetUniformLocation(forest.meshProgram, "uBake"), false);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &depth);
+    for (GLuint* atlas : atlases) {
+        glBindTexture(GL_TEXTURE_2D, *atlas);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool InitForest(Forest& forest, const ForestSettings& settings, Terrain& terrain, const TerrainSettings& terrainSettings, GLuint barkTexture) {
+    forest.barkTexture = barkTexture;
+    forest.cullProgram = LoadShaderProgram("shaders/forest_cull.glsl");
+    forest.meshProgram = LoadShaderProgram("shaders/forest_mesh.glsl");
+    forest.impostorProgram = LoadShaderProgram("shaders/forest_impostor.glsl");
+    InitGpuTimer(forest.timer);
+    if (!forest.cullProgram || !forest.meshProgram || !forest.impostorProgram) {
+        return false;
+    }
+
+    // Prototype mesh and its bounding sphere
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    BuildTreeMesh(vertices, indices);
+    glm::vec3 minimum(1e30f), maximum(-1e30f);
+    for (const Vertex& v : vertices) {
+        minimum = glm::min(minimum, glm::vec3(v.Position[0], v.Position[1], v.Position[2]));
+        maximum = glm::max(maximum, glm::vec3(v.Position[0], v.Position[1], v.Position[2]));
+    }
+    forest.boundsCenter = glm::vec3(0.0f, (minimum.y + maximum.y) * 0.5f, 0.0f);
+    forest.boundsRadius = 0.0f;
+    for (const Vertex& v : vertices) {
+        forest.boundsRadius = std::max(forest.boundsRadius, glm::distance(forest.boundsCenter, glm::vec3(v.Position[0], v.Position[1], v.Position[2])));
+    }
+    forest.meshIndexCount = (GLsizei)indices.size();
+    glGenVertexArrays(1, &forest.meshVAO);
+    glGenBuffers(1, &forest.meshVBO);
+    glGenBuffers(1, &forest.meshEBO);
+    glBindVertexArray(forest.meshVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, forest.meshVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, forest.meshEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    SetupVertexAttributes<FloatVertexLayout>();
+
+    static const unsigned int quad[] = { 0, 1, 2, 2, 1, 3 };
+    glGenVertexArrays(1, &forest.impostorVAO);
+    glGenBuffers(1, &forest.impostorEBO);
+    glBindVertexArray(forest.impostorVAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, forest.impostorEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    BakeImpostors(forest);
+
+    // Scatter: one jittered candidate per cell, kept with the density at its position
+    std::vector<float> density = BuildDensityMap(settings);
+    std::vector<glm::vec4> trees;
+    int cells = (int)(2.0f * settings.extent / settings.cellSize);
+    for (int j = 0; j < cells; ++j) {
+        for (int i = 0; i < cells; ++i) {
+            glm::vec2 jitter(Hash(i, j, 1), Hash(i, j, 2));
+            glm::vec2 position = (glm::vec2(i, j) + jitter) * settings.cellSize - settings.extent;
+            if (Hash(i, j, 3) >= SampleDensity(density, settings, position)) {
+                continue;
+            }
+            float scale = glm::mix(settings.minScale, settings.maxScale, Hash(i, j, 4));
+            float height = SampleTerrainHeight(terrain, terrainSettings, position);
+            trees.push_back(glm::vec4(position.x, height, position.y, scale));
+        }
+    }
+    forest.treeCount = (int)trees.size();
+    std::cout << "Forest: " << forest.treeCount << " trees" << std::endl;
+
+    glGenBuffers(1, &forest.treeBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, forest.treeBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(trees.size(), 1) * sizeof(glm::vec4), trees.data(), GL_STATIC_DRAW);
+    glGenBuffers(2, forest.visibleBuffer);
+    for (GLuint buffer : forest.visibleBuffer) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(trees.size(), 1) * sizeof(glm::uvec2), nullptr, GL_DYNAMIC_COPY);
+    }
+    glGenBuffers(1, &forest.indirectBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, forest.indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, 2 * sizeof(IndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glGenBuffers(GPU_TIMER_LATENCY, forest.statsBuffer);
+    for (GLuint buffer : forest.statsBuffer) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, 2 * sizeof(IndirectCommand), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return true;
+}
+
+void DestroyForest(Forest& forest) {
+    glDeleteBuffers(1, &forest.treeBuffer);
+    glDeleteBuffers(2, forest.visibleBuffer);
+    glDeleteBuffers(1, &forest.indirectBuffer);
+    glDeleteBuffers(GPU_TIMER_LATENCY, forest.statsBuffer);
+    glDeleteVertexArrays(1, &forest.meshVAO);
+    glDeleteBuffers(1, &forest.meshVBO);
+    glDeleteBuffers(1, &forest.meshEBO);
+    glDeleteVertexArrays(1, &forest.impostorVAO);
+    glDeleteBuffers(1, &forest.impostorEBO);
+    glDeleteTextures(1, &forest.impostorAlbedo);
+    glDeleteTextures(1, &forest.impostorNormal);
+    glDeleteProgram(forest.cullProgram);
+    glDeleteProgram(forest.meshProgram);
+    glDeleteProgram(forest.impostorProgram);
+    DestroyGpuTimer(forest.timer);
+}
+
+// Sets the uniforms both draw programs share
+static void SetDrawUniforms(const Forest& forest, const ForestSettings& settings, GLuint program, const glm::mat4& viewProjection,
+    const glm::mat4& prevViewProjection, const glm::vec3& cameraPosition, const VolumetricFog& fog, const VolumetricFogSettings& fogSettings,
+    const WindField& wind, const WindSettings& windSettings) {
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "uViewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+    glUniformMatrix4fv(glGetUniformLocation(program, "uPrevViewProjection"), 1, GL_FALSE, glm::value_ptr(prevViewProjection));
+    glUniform3fv(glGetUniformLocation(program, "uCameraPosition"), 1, glm::value_ptr(cameraPosition));
+    glUniform3fv(glGetUniformLocation(program, "uBoundsCenter"), 1, glm::value_ptr(forest.boundsCenter));
+    glUniform1f(glGetUniformLocation(program, "uBoundsRadius"), forest.boundsRadius);
+    glUniform1f(glGetUniformLocation(program, "uSway"), settings.sway);
+    BindVolumetricFog(fog, fogSettings, program, 2);
+    BindWindField(wind, windSettings, program, 4);
+}
+
+void RenderForest(Forest& forest, const ForestSettings& settings, const glm::mat4& view, const glm::mat4& projection,
+    const glm::mat4& prevViewProjection, const VolumetricFog& fog, const VolumetricFogSettings& fogSettings,
+    const WindField& wind, const WindSettings& windSettings, const OcclusionCuller& occlusion, const OcclusionSettings& occlusionSettings) {
+    if (!settings.enabled || forest.treeCount == 0) {
+        return;
+    }
+    BeginGpuTimer(forest.timer);
+
+    glm::mat4 viewProjection = projection * view;
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(view)[3]);
+
+    // Frustum planes from the rows of the view-projection matrix (Gribb & Hartmann)
+    glm::vec4 planes[6];
+    for (int i = 0; i < 3; ++i) {
+        glm::vec4 row(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        planes[i * 2] = w + row;
+        planes[i * 2 + 1] = w - row;
+    }
+    for (glm::vec4& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    // 1. Cull and LOD: reset the instance counts, then let the compute pass append to both lists
+    IndirectCommand commands[2] = {
+        { (GLuint)forest.meshIndexCount, 0, 0, 0, 0 },
+        { 6, 0, 0, 0, 0 },
+    };
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, forest.indirectBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(commands), commands);
+
+    glUseProgram(forest.cullProgram);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, forest.treeBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, forest.visibleBuffer[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, forest.visibleBuffer[1]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, forest.indirectBuffer);
+    glUniform4fv(glGetUniformLocation(forest.cullProgram, "uFrustum"), 6, glm::value_ptr(planes[0]));
+    glUniform3fv(glGetUniformLocation(forest.cullProgram, "uCameraPosition"), 1, glm::value_ptr(cameraPosition));
+    glUniform3fv(glGetUniformLocation(forest.cullProgram, "uBoundsCenter"), 1, glm::value_ptr(forest.boundsCenter));
+    glUniform1f(glGetUniformLocation(forest.cullProgram, "uBoundsRadius"), forest.boundsRadius);
+    glUniform1f(glGetUniformLocation(forest.cullProgram, "uMeshDistance"), settings.meshDistance);
+    glUniform1f(glGetUniformLocation(forest.cullProgram, "uFadeRange"), std::max(settings.fadeRange, 0.01f));
+    glUniform1f(glGetUniformLocation(forest.cullProgram, "uMaxDistance"), settings.maxDistance);
+    glUniform1ui(glGetUniformLocation(forest.cullProgram, "uCount"), (GLuint)forest.treeCount);
+    BindOcclusion(occlusion, occlusionSettings, forest.cullProgram, 0);
+    glDispatchCompute((forest.treeCount + 255) / 256, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Instance counts for the GUI, read back once the copy is a few frames old
+    int slot = forest.statsFrame % GPU_TIMER_LATENCY;
+    if (forest.statsFrame >= GPU_TIMER_LATENCY) {
+        IndirectCommand drawn[2];
+        glBindBuffer(GL_COPY_READ_BUFFER, forest.statsBuffer[slot]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(drawn), drawn);
+        forest.drawnMeshes = drawn[0].instanceCount;
+        forest.drawnImpostors = drawn[1].instanceCount;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, forest.statsBuffer[slot]);
+    glCopyBufferSubData(GL_DRAW_INDIRECT_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(commands));
+    forest.statsFrame++;
+
+    // 2. Near trees as instanced meshes
+    glEnable(GL_DEPTH_TEST);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, forest.barkTexture);
+    SetDrawUniforms(forest, settings, forest.meshProgram, viewProjection, prevViewProjection, cameraPosition, fog, fogSettings, wind, windSettings);
+    glUniform1i(glGetUniformLocation(forest.meshProgram, "uBark"), 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, forest.visibleBuffer[0]);
+    glBindVertexArray(forest.meshVAO);
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0);
+
+    // 3. Far trees as impostors
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, forest.impostorAlbedo);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, forest.impostorNormal);
+    SetDrawUniforms(forest, settings, forest.impostorProgram, viewProjection, prevViewProjection, cameraPosition, fog, fogSettings, wind, windSettings);
+    glUniform1i(glGetUniformLocation(forest.impostorProgram, "uAlbedoAtlas"), 0);
+    glUniform1i(glGetUniformLocation(forest.impostorProgram, "uNormalAtlas"), 1);
+    glUniform1i(glGetUniformLocation(forest.impostorProgram, "uFrames"), FOREST_IMPOSTOR_FRAMES);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, forest.visibleBuffer[1]);
+    glBindVertexArray(forest.impostorVAO);
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)sizeof(IndirectCommand));
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    EndGpuTimer(forest.timer);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "GpuTimer.h"
+#include "OcclusionCulling.h"
+#include "Terrain.h"
+#include "VolumetricFog.h"
+#include "WindField.h"
+
+// Scattered pine forest on the terrain.
+// Trees are placed once from a density map and kept in a GPU buffer. Each frame a compute pass
+// frustum and occlusion culls them and sorts the survivors into two instance lists by distance:
+// near trees draw as instanced meshes, far ones as octahedral impostors, and trees in between
+// appear in both lists with a dithered cross-fade. Both lists are drawn with one indirect call each.
+// The impostor atlas is baked from the tree mesh at load time, one frame per direction on a
+// hemi-octahedral grid, and the three frames nearest the view direction are blended.
+// Both tiers bend with the shared wind field in the vertex stage.
+const int FOREST_DENSITY_SIZE = 512;
+const int FOREST_IMPOSTOR_FRAMES = 8;         // Frames per atlas side
+const int FOREST_IMPOSTOR_FRAME_SIZE = 256;   // Texels per frame side
+
+struct ForestSettings {
+    bool enabled = true;
+    float extent = 1500.0f;         // Trees cover [-extent, extent] on x and z
+    float cellSize = 3.0f;          // One candidate tree per cell, kept with the density map's probability
+    float clearingRadius = 30.0f;   // No trees around the scene
+    float minScale = 5.0f;          // World height of the prototype tree, which is 1 unit tall
+    float maxScale = 11.0f;
+    float meshDistance = 80.0f;     // Trees closer than this are meshes
+    float fadeRange = 20.0f;        // Width of the mesh/impostor cross-fade band
+    float maxDistance = 1000.0f;
+    float sway = 0.03f;             // Tip displacement per unit of wind speed, relative to tree height
+};
+
+struct Forest {
+    GLuint treeBuffer = 0;          // vec4 per tree: position, scale
+    GLuint visibleBuffer[2] = {};   // uvec2 per drawn instance (tree index, fade bits): mesh, impostor
+    GLuint indirectBuffer = 0;      // Two DrawElementsIndirectCommand, counts filled by the cull pass
+    int treeCount = 0;
+
+    GLuint meshVAO = 0, meshVBO = 0, meshEBO = 0;
+    GLsizei meshIndexCount = 0;
+    GLuint impostorVAO = 0, impostorEBO = 0;   // One quad, corners from gl_VertexID
+    glm::vec3 boundsCenter = glm::vec3(0.0f);  // Prototype bounding sphere
+    float boundsRadius = 1.0f;
+
+    GLuint impostorAlbedo = 0;      // RGBA8 atlas: color, coverage
+    GLuint impostorNormal = 0;      // RGBA8 atlas: tree space normal
+
+    GLuint barkTexture = 0;
+    GLuint cullProgram = 0;
+    GLuint meshProgram = 0;
+    GLuint impostorProgram = 0;
+
+    GLuint statsBuffer[GPU_TIMER_LATENCY] = {};  // Copies of the indirect commands, read back a few frames late
+    int statsFrame = 0;
+    int drawnMeshes = 0, drawnImpostors = 0;
+    GpuTimer timer;
+};
+
+// Scatters the trees over the terrain and bakes the impostor atlas with the given bark texture
+bool InitForest(Forest& forest, const ForestSettings& settings, Terrain& terrain, const TerrainSettings& terrainSettings, GLuint barkTexture);
+void DestroyForest(Forest& forest);
+
+// Culls against the frustum and this frame's occlusion pyramid, picks LODs and draws into the bound scene target
+void RenderForest(Forest& forest, const ForestSettings& settings, const glm::mat4& view, const glm::mat4& projection,
+    const glm::mat4& prevViewProjection, const VolumetricFog& fog, const VolumetricFogSettings& fogSettings,
+    const WindField& wind, const WindSettings& windSettings, const OcclusionCuller& occlusion, const OcclusionSettings& occlusionSettings);
@@ -0,0 +1,39 @@
+#include "GpuTimer.h"
+
+void InitGpuTimer(GpuTimer& timer) {
+    glGenQueries(GPU_TIMER_LATENCY * 2, &timer.queries[0][0]);
+    for (int i = 0; i < GPU_TIMER_LATENCY; i++) {
+        timer.issued[i] = false;
+    }
+    timer.frame = 0;
+    timer.milliseconds = 0.0f;
+    timer.samples = 0;
+}
+
+void BeginGpuTimer(GpuTimer& timer) {
+    glQueryCounter(timer.queries[timer.frame][0], GL_TIMESTAMP);
+}
+
+void EndGpuTimer(GpuTimer& timer) {
+    glQueryCounter(timer.queries[timer.frame][1], GL_TIMESTAMP);
+    timer.issued[timer.frame] = true;
+    timer.frame = (timer.frame + 1) % GPU_TIMER_LATENCY;
+
+    // The slot we are about to reuse is the oldest one; only read it if the GPU is done with it
+    if (!timer.issued[timer.frame]) {
+        return;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(timer.queries[timer.frame][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(timer.queries[timer.frame][0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(timer.queries[timer.frame][1], GL_QUERY_RESULT, &end);
+        timer.milliseconds = (float)((double)(end - start) / 1.0e6);
+        timer.samples++;
+    }
+}
+
+void DestroyGpuTimer(GpuTimer& timer) {
+    glDeleteQueries(GPU_TIMER_LATENCY * 2, &timer.queries[0][0]);
+}
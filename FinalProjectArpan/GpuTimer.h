@@ -0,0 +1,20 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// GPU timing with GL_TIMESTAMP query pairs. Results are read a few frames late from a small
+// ring so the CPU never waits on the GPU, and timers may overlap or nest freely.
+const int GPU_TIMER_LATENCY = 3;
+
+struct GpuTimer {
+    GLuint queries[GPU_TIMER_LATENCY][2] = {};
+    bool issued[GPU_TIMER_LATENCY] = {};
+    int frame = 0;
+    float milliseconds = 0.0f;   // Most recent resolved GPU time
+    unsigned int samples = 0;    // Number of results resolved so far, to tell new readings apart
+};
+
+void InitGpuTimer(GpuTimer& timer);
+void BeginGpuTimer(GpuTimer& timer);
+void EndGpuTimer(GpuTimer& timer);
+void DestroyGpuTimer(GpuTimer& timer);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Importing 3D Obj File Parameters
+struct Vertex {
+    float Position[3];
+    float Normal[3];
+    float TexCoords[2];
+};
+
+struct Mesh {
+    unsigned int VAO, VBO, EBO;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    unsigned int textureID;  // To store texture ID for the mesh
+    glm::vec3 emissive;      // MTL Ke, added on top of the texture color
+    float opacity;           // MTL d, meshes below 1.0 go through the transparent pass
+    bool deformableSnow;     // The snow_grass ground, drawn through the deformable snow surface
+    int vertexFormat;        // Layout of the VBO, see VertexFormat.h
+    unsigned int indexType;  // GL_UNSIGNED_INT, or GL_UNSIGNED_SHORT when every index fits
+    glm::vec3 positionOffset, positionScale;   // Quantized attributes decode as offset + scale * stored
+    glm::vec2 texCoordOffset, texCoordScale;
+};
@@ -0,0 +1,535 @@
+#include "MeshCodec.h"
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+const int VERTEX_CHANNELS = sizeof(Vertex) / 4;
+static_assert(sizeof(Vertex) % 4 == 0, "Vertex is coded as 32-bit channels");
+const unsigned int NO_VERTEX = ~0u;
+
+static size_t PaddedCount(size_t count) {
+    return (count + MESH_CODEC_GROUP - 1) / MESH_CODEC_GROUP * MESH_CODEC_GROUP;
+}
+
+// A byte plane: 2-bit widths for four groups per header byte, then the packed groups
+static void EncodePlane(std::vector<unsigned char>& out, const unsigned char* plane, size_t count) {
+    size_t groups = PaddedCount(count) / MESH_CODEC_GROUP;
+    size_t header = out.size();
+    out.resize(out.size() + (groups + 3) / 4, 0);
+    for (size_t g = 0; g < groups; ++g) {
+        unsigned char values[MESH_CODEC_GROUP] = {};
+        std::copy(plane + g * MESH_CODEC_GROUP, plane + std::min(count, (g + 1) * MESH_CODEC_GROUP), values);
+        unsigned char largest = *std::max_element(values, values + MESH_CODEC_GROUP);
+        int mode = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+        out[header + g / 4] |= (unsigned char)(mode << ((g % 4) * 2));
+        if (mode == 1) {
+            for (int j = 0; j < 4; ++j) {
+                out.push_back((unsigned char)(values[4 * j] | values[4 * j + 1] << 2 | values[4 * j + 2] << 4 | values[4 * j + 3] << 6));
+            }
+        }
+        else if (mode == 2) {
+            for (int j = 0; j < 8; ++j) {
+                out.push_back((unsigned char)(values[2 * j] | values[2 * j + 1] << 4));
+            }
+        }
+        else if (mode == 3) {
+            out.insert(out.end(), values, values + MESH_CODEC_GROUP);
+        }
+    }
+}
+
+static const unsigned char* DecodePlane(unsigned char* plane, size_t count, const unsigned char* data, const unsigned char* end) {
+    size_t groups = PaddedCount(count) / MESH_CODEC_GROUP;
+    const unsigned char* header = data;
+    data += (groups + 3) / 4;
+    if (data > end) {
+        return nullptr;
+    }
+    const __m128i twoBits = _mm_set1_epi8(3), fourBits = _mm_set1_epi8(15);
+    for (size_t g = 0; g < groups; ++g) {
+        int mode = (header[g / 4] >> ((g % 4) * 2)) & 3;
+        static const int sizes[4] = { 0, 4, 8, 16 };
+        if (data + sizes[mode] > end) {
+            return nullptr;
+        }
+        __m128i values;
+        if (mode == 0) {
+            values = _mm_setzero_si128();
+        }
+        else if (mode == 1) {
+            int packed;
+            memcpy(&packed, data, 4);
+            __m128i x = _mm_cvtsi32_si128(packed);
+            __m128i t0 = _mm_and_si128(x, twoBits), t1 = _mm_and_si128(_mm_srli_epi16(x, 2), twoBits);
+            __m128i t2 = _mm_and_si128(_mm_srli_epi16(x, 4), twoBits), t3 = _mm_and_si128(_mm_srli_epi16(x, 6), twoBits);
+            values = _mm_unpacklo_epi16(_mm_unpacklo_epi8(t0, t1), _mm_unpacklo_epi8(t2, t3));
+        }
+        else if (mode == 2) {
+            __m128i x = _mm_loadl_epi64((const __m128i*)data);
+            values = _mm_unpacklo_epi8(_mm_and_si128(x, fourBits), _mm_and_si128(_mm_srli_epi16(x, 4), fourBits));
+        }
+        else {
+            values = _mm_loadu_si128((const __m128i*)data);
+        }
+        _mm_storeu_si128((__m128i*)(plane + g * MESH_CODEC_GROUP), values);
+        data += sizes[mode];
+    }
+    return data;
+}
+
+void EncodeVertexBuffer(std::vector<unsigned char>& out, const Vertex* vertices, size_t vertexCount) {
+    std::vector<unsigned char> planes[4];
+    for (auto& plane : planes) {
+        plane.resize(vertexCount);
+    }
+    for (int c = 0; c < VERTEX_CHANNELS; ++c) {
+        uint32_t previous = 0;
+        for (size_t i = 0; i < vertexCount; ++i) {
+            uint32_t value;
+            memcpy(&value, (const unsigned char*)&vertices[i] + c * 4, 4);
+            uint32_t delta = value - previous;
+            uint32_t zigzag = (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+            previous = value;
+            for (int k = 0; k < 4; ++k) {
+                planes[k][i] = (unsigned char)(zigzag >> (8 * k));
+            }
+        }
+        for (auto& plane : planes) {
+            EncodePlane(out, plane.data(), vertexCount);
+        }
+    }
+}
+
+bool DecodeVertexBuffer(Vertex* vertices, size_t vertexCount, const unsigned char* data, size_t size) {
+    const unsigned char* end = data + size;
+    size_t padded = PaddedCount(vertexCount);
+    std::vector<unsigned char> planes(padded * 4);
+    std::vector<uint32_t> channels(padded * VERTEX_CHANNELS);
+    const __m128i one = _mm_set1_epi32(1);
+    for (int c = 0; c < VERTEX_CHANNELS; ++c) {
+        for (int k = 0; k < 4; ++k) {
+            data = DecodePlane(&planes[k * padded], vertexCount, data, end);
+            if (!data) {
+                return false;
+            }
+        }
+
+        // Regather 16 values from the planes, undo the zigzag, then sum the deltas
+        __m128i carry = _mm_setzero_si128();
+        uint32_t* channel = &channels[c * padded];
+        for (size_t i = 0; i < padded; i += MESH_CODEC_GROUP) {
+            __m128i p0 = _mm_loadu_si128((const __m128i*)&planes[i]);
+            __m128i p1 = _mm_loadu_si128((const __m128i*)&planes[padded + i]);
+            __m128i p2 = _mm_loadu_si128((const __m128i*)&planes[2 * padded + i]);
+            __m128i p3 = _mm_loadu_si128((const __m128i*)&planes[3 * padded + i]);
+            __m128i low01 = _mm_unpacklo_epi8(p0, p1), high01 = _mm_unpackhi_epi8(p0, p1);
+            __m128i low23 = _mm_unpacklo_epi8(p2, p3), high23 = _mm_unpackhi_epi8(p2, p3);
+            __m128i quads[4] = { _mm_unpacklo_epi16(low01, low23), _mm_unpackhi_epi16(low01, low23),
+                _mm_unpacklo_epi16(high01, high23), _mm_unpackhi_epi16(high01, high23) };
+            for (int q = 0; q < 4; ++q) {
+                __m128i x = _mm_xor_si128(_mm_srli_epi32(quads[q], 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(quads[q], one)));
+                x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+                x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+                x = _mm_add_epi32(x, carry);
+                carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+                _mm_storeu_si128((__m128i*)&channel[i + q * 4], x);
+            }
+        }
+    }
+
+    // Channels back into vertices, four at a time through 4x4 transposes
+    static_assert(VERTEX_CHANNELS == 8, "The transpose writes two halves of four channels");
+    size_t i = 0;
+    for (; i + 4 <= vertexCount; i += 4) {
+        for (int half = 0; half < 2; ++half) {
+            __m128 rows[4];
+            for (int c = 0; c < 4; ++c) {
+                rows[c] = _mm_loadu_ps((const float*)&channels[(half * 4 + c) * padded + i]);
+            }
+            _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+            for (int v = 0; v < 4; ++v) {
+                _mm_storeu_ps((float*)&vertices[i + v] + half * 4, rows[v]);
+            }
+        }
+    }
+    for (; i < vertexCount; ++i) {
+        for (int c = 0; c < VERTEX_CHANNELS; ++c) {
+            memcpy((unsigned char*)&vertices[i] + c * 4, &channels[c * padded + i], 4);
+        }
+    }
+    return data == end;
+}
+
+// Encoder and decoder keep the same state, so each side only needs to mirror the other's updates
+struct IndexCodecState {
+    unsigned int edges[MESH_CODEC_EDGE_CACHE][2];
+    unsigned int vertices[MESH_CODEC_VERTEX_CACHE];
+    int edgeHead = 0, vertexHead = 0;
+    unsigned int next = 0, last = 0;
+};
+
+static void InitIndexCodec(IndexCodecState& state) {
+    std::fill(&state.edges[0][0], &state.edges[0][0] + 2 * MESH_CODEC_EDGE_CACHE, NO_VERTEX);
+    std::fill(state.vertices, state.vertices + MESH_CODEC_VERTEX_CACHE, NO_VERTEX);
+}
+
+// The age-th most recent entry
+static const unsigned int* RecentEdge(const IndexCodecState& state, int age) {
+    return state.edges[(state.edgeHead + MESH_CODEC_EDGE_CACHE - 1 - age) % MESH_CODEC_EDGE_CACHE];
+}
+
+static unsigned int RecentVertex(const IndexCodecState& state, int age) {
+    return state.vertices[(state.vertexHead + MESH_CODEC_VERTEX_CACHE - 1 - age) % MESH_CODEC_VERTEX_CACHE];
+}
+
+// The reversed edges are what a neighbor with the same winding starts with
+static void PushTriangle(IndexCodecState& state, unsigned int a, unsigned int b, unsigned int c) {
+    const unsigned int corners[3] = { a, b, c };
+    for (int k = 0; k < 3; ++k) {
+        state.edges[state.edgeHead][0] = corners[(k + 1) % 3];
+        state.edges[state.edgeHead][1] = corners[k];
+        state.edgeHead = (state.edgeHead + 1) % MESH_CODEC_EDGE_CACHE;
+    }
+}
+
+static void PushVertex(IndexCodecState& state, unsigned int v) {
+    state.vertices[state.vertexHead] = v;
+    state.vertexHead = (state.vertexHead + 1) % MESH_CODEC_VERTEX_CACHE;
+}
+
+static void WriteVarint(std::vector<unsigned char>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+static bool ReadVarint(const unsigned char*& data, const unsigned char* end, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (data == end) {
+            return false;
+        }
+        unsigned char byte = *data++;
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 0 for the next new vertex, 1 + age for a recent one, 15 for an explicit delta from the last explicit vertex
+static int EncodeVertexToken(IndexCodecState& state, unsigned int v, std::vector<uint32_t>& explicitValues) {
+    if (v == state.next) {
+        state.next++;
+        PushVertex(state, v);
+        return 0;
+    }
+    for (int age = 0; age < MESH_CODEC_VERTEX_CACHE; ++age) {
+        if (RecentVertex(state, age) == v) {
+            return 1 + age;
+        }
+    }
+    uint32_t delta = v - state.last;
+    explicitValues.push_back((delta << 1) ^ (uint32_t)((int32_t)delta >> 31));
+    state.last = v;
+    PushVertex(state, v);
+    return 15;
+}
+
+static bool DecodeVertexToken(IndexCodecState& state, int token, const unsigned char*& data, const unsigned char* end, unsigned int& v) {
+    if (token == 0) {
+        v = state.next++;
+        PushVertex(state, v);
+    }
+    else if (token < 15) {
+        v = RecentVertex(state, token - 1);
+    }
+    else {
+        uint32_t zigzag;
+        if (!ReadVarint(data, end, zigzag)) {
+            return false;
+        }
+        v = state.last + ((zigzag >> 1) ^ (0u - (zigzag & 1)));
+        state.last = v;
+        PushVertex(state, v);
+    }
+    return true;
+}
+
+void EncodeIndexBuffer(std::vector<unsigned char>& out, const unsigned int* indices, size_t indexCount) {
+    IndexCodecState state;
+    InitIndexCodec(state);
+    std::vector<uint32_t> explicitValues;
+    for (size_t t = 0; t + 2 < indexCount; t += 3) {
+        const unsigned int* triangle = &indices[t];
+        int edge = -1, rotation = 0;
+        for (int age = 0; age < MESH_CODEC_EDGE_CACHE && edge < 0; ++age) {
+            const unsigned int* candidate = RecentEdge(state, age);
+            for (int r = 0; r < 3; ++r) {
+                if (candidate[0] == triangle[r] && candidate[1] == triangle[(r + 1) % 3]) {
+                    edge = age;
+                    rotation = r;
+                    break;
+                }
+            }
+        }
+        explicitValues.clear();
+        if (edge >= 0) {
+            unsigned int a = triangle[rotation], b = triangle[(rotation + 1) % 3], c = triangle[(rotation + 2) % 3];
+            out.push_back((unsigned char)(edge << 4 | EncodeVertexToken(state, c, explicitValues)));
+            PushTriangle(state, a, b, c);
+        }
+        else {
+            int tokenA = EncodeVertexToken(state, triangle[0], explicitValues);
+            int tokenB = EncodeVertexToken(state, triangle[1], explicitValues);
+            int tokenC = EncodeVertexToken(state, triangle[2], explicitValues);
+            out.push_back((unsigned char)(15 << 4 | tokenA));
+            out.push_back((unsigned char)(tokenB << 4 | tokenC));
+            PushTriangle(state, triangle[0], triangle[1], triangle[2]);
+        }
+        for (uint32_t value : explicitValues) {
+            WriteVarint(out, value);
+        }
+    }
+}
+
+bool DecodeIndexBuffer(unsigned int* indices, size_t indexCount, const unsigned char* data, size_t size) {
+    if (indexCount % 3 != 0) {
+        return false;
+    }
+    const unsigned char* end = data + size;
+    IndexCodecState state;
+    InitIndexCodec(state);
+    for (size_t t = 0; t < indexCount; t += 3) {
+        if (data == end) {
+            return false;
+        }
+        unsigned char code = *data++;
+        unsigned int* triangle = &indices[t];
+        if ((code >> 4) < 15) {
+            const unsigned int* edge = RecentEdge(state, code >> 4);
+            triangle[0] = edge[0];
+            triangle[1] = edge[1];
+            if (!DecodeVertexToken(state, code & 15, data, end, triangle[2])) {
+                return false;
+            }
+        }
+        else {
+            if (data == end) {
+                return false;
+            }
+            unsigned char tokens = *data++;
+            // Explicit deltas follow both code bytes, in corner order
+            if (!DecodeVertexToken(state, code & 15, data, end, triangle[0]) || !DecodeVertexToken(state, tokens >> 4, data, end, triangle[1])
+                || !DecodeVertexToken(state, tokens & 15, data, end, triangle[2])) {
+                return false;
+            }
+        }
+        PushTriangle(state, triangle[0], triangle[1], triangle[2]);
+    }
+    return data == end;
+}
+
+template <typename T>
+static void Write(std::vector<unsigned char>& out, const T& value) {
+    out.insert(out.end(), (const unsigned char*)&value, (const unsigned char*)&value + sizeof(T));
+}
+
+template <typename T>
+static bool Read(const unsigned char*& data, const unsigned char* end, T& value) {
+    if ((size_t)(end - data) < sizeof(T)) {
+        return false;
+    }
+    memcpy(&value, data, sizeof(T));
+    data += sizeof(T);
+    return true;
+}
+
+static void WriteCacheStats(std::vector<unsigned char>& out, const VertexCacheStats& stats) {
+    Write(out, (uint64_t)stats.triangles);
+    Write(out, (uint64_t)stats.vertices);
+    Write(out, (uint64_t)stats.transforms);
+}
+
+static bool ReadCacheStats(const unsigned char*& data, const unsigned char* end, VertexCacheStats& stats) {
+    uint64_t values[3];
+    for (uint64_t& value : values) {
+        if (!Read(data, end, value)) {
+            return false;
+        }
+    }
+    stats.triangles = (size_t)values[0];
+    stats.vertices = (size_t)values[1];
+    stats.transforms = (size_t)values[2];
+    return true;
+}
+
+static void AddSource(std::vector<uint64_t>& sources, const fs::path& path) {
+    std::error_code error;
+    uint64_t size = fs::file_size(path, error);
+    uint64_t time = error ? 0 : (uint64_t)fs::last_write_time(path, error).time_since_epoch().count();
+    sources.push_back(error ? 0 : size);
+    sources.push_back(error ? 0 : time);
+}
+
+std::vector<uint64_t> MeshCacheSources(const std::string& modelPath) {
+    std::vector<uint64_t> sources;
+    std::ifstream model(modelPath);
+    if (!model) {
+        return sources;
+    }
+    AddSource(sources, modelPath);
+    // Material libraries are named relative to the model; a missing one counts as size and time zero
+    std::string line;
+    while (std::getline(model, line)) {
+        if (line.compare(0, 7, "mtllib ") == 0) {
+            size_t first = line.find_first_not_of(" \t", 7);
+            size_t last = line.find_last_not_of(" \t\r");
+            if (first != std::string::npos) {
+                AddSource(sources, fs::path(modelPath).parent_path() / line.substr(first, last - first + 1));
+            }
+        }
+    }
+    return sources;
+}
+
+bool SaveMeshCache(const std::string& path, const std::vector<uint64_t>& sources, const std::vector<Mesh>& meshes,
+    const std::vector<std::string>& textureNames, const MeshOptimizeStats& optimizeStats, MeshCodecStats& stats) {
+    std::vector<unsigned char> out = { 'M', 'S', 'C', '2' };
+    Write(out, MESH_CACHE_VERSION);
+    Write(out, (uint32_t)sources.size());
+    for (uint64_t source : sources) {
+        Write(out, source);
+    }
+    Write(out, (uint32_t)meshes.size());
+    WriteCacheStats(out, optimizeStats.before);
+    WriteCacheStats(out, optimizeStats.after);
+    stats.rawBytes = 0;
+    std::vector<unsigned char> stream;
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        const Mesh& mesh = meshes[m];
+        Write(out, (uint32_t)mesh.vertices.size());
+        Write(out, (uint32_t)mesh.indices.size());
+        Write(out, (uint32_t)textureNames[m].size());
+        out.insert(out.end(), textureNames[m].begin(), textureNames[m].end());
+        Write(out, mesh.emissive);
+        Write(out, mesh.opacity);
+        stream.clear();
+        EncodeVertexBuffer(stream, mesh.vertices.data(), mesh.vertices.size());
+        Write(out, (uint32_t)stream.size());
+        out.insert(out.end(), stream.begin(), stream.end());
+        stream.clear();
+        EncodeIndexBuffer(stream, mesh.indices.data(), mesh.indices.size());
+        Write(out, (uint32_t)stream.size());
+        out.insert(out.end(), stream.begin(), stream.end());
+        stats.rawBytes += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
+    }
+    stats.encodedBytes = out.size();
+    std::ofstream file(path, std::ios::binary);
+    if (!file || !file.write((const char*)out.data(), out.size())) {
+        std::cerr << "ERROR::MESH_CODEC::COULD_NOT_WRITE " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool LoadMeshCache(const std::string& path, const std::vector<uint64_t>& sources, std::vector<Mesh>& meshes,
+    std::vector<std::string>& textureNames, MeshOptimizeStats& optimizeStats, MeshCodecStats& stats) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    std::vector<unsigned char> bytes((size_t)file.tellg());
+    file.seekg(0);
+    if (!file.read((char*)bytes.data(), bytes.size())) {
+        return false;
+    }
+    const unsigned char* data = bytes.data();
+    const unsigned char* end = data + bytes.size();
+    uint32_t version = 0, sourceCount = 0, meshCount = 0;
+    if (bytes.size() < 4 || memcmp(data, "MSC2", 4) != 0) {
+        return false;
+    }
+    data += 4;
+    if (!Read(data, end, version) || version != MESH_CACHE_VERSION || !Read(data, end, sourceCount) || sourceCount != sources.size()) {
+        return false;
+    }
+    for (uint64_t source : sources) {
+        uint64_t cachedSource = 0;
+        if (!Read(data, end, cachedSource) || cachedSource != source) {
+            return false;
+        }
+    }
+    if (!Read(data, end, meshCount)) {
+        return false;
+    }
+    MeshOptimizeStats loadedOptimizeStats;
+    if (!ReadCacheStats(data, end, loadedOptimizeStats.before) || !ReadCacheStats(data, end, loadedOptimizeStats.after)) {
+        return false;
+    }
+
+    // Each mesh's counts and stream sizes alone take five words
+    if (meshCount > (size_t)(end - data) / (5 * sizeof(uint32_t))) {
+        return false;
+    }
+    std::vector<Mesh> loaded(meshCount);
+    std::vector<std::string> loadedNames(meshCount);
+    float decodeMilliseconds = 0.0f;
+    size_t rawBytes = 0;
+    for (uint32_t m = 0; m < meshCount; ++m) {
+        Mesh& mesh = loaded[m];
+        mesh = {};
+        uint32_t vertexCount, indexCount, nameLength, vertexBytes, indexBytes;
+        if (!Read(data, end, vertexCount) || !Read(data, end, indexCount) || !Read(data, end, nameLength) || (size_t)(end - data) < nameLength) {
+            return false;
+        }
+        loadedNames[m].assign((const char*)data, nameLength);
+        data += nameLength;
+        if (!Read(data, end, mesh.emissive) || !Read(data, end, mesh.opacity) || !Read(data, end, vertexBytes) || (size_t)(end - data) < vertexBytes) {
+            return false;
+        }
+        const unsigned char* vertexData = data;
+        data += vertexBytes;
+        if (!Read(data, end, indexBytes) || (size_t)(end - data) < indexBytes) {
+            return false;
+        }
+        const unsigned char* indexData = data;
+        data += indexBytes;
+        // Counts the streams can't hold are corrupt; reject them before allocating. Every vertex
+        // plane has a header byte per 64 values, and every triangle takes at least a code byte.
+        if (vertexCount > 2 * (size_t)vertexBytes || indexCount / 3 > indexBytes) {
+            std::cerr << "ERROR::MESH_CODEC::CORRUPT_CACHE " << path << std::endl;
+            return false;
+        }
+        mesh.vertices.resize(vertexCount);
+        mesh.indices.resize(indexCount);
+        auto decodeStart = std::chrono::high_resolution_clock::now();
+        bool decoded = DecodeVertexBuffer(mesh.vertices.data(), vertexCount, vertexData, vertexBytes)
+            && DecodeIndexBuffer(mesh.indices.data(), indexCount, indexData, indexBytes);
+        decodeMilliseconds += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - decodeStart).count();
+        if (!decoded || std::any_of(mesh.indices.begin(), mesh.indices.end(), [&](unsigned int index) { return index >= vertexCount; })) {
+            std::cerr << "ERROR::MESH_CODEC::CORRUPT_CACHE " << path << std::endl;
+            return false;
+        }
+        rawBytes += vertexCount * sizeof(Vertex) + indexCount * sizeof(unsigned int);
+    }
+    meshes = std::move(loaded);
+    textureNames = std::move(loadedNames);
+    optimizeStats = loadedOptimizeStats;
+    stats.rawBytes = rawBytes;
+    stats.encodedBytes = bytes.size();
+    stats.decodeMilliseconds = decodeMilliseconds;
+    stats.loadMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return true;
+}
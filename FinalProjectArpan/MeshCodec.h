@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+
+// Lossless compression of the imported scene meshes, cached next to the source model.
+// Vertices are coded as 32-bit channels: each channel is delta coded against the previous
+// vertex and zigzagged, split into byte planes, and every 16 bytes of a plane are bit-packed at
+// 0, 2, 4 or 8 bits per byte under a 2-bit header (after meshoptimizer's vertex codec). The
+// decoder unpacks the groups, regathers the planes, undoes the zigzag and runs the delta prefix
+// sums with SSE, 16 values at a time.
+// Triangles are coded against a FIFO of recent edges: a triangle that shares an edge with one of
+// the last MESH_CODEC_EDGE_CACHE triangles' edges costs a byte for the edge and its third vertex,
+// which is the next new vertex, one of the last MESH_CODEC_VERTEX_CACHE vertices, or a
+// varint delta. The import pass leaves vertices in first-use order, so most are the next one.
+// Triangles may come back rotated, with their winding kept.
+const int MESH_CODEC_GROUP = 16;          // Bytes of a plane that share a bit width
+const int MESH_CODEC_EDGE_CACHE = 15;
+const int MESH_CODEC_VERTEX_CACHE = 14;
+const uint32_t MESH_CACHE_VERSION = 1;    // Bump when the import, optimization passes or codec change their output
+
+struct MeshCodecStats {
+    size_t rawBytes = 0;            // Vertex and index data as Vertex and 32-bit indices
+    size_t encodedBytes = 0;
+    float decodeMilliseconds = 0.0f;
+    float loadMilliseconds = 0.0f;  // Reading and decoding the whole cache
+};
+
+// Appends the encoded stream
+void EncodeVertexBuffer(std::vector<unsigned char>& out, const Vertex* vertices, size_t vertexCount);
+void EncodeIndexBuffer(std::vector<unsigned char>& out, const unsigned int* indices, size_t indexCount);
+
+// False if the stream is malformed or does not cover exactly the output
+bool DecodeVertexBuffer(Vertex* vertices, size_t vertexCount, const unsigned char* data, size_t size);
+bool DecodeIndexBuffer(unsigned int* indices, size_t indexCount, const unsigned char* data, size_t size);
+
+// Size and modification time of an OBJ model and of every material library it names, which the
+// cache's materials come from; empty if the model is missing
+std::vector<uint64_t> MeshCacheSources(const std::string& modelPath);
+
+// The meshes' geometry and materials, with their diffuse texture names and import numbers.
+// sources and MESH_CACHE_VERSION tie the cache to the files and the code it was made with.
+bool SaveMeshCache(const std::string& path, const std::vector<uint64_t>& sources, const std::vector<Mesh>& meshes,
+    const std::vector<std::string>& textureNames, const MeshOptimizeStats& optimizeStats, MeshCodecStats& stats);
+bool LoadMeshCache(const std::string& path, const std::vector<uint64_t>& sources, std::vector<Mesh>& meshes,
+    std::vector<std::string>& textureNames, MeshOptimizeStats& optimizeStats, MeshCodecStats& stats);
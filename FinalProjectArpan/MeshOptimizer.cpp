@@ -0,0 +1,267 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+const int FORSYTH_VALENCE_TABLE = 32;   // Remaining triangle counts past this score the same
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount) {
+    VertexCacheStats stats;
+    stats.triangles = indices.size() / 3;
+    stats.vertices = vertexCount;
+    std::vector<size_t> stamp(vertexCount, 0);
+    size_t time = VERTEX_CACHE_FIFO_SIZE + 1;
+    for (unsigned int v : indices) {
+        if (time - stamp[v] > (size_t)VERTEX_CACHE_FIFO_SIZE) {
+            stamp[v] = time++;
+            stats.transforms++;
+        }
+    }
+    return stats;
+}
+
+// Forsyth's vertex score: recent cache entries score high, the last triangle's three a little
+// less so strips don't run in one direction forever, and vertices with few triangles left get a
+// boost so they are finished off
+static float ForsythScore(int cachePosition, int remaining) {
+    if (remaining == 0) {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        score = cachePosition < 3 ? 0.75f : std::pow(1.0f - (float)(cachePosition - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+    }
+    return score + 2.0f / std::sqrt((float)remaining);
+}
+
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    // Work on the vertices the range uses, numbered from zero
+    std::vector<unsigned int> used(indices, indices + triangleCount * 3);
+    std::sort(used.begin(), used.end());
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+    int vertexCount = (int)used.size();
+    std::vector<int> local(triangleCount * 3);
+    for (size_t i = 0; i < local.size(); ++i) {
+        local[i] = (int)(std::lower_bound(used.begin(), used.end(), indices[i]) - used.begin());
+    }
+
+    float scoreTable[VERTEX_CACHE_SIZE + 1][FORSYTH_VALENCE_TABLE + 1];
+    for (int position = -1; position < VERTEX_CACHE_SIZE; ++position) {
+        for (int remaining = 0; remaining <= FORSYTH_VALENCE_TABLE; ++remaining) {
+            scoreTable[position + 1][remaining] = ForsythScore(position, remaining);
+        }
+    }
+    auto score = [&](int position, int remaining) { return scoreTable[position + 1][std::min(remaining, FORSYTH_VALENCE_TABLE)]; };
+
+    // Each vertex's live triangles sit at the front of its adjacency range
+    std::vector<int> remaining(vertexCount, 0), adjacencyOffset(vertexCount + 1, 0);
+    for (int v : local) {
+        remaining[v]++;
+    }
+    std::partial_sum(remaining.begin(), remaining.end(), adjacencyOffset.begin() + 1);
+    std::vector<int> adjacency(local.size()), fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t i = 0; i < local.size(); ++i) {
+        adjacency[fill[local[i]]++] = (int)(i / 3);
+    }
+    std::vector<float> vertexScore(vertexCount), triangleScore(triangleCount, 0.0f);
+    for (int v = 0; v < vertexCount; ++v) {
+        vertexScore[v] = score(-1, remaining[v]);
+    }
+    for (size_t i = 0; i < local.size(); ++i) {
+        triangleScore[i / 3] += vertexScore[local[i]];
+    }
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> order;
+    order.reserve(triangleCount * 3);
+    std::vector<int> cache, nextCache;
+    cache.reserve(VERTEX_CACHE_SIZE + 3);
+    nextCache.reserve(VERTEX_CACHE_SIZE + 3);
+
+    int best = (int)(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+    size_t cursor = 0;   // Dead ends restart from the first triangle not yet emitted
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+        if (best < 0) {
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = (int)cursor;
+        }
+        emitted[best] = true;
+        const int* corners = &local[best * 3];
+        for (int k = 0; k < 3; ++k) {
+            int v = corners[k];
+            order.push_back(used[v]);
+            int* live = &adjacency[adjacencyOffset[v]];
+            int* found = std::find(live, live + remaining[v], best);
+            if (found != live + remaining[v]) {
+                std::swap(*found, live[remaining[v] - 1]);
+                remaining[v]--;
+            }
+        }
+
+        // The triangle's vertices move to the front of the cache and the rest shift back
+        nextCache.assign(corners, corners + 3);
+        for (int v : cache) {
+            if (v != corners[0] && v != corners[1] && v != corners[2]) {
+                nextCache.push_back(v);
+            }
+        }
+        cache.swap(nextCache);
+        for (int i = 0; i < (int)cache.size(); ++i) {
+            int v = cache[i];
+            int position = i < VERTEX_CACHE_SIZE ? i : -1;
+            float updated = score(position, remaining[v]);
+            float delta = updated - vertexScore[v];
+            vertexScore[v] = updated;
+            const int* live = &adjacency[adjacencyOffset[v]];
+            for (int j = 0; j < remaining[v]; ++j) {
+                triangleScore[live[j]] += delta;
+            }
+        }
+        if (cache.size() > (size_t)VERTEX_CACHE_SIZE) {
+            cache.resize(VERTEX_CACHE_SIZE);
+        }
+
+        // The next triangle is the best one touching the cache
+        best = -1;
+        float bestScore = -1e30f;
+        for (int v : cache) {
+            const int* live = &adjacency[adjacencyOffset[v]];
+            for (int j = 0; j < remaining[v]; ++j) {
+                if (triangleScore[live[j]] > bestScore) {
+                    bestScore = triangleScore[live[j]];
+                    best = live[j];
+                }
+            }
+        }
+    }
+    std::copy(order.begin(), order.end(), indices);
+}
+
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+    std::vector<size_t> stamp(vertices.size(), 0);
+    size_t time = VERTEX_CACHE_FIFO_SIZE + 1;
+    auto misses = [&](size_t triangle) {
+        int count = 0;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = indices[triangle * 3 + k];
+            if (time - stamp[v] > (size_t)VERTEX_CACHE_FIFO_SIZE) {
+                stamp[v] = time++;
+                count++;
+            }
+        }
+        return count;
+    };
+
+    // Hard boundaries where the cache order restarts, with every vertex a miss
+    std::vector<size_t> hard;
+    std::vector<int> triangleMisses(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        triangleMisses[t] = misses(t);
+        if (t == 0 || triangleMisses[t] == 3) {
+            hard.push_back(t);
+        }
+    }
+    hard.push_back(triangleCount);
+
+    // Soft boundaries: a piece ends once its own miss rate, from a cold cache, is close enough
+    // to its hard cluster's
+    std::vector<size_t> clusters;
+    for (size_t h = 0; h + 1 < hard.size(); ++h) {
+        int clusterMisses = 0;
+        for (size_t t = hard[h]; t < hard[h + 1]; ++t) {
+            clusterMisses += triangleMisses[t];
+        }
+        float threshold = OVERDRAW_THRESHOLD * clusterMisses / (hard[h + 1] - hard[h]);
+        size_t start = hard[h];
+        int pieceMisses = 0;
+        clusters.push_back(start);
+        time += VERTEX_CACHE_FIFO_SIZE + 1;
+        for (size_t t = start; t < hard[h + 1]; ++t) {
+            pieceMisses += misses(t);
+            if (t + 1 < hard[h + 1] && pieceMisses <= threshold * (t + 1 - start)) {
+                start = t + 1;
+                pieceMisses = 0;
+                clusters.push_back(start);
+                time += VERTEX_CACHE_FIFO_SIZE + 1;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // Clusters facing away from the mesh's center draw first; they tend to cover the rest
+    size_t clusterCount = clusters.size() - 1;
+    std::vector<glm::vec3> centroid(clusterCount, glm::vec3(0.0f)), normal(clusterCount, glm::vec3(0.0f));
+    std::vector<float> area(clusterCount, 0.0f);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    auto position = [&](unsigned int v) { return glm::vec3(vertices[v].Position[0], vertices[v].Position[1], vertices[v].Position[2]); };
+    for (size_t c = 0; c < clusterCount; ++c) {
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+            glm::vec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), d = position(indices[t * 3 + 2]);
+            glm::vec3 cross = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(cross);
+            centroid[c] += (a + b + d) * (triangleArea / 3.0f);
+            normal[c] += cross;
+            area[c] += triangleArea;
+        }
+        meshCentroid += centroid[c];
+        meshArea += area[c];
+    }
+    meshCentroid /= std::max(meshArea, 1e-20f);
+    std::vector<float> key(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        glm::vec3 center = centroid[c] / std::max(area[c], 1e-20f);
+        float length = glm::length(normal[c]);
+        key[c] = length > 0.0f ? glm::dot(center - meshCentroid, normal[c] / length) : 0.0f;
+    }
+    std::vector<size_t> sorted(clusterCount);
+    std::iota(sorted.begin(), sorted.end(), 0);
+    std::stable_sort(sorted.begin(), sorted.end(), [&](size_t a, size_t b) { return key[a] > key[b]; });
+    std::vector<unsigned int> reordered;
+    reordered.reserve(triangleCount * 3);
+    for (size_t c : sorted) {
+        reordered.insert(reordered.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+    reordered.insert(reordered.end(), indices.begin() + triangleCount * 3, indices.end());
+    indices.swap(reordered);
+}
+
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    unsigned int next = 0;
+    for (unsigned int& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+    std::vector<Vertex> reordered(next);
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        if (remap[v] != unused) {
+            reordered[remap[v]] = vertices[v];
+        }
+    }
+    vertices.swap(reordered);
+}
+
+void OptimizeMesh(Mesh& mesh, MeshOptimizeStats& stats) {
+    auto start = std::chrono::high_resolution_clock::now();
+    AddVertexCacheStats(stats.before, AnalyzeVertexCache(mesh.indices, mesh.vertices.size()));
+    OptimizeVertexCache(mesh.indices.data(), mesh.indices.size());
+    OptimizeOverdraw(mesh.indices, mesh.vertices);
+    OptimizeVertexFetch(mesh.vertices, mesh.indices);
+    AddVertexCacheStats(stats.after, AnalyzeVertexCache(mesh.indices, mesh.vertices.size()));
+    stats.milliseconds += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
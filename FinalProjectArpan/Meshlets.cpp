@@ -0,0 +1,287 @@
+#include "Meshlets.h"
+#include "MeshOptimizer.h"
+#include "Shader.h"
+#include "VertexFormat.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// Matches DrawElementsIndirectCommand
+struct MeshletCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+static unsigned long long SpreadBits(unsigned int x) {
+    unsigned long long v = x & 0x3ff;
+    v = (v | (v << 16)) & 0x30000ffull;
+    v = (v | (v << 8)) & 0x300f00full;
+    v = (v | (v << 4)) & 0x30c30c3ull;
+    v = (v | (v << 2)) & 0x9249249ull;
+    return v;
+}
+
+// Sphere around the meshlet's vertices and the cone of its face normals
+static void BoundMeshlet(Meshlet& meshlet, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+    const std::vector<glm::vec3>& faceNormals, const std::vector<unsigned char>& flipped, const std::vector<int>& triangles) {
+    glm::vec3 boundsMin(1e30f), boundsMax(-1e30f), normalSum(0.0f);
+    bool anyFlipped = false;
+    for (int t : triangles) {
+        for (int k = 0; k < 3; ++k) {
+            boundsMin = glm::min(boundsMin, positions[indices[3 * t + k]]);
+            boundsMax = glm::max(boundsMax, positions[indices[3 * t + k]]);
+        }
+        normalSum += faceNormals[t];
+        anyFlipped = anyFlipped || flipped[t];
+    }
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.0f;
+    for (int t : triangles) {
+        for (int k = 0; k < 3; ++k) {
+            radius = std::max(radius, glm::distance(center, positions[indices[3 * t + k]]));
+        }
+    }
+    meshlet.sphere = glm::vec4(center, radius);
+
+    // Triangles wound against their vertex normals may be seen from behind; their meshlet never cone culls
+    float length = glm::length(normalSum);
+    glm::vec3 axis = length > 1e-6f ? normalSum / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    float cutoff = length > 1e-6f && !anyFlipped ? 1.0f : -1.0f;
+    for (int t : triangles) {
+        cutoff = std::min(cutoff, glm::dot(axis, faceNormals[t]));
+    }
+    meshlet.cone = glm::vec4(axis, cutoff);
+}
+
+// Appends the mesh's meshlets and returns its indices in meshlet order
+static std::vector<unsigned int> BuildMeshMeshlets(std::vector<Meshlet>& meshlets, const Mesh& mesh, unsigned int meshletMesh, unsigned int firstCommand) {
+    int triangleCount = (int)mesh.indices.size() / 3;
+    std::vector<glm::vec3> positions(mesh.vertices.size());
+    glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        positions[i] = glm::vec3(mesh.vertices[i].Position[0], mesh.vertices[i].Position[1], mesh.vertices[i].Position[2]);
+        boundsMin = glm::min(boundsMin, positions[i]);
+        boundsMax = glm::max(boundsMax, positions[i]);
+    }
+    glm::vec3 scale = 1023.0f / glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+
+    // Facing bucket in the top bits, Morton code of the centroid below
+    std::vector<glm::vec3> faceNormals(triangleCount);
+    std::vector<unsigned char> flipped(triangleCount);
+    std::vector<std::pair<unsigned long long, int>> order(triangleCount);
+    for (int t = 0; t < triangleCount; ++t) {
+        const unsigned int* tri = &mesh.indices[3 * t];
+        glm::vec3 a = positions[tri[0]], b = positions[tri[1]], c = positions[tri[2]];
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        faceNormals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+        glm::vec3 vertexNormal(0.0f);
+        for (int k = 0; k < 3; ++k) {
+            vertexNormal += glm::vec3(mesh.vertices[tri[k]].Normal[0], mesh.vertices[tri[k]].Normal[1], mesh.vertices[tri[k]].Normal[2]);
+        }
+        flipped[t] = glm::dot(vertexNormal, faceNormals[t]) < 0.0f;
+
+        glm::vec3 absolute = glm::abs(faceNormals[t]);
+        int axis = absolute.x >= absolute.y && absolute.x >= absolute.z ? 0 : (absolute.y >= absolute.z ? 1 : 2);
+        unsigned long long bucket = axis * 2 + (faceNormals[t][axis] < 0.0f);
+        glm::uvec3 cell = glm::uvec3(glm::clamp(((a + b + c) / 3.0f - boundsMin) * scale, 0.0f, 1023.0f));
+        order[t] = { (bucket << 32) | (SpreadBits(cell.x) << 2) | (SpreadBits(cell.y) << 1) | SpreadBits(cell.z), t };
+    }
+    std::sort(order.begin(), order.end());
+
+    // Cut the sorted triangles whenever a limit is hit or the facing bucket changes
+    std::vector<unsigned int> reordered;
+    reordered.reserve(mesh.indices.size());
+    std::vector<unsigned int> vertexStamp(mesh.vertices.size(), 0);
+    unsigned int stamp = 1;
+    int vertexCount = 0;
+    std::vector<int> triangles;
+    auto closeMeshlet = [&]() {
+        if (triangles.empty()) {
+            return;
+        }
+        Meshlet meshlet;
+        meshlet.firstIndex = (unsigned int)reordered.size();
+        meshlet.indexCount = (unsigned int)triangles.size() * 3;
+        meshlet.mesh = meshletMesh;
+        meshlet.firstCommand = firstCommand;
+        BoundMeshlet(meshlet, positions, mesh.indices, faceNormals, flipped, triangles);
+        for (int t : triangles) {
+            reordered.insert(reordered.end(), { mesh.indices[3 * t], mesh.indices[3 * t + 1], mesh.indices[3 * t + 2] });
+        }
+        meshlets.push_back(meshlet);
+        triangles.clear();
+        vertexCount = 0;
+        stamp++;
+    };
+    for (size_t i = 0; i < order.size(); ++i) {
+        int t = order[i].second;
+        int added = 0;
+        for (int k = 0; k < 3; ++k) {
+            added += vertexStamp[mesh.indices[3 * t + k]] != stamp;
+        }
+        bool newBucket = i > 0 && (order[i].first >> 32) != (order[i - 1].first >> 32);
+        if (newBucket || vertexCount + added > MESHLET_MAX_VERTICES || (int)triangles.size() == MESHLET_MAX_TRIANGLES) {
+            closeMeshlet();
+        }
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = mesh.indices[3 * t + k];
+            if (vertexStamp[v] != stamp) {
+                vertexStamp[v] = stamp;
+                vertexCount++;
+            }
+        }
+        triangles.push_back(t);
+    }
+    closeMeshlet();
+    return reordered;
+}
+
+bool InitMeshlets(MeshletMeshes& meshlets, std::vector<Mesh>& meshes) {
+    meshlets.cullProgram = LoadShaderProgram("shaders/meshlet_cull.glsl");
+    InitGpuTimer(meshlets.timer);
+    if (!meshlets.cullProgram) {
+        return false;
+    }
+    meshlets.drawCount = GLEW_ARB_indirect_parameters != 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    meshlets.meshletMeshOf.assign(meshes.size(), -1);
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        Mesh& mesh = meshes[m];
+        if (mesh.opacity < 1.0f || (int)mesh.indices.size() / 3 < MESHLET_MIN_MESH_TRIANGLES) {
+            continue;
+        }
+        MeshletMesh meshletMesh;
+        meshletMesh.mesh = (int)m;
+        meshletMesh.firstMeshlet = (int)meshlets.meshlets.size();
+        mesh.indices = BuildMeshMeshlets(meshlets.meshlets, mesh, (unsigned int)meshlets.meshes.size(), (unsigned int)meshletMesh.firstMeshlet);
+        meshletMesh.meshletCount = (int)meshlets.meshlets.size() - meshletMesh.firstMeshlet;
+        meshlets.meshletMeshOf[m] = (int)meshlets.meshes.size();
+        meshlets.meshes.push_back(meshletMesh);
+        meshlets.totalTriangles += (int)mesh.indices.size() / 3;
+
+        // Meshlet order undoes the import's cache order, so restore it within each meshlet
+        for (int i = meshletMesh.firstMeshlet; i < meshletMesh.firstMeshlet + meshletMesh.meshletCount; ++i) {
+            OptimizeVertexCache(&mesh.indices[meshlets.meshlets[i].firstIndex], meshlets.meshlets[i].indexCount);
+        }
+        OptimizeVertexFetch(mesh.vertices, mesh.indices);
+        UploadMeshBuffers(mesh, mesh.vertexFormat, mesh.indexType == GL_UNSIGNED_SHORT);
+    }
+    float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Meshlets: " << meshlets.meshlets.size() << " over " << meshlets.meshes.size() << " meshes, built in " << milliseconds << " ms" << std::endl;
+
+    size_t meshletCount = std::max<size_t>(meshlets.meshlets.size(), 1);
+    glGenBuffers(1, &meshlets.meshletBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshlets.meshletBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, meshletCount * sizeof(Meshlet), meshlets.meshlets.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glGenBuffers(1, &meshlets.commandBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, meshlets.commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, meshletCount * sizeof(MeshletCommand), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    size_t counterSize = std::max<size_t>(meshlets.meshes.size(), 1) * 2 * sizeof(GLuint);
+    glGenBuffers(1, &meshlets.counterBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshlets.counterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, counterSize, nullptr, GL_DYNAMIC_COPY);
+    glGenBuffers(GPU_TIMER_LATENCY, meshlets.statsBuffer);
+    for (GLuint buffer : meshlets.statsBuffer) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, counterSize, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return true;
+}
+
+void DestroyMeshlets(MeshletMeshes& meshlets) {
+    glDeleteBuffers(1, &meshlets.meshletBuffer);
+    glDeleteBuffers(1, &meshlets.commandBuffer);
+    glDeleteBuffers(1, &meshlets.counterBuffer);
+    glDeleteBuffers(GPU_TIMER_LATENCY, meshlets.statsBuffer);
+    glDeleteProgram(meshlets.cullProgram);
+    DestroyGpuTimer(meshlets.timer);
+}
+
+void CullMeshlets(MeshletMeshes& meshlets, const MeshletSettings& settings, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection) {
+    if (!settings.enabled || meshlets.meshlets.empty()) {
+        return;
+    }
+    BeginGpuTimer(meshlets.timer);
+
+    // Frustum planes and eye in mesh space, from the rows of the full transform (Gribb & Hartmann)
+    glm::mat4 modelViewProjection = projection * view * model;
+    glm::vec4 planes[6];
+    for (int i = 0; i < 3; ++i) {
+        glm::vec4 row(modelViewProjection[0][i], modelViewProjection[1][i], modelViewProjection[2][i], modelViewProjection[3][i]);
+        glm::vec4 w(modelViewProjection[0][3], modelViewProjection[1][3], modelViewProjection[2][3], modelViewProjection[3][3]);
+        planes[i * 2] = w + row;
+        planes[i * 2 + 1] = w - row;
+    }
+    for (glm::vec4& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    glm::vec3 eye = glm::vec3(glm::inverse(view * model)[3]);
+
+    // Counts from a few frames ago for the GUI, then reset them
+    GLsizeiptr counterSize = meshlets.meshes.size() * 2 * sizeof(GLuint);
+    int slot = meshlets.statsFrame % GPU_TIMER_LATENCY;
+    if (meshlets.statsFrame >= GPU_TIMER_LATENCY) {
+        std::vector<GLuint> counters(meshlets.meshes.size() * 2);
+        glBindBuffer(GL_COPY_READ_BUFFER, meshlets.statsBuffer[slot]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, counterSize, counters.data());
+        meshlets.drawnMeshlets = 0;
+        meshlets.drawnTriangles = 0;
+        for (size_t i = 0; i < meshlets.meshes.size(); ++i) {
+            meshlets.drawnMeshlets += counters[2 * i];
+            meshlets.drawnTriangles += counters[2 * i + 1];
+        }
+    }
+    std::vector<GLuint> zeros(meshlets.meshes.size() * 2, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshlets.counterBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, counterSize, zeros.data());
+
+    glUseProgram(meshlets.cullProgram);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, meshlets.meshletBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, meshlets.commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, meshlets.counterBuffer);
+    glUniform4fv(glGetUniformLocation(meshlets.cullProgram, "uFrustum"), 6, glm::value_ptr(planes[0]));
+    glUniform3fv(glGetUniformLocation(meshlets.cullProgram, "uEye"), 1, glm::value_ptr(eye));
+    glUniform1i(glGetUniformLocation(meshlets.cullProgram, "uFrustumCulling"), settings.frustumCulling);
+    glUniform1i(glGetUniformLocation(meshlets.cullProgram, "uConeCulling"), settings.coneCulling);
+    glUniform1i(glGetUniformLocation(meshlets.cullProgram, "uCompact"), meshlets.drawCount);
+    glUniform1ui(glGetUniformLocation(meshlets.cullProgram, "uCount"), (GLuint)meshlets.meshlets.size());
+    glDispatchCompute(((GLuint)meshlets.meshlets.size() + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, meshlets.statsBuffer[slot]);
+    glCopyBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, counterSize);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    meshlets.statsFrame++;
+    EndGpuTimer(meshlets.timer);
+}
+
+bool DrawMeshlets(const MeshletMeshes& meshlets, const MeshletSettings& settings, int mesh, GLenum indexType) {
+    int index = meshlets.meshletMeshOf.empty() ? -1 : meshlets.meshletMeshOf[mesh];
+    if (!settings.enabled || index < 0) {
+        return false;
+    }
+    const MeshletMesh& meshletMesh = meshlets.meshes[index];
+    const void* commands = (const void*)(meshletMesh.firstMeshlet * sizeof(MeshletCommand));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, meshlets.commandBuffer);
+    if (meshlets.drawCount) {
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, meshlets.counterBuffer);
+        glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, indexType, commands, (GLintptr)(index * 2 * sizeof(GLuint)), meshletMesh.meshletCount, 0);
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+    }
+    else {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, commands, meshletMesh.meshletCount, 0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return true;
+}
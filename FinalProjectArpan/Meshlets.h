@@ -0,0 +1,68 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "GpuTimer.h"
+#include "Mesh.h"
+
+// Cluster culling for the big opaque scene meshes.
+// At import, each large mesh's triangles are grouped by facing (the major axis of the face normal)
+// and sorted along a Morton curve, then cut into meshlets of at most MESHLET_MAX_TRIANGLES triangles
+// and MESHLET_MAX_VERTICES distinct vertices. The index buffer is rewritten in meshlet order so
+// each meshlet is one contiguous range. Every meshlet keeps a bounding sphere and a cone that
+// holds its face normals (Shirman & Abi-Ezzi 1993); a meshlet is back facing as a whole when the
+// eye lies behind every plane the cone and sphere allow.
+// Each frame a compute pass tests every meshlet against the frustum and its cone in mesh space
+// and appends the survivors as indirect draw commands; each mesh then draws with one
+// multi-draw whose count stays on the GPU (ARB_indirect_parameters), or, without it,
+// one fixed command per meshlet with the culled ones left empty.
+const int MESHLET_MAX_VERTICES = 64;
+const int MESHLET_MAX_TRIANGLES = 124;
+const int MESHLET_MIN_MESH_TRIANGLES = 4096;   // Smaller meshes keep drawing whole
+
+struct MeshletSettings {
+    bool enabled = true;
+    bool frustumCulling = true;
+    bool coneCulling = true;
+};
+
+// Matches the cull shader's std430 layout
+struct Meshlet {
+    glm::vec4 sphere;        // Mesh space center, radius
+    glm::vec4 cone;          // Axis, cosine of the half angle; 0 or below never culls
+    unsigned int firstIndex, indexCount;
+    unsigned int mesh;       // Into MeshletMeshes::meshes
+    unsigned int firstCommand;
+};
+
+struct MeshletMesh {
+    int mesh = 0;            // Scene mesh index
+    int firstMeshlet = 0, meshletCount = 0;
+};
+
+struct MeshletMeshes {
+    std::vector<MeshletMesh> meshes;
+    std::vector<int> meshletMeshOf;    // Per scene mesh, into meshes or -1
+    std::vector<Meshlet> meshlets;
+    GLuint meshletBuffer = 0;
+    GLuint commandBuffer = 0;          // One DrawElementsIndirectCommand slot per meshlet
+    GLuint counterBuffer = 0;          // Per mesh: commands written, triangles kept
+    bool drawCount = false;            // ARB_indirect_parameters is there
+    GLuint cullProgram = 0;
+
+    GLuint statsBuffer[GPU_TIMER_LATENCY] = {};   // Copies of the counters, read back a few frames late
+    int statsFrame = 0;
+    int drawnMeshlets = 0, drawnTriangles = 0, totalTriangles = 0;
+    GpuTimer timer;
+};
+
+// Builds meshlets for every large opaque mesh, rewriting its buffers in meshlet order
+bool InitMeshlets(MeshletMeshes& meshlets, std::vector<Mesh>& meshes);
+void DestroyMeshlets(MeshletMeshes& meshlets);
+
+// Culls every meshlet for this frame; model is the scene meshes' transform (rotation and uniform scale)
+void CullMeshlets(MeshletMeshes& meshlets, const MeshletSettings& settings, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+
+// Draws a scene mesh's surviving meshlets with its VAO bound, in its index type; false if the mesh has none and must draw whole
+bool DrawMeshlets(const MeshletMeshes& meshlets, const MeshletSettings& settings, int mesh, GLenum indexType);
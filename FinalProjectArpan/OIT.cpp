@@ -0,0 +1,95 @@
+#include "OIT.h"
+#include "Shader.h"
+#include <iostream>
+
+static void DestroyTargets(OIT& oit) {
+    glDeleteFramebuffers(1, &oit.fbo);
+    glDeleteTextures(1, &oit.accumTexture);
+    glDeleteTextures(1, &oit.revealTexture);
+    oit.fbo = oit.accumTexture = oit.revealTexture = 0;
+    oit.width = oit.height = 0;
+}
+
+static GLuint CreateTarget(GLenum format, int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+// Follows the scene target size
+static void EnsureTargets(OIT& oit, const PostProcess& pp) {
+    if (oit.width == pp.width && oit.height == pp.height) {
+        return;
+    }
+    DestroyTargets(oit);
+    oit.width = pp.width;
+    oit.height = pp.height;
+
+    oit.accumTexture = CreateTarget(GL_RGBA16F, oit.width, oit.height);
+    oit.revealTexture = CreateTarget(GL_R8, oit.width, oit.height);
+    glGenFramebuffers(1, &oit.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, oit.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, oit.accumTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, oit.revealTexture, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool InitOIT(OIT& oit) {
+    oit.compositeProgram = LoadShaderProgram("shaders/oit_composite.glsl");
+    return oit.compositeProgram != 0;
+}
+
+void DestroyOIT(OIT& oit) {
+    DestroyTargets(oit);
+    glDeleteProgram(oit.compositeProgram);
+}
+
+void BeginTransparentPass(OIT& oit, const PostProcess& pp) {
+    EnsureTargets(oit, pp);
+
+    static const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    static const GLfloat accumClear[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    static const GLfloat revealClear[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glBindFramebuffer(GL_FRAMEBUFFER, oit.fbo);
+    // Shares the scene depth so transparents are occluded; re-attached since the scene target may have been rebuilt
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, pp.depthTexture, 0);
+    glDrawBuffers(2, drawBuffers);
+    glViewport(0, 0, oit.width, oit.height);
+    glClearBufferfv(GL_COLOR, 0, accumClear);
+    glClearBufferfv(GL_COLOR, 1, revealClear);
+
+    // Test against opaque depth but never write it, so submission order does not matter
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunci(0, GL_ONE, GL_ONE);
+    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+}
+
+void CompositeOIT(const OIT& oit, const PostProcess& pp) {
+    glDepthMask(GL_TRUE);
+    glDisable(GL_DEPTH_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, pp.hdrFBO);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glViewport(0, 0, pp.width, pp.height);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(oit.compositeProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, oit.accumTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, oit.revealTexture);
+    glUniform1i(glGetUniformLocation(oit.compositeProgram, "uAccum"), 0);
+    glUniform1i(glGetUniformLocation(oit.compositeProgram, "uReveal"), 1);
+    DrawFullscreenTriangle(pp);
+    glDisable(GL_BLEND);
+
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <GL/glew.h>
+#include "PostProcess.h"
+
+// Weighted blended order-independent transparency (McGuire & Bavoil 2013).
+// Transparent surfaces are drawn in any order into an additive accumulation target and a
+// multiplicative revealage target, testing against the opaque depth without writing it.
+// One fullscreen composite then blends the weighted average over the HDR scene color.
+struct OIT {
+    int width = 0, height = 0;
+
+    GLuint fbo = 0;
+    GLuint accumTexture = 0;    // RGBA16F: sum of weighted premultiplied color, sum of weighted alpha
+    GLuint revealTexture = 0;   // R8: product of (1 - alpha), how much of the background shows through
+
+    GLuint compositeProgram = 0;
+};
+
+bool InitOIT(OIT& oit);
+void DestroyOIT(OIT& oit);
+
+// Binds the OIT targets and blend state; transparent geometry is drawn between this and CompositeOIT
+void BeginTransparentPass(OIT& oit, const PostProcess& pp);
+
+// Restores opaque state and blends the accumulated transparency over the HDR color
+void CompositeOIT(const OIT& oit, const PostProcess& pp);
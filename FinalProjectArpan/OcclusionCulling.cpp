@@ -0,0 +1,416 @@
+#include "OcclusionCulling.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <xmmintrin.h>
+
+const int OCCLUSION_TILES_X = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+const int OCCLUSION_CLUSTER_CELLS = 32;   // Grid cells along the longest side of a mesh before coarsening
+
+// One occluder by vertex clustering; the grid coarsens until the triangle budget is met
+static bool BuildOccluder(Occluder& occluder, const Mesh& mesh, glm::vec3 boundsMin, glm::vec3 boundsMax) {
+    glm::vec3 size = boundsMax - boundsMin;
+    float longest = std::max(std::max(size.x, size.y), std::max(size.z, 1e-6f));
+    for (int cells = OCCLUSION_CLUSTER_CELLS; cells >= 2; cells = cells * 3 / 4) {
+        float cellSize = longest / cells;
+        std::unordered_map<unsigned long long, unsigned int> clusterOf;
+        std::vector<glm::vec3> sums, normals;
+        std::vector<int> counts;
+        std::vector<unsigned int> vertexCluster(mesh.vertices.size());
+        for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+            const Vertex& v = mesh.vertices[i];
+            glm::vec3 p(v.Position[0], v.Position[1], v.Position[2]);
+            glm::ivec3 cell = glm::clamp(glm::ivec3((p - boundsMin) / cellSize), 0, cells);
+            unsigned long long key = ((unsigned long long)cell.x << 42) | ((unsigned long long)cell.y << 21) | (unsigned long long)cell.z;
+            auto found = clusterOf.emplace(key, (unsigned int)sums.size());
+            if (found.second) {
+                sums.push_back(glm::vec3(0.0f));
+                normals.push_back(glm::vec3(0.0f));
+                counts.push_back(0);
+            }
+            unsigned int cluster = found.first->second;
+            sums[cluster] += p;
+            normals[cluster] += glm::vec3(v.Normal[0], v.Normal[1], v.Normal[2]);
+            counts[cluster]++;
+            vertexCluster[i] = cluster;
+        }
+
+        // A cluster whose normals disagree spans opposite surfaces, like both sides of a gap or a
+        // thin part, and can't be moved inside; triangles touching it are dropped
+        std::vector<bool> agrees(sums.size());
+        for (size_t i = 0; i < sums.size(); ++i) {
+            agrees[i] = glm::length(normals[i]) > 0.5f * counts[i];
+        }
+
+        // Triangles whose corners land in three different agreeing clusters survive, once each
+        std::unordered_set<unsigned long long> seen;
+        std::vector<unsigned int> indices;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            unsigned int a = vertexCluster[mesh.indices[i]], b = vertexCluster[mesh.indices[i + 1]], c = vertexCluster[mesh.indices[i + 2]];
+            if (a == b || b == c || a == c || !agrees[a] || !agrees[b] || !agrees[c]) {
+                continue;
+            }
+            unsigned int sorted[3] = { a, b, c };
+            std::sort(sorted, sorted + 3);
+            unsigned long long key = ((unsigned long long)sorted[0] << 42) | ((unsigned long long)sorted[1] << 21) | sorted[2];
+            if (seen.insert(key).second) {
+                indices.insert(indices.end(), { a, b, c });
+            }
+        }
+        if (indices.size() / 3 > (size_t)OCCLUSION_MAX_OCCLUDER_TRIANGLES && cells > 2) {
+            continue;
+        }
+
+        // Clusters sit at their mean, moved inward by half a cell diagonal, the farthest a mean can
+        // sit from the surface through its cell, so edges between them mostly stay inside
+        occluder.vertices.resize(sums.size());
+        for (size_t i = 0; i < sums.size(); ++i) {
+            glm::vec3 inward = agrees[i] ? -glm::normalize(normals[i]) : glm::vec3(0.0f);
+            occluder.vertices[i] = sums[i] / (float)counts[i] + inward * (0.87f * cellSize);
+        }
+        occluder.indices = std::move(indices);
+        occluder.boundsMin = boundsMin;
+        occluder.boundsMax = boundsMax;
+        return !occluder.indices.empty();
+    }
+    return false;
+}
+
+bool InitOcclusion(OcclusionCuller& culler, const std::vector<Mesh>& meshes) {
+    auto start = std::chrono::high_resolution_clock::now();
+    int triangles = 0;
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        const Mesh& mesh = meshes[m];
+        glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+        for (const Vertex& v : mesh.vertices) {
+            boundsMin = glm::min(boundsMin, glm::vec3(v.Position[0], v.Position[1], v.Position[2]));
+            boundsMax = glm::max(boundsMax, glm::vec3(v.Position[0], v.Position[1], v.Position[2]));
+        }
+        culler.meshBoundsMin.push_back(boundsMin);
+        culler.meshBoundsMax.push_back(boundsMax);
+        if (mesh.opacity < 1.0f || mesh.deformableSnow || mesh.vertices.empty()) {
+            continue;
+        }
+        Occluder occluder;
+        occluder.mesh = (int)m;
+        if (BuildOccluder(occluder, mesh, boundsMin, boundsMax)) {
+            triangles += (int)occluder.indices.size() / 3;
+            culler.occluders.push_back(std::move(occluder));
+        }
+    }
+    culler.meshVisible.assign(meshes.size(), 1);
+    float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Occlusion: " << culler.occluders.size() << " occluders, " << triangles << " triangles, built in " << milliseconds << " ms" << std::endl;
+
+    int offset = 0;
+    for (int level = 0; level < OCCLUSION_LEVELS; ++level) {
+        culler.levelOffset[level] = offset;
+        offset += (OCCLUSION_WIDTH >> level) * (OCCLUSION_HEIGHT >> level);
+    }
+    culler.depth.assign(offset, 0.0f);
+
+    glGenTextures(1, &culler.hiZTexture);
+    glBindTexture(GL_TEXTURE_2D, culler.hiZTexture);
+    glTexStorage2D(GL_TEXTURE_2D, OCCLUSION_LEVELS, GL_R32F, OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return !culler.occluders.empty();
+}
+
+void DestroyOcclusion(OcclusionCuller& culler) {
+    glDeleteTextures(1, &culler.hiZTexture);
+    culler.hiZTexture = 0;
+}
+
+// Screen space setup; counter-clockwise triangles are front facing, the rest are dropped
+static void AddTriangle(OcclusionBatch& batch, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (area <= 0.0f) {
+        return;
+    }
+    OcclusionTriangle triangle;
+    float minX = std::min(v0.x, std::min(v1.x, v2.x)), maxX = std::max(v0.x, std::max(v1.x, v2.x));
+    float minY = std::min(v0.y, std::min(v1.y, v2.y)), maxY = std::max(v0.y, std::max(v1.y, v2.y));
+    triangle.minX = std::max((int)std::ceil(minX - 0.5f), 0);
+    triangle.maxX = std::min((int)std::floor(maxX - 0.5f), OCCLUSION_WIDTH - 1);
+    triangle.minY = std::max((int)std::ceil(minY - 0.5f), 0);
+    triangle.maxY = std::min((int)std::floor(maxY - 0.5f), OCCLUSION_HEIGHT - 1);
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+        return;
+    }
+    const glm::vec3* v[3] = { &v0, &v1, &v2 };
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec3& a = *v[i];
+        const glm::vec3& b = *v[(i + 1) % 3];
+        float edgeA = a.y - b.y, edgeB = b.x - a.x;
+        triangle.edges[i] = glm::vec3(edgeA, edgeB, -(edgeA * a.x + edgeB * a.y));
+    }
+    float depthA = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+    float depthB = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+    triangle.depth = glm::vec3(depthA, depthB, v0.z - depthA * v0.x - depthB * v0.y);
+
+    int index = (int)batch.triangles.size();
+    batch.triangles.push_back(triangle);
+    for (int ty = triangle.minY / OCCLUSION_TILE_HEIGHT; ty <= triangle.maxY / OCCLUSION_TILE_HEIGHT; ++ty) {
+        for (int tx = triangle.minX / OCCLUSION_TILE_WIDTH; tx <= triangle.maxX / OCCLUSION_TILE_WIDTH; ++tx) {
+            batch.tiles[ty * OCCLUSION_TILES_X + tx].push_back(index);
+        }
+    }
+}
+
+// Clips against the near plane (z >= -w) and maps what is left to pixels and 1/w
+static void SetupTriangle(OcclusionBatch& batch, const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2) {
+    const glm::vec4* corners[3] = { &c0, &c1, &c2 };
+    glm::vec4 polygon[4];
+    int count = 0;
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec4& a = *corners[i];
+        const glm::vec4& b = *corners[(i + 1) % 3];
+        float da = a.z + a.w, db = b.z + b.w;
+        if (da >= 0.0f) {
+            polygon[count++] = a;
+        }
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            polygon[count++] = a + (b - a) * (da / (da - db));
+        }
+    }
+    if (count < 3) {
+        return;
+    }
+    glm::vec3 screen[4];
+    for (int i = 0; i < count; ++i) {
+        float inverseW = 1.0f / polygon[i].w;
+        screen[i] = glm::vec3((polygon[i].x * inverseW * 0.5f + 0.5f) * OCCLUSION_WIDTH,
+            (polygon[i].y * inverseW * 0.5f + 0.5f) * OCCLUSION_HEIGHT, inverseW);
+    }
+    for (int i = 1; i + 1 < count; ++i) {
+        AddTriangle(batch, screen[0], screen[i], screen[i + 1]);
+    }
+}
+
+// Keeps the nearest 1/w per pixel inside one tile, four pixels at a time
+static void RasterizeTile(OcclusionCuller& culler, int tile, int batchCount) {
+    int tileX = (tile % OCCLUSION_TILES_X) * OCCLUSION_TILE_WIDTH;
+    int tileY = (tile / OCCLUSION_TILES_X) * OCCLUSION_TILE_HEIGHT;
+    float* depth = culler.depth.data();
+    for (int y = tileY; y < tileY + OCCLUSION_TILE_HEIGHT; ++y) {
+        std::fill(depth + y * OCCLUSION_WIDTH + tileX, depth + y * OCCLUSION_WIDTH + tileX + OCCLUSION_TILE_WIDTH, 0.0f);
+    }
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    for (int b = 0; b < batchCount; ++b) {
+        const OcclusionBatch& batch = culler.batches[b];
+        for (int index : batch.tiles[tile]) {
+            const OcclusionTriangle& t = batch.triangles[index];
+            int x0 = std::max(t.minX, tileX) & ~3, x1 = std::min(t.maxX, tileX + OCCLUSION_TILE_WIDTH - 1);
+            int y0 = std::max(t.minY, tileY), y1 = std::min(t.maxY, tileY + OCCLUSION_TILE_HEIGHT - 1);
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x0), laneOffsets);
+            __m128 a0 = _mm_set1_ps(t.edges[0].x), a1 = _mm_set1_ps(t.edges[1].x), a2 = _mm_set1_ps(t.edges[2].x);
+            __m128 step0 = _mm_set1_ps(4.0f * t.edges[0].x), step1 = _mm_set1_ps(4.0f * t.edges[1].x), step2 = _mm_set1_ps(4.0f * t.edges[2].x);
+            __m128 depthA = _mm_set1_ps(t.depth.x), depthStep = _mm_set1_ps(4.0f * t.depth.x);
+            for (int y = y0; y <= y1; ++y) {
+                float py = y + 0.5f;
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), _mm_set1_ps(t.edges[0].y * py + t.edges[0].z));
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), _mm_set1_ps(t.edges[1].y * py + t.edges[1].z));
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), _mm_set1_ps(t.edges[2].y * py + t.edges[2].z));
+                __m128 z = _mm_add_ps(_mm_mul_ps(depthA, px), _mm_set1_ps(t.depth.y * py + t.depth.z));
+                float* row = depth + y * OCCLUSION_WIDTH;
+                for (int x = x0; x <= x1; x += 4) {
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                    __m128 old = _mm_loadu_ps(row + x);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, _mm_max_ps(old, z)), _mm_andnot_ps(inside, old)));
+                    e0 = _mm_add_ps(e0, step0);
+                    e1 = _mm_add_ps(e1, step1);
+                    e2 = _mm_add_ps(e2, step2);
+                    z = _mm_add_ps(z, depthStep);
+                }
+            }
+        }
+    }
+}
+
+// Each texel keeps the farthest (smallest) 1/w of the 2x2 below it
+static void BuildPyramid(OcclusionCuller& culler) {
+    for (int level = 1; level < OCCLUSION_LEVELS; ++level) {
+        int width = OCCLUSION_WIDTH >> level, height = OCCLUSION_HEIGHT >> level;
+        const float* below = culler.depth.data() + culler.levelOffset[level - 1];
+        float* texels = culler.depth.data() + culler.levelOffset[level];
+        for (int y = 0; y < height; ++y) {
+            const float* row0 = below + (2 * y) * (2 * width);
+            const float* row1 = row0 + 2 * width;
+            for (int x = 0; x < width; ++x) {
+                texels[y * width + x] = std::min(std::min(row0[2 * x], row0[2 * x + 1]), std::min(row1[2 * x], row1[2 * x + 1]));
+            }
+        }
+    }
+}
+
+// Screen rectangle of a box as a fraction of the screen, 1 if it reaches behind the near plane
+static float ScreenArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& modelViewProjection) {
+    glm::vec2 minimum(1e30f), maximum(-1e30f);
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+        glm::vec4 clip = modelViewProjection * glm::vec4(corner, 1.0f);
+        if (clip.z < -clip.w) {
+            return 1.0f;
+        }
+        minimum = glm::min(minimum, glm::vec2(clip) / clip.w);
+        maximum = glm::max(maximum, glm::vec2(clip) / clip.w);
+    }
+    glm::vec2 size = glm::max(glm::min(maximum, glm::vec2(1.0f)) - glm::max(minimum, glm::vec2(-1.0f)), glm::vec2(0.0f));
+    return size.x * size.y * 0.25f;
+}
+
+void UpdateOcclusion(OcclusionCuller& culler, const OcclusionSettings& settings, ThreadPool& pool,
+    const glm::mat4& model, const glm::mat4& viewProjection) {
+    auto start = std::chrono::high_resolution_clock::now();
+    culler.active = settings.enabled && !culler.occluders.empty();
+    culler.viewProjection = viewProjection;
+    culler.triangleCount = 0;
+    culler.occludedMeshes = 0;
+    std::fill(culler.meshVisible.begin(), culler.meshVisible.end(), 1);
+    if (!culler.active) {
+        culler.drawn.clear();
+        culler.milliseconds = 0.0f;
+        return;
+    }
+    glm::mat4 modelViewProjection = viewProjection * model;
+
+    // 1. Occluders big enough on screen, and their vertices in clip space
+    culler.drawn.clear();
+    culler.vertexStart.clear();
+    culler.jobs.clear();
+    int vertexCount = 0;
+    for (int i = 0; i < (int)culler.occluders.size(); ++i) {
+        const Occluder& occluder = culler.occluders[i];
+        if (ScreenArea(occluder.boundsMin, occluder.boundsMax, modelViewProjection) < settings.minOccluderArea) {
+            continue;
+        }
+        int triangles = (int)occluder.indices.size() / 3;
+        for (int first = 0; first < triangles; first += OCCLUSION_BATCH_TRIANGLES) {
+            culler.jobs.push_back(glm::ivec3((int)culler.drawn.size(), first, std::min(OCCLUSION_BATCH_TRIANGLES, triangles - first)));
+        }
+        culler.drawn.push_back(i);
+        culler.vertexStart.push_back(vertexCount);
+        vertexCount += (int)occluder.vertices.size();
+    }
+    culler.clipVertices.resize(vertexCount);
+    ParallelFor(pool, (int)culler.drawn.size(), 1, [&](int begin, int end) {
+        for (int d = begin; d < end; ++d) {
+            const Occluder& occluder = culler.occluders[culler.drawn[d]];
+            glm::vec4* clip = culler.clipVertices.data() + culler.vertexStart[d];
+            for (size_t v = 0; v < occluder.vertices.size(); ++v) {
+                clip[v] = modelViewProjection * glm::vec4(occluder.vertices[v], 1.0f);
+            }
+        }
+    });
+
+    // 2. Clip, set up and bin a batch of triangles per task
+    if (culler.batches.size() < culler.jobs.size()) {
+        culler.batches.resize(culler.jobs.size());
+    }
+    ParallelFor(pool, (int)culler.jobs.size(), 1, [&](int begin, int end) {
+        for (int j = begin; j < end; ++j) {
+            glm::ivec3 job = culler.jobs[j];
+            OcclusionBatch& batch = culler.batches[j];
+            batch.triangles.clear();
+            for (std::vector<int>& tile : batch.tiles) {
+                tile.clear();
+            }
+            const Occluder& occluder = culler.occluders[culler.drawn[job.x]];
+            const glm::vec4* clip = culler.clipVertices.data() + culler.vertexStart[job.x];
+            for (int t = job.y; t < job.y + job.z; ++t) {
+                SetupTriangle(batch, clip[occluder.indices[3 * t]], clip[occluder.indices[3 * t + 1]], clip[occluder.indices[3 * t + 2]]);
+            }
+        }
+    });
+    for (size_t j = 0; j < culler.jobs.size(); ++j) {
+        culler.triangleCount += (int)culler.batches[j].triangles.size();
+    }
+
+    // 3. Fill the tiles, one task each, then reduce into the pyramid
+    int batchCount = (int)culler.jobs.size();
+    ParallelFor(pool, OCCLUSION_TILES, 1, [&](int begin, int end) {
+        for (int tile = begin; tile < end; ++tile) {
+            RasterizeTile(culler, tile, batchCount);
+        }
+    });
+    BuildPyramid(culler);
+
+    // 4. Scene meshes against it
+    for (size_t m = 0; m < culler.meshVisible.size(); ++m) {
+        culler.meshVisible[m] = IsBoxVisible(culler, culler.meshBoundsMin[m], culler.meshBoundsMax[m], modelViewProjection);
+        culler.occludedMeshes += !culler.meshVisible[m];
+    }
+    culler.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    glBindTexture(GL_TEXTURE_2D, culler.hiZTexture);
+    for (int level = 0; level < OCCLUSION_LEVELS; ++level) {
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, OCCLUSION_WIDTH >> level, OCCLUSION_HEIGHT >> level, GL_RED, GL_FLOAT,
+            culler.depth.data() + culler.levelOffset[level]);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool IsBoxVisible(const OcclusionCuller& culler, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& modelViewProjection) {
+    if (!culler.active) {
+        return true;
+    }
+    // w is affine in position, so the nearest point of the box is one of its corners
+    glm::vec2 minimum(1e30f), maximum(-1e30f);
+    float nearestW = 1e30f;
+    int behind = 0;
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+        glm::vec4 clip = modelViewProjection * glm::vec4(corner, 1.0f);
+        if (clip.z < -clip.w) {
+            behind++;
+            continue;
+        }
+        minimum = glm::min(minimum, glm::vec2(clip) / clip.w);
+        maximum = glm::max(maximum, glm::vec2(clip) / clip.w);
+        nearestW = std::min(nearestW, clip.w);
+    }
+    if (behind > 0) {
+        return behind < 8;   // Wholly behind the viewer, or reaching past the near plane
+    }
+    if (maximum.x < -1.0f || maximum.y < -1.0f || minimum.x > 1.0f || minimum.y > 1.0f) {
+        return false;
+    }
+
+    // The level where the rectangle spans at most two texels each way
+    int x0 = std::clamp((int)((minimum.x * 0.5f + 0.5f) * OCCLUSION_WIDTH), 0, OCCLUSION_WIDTH - 1);
+    int x1 = std::clamp((int)((maximum.x * 0.5f + 0.5f) * OCCLUSION_WIDTH), 0, OCCLUSION_WIDTH - 1);
+    int y0 = std::clamp((int)((minimum.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT), 0, OCCLUSION_HEIGHT - 1);
+    int y1 = std::clamp((int)((maximum.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT), 0, OCCLUSION_HEIGHT - 1);
+    int level = 0;
+    while (level + 1 < OCCLUSION_LEVELS && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+        level++;
+    }
+    int width = OCCLUSION_WIDTH >> level;
+    const float* texels = culler.depth.data() + culler.levelOffset[level];
+    float farthest = 1e30f;
+    for (int y = y0 >> level; y <= y1 >> level; ++y) {
+        for (int x = x0 >> level; x <= x1 >> level; ++x) {
+            farthest = std::min(farthest, texels[y * width + x]);
+        }
+    }
+    return 1.0f / nearestW >= farthest;
+}
+
+void BindOcclusion(const OcclusionCuller& culler, const OcclusionSettings& settings, GLuint program, int unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, culler.hiZTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program, "uHiZ"), unit);
+    glUniform1i(glGetUniformLocation(program, "uOcclusion"), settings.enabled && culler.active);
+    glUniform1i(glGetUniformLocation(program, "uHiZLevels"), OCCLUSION_LEVELS);
+    glUniformMatrix4fv(glGetUniformLocation(program, "uOcclusionViewProjection"), 1, GL_FALSE, glm::value_ptr(culler.viewProjection));
+}
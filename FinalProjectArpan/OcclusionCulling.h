@@ -0,0 +1,90 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+// Software occlusion culling ahead of submission.
+// At load time every opaque scene mesh gets a simplified occluder: its vertices are clustered on
+// a coarse grid (Rossignac & Borrel 1993) and each cluster is pulled inside the surface along its
+// averaged normal by half a cell diagonal, so the occluder mostly hides a little less than the
+// mesh. It is not strictly conservative: thin parts and tight concave corners can still poke out.
+// Clusters whose normals disagree can't be pulled inside, so triangles touching them are left out.
+// Each frame the occluders that cover enough of the screen are rasterized on the CPU into a small
+// depth buffer holding 1/w of the nearest occluder. Triangles are transformed, near clipped and
+// binned into screen tiles across the thread pool, then each tile is filled by one task, four
+// pixels per SSE instruction. A hierarchical-Z pyramid keeps the farthest occluder depth of each
+// block, so a bounding box is tested by reading the 2x2 texels of the level its screen rectangle spans.
+// Scene meshes are tested here; the pyramid is uploaded for the forest's GPU cull pass.
+const int OCCLUSION_WIDTH = 320;
+const int OCCLUSION_HEIGHT = 192;
+const int OCCLUSION_LEVELS = 7;                     // Down to 5x3
+const int OCCLUSION_TILE_WIDTH = 64;                // Pixels, a multiple of 4
+const int OCCLUSION_TILE_HEIGHT = 32;
+const int OCCLUSION_TILES = (OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH) * (OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT);
+const int OCCLUSION_MAX_OCCLUDER_TRIANGLES = 1024;
+const int OCCLUSION_BATCH_TRIANGLES = 256;          // Triangles set up and binned per task
+
+struct OcclusionSettings {
+    bool enabled = true;
+    float minOccluderArea = 0.01f;   // Fraction of the screen an occluder's bounds must cover to be rasterized
+};
+
+struct Occluder {
+    int mesh = 0;
+    glm::vec3 boundsMin, boundsMax;
+    std::vector<glm::vec3> vertices;     // Mesh space
+    std::vector<unsigned int> indices;
+};
+
+// Edge functions and the 1/w plane of a screen space triangle, evaluated at pixel centers
+struct OcclusionTriangle {
+    glm::vec3 edges[3];                  // a * x + b * y + c >= 0 inside
+    glm::vec3 depth;
+    int minX, maxX, minY, maxY;          // Covered pixels
+};
+
+struct OcclusionBatch {
+    std::vector<OcclusionTriangle> triangles;
+    std::vector<int> tiles[OCCLUSION_TILES];   // Triangles overlapping each tile
+};
+
+struct OcclusionCuller {
+    std::vector<Occluder> occluders;
+    std::vector<glm::vec3> meshBoundsMin, meshBoundsMax;   // Every scene mesh, mesh space
+    std::vector<unsigned char> meshVisible;                // This frame's verdicts
+
+    std::vector<float> depth;            // Every pyramid level back to back, 0 where no occluder
+    int levelOffset[OCCLUSION_LEVELS] = {};
+    glm::mat4 viewProjection = glm::mat4(1.0f);            // That the pyramid was rasterized with
+    bool active = false;                 // The pyramid holds this frame's occluders
+
+    // Per frame working set
+    std::vector<int> drawn;              // Occluders rasterized
+    std::vector<int> vertexStart;        // Per drawn occluder, into clipVertices
+    std::vector<glm::vec4> clipVertices;
+    std::vector<glm::ivec3> jobs;        // Drawn occluder, first triangle, triangle count
+    std::vector<OcclusionBatch> batches; // One per job
+
+    GLuint hiZTexture = 0;               // R32F, one mip per pyramid level
+    int triangleCount = 0;               // Rasterized this frame, after clipping and back faces
+    int occludedMeshes = 0;
+    float milliseconds = 0.0f;           // CPU time of the whole stage
+};
+
+// Builds an occluder for every opaque mesh except the deformable ground
+bool InitOcclusion(OcclusionCuller& culler, const std::vector<Mesh>& meshes);
+void DestroyOcclusion(OcclusionCuller& culler);
+
+// Rasterizes this frame's occluders, builds and uploads the pyramid and tests the scene meshes,
+// which are drawn with 'model'; with culling disabled every mesh is visible
+void UpdateOcclusion(OcclusionCuller& culler, const OcclusionSettings& settings, ThreadPool& pool,
+    const glm::mat4& model, const glm::mat4& viewProjection);
+
+// False if the box is off screen or behind the occluders; modelViewProjection maps it to clip space
+bool IsBoxVisible(const OcclusionCuller& culler, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& modelViewProjection);
+
+// Binds the pyramid on a texture unit for GPU tests against it (see forest_cull.glsl)
+void BindOcclusion(const OcclusionCuller& culler, const OcclusionSettings& settings, GLuint program, int unit);
@@ -0,0 +1,144 @@
+#include "OcclusionQueries.h"
+#include "Shader.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+
+bool InitOcclusionQueries(OcclusionQueries& queries, const std::vector<Mesh>& meshes) {
+    queries.program = LoadShaderProgram("shaders/occlusion_box.glsl");
+    if (!queries.program) {
+        return false;
+    }
+    for (const Mesh& mesh : meshes) {
+        glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+        for (const Vertex& v : mesh.vertices) {
+            boundsMin = glm::min(boundsMin, glm::vec3(v.Position[0], v.Position[1], v.Position[2]));
+            boundsMax = glm::max(boundsMax, glm::vec3(v.Position[0], v.Position[1], v.Position[2]));
+        }
+        queries.boundsMin.push_back(boundsMin);
+        queries.boundsMax.push_back(boundsMax);
+        // The deformable ground is drawn as a displaced grid, not within its mesh's bounds
+        queries.triangles.push_back(mesh.deformableSnow || mesh.vertices.empty() ? 0 : (int)mesh.indices.size() / 3);
+    }
+    queries.queries.resize(meshes.size());
+    glGenQueries((GLsizei)queries.queries.size(), queries.queries.data());
+    queries.issued.assign(meshes.size(), 0);
+    queries.visible.assign(meshes.size(), 1);
+    queries.conditional.assign(meshes.size(), 0);
+
+    static const unsigned int box[] = {
+        0, 2, 6, 0, 6, 4,   1, 5, 7, 1, 7, 3,   // -x, +x
+        0, 4, 5, 0, 5, 1,   2, 3, 7, 2, 7, 6,   // -y, +y
+        0, 1, 3, 0, 3, 2,   4, 6, 7, 4, 7, 5,   // -z, +z
+    };
+    glGenVertexArrays(1, &queries.VAO);
+    glGenBuffers(1, &queries.EBO);
+    glBindVertexArray(queries.VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, queries.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(box), box, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    return true;
+}
+
+void DestroyOcclusionQueries(OcclusionQueries& queries) {
+    if (!queries.queries.empty()) {
+        glDeleteQueries((GLsizei)queries.queries.size(), queries.queries.data());
+    }
+    glDeleteVertexArrays(1, &queries.VAO);
+    glDeleteBuffers(1, &queries.EBO);
+    glDeleteProgram(queries.program);
+}
+
+static bool IsHeavy(const OcclusionQueries& queries, const OcclusionQuerySettings& settings, int mesh) {
+    return queries.triangles[mesh] > 0 && queries.triangles[mesh] >= settings.minTriangles;
+}
+
+// Mesh space box with the margin added
+static void MarginBounds(const OcclusionQueries& queries, const OcclusionQuerySettings& settings, int mesh,
+    glm::vec3& boundsMin, glm::vec3& boundsMax) {
+    glm::vec3 margin = (queries.boundsMax[mesh] - queries.boundsMin[mesh]) * settings.boundsMargin;
+    boundsMin = queries.boundsMin[mesh] - margin;
+    boundsMax = queries.boundsMax[mesh] + margin;
+}
+
+void BeginOcclusionQueries(OcclusionQueries& queries, const OcclusionQuerySettings& settings, const glm::mat4& model, const glm::mat4& view) {
+    std::fill(queries.conditional.begin(), queries.conditional.end(), 0);
+    queries.heavyMeshes = 0;
+    queries.hiddenMeshes = 0;
+    if (!settings.enabled) {
+        // Results go stale while off; start over when turned back on
+        std::fill(queries.issued.begin(), queries.issued.end(), 0);
+        std::fill(queries.visible.begin(), queries.visible.end(), 1);
+        return;
+    }
+    glm::vec3 eye = glm::vec3(glm::inverse(model) * glm::inverse(view)[3]);
+    for (int i = 0; i < (int)queries.queries.size(); ++i) {
+        if (!IsHeavy(queries, settings, i)) {
+            continue;
+        }
+        queries.heavyMeshes++;
+        if (queries.issued[i]) {
+            GLint available = 0;
+            glGetQueryObjectiv(queries.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLint anySamples = 0;
+                glGetQueryObjectiv(queries.queries[i], GL_QUERY_RESULT, &anySamples);
+                queries.visible[i] = anySamples != 0;
+            }
+        }
+        queries.hiddenMeshes += !queries.visible[i];
+        glm::vec3 boundsMin, boundsMax;
+        MarginBounds(queries, settings, i, boundsMin, boundsMax);
+        bool inside = glm::all(glm::greaterThanEqual(eye, boundsMin)) && glm::all(glm::lessThanEqual(eye, boundsMax));
+        queries.conditional[i] = queries.issued[i] && !inside;
+    }
+}
+
+void BeginConditionalMesh(const OcclusionQueries& queries, int mesh) {
+    if (queries.conditional[mesh]) {
+        glBeginConditionalRender(queries.queries[mesh], GL_QUERY_NO_WAIT);
+    }
+}
+
+void EndConditionalMesh(const OcclusionQueries& queries, int mesh) {
+    if (queries.conditional[mesh]) {
+        glEndConditionalRender();
+    }
+}
+
+void IssueOcclusionQueries(OcclusionQueries& queries, const OcclusionQuerySettings& settings, const glm::mat4& model, const glm::mat4& viewProjection) {
+    queries.issuedQueries = 0;
+    if (!settings.enabled) {
+        return;
+    }
+    glm::mat4 modelViewProjection = viewProjection * model;
+    glUseProgram(queries.program);
+    glUniformMatrix4fv(glGetUniformLocation(queries.program, "uModelViewProjection"), 1, GL_FALSE, glm::value_ptr(modelViewProjection));
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_DEPTH_TEST);
+    glBindVertexArray(queries.VAO);
+    int interval = std::max(settings.visibleInterval, 1);
+    for (int i = 0; i < (int)queries.queries.size(); ++i) {
+        if (!IsHeavy(queries, settings, i)) {
+            queries.issued[i] = 0;
+            continue;
+        }
+        // A visible mesh's last result still says visible, so it can wait for its turn
+        if (queries.issued[i] && queries.visible[i] && (queries.frame + i) % interval != 0) {
+            continue;
+        }
+        glm::vec3 boundsMin, boundsMax;
+        MarginBounds(queries, settings, i, boundsMin, boundsMax);
+        glUniform3fv(glGetUniformLocation(queries.program, "uBoundsMin"), 1, glm::value_ptr(boundsMin));
+        glUniform3fv(glGetUniformLocation(queries.program, "uBoundsMax"), 1, glm::value_ptr(boundsMax));
+        glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, queries.queries[i]);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+        queries.issued[i] = 1;
+        queries.issuedQueries++;
+    }
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    queries.frame++;
+}
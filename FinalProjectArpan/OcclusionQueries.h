@@ -0,0 +1,49 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Mesh.h"
+
+// Hardware occlusion queries for the scene's heavy meshes, the GPU-side counterpart of OcclusionCulling.
+// Once the opaque pass has filled the depth buffer, each heavy mesh's bounding box is drawn with
+// color and depth writes off inside an any-samples-passed query. The next frame draws the mesh
+// under glBeginConditionalRender on that query with GL_QUERY_NO_WAIT: the GPU skips the draw
+// when no sample of the box passed, and draws it when the result is not in yet, so the CPU
+// never waits. Results are read back only when already available, to schedule the next queries:
+// meshes that were visible keep their last result and are re-queried every few frames, staggered,
+// while hidden ones are queried every frame so they reappear one frame late at most.
+// Meshes whose box contains the eye are drawn unconditionally.
+struct OcclusionQuerySettings {
+    bool enabled = true;
+    int minTriangles = 5000;       // Meshes with fewer triangles are always drawn
+    int visibleInterval = 4;       // Frames between queries for meshes last seen visible
+    float boundsMargin = 0.05f;    // Box growth, relative to its size, so motion uncovers meshes a little early
+};
+
+struct OcclusionQueries {
+    std::vector<GLuint> queries;                  // One per scene mesh
+    std::vector<glm::vec3> boundsMin, boundsMax;  // Mesh space
+    std::vector<int> triangles;
+    std::vector<unsigned char> issued;            // The query holds a result for this mesh
+    std::vector<unsigned char> visible;           // Last result read back
+    std::vector<unsigned char> conditional;       // This frame's draw waits on the query
+    GLuint VAO = 0, EBO = 0;                      // Box corners come from gl_VertexID
+    GLuint program = 0;
+    int frame = 0;
+    int heavyMeshes = 0, issuedQueries = 0, hiddenMeshes = 0;
+};
+
+bool InitOcclusionQueries(OcclusionQueries& queries, const std::vector<Mesh>& meshes);
+void DestroyOcclusionQueries(OcclusionQueries& queries);
+
+// Before the scene meshes: reads the results that are ready and picks the conditional draws.
+// model is the scene meshes' transform.
+void BeginOcclusionQueries(OcclusionQueries& queries, const OcclusionQuerySettings& settings, const glm::mat4& model, const glm::mat4& view);
+
+// Around a scene mesh's draw calls
+void BeginConditionalMesh(const OcclusionQueries& queries, int mesh);
+void EndConditionalMesh(const OcclusionQueries& queries, int mesh);
+
+// After the opaque pass, into the bound scene target: queries the heavy meshes' boxes for next frame
+void IssueOcclusionQueries(OcclusionQueries& queries, const OcclusionQuerySettings& settings, const glm::mat4& model, const glm::mat4& viewProjection);
@@ -0,0 +1,116 @@
+#include "OffscreenParticles.h"
+#include "Shader.h"
+#include <iostream>
+#include <algorithm>
+
+static GLuint CreateTarget(GLenum format, int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+static void DestroyTargets(OffscreenParticles& op) {
+    glDeleteFramebuffers(1, &op.fbo);
+    glDeleteTextures(1, &op.colorTexture);
+    glDeleteTextures(1, &op.depthTexture);
+    op.fbo = op.colorTexture = op.depthTexture = 0;
+    op.fullWidth = op.fullHeight = op.divisor = 0;
+}
+
+// (Re)creates the reduced resolution target when the scene size or divisor changes
+static void EnsureTargets(OffscreenParticles& op, int fullWidth, int fullHeight, int divisor) {
+    if (op.fullWidth == fullWidth && op.fullHeight == fullHeight && op.divisor == divisor) {
+        return;
+    }
+    DestroyTargets(op);
+    op.fullWidth = fullWidth;
+    op.fullHeight = fullHeight;
+    op.divisor = divisor;
+    op.width = std::max(1, (fullWidth + divisor - 1) / divisor);
+    op.height = std::max(1, (fullHeight + divisor - 1) / divisor);
+
+    op.colorTexture = CreateTarget(GL_RGBA16F, op.width, op.height);
+    op.depthTexture = CreateTarget(GL_DEPTH_COMPONENT32F, op.width, op.height);
+    glGenFramebuffers(1, &op.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, op.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, op.colorTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, op.depthTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "ERROR::FRAMEBUFFER::PARTICLE_TARGET_INCOMPLETE" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool InitOffscreenParticles(OffscreenParticles& op) {
+    op.depthDownsampleProgram = LoadShaderProgram("shaders/particle_depth_downsample.glsl");
+    op.compositeProgram = LoadShaderProgram("shaders/particle_composite.glsl");
+    return op.depthDownsampleProgram && op.compositeProgram;
+}
+
+void DestroyOffscreenParticles(OffscreenParticles& op) {
+    DestroyTargets(op);
+    glDeleteProgram(op.depthDownsampleProgram);
+    glDeleteProgram(op.compositeProgram);
+}
+
+void BeginOffscreenParticles(OffscreenParticles& op, const PostProcess& pp, int divisor) {
+    EnsureTargets(op, pp.width, pp.height, std::max(1, divisor));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, op.fbo);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glViewport(0, 0, op.width, op.height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // Farthest depth of each block, written through gl_FragDepth
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glUseProgram(op.depthDownsampleProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pp.depthTexture);
+    glUniform1i(glGetUniformLocation(op.depthDownsampleProgram, "uDepth"), 0);
+    glUniform1i(glGetUniformLocation(op.depthDownsampleProgram, "uDivisor"), op.divisor);
+    DrawFullscreenTriangle(pp);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthFunc(GL_LESS);
+
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void CompositeOffscreenParticles(const OffscreenParticles& op, const PostProcess& pp, const glm::mat4& projection) {
+    glDepthMask(GL_TRUE);
+    glDisable(GL_DEPTH_TEST);
+
+    // Premultiplied "over" onto the scene color
+    glBindFramebuffer(GL_FRAMEBUFFER, pp.hdrFBO);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glViewport(0, 0, pp.width, pp.height);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(op.compositeProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, op.colorTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, op.depthTexture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, pp.depthTexture);
+    glUniform1i(glGetUniformLocation(op.compositeProgram, "uParticles"), 0);
+    glUniform1i(glGetUniformLocation(op.compositeProgram, "uLowDepth"), 1);
+    glUniform1i(glGetUniformLocation(op.compositeProgram, "uDepth"), 2);
+    glUniform1i(glGetUniformLocation(op.compositeProgram, "uDivisor"), op.divisor);
+    glUniform2f(glGetUniformLocation(op.compositeProgram, "uDepthParams"), projection[2][2], projection[3][2]);
+    DrawFullscreenTriangle(pp);
+    glDisable(GL_BLEND);
+
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_DEPTH_TEST);
+}
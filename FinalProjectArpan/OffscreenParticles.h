@@ -0,0 +1,33 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "PostProcess.h"
+
+// Low resolution offscreen target for fill-rate bound particles.
+// The scene depth is downsampled (keeping the farthest depth of each block) into the target's
+// depth buffer, particles blend into it with premultiplied alpha, and a nearest-depth upsample
+// composites them over the HDR color so they stay sharp against silhouettes.
+// Each emitter chooses its own divisor: 1 draws straight into the scene, 2 or 4 use this target.
+struct OffscreenParticles {
+    int fullWidth = 0, fullHeight = 0;
+    int divisor = 0;
+    int width = 0, height = 0;
+
+    GLuint fbo = 0;
+    GLuint colorTexture = 0;   // RGBA16F premultiplied particle color and coverage
+    GLuint depthTexture = 0;   // Downsampled scene depth, depth tested but not written by particles
+
+    GLuint depthDownsampleProgram = 0;
+    GLuint compositeProgram = 0;
+};
+
+bool InitOffscreenParticles(OffscreenParticles& op);
+void DestroyOffscreenParticles(OffscreenParticles& op);
+
+// Downsamples depth, binds and clears the low resolution target and sets premultiplied blending.
+// Particle shaders drawn after this should output premultiplied color with coverage in alpha.
+void BeginOffscreenParticles(OffscreenParticles& op, const PostProcess& pp, int divisor);
+
+// Depth-aware upsample of the particles onto the HDR scene color
+void CompositeOffscreenParticles(const OffscreenParticles& op, const PostProcess& pp, const glm::mat4& projection);
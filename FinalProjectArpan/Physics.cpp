@@ -0,0 +1,881 @@
+#include "Physics.h"
+#include "Shader.h"
+#include "VertexFormat.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <xmmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+const float PHYSICS_MARGIN = 0.02f;        // Contacts are made this far ahead of touching
+const float PHYSICS_SLOP = 0.005f;         // Penetration left alone, so resting contacts don't jitter
+const float PHYSICS_BAUMGARTE = 0.2f;      // Share of the remaining penetration pushed out per step
+
+static void UploadMesh(Mesh& mesh) {
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glGenBuffers(1, &mesh.EBO);
+    glBindVertexArray(mesh.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(Vertex), mesh.vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+    SetupVertexAttributes<FloatVertexLayout>();
+    glBindVertexArray(0);
+}
+
+static Mesh EmptyMesh(GLuint texture) {
+    Mesh mesh = {};
+    mesh.textureID = texture;
+    mesh.emissive = glm::vec3(0.0f);
+    mesh.opacity = 1.0f;
+    mesh.deformableSnow = false;
+    return mesh;
+}
+
+static void PushVertex(Mesh& mesh, const glm::vec3& position, const glm::vec3& normal, const glm::vec2& texCoords) {
+    Vertex v;
+    v.Position[0] = position.x; v.Position[1] = position.y; v.Position[2] = position.z;
+    v.Normal[0] = normal.x; v.Normal[1] = normal.y; v.Normal[2] = normal.z;
+    v.TexCoords[0] = texCoords.x; v.TexCoords[1] = texCoords.y;
+    mesh.vertices.push_back(v);
+}
+
+// The [-1, 1] cube under 'transform', one textured quad per face
+static void AddBox(Mesh& mesh, const glm::mat4& transform) {
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int side = -1; side <= 1; side += 2) {
+            glm::vec3 n(0.0f), u(0.0f), v(0.0f);
+            n[axis] = (float)side;
+            u[(axis + 1) % 3] = 1.0f;
+            v[(axis + 2) % 3] = 1.0f;
+            if (side < 0) {
+                std::swap(u, v);    // Keeps the winding counter-clockwise from outside
+            }
+            glm::vec3 corners[4] = { n - u - v, n + u - v, n + u + v, n - u + v };
+            for (glm::vec3& corner : corners) {
+                corner = glm::vec3(transform * glm::vec4(corner, 1.0f));
+            }
+            glm::vec3 normal = glm::normalize(glm::cross(corners[1] - corners[0], corners[3] - corners[0]));
+            unsigned int base = (unsigned int)mesh.vertices.size();
+            const glm::vec2 texCoords[4] = { glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f) };
+            for (int k = 0; k < 4; ++k) {
+                PushVertex(mesh, corners[k], normal, texCoords[k]);
+            }
+            mesh.indices.insert(mesh.indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+        }
+    }
+}
+
+static Mesh BuildSphereMesh(float radius, GLuint texture) {
+    const int slices = 16, stacks = 12;
+    Mesh mesh = EmptyMesh(texture);
+    for (int j = 0; j <= stacks; ++j) {
+        float polar = (float)j / stacks * glm::pi<float>();
+        for (int i = 0; i <= slices; ++i) {
+            float azimuth = (float)i / slices * glm::two_pi<float>();
+            glm::vec3 normal(std::sin(polar) * std::cos(azimuth), std::cos(polar), std::sin(polar) * std::sin(azimuth));
+            PushVertex(mesh, normal * radius, normal, glm::vec2((float)i / slices, (float)j / stacks));
+        }
+    }
+    for (int j = 0; j < stacks; ++j) {
+        for (int i = 0; i < slices; ++i) {
+            unsigned int a = j * (slices + 1) + i, b = a + slices + 1;
+            mesh.indices.insert(mesh.indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+        }
+    }
+    return mesh;
+}
+
+static Mesh BuildGiftMesh(glm::vec3 halfExtents, bool bow, GLuint texture) {
+    Mesh mesh = EmptyMesh(texture);
+    AddBox(mesh, glm::scale(glm::mat4(1.0f), halfExtents));
+    if (bow) {
+        // Two loops leaning apart and a knot between them
+        float s = std::min(halfExtents.x, halfExtents.z);
+        for (int side = -1; side <= 1; side += 2) {
+            glm::mat4 loop = glm::translate(glm::mat4(1.0f), glm::vec3(side * 0.2f * s, halfExtents.y + 0.16f * s, 0.0f)) *
+                glm::rotate(glm::mat4(1.0f), side * glm::radians(-40.0f), glm::vec3(0.0f, 0.0f, 1.0f)) *
+                glm::scale(glm::mat4(1.0f), glm::vec3(0.22f * s, 0.04f * s, 0.14f * s));
+            AddBox(mesh, loop);
+        }
+        AddBox(mesh, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, halfExtents.y + 0.06f * s, 0.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.07f * s)));
+    }
+    return mesh;
+}
+
+bool InitPhysics(PhysicsWorld& world, Terrain& terrain, const TerrainSettings& terrainSettings, float extent) {
+    world.program = LoadShaderProgram("shaders/physics.glsl");
+    InitGpuTimer(world.timer);
+    if (!world.program) {
+        return false;
+    }
+    BuildTerrainHeightCache(world.ground, terrain, terrainSettings, extent, PHYSICS_HEIGHT_SIZE);
+    glGenBuffers(1, &world.instanceBuffer);
+    world.bodies.reserve(PHYSICS_MAX_BODIES);
+    return true;
+}
+
+void DestroyPhysics(PhysicsWorld& world) {
+    for (PhysicsShape& shape : world.shapes) {
+        if (shape.ownsMesh) {
+            glDeleteVertexArrays(1, &shape.mesh.VAO);
+            glDeleteBuffers(1, &shape.mesh.VBO);
+            glDeleteBuffers(1, &shape.mesh.EBO);
+        }
+    }
+    world.shapes.clear();
+    world.bodies.clear();
+    glDeleteBuffers(1, &world.instanceBuffer);
+    glDeleteProgram(world.program);
+    DestroyGpuTimer(world.timer);
+}
+
+int AddPhysicsShape(PhysicsWorld& world, const Mesh& mesh, int type, float scale) {
+    if (mesh.vertices.empty()) {
+        return -1;
+    }
+    PhysicsShape shape;
+    shape.type = type;
+    shape.mesh = mesh;
+    shape.meshScale = scale;
+
+    // Center of mass at the middle of the bounds
+    glm::vec3 lo(1e30f), hi(-1e30f);
+    for (const Vertex& v : mesh.vertices) {
+        glm::vec3 p = glm::vec3(v.Position[0], v.Position[1], v.Position[2]) * scale;
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    shape.center = (lo + hi) * 0.5f;
+    glm::vec3 h = (hi - lo) * 0.5f;
+    shape.halfExtents = h;
+    for (const Vertex& v : mesh.vertices) {
+        shape.radius = std::max(shape.radius, glm::length(glm::vec3(v.Position[0], v.Position[1], v.Position[2]) * scale - shape.center));
+    }
+
+    if (type == SHAPE_SPHERE) {
+        shape.halfExtents = glm::vec3(shape.radius);
+        shape.inertia = glm::vec3(0.4f * shape.radius * shape.radius);
+    }
+    else {
+        // A solid box's, for hulls too
+        shape.inertia = glm::vec3(h.y * h.y + h.z * h.z, h.x * h.x + h.z * h.z, h.x * h.x + h.y * h.y) / 3.0f;
+    }
+    if (type == SHAPE_BOX) {
+        for (int i = 0; i < 8; ++i) {
+            shape.points.push_back(h * glm::vec3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f));
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            glm::vec3 n(0.0f);
+            n[axis] = 1.0f;
+            shape.planes.push_back(glm::vec4(n, h[axis]));
+            shape.planes.push_back(glm::vec4(-n, h[axis]));
+        }
+    }
+    else if (type == SHAPE_HULL) {
+        // 26-DOP: the face, edge and corner directions of a cube
+        for (int x = -1; x <= 1; ++x) {
+            for (int y = -1; y <= 1; ++y) {
+                for (int z = -1; z <= 1; ++z) {
+                    if (x == 0 && y == 0 && z == 0) {
+                        continue;
+                    }
+                    glm::vec3 direction = glm::normalize(glm::vec3(x, y, z));
+                    float extent = -1e30f;
+                    glm::vec3 support(0.0f);
+                    for (const Vertex& v : mesh.vertices) {
+                        glm::vec3 p = glm::vec3(v.Position[0], v.Position[1], v.Position[2]) * scale - shape.center;
+                        float d = glm::dot(direction, p);
+                        if (d > extent) {
+                            extent = d;
+                            support = p;
+                        }
+                    }
+                    shape.planes.push_back(glm::vec4(direction, extent));
+                    bool known = std::any_of(shape.points.begin(), shape.points.end(),
+                        [&](const glm::vec3& p) { return glm::distance(p, support) < 1e-4f; });
+                    if (!known) {
+                        shape.points.push_back(support);
+                    }
+                }
+            }
+        }
+    }
+    world.shapes.push_back(std::move(shape));
+    return (int)world.shapes.size() - 1;
+}
+
+int AddSphereShape(PhysicsWorld& world, float radius, GLuint texture) {
+    Mesh mesh = BuildSphereMesh(radius, texture);
+    UploadMesh(mesh);
+    int shape = AddPhysicsShape(world, mesh, SHAPE_SPHERE);
+    world.shapes[shape].ownsMesh = true;
+    return shape;
+}
+
+int AddGiftShape(PhysicsWorld& world, glm::vec3 halfExtents, bool bow, GLuint texture) {
+    Mesh mesh = BuildGiftMesh(halfExtents, bow, texture);
+    UploadMesh(mesh);
+    int shape = AddPhysicsShape(world, mesh, bow ? SHAPE_HULL : SHAPE_BOX);
+    world.shapes[shape].ownsMesh = true;
+    return shape;
+}
+
+// Drops last step's impulses on a body slot about to be reused, so the new body isn't warm
+// started with its predecessor's contacts. Keys hold a + 1 from bit 40 and b from bit 16, see ContactKey.
+static void ForgetCachedImpulses(PhysicsWorld& world, int index) {
+    auto touches = [index](const CachedImpulse& cached) {
+        return (int)(cached.key >> 40) - 1 == index || (int)((cached.key >> 16) & 0xffffff) == index;
+    };
+    world.cachedImpulses.erase(std::remove_if(world.cachedImpulses.begin(), world.cachedImpulses.end(), touches), world.cachedImpulses.end());
+}
+
+int AddRigidBody(PhysicsWorld& world, int shape, float mass, const glm::vec3& position, const glm::quat& orientation,
+    const glm::vec3& linearVelocity, const glm::vec3& angularVelocity) {
+    if (shape < 0 || shape >= (int)world.shapes.size()) {
+        return -1;
+    }
+    int index;
+    if ((int)world.bodies.size() < PHYSICS_MAX_BODIES) {
+        index = (int)world.bodies.size();
+        world.bodies.push_back(RigidBody());
+        world.order.push_back(index);
+        world.drawnTransforms.push_back(glm::mat4(1.0f));
+    }
+    else {
+        index = world.oldestBody;
+        world.oldestBody = (world.oldestBody + 1) % PHYSICS_MAX_BODIES;
+        ForgetCachedImpulses(world, index);
+    }
+    RigidBody& body = world.bodies[index];
+    body = RigidBody();
+    body.shape = shape;
+    body.position = body.prevPosition = position;
+    body.orientation = body.prevOrientation = glm::normalize(orientation);
+    body.linearVelocity = linearVelocity;
+    body.angularVelocity = angularVelocity;
+    body.inverseMass = 1.0f / mass;
+    body.inverseInertia = 1.0f / (world.shapes[shape].inertia * mass);
+    return index;
+}
+
+static float GroundHeight(const PhysicsWorld& world, float x, float z) {
+    return SampleTerrainHeightCache(world.ground, x, z);
+}
+
+static glm::vec3 GroundNormal(const PhysicsWorld& world, float x, float z) {
+    float e = world.ground.spacing;
+    float dx = GroundHeight(world, x + e, z) - GroundHeight(world, x - e, z);
+    float dz = GroundHeight(world, x, z + e) - GroundHeight(world, x, z - e);
+    return glm::normalize(glm::vec3(-dx, 2.0f * e, -dz));
+}
+
+static void ComputeBounds(PhysicsWorld& world, int i) {
+    const RigidBody& body = world.bodies[i];
+    const PhysicsShape& shape = world.shapes[body.shape];
+    glm::vec3 extent = glm::vec3(shape.radius);
+    if (shape.type != SHAPE_SPHERE) {
+        glm::mat3 rotation = glm::mat3_cast(body.orientation);
+        extent = glm::abs(rotation[0]) * shape.halfExtents.x + glm::abs(rotation[1]) * shape.halfExtents.y + glm::abs(rotation[2]) * shape.halfExtents.z;
+    }
+    extent += PHYSICS_MARGIN;
+    world.boundsMin[i] = body.position - extent;
+    world.boundsMax[i] = body.position + extent;
+}
+
+// Keeps the deepest PHYSICS_MAX_MANIFOLD contacts
+static void KeepContact(PhysicsContact* manifold, int& count, const PhysicsContact& contact) {
+    if (count < PHYSICS_MAX_MANIFOLD) {
+        manifold[count++] = contact;
+        return;
+    }
+    int shallowest = 0;
+    for (int k = 1; k < PHYSICS_MAX_MANIFOLD; ++k) {
+        shallowest = manifold[k].depth < manifold[shallowest].depth ? k : shallowest;
+    }
+    if (contact.depth > manifold[shallowest].depth) {
+        manifold[shallowest] = contact;
+    }
+}
+
+static PhysicsContact MakeContact(int a, int b, int feature, const glm::vec3& point, const glm::vec3& normal, float depth) {
+    PhysicsContact contact;
+    contact.a = a;
+    contact.b = b;
+    contact.feature = feature;
+    contact.point = point;
+    contact.normal = normal;
+    contact.depth = depth;
+    return contact;
+}
+
+static void SphereSphere(const PhysicsWorld& world, int a, int b, PhysicsContact* manifold, int& count) {
+    const RigidBody& A = world.bodies[a];
+    const RigidBody& B = world.bodies[b];
+    float rA = world.shapes[A.shape].radius, rB = world.shapes[B.shape].radius;
+    glm::vec3 d = B.position - A.position;
+    float distance = glm::length(d);
+    float separation = distance - rA - rB;
+    if (separation > PHYSICS_MARGIN) {
+        return;
+    }
+    glm::vec3 normal = distance > 1e-6f ? d / distance : glm::vec3(0.0f, 1.0f, 0.0f);
+    KeepContact(manifold, count, MakeContact(a, b, 0, A.position + normal * (rA + 0.5f * separation), normal, -separation));
+}
+
+static void SpherePolytope(const PhysicsWorld& world, int sphere, int polytope, PhysicsContact* manifold, int& count) {
+    const RigidBody& S = world.bodies[sphere];
+    const RigidBody& P = world.bodies[polytope];
+    const PhysicsShape& shape = world.shapes[P.shape];
+    float radius = world.shapes[S.shape].radius;
+    glm::vec3 center = glm::conjugate(P.orientation) * (S.position - P.position);
+
+    glm::vec3 normal, surface;      // Local, pointing out of the polytope toward the sphere
+    float separation;
+    if (shape.type == SHAPE_BOX) {
+        glm::vec3 h = shape.halfExtents;
+        glm::vec3 closest = glm::clamp(center, -h, h);
+        glm::vec3 d = center - closest;
+        float distance = glm::length(d);
+        if (distance > 1e-6f) {
+            normal = d / distance;
+            separation = distance - radius;
+            surface = closest;
+        }
+        else {
+            // Center inside: out through the nearest face
+            glm::vec3 room = h - glm::abs(center);
+            int axis = room.x < room.y ? (room.x < room.z ? 0 : 2) : (room.y < room.z ? 1 : 2);
+            normal = glm::vec3(0.0f);
+            normal[axis] = center[axis] < 0.0f ? -1.0f : 1.0f;
+            separation = -room[axis] - radius;
+            surface = center + normal * room[axis];
+        }
+    }
+    else {
+        // Least separated plane: exact over faces, a little early near edges and corners
+        float best = -1e30f;
+        int plane = 0;
+        for (int k = 0; k < (int)shape.planes.size(); ++k) {
+            float s = glm::dot(glm::vec3(shape.planes[k]), center) - shape.planes[k].w;
+            if (s > best) {
+                best = s;
+                plane = k;
+            }
+        }
+        normal = glm::vec3(shape.planes[plane]);
+        separation = best - radius;
+        surface = center - normal * best;
+    }
+    if (separation > PHYSICS_MARGIN) {
+        return;
+    }
+    KeepContact(manifold, count, MakeContact(sphere, polytope, 0, P.position + P.orientation * surface, -(P.orientation * normal), -separation));
+}
+
+// Vertices of 'from' against the planes of 'into'; 'sign' turns into's outward normal into a to b
+static void VerticesAgainstPlanes(const PhysicsWorld& world, int a, int b, int from, int into, float sign, PhysicsContact* manifold, int& count) {
+    const RigidBody& F = world.bodies[from];
+    const RigidBody& I = world.bodies[into];
+    const PhysicsShape& fromShape = world.shapes[F.shape];
+    const PhysicsShape& intoShape = world.shapes[I.shape];
+    glm::quat inverse = glm::conjugate(I.orientation);
+    glm::quat relative = inverse * F.orientation;
+    glm::vec3 offset = inverse * (F.position - I.position);
+    glm::vec3 reach = intoShape.halfExtents + PHYSICS_MARGIN;
+    for (int p = 0; p < (int)fromShape.points.size(); ++p) {
+        glm::vec3 local = relative * fromShape.points[p] + offset;
+        if (glm::any(glm::greaterThan(glm::abs(local), reach))) {
+            continue;
+        }
+        float best = -1e30f;
+        int plane = 0;
+        for (int k = 0; k < (int)intoShape.planes.size() && best <= PHYSICS_MARGIN; ++k) {
+            float s = glm::dot(glm::vec3(intoShape.planes[k]), local) - intoShape.planes[k].w;
+            if (s > best) {
+                best = s;
+                plane = k;
+            }
+        }
+        if (best > PHYSICS_MARGIN) {
+            continue;
+        }
+        KeepContact(manifold, count, MakeContact(a, b, from == a ? p : 256 + p, I.position + I.orientation * local, sign * (I.orientation * glm::vec3(intoShape.planes[plane])), -best));
+    }
+}
+
+static void PairContacts(const PhysicsWorld& world, int a, int b, PhysicsContact* manifold, int& count) {
+    const RigidBody& A = world.bodies[a];
+    const RigidBody& B = world.bodies[b];
+    const PhysicsShape& shapeA = world.shapes[A.shape];
+    const PhysicsShape& shapeB = world.shapes[B.shape];
+    float reach = shapeA.radius + shapeB.radius + PHYSICS_MARGIN;
+    glm::vec3 d = B.position - A.position;
+    if (glm::dot(d, d) > reach * reach) {
+        return;
+    }
+    bool sphereA = shapeA.type == SHAPE_SPHERE, sphereB = shapeB.type == SHAPE_SPHERE;
+    if (sphereA && sphereB) {
+        SphereSphere(world, a, b, manifold, count);
+    }
+    else if (sphereA) {
+        SpherePolytope(world, a, b, manifold, count);
+    }
+    else if (sphereB) {
+        SpherePolytope(world, b, a, manifold, count);
+    }
+    else {
+        VerticesAgainstPlanes(world, a, b, a, b, -1.0f, manifold, count);
+        VerticesAgainstPlanes(world, a, b, b, a, 1.0f, manifold, count);
+    }
+}
+
+static void GroundContacts(const PhysicsWorld& world, int i, PhysicsContact* manifold, int& count) {
+    const RigidBody& body = world.bodies[i];
+    const PhysicsShape& shape = world.shapes[body.shape];
+    const glm::vec3& lo = world.boundsMin[i];
+    const glm::vec3& hi = world.boundsMax[i];
+    float top = std::max(std::max(GroundHeight(world, lo.x, lo.z), GroundHeight(world, hi.x, lo.z)),
+        std::max(GroundHeight(world, lo.x, hi.z), GroundHeight(world, hi.x, hi.z)));
+    if (lo.y > std::max(top, GroundHeight(world, body.position.x, body.position.z)) + PHYSICS_MARGIN) {
+        return;
+    }
+    glm::vec3 normal = GroundNormal(world, body.position.x, body.position.z);
+    if (shape.type == SHAPE_SPHERE) {
+        float separation = (body.position.y - GroundHeight(world, body.position.x, body.position.z)) * normal.y - shape.radius;
+        if (separation <= PHYSICS_MARGIN) {
+            KeepContact(manifold, count, MakeContact(-1, i, 0, body.position - normal * shape.radius, normal, -separation));
+        }
+        return;
+    }
+    for (int k = 0; k < (int)shape.points.size(); ++k) {
+        glm::vec3 p = body.position + body.orientation * shape.points[k];
+        float separation = (p.y - GroundHeight(world, p.x, p.z)) * normal.y;
+        if (separation <= PHYSICS_MARGIN) {
+            KeepContact(manifold, count, MakeContact(-1, i, k, p, normal, -separation));
+        }
+    }
+}
+
+// Insertion sort on bounds min x, then a sweep that stops at the first body starting past the
+// current one's max x. Candidates are checked four at a time on the other two axes.
+static void SortAndSweep(PhysicsWorld& world) {
+    int n = (int)world.bodies.size();
+    std::vector<int>& order = world.order;
+    for (int s = 1; s < n; ++s) {
+        int body = order[s];
+        float key = world.boundsMin[body].x;
+        int t = s;
+        for (; t > 0 && world.boundsMin[order[t - 1]].x > key; --t) {
+            order[t] = order[t - 1];
+        }
+        order[t] = body;
+    }
+    for (std::vector<float>& axis : world.sweep) {
+        axis.assign(n + 4, 1e30f);      // Padding never overlaps
+    }
+    for (int s = 0; s < n; ++s) {
+        const glm::vec3& lo = world.boundsMin[order[s]];
+        const glm::vec3& hi = world.boundsMax[order[s]];
+        world.sweep[0][s] = lo.x; world.sweep[1][s] = hi.x;
+        world.sweep[2][s] = lo.y; world.sweep[3][s] = hi.y;
+        world.sweep[4][s] = lo.z; world.sweep[5][s] = hi.z;
+    }
+
+    world.pairs.clear();
+    const float* minX = world.sweep[0].data();
+    const float* minY = world.sweep[2].data();
+    const float* maxY = world.sweep[3].data();
+    const float* minZ = world.sweep[4].data();
+    const float* maxZ = world.sweep[5].data();
+    for (int s = 0; s < n; ++s) {
+        __m128 maxX = _mm_set1_ps(world.sweep[1][s]);
+        __m128 loY = _mm_set1_ps(minY[s]), hiY = _mm_set1_ps(maxY[s]);
+        __m128 loZ = _mm_set1_ps(minZ[s]), hiZ = _mm_set1_ps(maxZ[s]);
+        bool asleep = world.bodies[order[s]].asleep;
+        for (int t = s + 1; t < n; t += 4) {
+            __m128 started = _mm_cmple_ps(_mm_loadu_ps(minX + t), maxX);
+            if (_mm_movemask_ps(started) == 0) {
+                break;
+            }
+            __m128 overlapY = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minY + t), hiY), _mm_cmpge_ps(_mm_loadu_ps(maxY + t), loY));
+            __m128 overlapZ = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minZ + t), hiZ), _mm_cmpge_ps(_mm_loadu_ps(maxZ + t), loZ));
+            int mask = _mm_movemask_ps(_mm_and_ps(started, _mm_and_ps(overlapY, overlapZ)));
+            for (int k = 0; mask != 0; ++k, mask >>= 1) {
+                int other = order[t + k];
+                if ((mask & 1) && !(asleep && world.bodies[other].asleep)) {
+                    world.pairs.push_back(glm::ivec2(order[s], other));
+                }
+            }
+        }
+    }
+}
+
+static int FindIsland(std::vector<int>& parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// Joins bodies that touch and groups the awake islands' bodies and contacts, waking any sleeping
+// body something awake ran into
+static void BuildIslands(PhysicsWorld& world) {
+    int n = (int)world.bodies.size();
+    std::vector<int>& parent = world.islandOf;
+    parent.resize(n);
+    for (int i = 0; i < n; ++i) {
+        parent[i] = i;
+    }
+
+    // Compact the manifolds in place
+    int contactCount = 0;
+    for (int slot = 0; slot < (int)world.pairContactCount.size(); ++slot) {
+        for (int k = 0; k < world.pairContactCount[slot]; ++k) {
+            const PhysicsContact& contact = world.pairContacts[slot * PHYSICS_MAX_MANIFOLD + k];
+            if (contact.a >= 0) {
+                parent[FindIsland(parent, contact.a)] = FindIsland(parent, contact.b);
+            }
+            world.pairContacts[contactCount++] = contact;
+        }
+    }
+
+    std::vector<int> root(n), islandOfRoot(n, -1);
+    std::vector<char> awake(n, 0);
+    for (int i = 0; i < n; ++i) {
+        root[i] = FindIsland(parent, i);
+        awake[root[i]] |= !world.bodies[i].asleep;
+    }
+    int islandCount = 0;
+    for (int i = 0; i < n; ++i) {
+        if (awake[root[i]] && islandOfRoot[root[i]] < 0) {
+            islandOfRoot[root[i]] = islandCount++;
+        }
+    }
+    world.islandBodyStart.assign(islandCount + 1, 0);
+    world.islandContactStart.assign(islandCount + 1, 0);
+    for (int i = 0; i < n; ++i) {
+        int island = islandOfRoot[root[i]];
+        parent[i] = island;     // From here on, the island of each body
+        if (island >= 0) {
+            world.bodies[i].asleep = false;
+            world.islandBodyStart[island + 1]++;
+        }
+    }
+    for (int k = 0; k < contactCount; ++k) {
+        int island = parent[world.pairContacts[k].b];
+        if (island >= 0) {
+            world.islandContactStart[island + 1]++;
+        }
+    }
+    for (int island = 0; island < islandCount; ++island) {
+        world.islandBodyStart[island + 1] += world.islandBodyStart[island];
+        world.islandContactStart[island + 1] += world.islandContactStart[island];
+    }
+
+    std::vector<int> nextBody(world.islandBodyStart.begin(), world.islandBodyStart.end() - 1);
+    std::vector<int> nextContact(world.islandContactStart.begin(), world.islandContactStart.end() - 1);
+    world.islandBodies.resize(world.islandBodyStart[islandCount]);
+    world.contacts.resize(world.islandContactStart[islandCount]);
+    for (int i = 0; i < n; ++i) {
+        if (parent[i] >= 0) {
+            world.islandBodies[nextBody[parent[i]]++] = i;
+        }
+    }
+    for (int k = 0; k < contactCount; ++k) {
+        int island = parent[world.pairContacts[k].b];
+        if (island >= 0) {
+            world.contacts[nextContact[island]++] = world.pairContacts[k];
+        }
+    }
+
+    world.islandOrder.resize(islandCount);
+    for (int island = 0; island < islandCount; ++island) {
+        world.islandOrder[island] = island;
+    }
+    auto size = [&](int island) {
+        return world.islandBodyStart[island + 1] - world.islandBodyStart[island] + world.islandContactStart[island + 1] - world.islandContactStart[island];
+    };
+    std::sort(world.islandOrder.begin(), world.islandOrder.end(), [&](int x, int y) { return size(x) > size(y); });
+    world.islandCount = islandCount;
+    world.awakeCount = (int)world.islandBodies.size();
+    world.contactCount = (int)world.contacts.size();
+}
+
+static unsigned long long ContactKey(const PhysicsContact& c) {
+    return ((unsigned long long)(c.a + 1) << 40) | ((unsigned long long)c.b << 16) | (unsigned long long)c.feature;
+}
+
+static glm::vec3 ContactVelocity(const RigidBody* body, const glm::vec3& r) {
+    return body ? body->linearVelocity + glm::cross(body->angularVelocity, r) : glm::vec3(0.0f);
+}
+
+static void ApplyImpulse(PhysicsWorld& world, const PhysicsContact& c, const glm::vec3& impulse) {
+    if (c.a >= 0) {
+        RigidBody& A = world.bodies[c.a];
+        A.linearVelocity -= impulse * A.inverseMass;
+        A.angularVelocity -= world.inverseInertiaWorld[c.a] * glm::cross(c.rA, impulse);
+    }
+    RigidBody& B = world.bodies[c.b];
+    B.linearVelocity += impulse * B.inverseMass;
+    B.angularVelocity += world.inverseInertiaWorld[c.b] * glm::cross(c.rB, impulse);
+}
+
+static float EffectiveMass(const PhysicsWorld& world, const PhysicsContact& c, const glm::vec3& direction) {
+    float k = world.bodies[c.b].inverseMass + glm::dot(direction, glm::cross(world.inverseInertiaWorld[c.b] * glm::cross(c.rB, direction), c.rB));
+    if (c.a >= 0) {
+        k += world.bodies[c.a].inverseMass + glm::dot(direction, glm::cross(world.inverseInertiaWorld[c.a] * glm::cross(c.rA, direction), c.rA));
+    }
+    return k > 0.0f ? 1.0f / k : 0.0f;
+}
+
+static void SolveIsland(PhysicsWorld& world, const PhysicsSettings& settings, int island, float h) {
+    const int* bodies = world.islandBodies.data() + world.islandBodyStart[island];
+    int bodyCount = world.islandBodyStart[island + 1] - world.islandBodyStart[island];
+    PhysicsContact* contacts = world.contacts.data() + world.islandContactStart[island];
+    int contactCount = world.islandContactStart[island + 1] - world.islandContactStart[island];
+
+    for (int k = 0; k < bodyCount; ++k) {
+        RigidBody& body = world.bodies[bodies[k]];
+        body.linearVelocity.y -= settings.gravity * h;
+        glm::mat3 rotation = glm::mat3_cast(body.orientation);
+        glm::mat3 inverseInertia(0.0f);
+        inverseInertia[0][0] = body.inverseInertia.x;
+        inverseInertia[1][1] = body.inverseInertia.y;
+        inverseInertia[2][2] = body.inverseInertia.z;
+        world.inverseInertiaWorld[bodies[k]] = rotation * inverseInertia * glm::transpose(rotation);
+    }
+
+    for (int k = 0; k < contactCount; ++k) {
+        PhysicsContact& c = contacts[k];
+        RigidBody* A = c.a >= 0 ? &world.bodies[c.a] : nullptr;
+        RigidBody& B = world.bodies[c.b];
+        c.rA = A ? c.point - A->position : glm::vec3(0.0f);
+        c.rB = c.point - B.position;
+        glm::vec3 n = c.normal;
+        c.tangent[0] = glm::normalize(std::abs(n.x) > 0.57f ? glm::vec3(n.y, -n.x, 0.0f) : glm::vec3(0.0f, n.z, -n.y));
+        c.tangent[1] = glm::cross(n, c.tangent[0]);
+        c.normalMass = EffectiveMass(world, c, n);
+        c.tangentMass[0] = EffectiveMass(world, c, c.tangent[0]);
+        c.tangentMass[1] = EffectiveMass(world, c, c.tangent[1]);
+        float approach = glm::dot(ContactVelocity(&B, c.rB) - ContactVelocity(A, c.rA), n);
+        if (c.depth < 0.0f) {
+            c.velocityBias = c.depth / h;   // Not touching yet: may close the gap this step, no more
+        }
+        else {
+            c.velocityBias = PHYSICS_BAUMGARTE / h * std::max(c.depth - PHYSICS_SLOP, 0.0f);
+            if (approach < -1.0f) {
+                c.velocityBias = std::max(c.velocityBias, -settings.restitution * approach);
+            }
+        }
+    }
+
+    // Warm start from last step's impulses, so stacks don't have to be rebuilt from nothing
+    for (int k = 0; k < contactCount; ++k) {
+        PhysicsContact& c = contacts[k];
+        CachedImpulse key = { ContactKey(c) };
+        auto cached = std::lower_bound(world.cachedImpulses.begin(), world.cachedImpulses.end(), key,
+            [](const CachedImpulse& x, const CachedImpulse& y) { return x.key < y.key; });
+        if (cached != world.cachedImpulses.end() && cached->key == key.key) {
+            c.normalImpulse = cached->normal;
+            c.tangentImpulse[0] = cached->tangent[0];
+            c.tangentImpulse[1] = cached->tangent[1];
+            ApplyImpulse(world, c, c.normal * c.normalImpulse + c.tangent[0] * c.tangentImpulse[0] + c.tangent[1] * c.tangentImpulse[1]);
+        }
+        else {
+            c.normalImpulse = c.tangentImpulse[0] = c.tangentImpulse[1] = 0.0f;
+        }
+    }
+
+    for (int iteration = 0; iteration < settings.iterations; ++iteration) {
+        for (int k = 0; k < contactCount; ++k) {
+            PhysicsContact& c = contacts[k];
+            RigidBody* A = c.a >= 0 ? &world.bodies[c.a] : nullptr;
+            RigidBody& B = world.bodies[c.b];
+            // Friction, bounded by the normal impulse so far
+            float limit = settings.friction * c.normalImpulse;
+            for (int t = 0; t < 2; ++t) {
+                glm::vec3 dv = ContactVelocity(&B, c.rB) - ContactVelocity(A, c.rA);
+                float impulse = std::clamp(c.tangentImpulse[t] - glm::dot(dv, c.tangent[t]) * c.tangentMass[t], -limit, limit);
+                float applied = impulse - c.tangentImpulse[t];
+                c.tangentImpulse[t] = impulse;
+                ApplyImpulse(world, c, c.tangent[t] * applied);
+            }
+            glm::vec3 dv = ContactVelocity(&B, c.rB) - ContactVelocity(A, c.rA);
+            float impulse = std::max(c.normalImpulse + (c.velocityBias - glm::dot(dv, c.normal)) * c.normalMass, 0.0f);
+            float applied = impulse - c.normalImpulse;
+            c.normalImpulse = impulse;
+            ApplyImpulse(world, c, c.normal * applied);
+        }
+    }
+
+    // Snow soaks up rolling: touching anything slows a body's spin
+    float rolling = 1.0f / (1.0f + settings.rollingResistance * h);
+    for (int k = 0; k < contactCount; ++k) {
+        if (contacts[k].a >= 0) {
+            world.bodies[contacts[k].a].angularVelocity *= rolling;
+        }
+        world.bodies[contacts[k].b].angularVelocity *= rolling;
+    }
+
+    // Integrate, and put the island to sleep once all of it has been still for a while
+    float restTime = 1e30f;
+    for (int k = 0; k < bodyCount; ++k) {
+        RigidBody& body = world.bodies[bodies[k]];
+        body.linearVelocity *= 1.0f / (1.0f + 0.05f * h);
+        body.angularVelocity *= 1.0f / (1.0f + 0.5f * h);
+        body.position += body.linearVelocity * h;
+        glm::quat spin(0.0f, body.angularVelocity.x, body.angularVelocity.y, body.angularVelocity.z);
+        body.orientation = glm::normalize(body.orientation + spin * body.orientation * (0.5f * h));
+        float radius = world.shapes[body.shape].radius;
+        float speed2 = std::max(glm::dot(body.linearVelocity, body.linearVelocity), glm::dot(body.angularVelocity, body.angularVelocity) * radius * radius);
+        body.restTime = speed2 < settings.sleepSpeed * settings.sleepSpeed ? body.restTime + h : 0.0f;
+        restTime = std::min(restTime, body.restTime);
+    }
+    if (restTime >= settings.sleepTime) {
+        for (int k = 0; k < bodyCount; ++k) {
+            RigidBody& body = world.bodies[bodies[k]];
+            body.asleep = true;
+            body.linearVelocity = body.angularVelocity = glm::vec3(0.0f);
+        }
+    }
+}
+
+static void Step(PhysicsWorld& world, const PhysicsSettings& settings, ThreadPool& pool, float h) {
+    int n = (int)world.bodies.size();
+    for (RigidBody& body : world.bodies) {
+        body.prevPosition = body.position;
+        body.prevOrientation = body.orientation;
+    }
+
+    // 1. Broadphase
+    world.boundsMin.resize(n);
+    world.boundsMax.resize(n);
+    world.inverseInertiaWorld.resize(n);
+    ParallelFor(pool, n, 256, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            ComputeBounds(world, i);
+        }
+    });
+    SortAndSweep(world);
+
+    // 2. Narrowphase: one manifold per pair, then one per body against the ground. A sleeping
+    // body only needs its ground contacts if something awake reached it.
+    int pairCount = (int)world.pairs.size();
+    std::vector<char> reached(n, 0);
+    for (const glm::ivec2& pair : world.pairs) {
+        reached[pair.x] = reached[pair.y] = 1;
+    }
+    int slots = pairCount + n;
+    world.pairContacts.resize((size_t)slots * PHYSICS_MAX_MANIFOLD);
+    world.pairContactCount.assign(slots, 0);
+    ParallelFor(pool, slots, 64, [&](int begin, int end) {
+        for (int slot = begin; slot < end; ++slot) {
+            PhysicsContact* manifold = &world.pairContacts[(size_t)slot * PHYSICS_MAX_MANIFOLD];
+            int& count = world.pairContactCount[slot];
+            if (slot < pairCount) {
+                PairContacts(world, world.pairs[slot].x, world.pairs[slot].y, manifold, count);
+            }
+            else if (!world.bodies[slot - pairCount].asleep || reached[slot - pairCount]) {
+                GroundContacts(world, slot - pairCount, manifold, count);
+            }
+        }
+    });
+
+    // 3. Islands, each solved and integrated by one task
+    BuildIslands(world);
+    ParallelFor(pool, world.islandCount, 1, [&](int begin, int end) {
+        for (int k = begin; k < end; ++k) {
+            SolveIsland(world, settings, world.islandOrder[k], h);
+        }
+    });
+    world.cachedImpulses.resize(world.contacts.size());
+    for (size_t k = 0; k < world.contacts.size(); ++k) {
+        const PhysicsContact& c = world.contacts[k];
+        world.cachedImpulses[k] = { ContactKey(c), c.normalImpulse, { c.tangentImpulse[0], c.tangentImpulse[1] } };
+    }
+    std::sort(world.cachedImpulses.begin(), world.cachedImpulses.end(),
+        [](const CachedImpulse& x, const CachedImpulse& y) { return x.key < y.key; });
+}
+
+void StepPhysics(PhysicsWorld& world, const PhysicsSettings& settings, ThreadPool& pool, float deltaTime) {
+    if (!settings.enabled || world.bodies.empty()) {
+        return;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    float step = 1.0f / settings.stepRate;
+    world.accumulator += deltaTime;
+    int substeps = 0;
+    while (world.accumulator >= step && substeps < settings.maxSubsteps) {
+        Step(world, settings, pool, step);
+        world.accumulator -= step;
+        ++substeps;
+    }
+    world.accumulator = std::min(world.accumulator, step);
+    world.interpolation = world.accumulator / step;
+    world.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void RenderPhysics(PhysicsWorld& world, const PhysicsSettings& settings, const glm::mat4& view, const glm::mat4& projection,
+    const glm::mat4& prevViewProjection, const VolumetricFog& fog, const VolumetricFogSettings& fogSettings) {
+    int n = (int)world.bodies.size();
+    if (!settings.enabled || n == 0) {
+        return;
+    }
+    BeginGpuTimer(world.timer);
+
+    // Interpolated transforms grouped by shape, followed by last frame's in the same order
+    int shapeCount = (int)world.shapes.size();
+    world.shapeCount.assign(shapeCount, 0);
+    world.shapeFirst.assign(shapeCount + 1, 0);
+    for (const RigidBody& body : world.bodies) {
+        world.shapeCount[body.shape]++;
+    }
+    for (int s = 0; s < shapeCount; ++s) {
+        world.shapeFirst[s + 1] = world.shapeFirst[s] + world.shapeCount[s];
+    }
+    std::vector<int> next(world.shapeFirst.begin(), world.shapeFirst.end() - 1);
+    world.instanceTransforms.resize((size_t)n * 2);
+    for (int i = 0; i < n; ++i) {
+        RigidBody& body = world.bodies[i];
+        const PhysicsShape& shape = world.shapes[body.shape];
+        glm::vec3 position = glm::mix(body.prevPosition, body.position, world.interpolation);
+        glm::quat orientation = glm::slerp(body.prevOrientation, body.orientation, world.interpolation);
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), position) * glm::mat4_cast(orientation) *
+            glm::translate(glm::mat4(1.0f), -shape.center) * glm::scale(glm::mat4(1.0f), glm::vec3(shape.meshScale));
+        int slot = next[body.shape]++;
+        world.instanceTransforms[slot] = transform;
+        world.instanceTransforms[n + slot] = body.teleported ? transform : world.drawnTransforms[i];
+        world.drawnTransforms[i] = transform;
+        body.teleported = false;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, world.instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, world.instanceTransforms.size() * sizeof(glm::mat4), world.instanceTransforms.data(), GL_STREAM_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, world.instanceBuffer);
+
+    GLuint program = world.program;
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "uViewProjection"), 1, GL_FALSE, glm::value_ptr(projection * view));
+    glUniformMatrix4fv(glGetUniformLocation(program, "uPrevViewProjection"), 1, GL_FALSE, glm::value_ptr(prevViewProjection));
+    glUniform1i(glGetUniformLocation(program, "uPrevOffset"), n);
+    glUniform1i(glGetUniformLocation(program, "uAlbedo"), 0);
+    BindVolumetricFog(fog, fogSettings, program, 2);
+    glActiveTexture(GL_TEXTURE0);
+
+    glEnable(GL_DEPTH_TEST);
+    for (int s = 0; s < shapeCount; ++s) {
+        if (world.shapeCount[s] == 0) {
+            continue;
+        }
+        const Mesh& mesh = world.shapes[s].mesh;
+        glUniform1i(glGetUniformLocation(program, "uFirstInstance"), world.shapeFirst[s]);
+        glBindTexture(GL_TEXTURE_2D, mesh.textureID);
+        glBindVertexArray(mesh.VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, 0, world.shapeCount[s]);
+    }
+    glBindVertexArray(0);
+    EndGpuTimer(world.timer);
+}
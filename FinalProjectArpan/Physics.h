@@ -0,0 +1,148 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+#include "GpuTimer.h"
+#include "Mesh.h"
+#include "Terrain.h"
+#include "ThreadPool.h"
+#include "VolumetricFog.h"
+
+// Rigid bodies for thrown snowballs and tumbling gifts.
+// Shapes are fitted to Mesh data, as processMesh returns it: a sphere, a box, or a convex hull
+// kept as a 26-DOP (the mesh's extreme vertex along each of 26 directions and the plane there).
+// The world advances in fixed steps:
+//  - Broadphase: sort and sweep along x. The order is kept between steps so an insertion sort
+//    is close to linear, and y and z overlap is tested for four bodies per SSE compare.
+//  - Narrowphase: contacts for every pair across the thread pool. Polytopes test their vertices
+//    against each other's planes; the ground is a cached grid of terrain heights.
+//  - Solver: bodies joined by contacts form islands (union-find), each solved by one task with
+//    sequential impulses (Catto 2005), so no two threads touch a body. Islands that come to
+//    rest go to sleep until something hits them.
+// Drawing interpolates between the last two steps, one instanced call per shape.
+const int PHYSICS_MAX_BODIES = 2048;
+const int PHYSICS_MAX_MANIFOLD = 4;      // Contacts kept per pair
+const int PHYSICS_HEIGHT_SIZE = 256;     // Ground height cache resolution
+
+enum ShapeType { SHAPE_SPHERE = 0, SHAPE_BOX = 1, SHAPE_HULL = 2 };
+
+struct PhysicsShape {
+    int type = SHAPE_SPHERE;
+    float radius = 0.0f;                        // Bounding radius, the sphere itself for spheres
+    glm::vec3 halfExtents = glm::vec3(0.0f);    // Local bounds around the center of mass
+    std::vector<glm::vec3> points;              // Box corners or hull vertices, around the center of mass
+    std::vector<glm::vec4> planes;              // Outward normal, offset
+    glm::vec3 inertia = glm::vec3(1.0f);        // Diagonal of the inertia tensor per unit mass
+
+    Mesh mesh;                                  // Drawn around the body's position
+    glm::vec3 center = glm::vec3(0.0f);         // Center of mass in scaled mesh space
+    float meshScale = 1.0f;
+    bool ownsMesh = false;
+};
+
+struct PhysicsSettings {
+    bool enabled = true;
+    float stepRate = 60.0f;       // Fixed steps per second
+    int maxSubsteps = 4;          // Per frame; after a long frame time is dropped rather than caught up
+    int iterations = 8;           // Velocity solver passes per step
+    float gravity = 9.81f;
+    float friction = 0.6f;
+    float restitution = 0.15f;
+    float rollingResistance = 3.0f;   // Spin damping per second for each contact
+    float sleepSpeed = 0.1f;      // Islands slower than this for sleepTime seconds go to sleep
+    float sleepTime = 0.5f;
+};
+
+struct RigidBody {
+    glm::vec3 position = glm::vec3(0.0f);       // Center of mass
+    glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 linearVelocity = glm::vec3(0.0f);
+    glm::vec3 angularVelocity = glm::vec3(0.0f);
+    glm::vec3 prevPosition = glm::vec3(0.0f);   // At the previous step, for interpolation
+    glm::quat prevOrientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    float inverseMass = 1.0f;
+    glm::vec3 inverseInertia = glm::vec3(1.0f); // Local diagonal
+    int shape = 0;
+    float restTime = 0.0f;                      // Seconds spent below the sleep speed
+    bool asleep = false;
+    bool teleported = true;                     // No drawn transform yet, so no motion vector
+};
+
+struct PhysicsContact {
+    int a = -1, b = -1;                         // Bodies; a is -1 for the ground
+    glm::vec3 point = glm::vec3(0.0f);
+    glm::vec3 normal = glm::vec3(0.0f, 1.0f, 0.0f);   // From a to b
+    float depth = 0.0f;
+    int feature = 0;                            // Vertex that made it, to find it again next step
+
+    glm::vec3 rA, rB, tangent[2];               // Solver state
+    float normalMass, tangentMass[2], velocityBias;
+    float normalImpulse, tangentImpulse[2];
+};
+
+// A contact's impulses at the end of a step
+struct CachedImpulse {
+    unsigned long long key;                     // Bodies and feature
+    float normal, tangent[2];
+};
+
+struct PhysicsWorld {
+    std::vector<PhysicsShape> shapes;
+    std::vector<RigidBody> bodies;
+    int oldestBody = 0;                         // Replaced next once the world is full
+    float accumulator = 0.0f;
+    float interpolation = 0.0f;                 // Between the previous and current step, for drawing
+
+    // Broadphase
+    std::vector<int> order;                     // Bodies by bounds min x, kept from step to step
+    std::vector<glm::vec3> boundsMin, boundsMax;
+    std::vector<float> sweep[6];                // Sorted min x, max x, min y, max y, min z, max z, padded
+    std::vector<glm::ivec2> pairs;
+
+    // Narrowphase and islands
+    std::vector<PhysicsContact> pairContacts;   // PHYSICS_MAX_MANIFOLD slots per pair, then per body for the ground
+    std::vector<int> pairContactCount;
+    std::vector<PhysicsContact> contacts;       // Grouped by island
+    std::vector<int> islandOf;                  // Union-find parents, then island per body
+    std::vector<int> islandBodies, islandBodyStart, islandContactStart;
+    std::vector<int> islandOrder;               // Largest first, to balance the workers
+    std::vector<glm::mat3> inverseInertiaWorld;
+    std::vector<CachedImpulse> cachedImpulses;  // Last step's, sorted by key, to warm start the solver
+
+    // Ground heights over the square the bodies can reach
+    TerrainHeightCache ground;
+
+    // Drawing
+    std::vector<glm::mat4> drawnTransforms;     // Per body, last frame's
+    std::vector<glm::mat4> instanceTransforms;  // This frame's then last frame's, grouped by shape
+    std::vector<int> shapeFirst, shapeCount;
+    GLuint instanceBuffer = 0;
+    GLuint program = 0;
+    GpuTimer timer;
+
+    int awakeCount = 0, contactCount = 0, islandCount = 0;
+    float milliseconds = 0.0f;                  // CPU time of this frame's steps
+};
+
+// Caches the ground over +-extent around the scene
+bool InitPhysics(PhysicsWorld& world, Terrain& terrain, const TerrainSettings& terrainSettings, float extent = 64.0f);
+void DestroyPhysics(PhysicsWorld& world);
+
+// Fits a shape of the given type to the mesh's vertices; the mesh is drawn for it but stays the caller's
+int AddPhysicsShape(PhysicsWorld& world, const Mesh& mesh, int type, float scale = 1.0f);
+// Built-in meshes: a snowball, and a wrapped gift with or without a bow (a hull with one)
+int AddSphereShape(PhysicsWorld& world, float radius, GLuint texture);
+int AddGiftShape(PhysicsWorld& world, glm::vec3 halfExtents, bool bow, GLuint texture);
+
+// Replaces the oldest body once there are PHYSICS_MAX_BODIES
+int AddRigidBody(PhysicsWorld& world, int shape, float mass, const glm::vec3& position, const glm::quat& orientation,
+    const glm::vec3& linearVelocity, const glm::vec3& angularVelocity = glm::vec3(0.0f));
+
+// Runs the fixed steps due after deltaTime; no GL calls
+void StepPhysics(PhysicsWorld& world, const PhysicsSettings& settings, ThreadPool& pool, float deltaTime);
+
+// Draws every body at its interpolated transform into the bound scene target
+void RenderPhysics(PhysicsWorld& world, const PhysicsSettings& settings, const glm::mat4& view, const glm::mat4& projection,
+    const glm::mat4& prevViewProjection, const VolumetricFog& fog, const VolumetricFogSettings& fogSettings);
@@ -0,0 +1,235 @@
+#include "PostProcess.h"
+#include "Shader.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+static void CreateTargets(PostProcess& pp) {
+    // HDR scene target
+    glGenTextures(1, &pp.hdrColor);
+    glBindTexture(GL_TEXTURE_2D, pp.hdrColor);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, pp.width, pp.height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &pp.normalTexture);
+    glBindTexture(GL_TEXTURE_2D, pp.normalTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB10_A2, pp.width, pp.height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &pp.motionTexture);
+    glBindTexture(GL_TEXTURE_2D, pp.motionTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, pp.width, pp.height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &pp.depthTexture);
+    glBindTexture(GL_TEXTURE_2D, pp.depthTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, pp.width, pp.height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &pp.hdrFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, pp.hdrFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pp.hdrColor, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, pp.normalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, pp.motionTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, pp.depthTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "ERROR::FRAMEBUFFER::HDR_TARGET_INCOMPLETE" << std::endl;
+    }
+
+    // Tonemapped target that FXAA reads from
+    glGenTextures(1, &pp.ldrColor);
+    glBindTexture(GL_TEXTURE_2D, pp.ldrColor);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, pp.width, pp.height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &pp.ldrFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, pp.ldrFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pp.ldrColor, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "ERROR::FRAMEBUFFER::LDR_TARGET_INCOMPLETE" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Bloom pyramid starts at half resolution; R11G11B10F halves the bandwidth of RGBA16F
+    int bloomWidth = std::max(1, pp.width / 2);
+    int bloomHeight = std::max(1, pp.height / 2);
+    int levels = 1 + (int)std::floor(std::log2((float)std::max(bloomWidth, bloomHeight)));
+    pp.bloomMips = std::min(BLOOM_MAX_MIPS, levels);
+
+    glGenTextures(1, &pp.bloomTexture);
+    glBindTexture(GL_TEXTURE_2D, pp.bloomTexture);
+    glTexStorage2D(GL_TEXTURE_2D, pp.bloomMips, GL_R11F_G11F_B10F, bloomWidth, bloomHeight);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+static void DestroyTargets(PostProcess& pp) {
+    glDeleteFramebuffers(1, &pp.hdrFBO);
+    glDeleteFramebuffers(1, &pp.ldrFBO);
+    glDeleteTextures(1, &pp.hdrColor);
+    glDeleteTextures(1, &pp.normalTexture);
+    glDeleteTextures(1, &pp.motionTexture);
+    glDeleteTextures(1, &pp.depthTexture);
+    glDeleteTextures(1, &pp.ldrColor);
+    glDeleteTextures(1, &pp.bloomTexture);
+    pp.hdrFBO = pp.ldrFBO = 0;
+    pp.hdrColor = pp.normalTexture = pp.motionTexture = pp.depthTexture = pp.ldrColor = pp.bloomTexture = 0;
+}
+
+bool InitPostProcess(PostProcess& pp, int width, int height) {
+    if (!GLEW_VERSION_4_3) {
+        std::cerr << "ERROR::POSTPROCESS::OPENGL_4_3_REQUIRED" << std::endl;
+        return false;
+    }
+
+    pp.width = std::max(1, width);
+    pp.height = std::max(1, height);
+    CreateTargets(pp);
+
+    // The downsampler's last workgroup resets this to zero, so it only needs clearing once
+    GLuint zero = 0;
+    glGenBuffers(1, &pp.spdCounter);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pp.spdCounter);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenVertexArrays(1, &pp.fullscreenVAO);
+
+    pp.downsampleProgram = LoadShaderProgram("shaders/bloom_downsample.glsl");
+    pp.upsampleProgram = LoadShaderProgram("shaders/bloom_upsample.glsl");
+    pp.tonemapProgram = LoadShaderProgram("shaders/tonemap.glsl");
+    pp.fxaaProgram = LoadShaderProgram("shaders/fxaa.glsl");
+
+    InitGpuTimer(pp.bloomTimer);
+    return true;
+}
+
+void ResizePostProcess(PostProcess& pp, int width, int height) {
+    // Minimized windows report a zero size; keep the old targets until we are visible again
+    if (width <= 0 || height <= 0 || (width == pp.width && height == pp.height)) {
+        return;
+    }
+    DestroyTargets(pp);
+    pp.width = width;
+    pp.height = height;
+    CreateTargets(pp);
+}
+
+void DestroyPostProcess(PostProcess& pp) {
+    DestroyTargets(pp);
+    glDeleteBuffers(1, &pp.spdCounter);
+    glDeleteVertexArrays(1, &pp.fullscreenVAO);
+    glDeleteProgram(pp.downsampleProgram);
+    glDeleteProgram(pp.upsampleProgram);
+    glDeleteProgram(pp.tonemapProgram);
+    glDeleteProgram(pp.fxaaProgram);
+    DestroyGpuTimer(pp.bloomTimer);
+}
+
+void BeginScenePass(const PostProcess& pp) {
+    static const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+    glBindFramebuffer(GL_FRAMEBUFFER, pp.hdrFBO);
+    glDrawBuffers(3, drawBuffers);
+    glViewport(0, 0, pp.width, pp.height);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void DrawFullscreenTriangle(const PostProcess& pp) {
+    glBindVertexArray(pp.fullscreenVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+}
+
+static void RenderBloom(PostProcess& pp, const PostProcessSettings& settings) {
+    // Single-pass downsample: one 256-thread group per 64x64 tile of the scene
+    glUseProgram(pp.downsampleProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pp.hdrColor);
+    glUniform1i(glGetUniformLocation(pp.downsampleProgram, "uSource"), 0);
+    for (int i = 0; i < BLOOM_MAX_MIPS; i++) {
+        // Units past the last level are bound to it anyway so every image uniform is valid
+        glBindImageTexture(i, pp.bloomTexture, std::min(i, pp.bloomMips - 1), GL_FALSE, 0, GL_READ_WRITE, GL_R11F_G11F_B10F);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, pp.spdCounter);
+
+    int groupsX = (pp.width + 63) / 64;
+    int groupsY = (pp.height + 63) / 64;
+    float knee = std::max(settings.bloomKnee, 1e-4f);
+    glUniform2i(glGetUniformLocation(pp.downsampleProgram, "uSourceSize"), pp.width, pp.height);
+    glUniform1i(glGetUniformLocation(pp.downsampleProgram, "uMipCount"), pp.bloomMips);
+    glUniform1ui(glGetUniformLocation(pp.downsampleProgram, "uNumWorkGroups"), (GLuint)(groupsX * groupsY));
+    glUniform4f(glGetUniformLocation(pp.downsampleProgram, "uThreshold"),
+        settings.bloomThreshold, settings.bloomThreshold - knee, 2.0f * knee, 0.25f / knee);
+    glDispatchCompute(groupsX, groupsY, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // Fold the pyramid back up, each level adding a tent-filtered copy of the one below it
+    glUseProgram(pp.upsampleProgram);
+    glBindTexture(GL_TEXTURE_2D, pp.bloomTexture);
+    glUniform1i(glGetUniformLocation(pp.upsampleProgram, "uBloom"), 0);
+    glUniform1f(glGetUniformLocation(pp.upsampleProgram, "uRadius"), settings.bloomRadius);
+    for (int mip = pp.bloomMips - 1; mip > 0; mip--) {
+        int targetWidth = std::max(1, (pp.width / 2) >> (mip - 1));
+        int targetHeight = std::max(1, (pp.height / 2) >> (mip - 1));
+        glBindImageTexture(0, pp.bloomTexture, mip - 1, GL_FALSE, 0, GL_READ_WRITE, GL_R11F_G11F_B10F);
+        glUniform1i(glGetUniformLocation(pp.upsampleProgram, "uSourceMip"), mip);
+        glDispatchCompute((targetWidth + 7) / 8, (targetHeight + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+}
+
+void ApplyPostProcess(PostProcess& pp, const PostProcessSettings& settings, GLuint targetFBO) {
+    glDisable(GL_DEPTH_TEST);
+
+    if (settings.bloom) {
+        BeginGpuTimer(pp.bloomTimer);
+        RenderBloom(pp, settings);
+        EndGpuTimer(pp.bloomTimer);
+    }
+
+    // Tonemap straight to the target when FXAA is off
+    glBindFramebuffer(GL_FRAMEBUFFER, settings.fxaa ? pp.ldrFBO : targetFBO);
+    glViewport(0, 0, pp.width, pp.height);
+    glUseProgram(pp.tonemapProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pp.hdrColor);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, pp.bloomTexture);
+    glUniform1i(glGetUniformLocation(pp.tonemapProgram, "uScene"), 0);
+    glUniform1i(glGetUniformLocation(pp.tonemapProgram, "uBloom"), 1);
+    glUniform1f(glGetUniformLocation(pp.tonemapProgram, "uBloomIntensity"), settings.bloom ? settings.bloomIntensity : 0.0f);
+    glUniform1f(glGetUniformLocation(pp.tonemapProgram, "uExposure"), settings.exposure);
+    glUniform1i(glGetUniformLocation(pp.tonemapProgram, "uTonemapper"), settings.tonemapper);
+    DrawFullscreenTriangle(pp);
+
+    if (settings.fxaa) {
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+        glUseProgram(pp.fxaaProgram);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, pp.ldrColor);
+        glUniform1i(glGetUniformLocation(pp.fxaaProgram, "uColor"), 0);
+        glUniform2f(glGetUniformLocation(pp.fxaaProgram, "uInvResolution"), 1.0f / pp.width, 1.0f / pp.height);
+        DrawFullscreenTriangle(pp);
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <GL/glew.h>
+#include "GpuTimer.h"
+
+// HDR scene target followed by bloom, tonemapping and FXAA.
+// The bloom pyramid is built by one compute dispatch (bloom_downsample.glsl) and then
+// folded back up with a short chain of tent-filter upsamples.
+const int BLOOM_MAX_MIPS = 8;
+
+struct PostProcessSettings {
+    bool bloom = true;
+    float bloomThreshold = 1.0f;   // Scene luminance where bloom starts
+    float bloomKnee = 0.5f;        // Soft threshold width
+    float bloomIntensity = 0.15f;
+    float bloomRadius = 1.0f;      // Upsample tent filter radius in texels
+    float exposure = 1.0f;
+    int tonemapper = 2;            // 0: clamp, 1: Reinhard, 2: ACES
+    bool fxaa = true;
+};
+
+struct PostProcess {
+    int width = 0, height = 0;
+
+    GLuint hdrFBO = 0;
+    GLuint hdrColor = 0;      // RGBA16F scene color
+    GLuint depthTexture = 0;  // Scene depth, sampleable by later passes
+    GLuint normalTexture = 0; // World space normal * 0.5 + 0.5, alpha 0 marks the skybox
+    GLuint motionTexture = 0; // RGBA16F: xy uv motion since last frame, z change in view depth
+
+    GLuint ldrFBO = 0;
+    GLuint ldrColor = 0;      // Tonemapped color with luma in alpha, input to FXAA
+
+    GLuint bloomTexture = 0;  // Half resolution R11G11B10F pyramid
+    int bloomMips = 0;
+    GLuint spdCounter = 0;    // Workgroup counter used by the single-pass downsampler
+
+    GLuint fullscreenVAO = 0;
+    GLuint downsampleProgram = 0;
+    GLuint upsampleProgram = 0;
+    GLuint tonemapProgram = 0;
+    GLuint fxaaProgram = 0;
+
+    GpuTimer bloomTimer;
+};
+
+bool InitPostProcess(PostProcess& pp, int width, int height);
+void ResizePostProcess(PostProcess& pp, int width, int height);
+void DestroyPostProcess(PostProcess& pp);
+
+// Binds the HDR target; the scene is drawn between this and ApplyPostProcess
+void BeginScenePass(const PostProcess& pp);
+
+// Bloom, tonemap and FXAA into targetFBO (the default framebuffer unless the scene is upscaled)
+void ApplyPostProcess(PostProcess& pp, const PostProcessSettings& settings, GLuint targetFBO = 0);
+
+// Draws one triangle covering the viewport; the vertex shader derives positions from gl_VertexID
+void DrawFullscreenTriangle(const PostProcess& pp);
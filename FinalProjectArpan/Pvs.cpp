@@ -0,0 +1,327 @@
+#include "Pvs.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+
+const int PVS_BATCH_COLUMNS = 8;        // Columns whose rays are traced together
+
+static glm::vec3 OctahedralDirection(glm::vec2 uv) {
+    glm::vec2 e = uv * 2.0f - 1.0f;
+    glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+    if (n.z < 0.0f) {
+        glm::vec2 folded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        n.x = folded.x;
+        n.y = folded.y;
+    }
+    return glm::normalize(n);
+}
+
+// Zero bytes become a zero and the run length
+static std::vector<unsigned char> Compress(const unsigned char* set, int bytes) {
+    std::vector<unsigned char> out;
+    for (int i = 0; i < bytes; ++i) {
+        if (set[i] != 0) {
+            out.push_back(set[i]);
+            continue;
+        }
+        int run = 1;
+        while (i + run < bytes && set[i + run] == 0 && run < 255) {
+            run++;
+        }
+        out.push_back(0);
+        out.push_back((unsigned char)run);
+        i += run - 1;
+    }
+    return out;
+}
+
+static bool Decompress(const unsigned char* in, int length, unsigned char* set, int bytes) {
+    int written = 0;
+    for (int i = 0; i < length; ++i) {
+        if (in[i] != 0) {
+            if (written >= bytes) {
+                return false;
+            }
+            set[written++] = in[i];
+            continue;
+        }
+        if (i + 1 >= length || written + in[i + 1] > bytes) {
+            return false;
+        }
+        std::fill(set + written, set + written + in[i + 1], 0);
+        written += in[++i];
+    }
+    return written == bytes;
+}
+
+static unsigned int CountTriangles(const std::vector<Mesh>& meshes) {
+    unsigned int triangles = 0;
+    for (const Mesh& mesh : meshes) {
+        triangles += (unsigned int)mesh.indices.size() / 3;
+    }
+    return triangles;
+}
+
+// FNV-1a over everything the bake depends on
+static unsigned long long HashGeometry(const std::vector<Mesh>& meshes) {
+    unsigned long long hash = 14695981039346656037ull;
+    auto add = [&](const void* data, size_t size) {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    for (const Mesh& mesh : meshes) {
+        for (const Vertex& v : mesh.vertices) {
+            add(v.Position, sizeof(v.Position));
+        }
+        add(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        add(&mesh.opacity, sizeof(mesh.opacity));
+    }
+    return hash;
+}
+
+// Marks the first hit's mesh; rays that hit a transparent mesh are traced on from just past it
+static void TraceVisibility(const SceneBvh& bvh, ThreadPool& pool, const std::vector<Mesh>& meshes, std::vector<BvhRay>& rays,
+    std::vector<int>& rayColumn, std::vector<unsigned char>& visible, int setBytes) {
+    std::vector<BvhHit> hits;
+    for (int layer = 0; layer < PVS_PASS_LAYERS && !rays.empty(); ++layer) {
+        hits.assign(rays.size(), BvhHit());
+        TraceRays(bvh, pool, rays.data(), hits.data(), (int)rays.size());
+        size_t kept = 0;
+        for (size_t i = 0; i < rays.size(); ++i) {
+            if (hits[i].instance < 0) {
+                continue;
+            }
+            int mesh = bvh.instances[hits[i].instance].mesh;
+            visible[rayColumn[i] * setBytes + (mesh >> 3)] |= (unsigned char)(1 << (mesh & 7));
+            if (meshes[mesh].opacity < 1.0f) {
+                BvhRay ray = rays[i];
+                ray.origin += ray.direction * (hits[i].t * 1.0001f + 1e-4f);
+                rays[kept] = ray;
+                rayColumn[kept] = rayColumn[i];
+                kept++;
+            }
+        }
+        rays.resize(kept);
+        rayColumn.resize(kept);
+    }
+}
+
+void BakePvs(Pvs& pvs, const PvsSettings& settings, const SceneBvh& bvh, ThreadPool& pool, const std::vector<Mesh>& meshes, const glm::mat4& model) {
+    auto start = std::chrono::high_resolution_clock::now();
+    pvs = Pvs();
+    pvs.meshCount = (int)meshes.size();
+    pvs.setBytes = std::max((pvs.meshCount + 7) / 8, 1);
+    pvs.triangleCount = CountTriangles(meshes);
+    pvs.geometryHash = HashGeometry(meshes);
+    std::vector<glm::vec3> meshMin(meshes.size(), glm::vec3(1e30f)), meshMax(meshes.size(), glm::vec3(-1e30f));
+    pvs.boundsMin = glm::vec3(1e30f);
+    pvs.boundsMax = glm::vec3(-1e30f);
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        for (const Vertex& v : meshes[m].vertices) {
+            meshMin[m] = glm::min(meshMin[m], glm::vec3(v.Position[0], v.Position[1], v.Position[2]));
+            meshMax[m] = glm::max(meshMax[m], glm::vec3(v.Position[0], v.Position[1], v.Position[2]));
+        }
+        pvs.boundsMin = glm::min(pvs.boundsMin, meshMin[m]);
+        pvs.boundsMax = glm::max(pvs.boundsMax, meshMax[m]);
+    }
+    if (meshes.empty() || pvs.boundsMin.x > pvs.boundsMax.x) {
+        return;
+    }
+    const int columns = PVS_GRID * PVS_GRID;
+    glm::vec2 columnSize = glm::max(glm::vec2(pvs.boundsMax.x - pvs.boundsMin.x, pvs.boundsMax.z - pvs.boundsMin.z) / (float)PVS_GRID, glm::vec2(1e-4f));
+    glm::mat3 toWorld = glm::mat3(model);
+    auto worldRay = [&](glm::vec3 origin, glm::vec3 direction) {
+        BvhRay ray;
+        ray.origin = glm::vec3(model * glm::vec4(origin, 1.0f));
+        ray.direction = toWorld * direction;
+        return ray;
+    };
+
+    // Eye positions: stratified over each column, from its lowest ground to above its highest
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<glm::vec2> sampleXZ(columns * PVS_SAMPLES);
+    std::vector<BvhRay> rays(sampleXZ.size());
+    std::vector<BvhHit> hits(sampleXZ.size());
+    int strata = (int)std::sqrt((float)PVS_SAMPLES);
+    float top = pvs.boundsMax.y + 1.0f;
+    for (int c = 0; c < columns; ++c) {
+        glm::vec2 corner = glm::vec2(pvs.boundsMin.x, pvs.boundsMin.z) + glm::vec2(c % PVS_GRID, c / PVS_GRID) * columnSize;
+        for (int s = 0; s < PVS_SAMPLES; ++s) {
+            glm::vec2 cell((s % strata + unit(random)) / strata, (s / strata % strata + unit(random)) / strata);
+            glm::vec2 xz = corner + cell * columnSize;
+            sampleXZ[c * PVS_SAMPLES + s] = xz;
+            rays[c * PVS_SAMPLES + s] = worldRay(glm::vec3(xz.x, top, xz.y), glm::vec3(0.0f, -1.0f, 0.0f));
+        }
+    }
+    TraceRays(bvh, pool, rays.data(), hits.data(), (int)rays.size());
+    std::vector<float> groundLow(columns, 1e30f), groundHigh(columns, -1e30f);
+    for (int i = 0; i < (int)hits.size(); ++i) {
+        if (hits[i].instance >= 0) {
+            float ground = top - hits[i].t;
+            groundLow[i / PVS_SAMPLES] = std::min(groundLow[i / PVS_SAMPLES], ground);
+            groundHigh[i / PVS_SAMPLES] = std::max(groundHigh[i / PVS_SAMPLES], ground);
+        }
+    }
+    pvs.columnTop.resize(columns);
+    for (int c = 0; c < columns; ++c) {
+        if (groundLow[c] > groundHigh[c]) {
+            groundLow[c] = groundHigh[c] = pvs.boundsMin.y;
+        }
+        pvs.columnTop[c] = groundHigh[c] + settings.maxEyeHeight;
+    }
+
+    // Sphere of rays from every eye, a few columns at a time; 2x2 direction blocks keep packets coherent
+    std::vector<unsigned char> visible(columns * pvs.setBytes, 0);
+    std::vector<int> rayColumn;
+    const int raysPerEye = PVS_DIRECTIONS * PVS_DIRECTIONS;
+    for (int first = 0; first < columns; first += PVS_BATCH_COLUMNS) {
+        int last = std::min(first + PVS_BATCH_COLUMNS, columns);
+        rays.clear();
+        rayColumn.clear();
+        for (int c = first; c < last; ++c) {
+            for (int s = 0; s < PVS_SAMPLES; ++s) {
+                glm::vec2 xz = sampleXZ[c * PVS_SAMPLES + s];
+                glm::vec3 eye(xz.x, glm::mix(groundLow[c], pvs.columnTop[c], unit(random)), xz.y);
+                glm::vec2 jitter(unit(random), unit(random));
+                for (int d = 0; d < raysPerEye; ++d) {
+                    int block = d / 4, within = d % 4;
+                    int x = (block % (PVS_DIRECTIONS / 2)) * 2 + within % 2;
+                    int y = (block / (PVS_DIRECTIONS / 2)) * 2 + within / 2;
+                    rays.push_back(worldRay(eye, OctahedralDirection((glm::vec2(x, y) + jitter) / (float)PVS_DIRECTIONS)));
+                    rayColumn.push_back(c);
+                }
+            }
+        }
+        TraceVisibility(bvh, pool, meshes, rays, rayColumn, visible, pvs.setBytes);
+    }
+
+    // Meshes overlapping a column or its neighbors are visible from it whatever the rays found
+    for (int c = 0; c < columns; ++c) {
+        glm::vec2 low = glm::vec2(pvs.boundsMin.x, pvs.boundsMin.z) + glm::vec2(c % PVS_GRID - 1, c / PVS_GRID - 1) * columnSize;
+        glm::vec2 high = low + 3.0f * columnSize;
+        for (int m = 0; m < pvs.meshCount; ++m) {
+            if (meshMin[m].x <= high.x && meshMax[m].x >= low.x && meshMin[m].z <= high.y && meshMax[m].z >= low.y && meshMin[m].y <= pvs.columnTop[c]) {
+                visible[c * pvs.setBytes + (m >> 3)] |= (unsigned char)(1 << (m & 7));
+            }
+        }
+    }
+
+    // Widen by the neighborhood, then keep each distinct set once
+    std::map<std::vector<unsigned char>, int> unique;
+    pvs.columnSet.resize(columns);
+    std::vector<unsigned char> set(pvs.setBytes);
+    for (int c = 0; c < columns; ++c) {
+        std::fill(set.begin(), set.end(), 0);
+        int cx = c % PVS_GRID, cz = c / PVS_GRID;
+        for (int z = std::max(cz - PVS_NEIGHBORHOOD, 0); z <= std::min(cz + PVS_NEIGHBORHOOD, PVS_GRID - 1); ++z) {
+            for (int x = std::max(cx - PVS_NEIGHBORHOOD, 0); x <= std::min(cx + PVS_NEIGHBORHOOD, PVS_GRID - 1); ++x) {
+                for (int b = 0; b < pvs.setBytes; ++b) {
+                    set[b] |= visible[(z * PVS_GRID + x) * pvs.setBytes + b];
+                }
+            }
+        }
+        auto found = unique.emplace(set, (int)unique.size());
+        if (found.second) {
+            pvs.sets.insert(pvs.sets.end(), set.begin(), set.end());
+            pvs.compressedBytes += (int)Compress(set.data(), pvs.setBytes).size();
+        }
+        pvs.columnSet[c] = (unsigned short)found.first->second;
+    }
+    pvs.valid = true;
+    pvs.bakeMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "PVS: " << unique.size() << " distinct sets over " << columns << " columns, " << pvs.compressedBytes
+        << " bytes compressed, baked in " << pvs.bakeMilliseconds << " ms" << std::endl;
+}
+
+bool SavePvs(const Pvs& pvs, const std::string& path) {
+    std::ofstream file(path, std::ios::binary);
+    if (!pvs.valid || !file) {
+        std::cerr << "ERROR::PVS::COULD_NOT_WRITE " << path << std::endl;
+        return false;
+    }
+    int setCount = (int)(pvs.sets.size() / pvs.setBytes);
+    file.write("PVS2", 4);
+    file.write((const char*)&pvs.meshCount, sizeof(int));
+    file.write((const char*)&pvs.triangleCount, sizeof(unsigned int));
+    file.write((const char*)&pvs.geometryHash, sizeof(unsigned long long));
+    file.write((const char*)&pvs.boundsMin, sizeof(glm::vec3));
+    file.write((const char*)&pvs.boundsMax, sizeof(glm::vec3));
+    file.write((const char*)&setCount, sizeof(int));
+    file.write((const char*)pvs.columnTop.data(), pvs.columnTop.size() * sizeof(float));
+    file.write((const char*)pvs.columnSet.data(), pvs.columnSet.size() * sizeof(unsigned short));
+    for (int s = 0; s < setCount; ++s) {
+        std::vector<unsigned char> packed = Compress(&pvs.sets[s * pvs.setBytes], pvs.setBytes);
+        unsigned short length = (unsigned short)packed.size();
+        file.write((const char*)&length, sizeof(length));
+        file.write((const char*)packed.data(), packed.size());
+    }
+    return (bool)file;
+}
+
+bool LoadPvs(Pvs& pvs, const std::string& path, const std::vector<Mesh>& meshes) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[4];
+    if (!file || !file.read(magic, 4) || std::string(magic, 4) != "PVS2") {
+        return false;
+    }
+    Pvs loaded;
+    int setCount = 0;
+    file.read((char*)&loaded.meshCount, sizeof(int));
+    file.read((char*)&loaded.triangleCount, sizeof(unsigned int));
+    file.read((char*)&loaded.geometryHash, sizeof(unsigned long long));
+    file.read((char*)&loaded.boundsMin, sizeof(glm::vec3));
+    file.read((char*)&loaded.boundsMax, sizeof(glm::vec3));
+    file.read((char*)&setCount, sizeof(int));
+    if (!file || loaded.meshCount != (int)meshes.size() || loaded.triangleCount != CountTriangles(meshes)
+        || loaded.geometryHash != HashGeometry(meshes) || setCount <= 0) {
+        return false;
+    }
+    loaded.setBytes = std::max((loaded.meshCount + 7) / 8, 1);
+    loaded.columnTop.resize(PVS_GRID * PVS_GRID);
+    loaded.columnSet.resize(PVS_GRID * PVS_GRID);
+    file.read((char*)loaded.columnTop.data(), loaded.columnTop.size() * sizeof(float));
+    file.read((char*)loaded.columnSet.data(), loaded.columnSet.size() * sizeof(unsigned short));
+    loaded.sets.resize(setCount * loaded.setBytes);
+    for (int s = 0; s < setCount; ++s) {
+        unsigned short length = 0;
+        file.read((char*)&length, sizeof(length));
+        std::vector<unsigned char> packed(length);
+        file.read((char*)packed.data(), length);
+        if (!file || !Decompress(packed.data(), length, &loaded.sets[s * loaded.setBytes], loaded.setBytes)) {
+            return false;
+        }
+        loaded.compressedBytes += length;
+    }
+    for (unsigned short set : loaded.columnSet) {
+        if (set >= setCount) {
+            return false;
+        }
+    }
+    loaded.valid = true;
+    pvs = std::move(loaded);
+    std::cout << "PVS: loaded " << setCount << " distinct sets from " << path << std::endl;
+    return true;
+}
+
+const unsigned char* FindPvsSet(const Pvs& pvs, const glm::vec3& eye) {
+    if (!pvs.valid) {
+        return nullptr;
+    }
+    glm::vec2 cell = (glm::vec2(eye.x, eye.z) - glm::vec2(pvs.boundsMin.x, pvs.boundsMin.z))
+        / glm::vec2(pvs.boundsMax.x - pvs.boundsMin.x, pvs.boundsMax.z - pvs.boundsMin.z) * (float)PVS_GRID;
+    if (!(cell.x >= 0.0f && cell.y >= 0.0f && cell.x < PVS_GRID && cell.y < PVS_GRID)) {
+        return nullptr;
+    }
+    int column = (int)cell.y * PVS_GRID + (int)cell.x;
+    if (eye.y > pvs.columnTop[column]) {
+        return nullptr;
+    }
+    return &pvs.sets[pvs.columnSet[column] * pvs.setBytes];
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "Bvh.h"
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+// Potentially visible sets for the static scene meshes.
+// The area the first person camera can reach, the scene's footprint from the ground up to a
+// maximum eye height, is cut into a grid of columns in mesh space. The baker places eye samples
+// in each column and casts a sphere of rays from each through the scene BVH; every mesh a ray hits
+// first is visible from the column (transparent meshes let the ray through). Meshes near the
+// column are always visible, and each set is widened by its neighbors' to cover what the sampling
+// missed. Identical sets are stored once, and the file keeps them run-length coded: a zero byte
+// is followed by its run length (as in Quake's PVS). At runtime the camera's column gives its
+// set in O(1); outside the grid or above a column's top nothing is pruned.
+const int PVS_GRID = 32;               // Columns per side
+const int PVS_SAMPLES = 16;            // Eye positions per column
+const int PVS_DIRECTIONS = 16;         // Per side of the octahedral direction grid, so 256 rays per eye
+const int PVS_NEIGHBORHOOD = 1;        // Columns each set is widened by
+const int PVS_PASS_LAYERS = 4;         // Transparent meshes a ray may pass through
+
+struct PvsSettings {
+    bool enabled = true;
+    float maxEyeHeight = 5.0f;         // Above the highest ground in a column, mesh units
+};
+
+struct Pvs {
+    int meshCount = 0;
+    int setBytes = 0;                   // Bytes per bitset
+    unsigned int triangleCount = 0;     // Of the meshes baked for
+    unsigned long long geometryHash = 0;   // Positions, triangles and opacity baked for, to reject a stale file
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);   // Grid bounds, mesh space
+    std::vector<float> columnTop;       // Highest eye each column covers
+    std::vector<unsigned short> columnSet;
+    std::vector<unsigned char> sets;    // Unique bitsets, setBytes each
+    int compressedBytes = 0;            // Bitsets as stored in the file
+    bool valid = false;
+
+    float bakeMilliseconds = 0.0f;
+    int prunedMeshes = 0;               // This frame
+};
+
+// Bakes with rays through the BVH, whose instances are placed by model
+void BakePvs(Pvs& pvs, const PvsSettings& settings, const SceneBvh& bvh, ThreadPool& pool, const std::vector<Mesh>& meshes, const glm::mat4& model);
+
+// False if the file is missing or was baked for other meshes, including the same meshes moved,
+// reshaped or made (non)transparent
+bool LoadPvs(Pvs& pvs, const std::string& path, const std::vector<Mesh>& meshes);
+bool SavePvs(const Pvs& pvs, const std::string& path);
+
+// The set for an eye in mesh space, or nullptr where the PVS says nothing
+const unsigned char* FindPvsSet(const Pvs& pvs, const glm::vec3& eye);
+
+inline bool IsPvsVisible(const unsigned char* set, int mesh) {
+    return !set || ((set[mesh >> 3] >> (mesh & 7)) & 1);
+}
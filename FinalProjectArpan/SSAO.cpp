@@ -0,0 +1,221 @@
+#include "SSAO.h"
+#include "Shader.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <algorithm>
+
+static GLuint CreateTarget(GLenum format, int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+static void DestroyTargets(SSAO& ssao) {
+    glDeleteFramebuffers(1, &ssao.downsampleFBO);
+    glDeleteFramebuffers(2, ssao.aoFBO);
+    glDeleteTextures(1, &ssao.linearDepth);
+    glDeleteTextures(1, &ssao.normals);
+    glDeleteTextures(2, ssao.aoTexture);
+    ssao.downsampleFBO = ssao.linearDepth = ssao.normals = 0;
+    ssao.aoFBO[0] = ssao.aoFBO[1] = ssao.aoTexture[0] = ssao.aoTexture[1] = 0;
+    glDeleteFramebuffers(1, &ssao.sparseFBO);
+    glDeleteTextures(1, &ssao.sparseTexture);
+    ssao.sparseFBO = ssao.sparseTexture = 0;
+    ssao.sparsePattern = -1;
+    DestroyTemporalHistory(ssao.history);
+}
+
+// Packed target for the pixels shaded this frame; its size depends on the temporal pattern
+static void EnsureSparseTarget(SSAO& ssao, TemporalPattern pattern) {
+    if (ssao.sparsePattern == (int)pattern) {
+        return;
+    }
+    glDeleteFramebuffers(1, &ssao.sparseFBO);
+    glDeleteTextures(1, &ssao.sparseTexture);
+    ssao.sparsePattern = (int)pattern;
+
+    glm::ivec2 size = TemporalPackedSize(pattern, ssao.width, ssao.height);
+    ssao.sparseTexture = CreateTarget(GL_R8, size.x, size.y);
+    glGenFramebuffers(1, &ssao.sparseFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, ssao.sparseFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssao.sparseTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "ERROR::FRAMEBUFFER::SSAO_SPARSE_INCOMPLETE" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// (Re)creates the reduced resolution targets when the scene size or divisor changes
+static void EnsureTargets(SSAO& ssao, int fullWidth, int fullHeight, int divisor) {
+    if (ssao.fullWidth == fullWidth && ssao.fullHeight == fullHeight && ssao.divisor == divisor) {
+        return;
+    }
+    DestroyTargets(ssao);
+    ssao.fullWidth = fullWidth;
+    ssao.fullHeight = fullHeight;
+    ssao.divisor = divisor;
+    ssao.width = std::max(1, fullWidth / divisor);
+    ssao.height = std::max(1, fullHeight / divisor);
+
+    ssao.linearDepth = CreateTarget(GL_R32F, ssao.width, ssao.height);
+    ssao.normals = CreateTarget(GL_RGB10_A2, ssao.width, ssao.height);
+    glGenFramebuffers(1, &ssao.downsampleFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, ssao.downsampleFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssao.linearDepth, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, ssao.normals, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "ERROR::FRAMEBUFFER::SSAO_DOWNSAMPLE_INCOMPLETE" << std::endl;
+    }
+
+    glGenFramebuffers(2, ssao.aoFBO);
+    for (int i = 0; i < 2; i++) {
+        ssao.aoTexture[i] = CreateTarget(GL_R8, ssao.width, ssao.height);
+        glBindFramebuffer(GL_FRAMEBUFFER, ssao.aoFBO[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssao.aoTexture[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "ERROR::FRAMEBUFFER::SSAO_TARGET_INCOMPLETE" << std::endl;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool InitSSAO(SSAO& ssao) {
+    ssao.downsampleProgram = LoadShaderProgram("shaders/ssao_downsample.glsl");
+    ssao.aoProgram = LoadShaderProgram("shaders/ssao.glsl");
+    ssao.blurProgram = LoadShaderProgram("shaders/ssao_blur.glsl");
+    ssao.upsampleProgram = LoadShaderProgram("shaders/ssao_upsample.glsl");
+    InitGpuTimer(ssao.timer);
+    return ssao.downsampleProgram && ssao.aoProgram && ssao.blurProgram && ssao.upsampleProgram;
+}
+
+void DestroySSAO(SSAO& ssao) {
+    DestroyTargets(ssao);
+    glDeleteProgram(ssao.downsampleProgram);
+    glDeleteProgram(ssao.aoProgram);
+    glDeleteProgram(ssao.blurProgram);
+    glDeleteProgram(ssao.upsampleProgram);
+    DestroyGpuTimer(ssao.timer);
+}
+
+void ApplySSAO(SSAO& ssao, const SSAOSettings& settings, const PostProcess& pp, const glm::mat4& view, const glm::mat4& projection,
+    const Temporal& temporal, const TemporalSettings& temporalSettings) {
+    if (!settings.enabled) {
+        ssao.history.valid = false;
+        return;
+    }
+    EnsureTargets(ssao, pp.width, pp.height, std::max(1, settings.resolutionDivisor));
+    TemporalPattern pattern = settings.temporal ? (TemporalPattern)settings.temporalPattern : TEMPORAL_FULL;
+    if (settings.temporal) {
+        EnsureSparseTarget(ssao, pattern);
+        EnsureTemporalHistory(ssao.history, ssao.width, ssao.height);
+    }
+    else {
+        ssao.history.valid = false;
+    }
+
+    BeginGpuTimer(ssao.timer);
+    glDisable(GL_DEPTH_TEST);
+
+    // Projection terms used to rebuild view space positions from linear depth
+    glm::vec4 projectionInfo(projection[0][0], projection[1][1], projection[2][2], projection[3][2]);
+
+    // 1. Downsample depth (as linear view depth) and normals (into view space)
+    static const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glBindFramebuffer(GL_FRAMEBUFFER, ssao.downsampleFBO);
+    glDrawBuffers(2, drawBuffers);
+    glViewport(0, 0, ssao.width, ssao.height);
+    glUseProgram(ssao.downsampleProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pp.depthTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, pp.normalTexture);
+    glUniform1i(glGetUniformLocation(ssao.downsampleProgram, "uDepth"), 0);
+    glUniform1i(glGetUniformLocation(ssao.downsampleProgram, "uNormals"), 1);
+    glUniform1i(glGetUniformLocation(ssao.downsampleProgram, "uDivisor"), ssao.divisor);
+    glUniform4fv(glGetUniformLocation(ssao.downsampleProgram, "uProjectionInfo"), 1, glm::value_ptr(projectionInfo));
+    glUniformMatrix4fv(glGetUniformLocation(ssao.downsampleProgram, "uView"), 1, GL_FALSE, glm::value_ptr(view));
+    DrawFullscreenTriangle(pp);
+
+    // 2. Occlusion at the reduced resolution, or only this frame's sparse pixels of it
+    glm::ivec2 aoSize = TemporalPackedSize(pattern, ssao.width, ssao.height);
+    glBindFramebuffer(GL_FRAMEBUFFER, settings.temporal ? ssao.sparseFBO : ssao.aoFBO[0]);
+    glViewport(0, 0, aoSize.x, aoSize.y);
+    glUseProgram(ssao.aoProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, ssao.linearDepth);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, ssao.normals);
+    glUniform1i(glGetUniformLocation(ssao.aoProgram, "uLinearDepth"), 0);
+    glUniform1i(glGetUniformLocation(ssao.aoProgram, "uNormals"), 1);
+    glUniform4fv(glGetUniformLocation(ssao.aoProgram, "uProjectionInfo"), 1, glm::value_ptr(projectionInfo));
+    glUniform1f(glGetUniformLocation(ssao.aoProgram, "uRadius"), settings.radius);
+    glUniform1i(glGetUniformLocation(ssao.aoProgram, "uSampleCount"), std::min(settings.sampleCount, SSAO_MAX_SAMPLES));
+    glUniform1f(glGetUniformLocation(ssao.aoProgram, "uIntensity"), settings.intensity);
+    glUniform1f(glGetUniformLocation(ssao.aoProgram, "uBias"), settings.bias);
+    if (settings.temporal) {
+        SetTemporalUniforms(ssao.aoProgram, temporal, pattern);
+    }
+    else {
+        glUniform1i(glGetUniformLocation(ssao.aoProgram, "uTemporalPattern"), TEMPORAL_FULL);
+        glUniform1i(glGetUniformLocation(ssao.aoProgram, "uTemporalFrame"), 0);
+    }
+    DrawFullscreenTriangle(pp);
+
+    // Accumulate with the reprojected history and fill the pixels skipped this frame
+    GLuint rawAO = ssao.aoTexture[0];
+    if (settings.temporal) {
+        rawAO = ResolveTemporal(temporal, temporalSettings, ssao.history, pattern, ssao.sparseTexture, ssao.linearDepth, pp);
+    }
+
+    // 3. Depth-aware 4x4 blur removes the per-pixel kernel rotation pattern
+    glBindFramebuffer(GL_FRAMEBUFFER, ssao.aoFBO[1]);
+    glViewport(0, 0, ssao.width, ssao.height);
+    glUseProgram(ssao.blurProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, rawAO);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, ssao.linearDepth);
+    glUniform1i(glGetUniformLocation(ssao.blurProgram, "uAO"), 0);
+    glUniform1i(glGetUniformLocation(ssao.blurProgram, "uLinearDepth"), 1);
+    DrawFullscreenTriangle(pp);
+
+    // 4. Joint bilateral upsample, multiplied into the scene color with blending
+    glBindFramebuffer(GL_FRAMEBUFFER, pp.hdrFBO);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glViewport(0, 0, pp.width, pp.height);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+    glUseProgram(ssao.upsampleProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, ssao.aoTexture[1]);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, ssao.linearDepth);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, ssao.normals);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, pp.depthTexture);
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D, pp.normalTexture);
+    glUniform1i(glGetUniformLocation(ssao.upsampleProgram, "uAO"), 0);
+    glUniform1i(glGetUniformLocation(ssao.upsampleProgram, "uLowDepth"), 1);
+    glUniform1i(glGetUniformLocation(ssao.upsampleProgram, "uLowNormals"), 2);
+    glUniform1i(glGetUniformLocation(ssao.upsampleProgram, "uDepth"), 3);
+    glUniform1i(glGetUniformLocation(ssao.upsampleProgram, "uNormals"), 4);
+    glUniform1i(glGetUniformLocation(ssao.upsampleProgram, "uDivisor"), ssao.divisor);
+    glUniform4fv(glGetUniformLocation(ssao.upsampleProgram, "uProjectionInfo"), 1, glm::value_ptr(projectionInfo));
+    glUniformMatrix4fv(glGetUniformLocation(ssao.upsampleProgram, "uView"), 1, GL_FALSE, glm::value_ptr(view));
+    DrawFullscreenTriangle(pp);
+    glDisable(GL_BLEND);
+
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_DEPTH_TEST);
+    EndGpuTimer(ssao.timer);
+}
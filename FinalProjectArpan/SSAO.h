@@ -0,0 +1,57 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "GpuTimer.h"
+#include "PostProcess.h"
+#include "Temporal.h"
+
+// Screen-space ambient occlusion computed at half or quarter resolution.
+// Depth and normals are downsampled first, AO is evaluated and blurred at the reduced size,
+// then a joint bilateral upsample multiplies it into the full resolution HDR color.
+// With temporal accumulation on, only a sparse pattern of pixels is shaded each frame and
+// the result is resolved against the reprojected history before the blur.
+const int SSAO_MAX_SAMPLES = 32;
+
+struct SSAOSettings {
+    bool enabled = true;
+    int resolutionDivisor = 2;   // 2: half resolution, 4: quarter resolution
+    float radius = 0.5f;         // Kernel radius in world units
+    int sampleCount = 12;
+    float intensity = 1.5f;
+    float bias = 0.02f;
+    bool temporal = true;
+    int temporalPattern = TEMPORAL_CHECKERBOARD;
+};
+
+struct SSAO {
+    int fullWidth = 0, fullHeight = 0;
+    int divisor = 0;
+    int width = 0, height = 0;   // Reduced resolution
+
+    GLuint downsampleFBO = 0;
+    GLuint linearDepth = 0;      // R32F positive view space depth
+    GLuint normals = 0;          // RGB10_A2 view space normals
+
+    GLuint aoFBO[2] = {};
+    GLuint aoTexture[2] = {};    // R8 raw and blurred occlusion
+
+    int sparsePattern = -1;
+    GLuint sparseFBO = 0;
+    GLuint sparseTexture = 0;    // R8 occlusion for this frame's pixels, packed by pattern
+    TemporalHistory history;
+
+    GLuint downsampleProgram = 0;
+    GLuint aoProgram = 0;
+    GLuint blurProgram = 0;
+    GLuint upsampleProgram = 0;
+
+    GpuTimer timer;
+};
+
+bool InitSSAO(SSAO& ssao);
+void DestroySSAO(SSAO& ssao);
+
+// Reads depth and normals from the HDR target and darkens its color in place
+void ApplySSAO(SSAO& ssao, const SSAOSettings& settings, const PostProcess& pp, const glm::mat4& view, const glm::mat4& projection,
+    const Temporal& temporal, const TemporalSettings& temporalSettings);
@@ -0,0 +1,123 @@
+#include "Shader.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <malloc.h>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+ShaderProgramSource ParseShader(const std::string& filepath) {
+    std::ifstream stream(filepath);
+    if (!stream) {
+        std::cerr << "ERROR::SHADER::FILE_NOT_FOUND: " << filepath << std::endl;
+    }
+    std::stringstream ss[3];
+    std::string line;
+    enum class ShaderType { NONE = -1, VERTEX = 0, FRAGMENT = 1, COMPUTE = 2 } type = ShaderType::NONE;
+
+    while (getline(stream, line)) {
+        if (line.find("#shader") != std::string::npos) {
+            if (line.find("vertex") != std::string::npos) {
+                type = ShaderType::VERTEX;
+            }
+            else if (line.find("fragment") != std::string::npos) {
+                type = ShaderType::FRAGMENT;
+            }
+            else if (line.find("compute") != std::string::npos) {
+                type = ShaderType::COMPUTE;
+            }
+        }
+        else if (type != ShaderType::NONE && line.find("#include") == 0) {
+            // Shared GLSL snippets, resolved relative to the including file
+            size_t first = line.find('"');
+            size_t last = line.rfind('"');
+            fs::path includePath = fs::path(filepath).parent_path() / line.substr(first + 1, last - first - 1);
+            std::ifstream include(includePath);
+            if (!include) {
+                std::cerr << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << includePath.string() << std::endl;
+            }
+            else {
+                ss[(int)type] << include.rdbuf() << '\n';
+            }
+        }
+        else if (type != ShaderType::NONE) {
+            ss[(int)type] << line << '\n';
+        }
+    }
+
+    return { ss[0].str(), ss[1].str(), ss[2].str() };
+}
+
+unsigned int CompileShader(unsigned int type, const std::string& source) {
+    unsigned int id = glCreateShader(type);
+    const char* src = source.c_str();
+    glShaderSource(id, 1, &src, nullptr);
+    glCompileShader(id);
+
+    int result;
+    glGetShaderiv(id, GL_COMPILE_STATUS, &result);
+    if (result == GL_FALSE) {
+        int length;
+        glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+        char* message = (char*)alloca(length * sizeof(char));
+        glGetShaderInfoLog(id, length, &length, message);
+        std::cerr << "Failed to compile shader\n" << message << std::endl;
+        glDeleteShader(id);
+        return 0;
+    }
+
+    return id;
+}
+
+unsigned int CreateShader(const std::string& vertexShader, const std::string& fragmentShader) {
+    unsigned int program = glCreateProgram();
+    unsigned int vs = CompileShader(GL_VERTEX_SHADER, vertexShader);
+    unsigned int fs = CompileShader(GL_FRAGMENT_SHADER, fragmentShader);
+
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glValidateProgram(program);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    return program;
+}
+
+unsigned int CreateComputeShader(const std::string& computeShader) {
+    unsigned int program = glCreateProgram();
+    unsigned int cs = CompileShader(GL_COMPUTE_SHADER, computeShader);
+
+    glAttachShader(program, cs);
+    glLinkProgram(program);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+
+    glDeleteShader(cs);
+
+    return program;
+}
+
+unsigned int LoadShaderProgram(const std::string& filepath) {
+    ShaderProgramSource source = ParseShader(filepath);
+    if (!source.ComputeSource.empty()) {
+        return CreateComputeShader(source.ComputeSource);
+    }
+    return CreateShader(source.VertexSource, source.FragmentSource);
+}
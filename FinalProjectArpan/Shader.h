@@ -0,0 +1,21 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <string>
+
+// Linking Shader Files
+// A .glsl file holds one program, split into stages by "#shader vertex", "#shader fragment"
+// and "#shader compute" lines. '#include "file.glsl"' inside a stage pastes a shared snippet.
+struct ShaderProgramSource {
+    std::string VertexSource;
+    std::string FragmentSource;
+    std::string ComputeSource;
+};
+
+ShaderProgramSource ParseShader(const std::string& filepath);
+unsigned int CompileShader(unsigned int type, const std::string& source);
+unsigned int CreateShader(const std::string& vertexShader, const std::string& fragmentShader);
+unsigned int CreateComputeShader(const std::string& computeShader);
+
+// Parses a .glsl file and builds either a compute program or a vertex/fragment program from it
+unsigned int LoadShaderProgram(const std::string& filepath);
@@ -0,0 +1,236 @@
+#include "SnowSurface.h"
+#include "Shader.h"
+#include "VertexFormat.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+bool InitSnowSurface(SnowSurface& snow, const Mesh& ground, const SnowSurfaceSettings& settings) {
+    if (ground.vertices.empty()) {
+        std::cerr << "ERROR::SNOW_SURFACE::EMPTY_GROUND_MESH" << std::endl;
+        return false;
+    }
+
+    // Bounds and mean height of the ground, plus a least squares fit of its texture coordinates
+    // as an affine function of x and z so the grid keeps the original tiling
+    glm::vec2 minimum(1e30f), maximum(-1e30f);
+    double height = 0.0;
+    glm::dmat3 normal(0.0);
+    glm::dvec3 rightU(0.0), rightV(0.0);
+    for (const Vertex& v : ground.vertices) {
+        glm::vec2 xz(v.Position[0], v.Position[2]);
+        minimum = glm::min(minimum, xz);
+        maximum = glm::max(maximum, xz);
+        height += v.Position[1];
+        glm::dvec3 row(xz.x, xz.y, 1.0);
+        normal += glm::outerProduct(row, row);
+        rightU += row * (double)v.TexCoords[0];
+        rightV += row * (double)v.TexCoords[1];
+    }
+    snow.boundsMin = minimum;
+    snow.boundsSize = glm::max(maximum - minimum, glm::vec2(1e-3f));
+    snow.groundHeight = (float)(height / ground.vertices.size());
+    glm::dvec3 fitU(0.0), fitV(0.0);
+    if (std::abs(glm::determinant(normal)) > 1e-12) {
+        glm::dmat3 inverseNormal = glm::inverse(normal);
+        fitU = inverseNormal * rightU;
+        fitV = inverseNormal * rightV;
+    }
+
+    const int n = SNOW_GRID_RESOLUTION;
+    std::vector<Vertex> vertices;
+    vertices.reserve((n + 1) * (n + 1));
+    for (int j = 0; j <= n; ++j) {
+        for (int i = 0; i <= n; ++i) {
+            float x = snow.boundsMin.x + snow.boundsSize.x * i / n;
+            float z = snow.boundsMin.y + snow.boundsSize.y * j / n;
+            Vertex v = {};
+            v.Position[0] = x;
+            v.Position[1] = snow.groundHeight;
+            v.Position[2] = z;
+            v.Normal[1] = 1.0f;
+            v.TexCoords[0] = (float)(fitU.x * x + fitU.y * z + fitU.z);
+            v.TexCoords[1] = (float)(fitV.x * x + fitV.y * z + fitV.z);
+            vertices.push_back(v);
+        }
+    }
+    std::vector<unsigned int> indices;
+    indices.reserve(n * n * 6);
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < n; ++i) {
+            unsigned int a = j * (n + 1) + i;
+            unsigned int b = a + n + 1;
+            indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    snow.gridIndexCount = (GLsizei)indices.size();
+
+    glGenVertexArrays(1, &snow.gridVAO);
+    glGenBuffers(1, &snow.gridVBO);
+    glGenBuffers(1, &snow.gridEBO);
+    glBindVertexArray(snow.gridVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, snow.gridVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, snow.gridEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    SetupVertexAttributes<FloatVertexLayout>();
+    glBindVertexArray(0);
+
+    // Nothing is pressed yet, so the whole deficit texture starts at zero
+    std::vector<GLushort> zero(SNOW_HEIGHTFIELD_SIZE * SNOW_HEIGHTFIELD_SIZE, 0);
+    glGenTextures(1, &snow.deficitTexture);
+    glBindTexture(GL_TEXTURE_2D, snow.deficitTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, SNOW_HEIGHTFIELD_SIZE, SNOW_HEIGHTFIELD_SIZE, 0, GL_RED, GL_HALF_FLOAT, zero.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(1, &snow.tileBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, snow.tileBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, SNOW_TILES_PER_SIDE * SNOW_TILES_PER_SIDE * sizeof(glm::ivec4), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    snow.tileTimeLeft.assign(SNOW_TILES_PER_SIDE * SNOW_TILES_PER_SIDE, 0.0f);
+    snow.pendingStamps.clear();
+    snow.snowDepth = settings.initialDepth;
+    snow.hasFootprint = false;
+    snow.updateProgram = LoadShaderProgram("shaders/snow_stamp.glsl");
+    InitGpuTimer(snow.timer);
+    return snow.updateProgram != 0;
+}
+
+void DestroySnowSurface(SnowSurface& snow) {
+    glDeleteVertexArrays(1, &snow.gridVAO);
+    glDeleteBuffers(1, &snow.gridVBO);
+    glDeleteBuffers(1, &snow.gridEBO);
+    glDeleteTextures(1, &snow.deficitTexture);
+    glDeleteBuffers(1, &snow.tileBuffer);
+    glDeleteProgram(snow.updateProgram);
+    DestroyGpuTimer(snow.timer);
+}
+
+void StampSnow(SnowSurface& snow, const SnowStamp& stamp) {
+    snow.pendingStamps.push_back(stamp);
+}
+
+void UpdateFootprints(SnowSurface& snow, const SnowSurfaceSettings& settings, const glm::vec3& walkerPosition) {
+    glm::vec2 position(walkerPosition.x, walkerPosition.z);
+    if (!snow.hasFootprint) {
+        snow.lastFootprint = position;
+        snow.hasFootprint = true;
+        return;
+    }
+    glm::vec2 step = position - snow.lastFootprint;
+    float distance = glm::length(step);
+    if (distance < settings.strideLength) {
+        return;
+    }
+    // Teleports (camera mode switches, resets) start a new trail instead of a long track
+    if (distance < settings.strideLength * 4.0f) {
+        glm::vec2 side = glm::vec2(-step.y, step.x) / distance;
+        glm::vec2 foot = position + side * (settings.footprintRadius * snow.footprintSide);
+        StampSnow(snow, { foot, foot, settings.footprintRadius, settings.footprintDepth });
+        snow.footprintSide = -snow.footprintSide;
+    }
+    snow.lastFootprint = position;
+}
+
+void UpdateSnowSurface(SnowSurface& snow, const SnowSurfaceSettings& settings, float deltaTime, bool snowing) {
+    if (!settings.enabled) {
+        snow.pendingStamps.clear();
+        snow.activeTileCount = 0;
+        return;
+    }
+    if (snowing) {
+        snow.snowDepth = std::min(snow.snowDepth + settings.accumulationRate * deltaTime, settings.maxDepth);
+    }
+
+    // Mark the tiles under this frame's stamps. A tile stays active for five refill time
+    // constants, after which the remaining dent is below 1% and gets cleared on its last update
+    float activeTime = std::max(settings.refillTime, 0.1f) * 5.0f;
+    glm::vec2 texelsPerUnit = glm::vec2((float)SNOW_HEIGHTFIELD_SIZE) / snow.boundsSize;
+    for (const SnowStamp& stamp : snow.pendingStamps) {
+        glm::vec2 low = (glm::min(stamp.from, stamp.to) - stamp.radius - snow.boundsMin) * texelsPerUnit;
+        glm::vec2 high = (glm::max(stamp.from, stamp.to) + stamp.radius - snow.boundsMin) * texelsPerUnit;
+        glm::ivec2 tileLow = glm::clamp(glm::ivec2(glm::floor(low / (float)SNOW_TILE_SIZE)), 0, SNOW_TILES_PER_SIDE - 1);
+        glm::ivec2 tileHigh = glm::clamp(glm::ivec2(glm::floor(high / (float)SNOW_TILE_SIZE)), 0, SNOW_TILES_PER_SIDE - 1);
+        if (high.x < 0.0f || high.y < 0.0f || low.x >= SNOW_HEIGHTFIELD_SIZE || low.y >= SNOW_HEIGHTFIELD_SIZE) {
+            continue;
+        }
+        for (int y = tileLow.y; y <= tileHigh.y; ++y) {
+            for (int x = tileLow.x; x <= tileHigh.x; ++x) {
+                snow.tileTimeLeft[y * SNOW_TILES_PER_SIDE + x] = activeTime;
+            }
+        }
+    }
+
+    std::vector<glm::ivec4> tiles;
+    for (int i = 0; i < (int)snow.tileTimeLeft.size(); ++i) {
+        if (snow.tileTimeLeft[i] <= 0.0f) {
+            continue;
+        }
+        snow.tileTimeLeft[i] -= deltaTime;
+        bool lastUpdate = snow.tileTimeLeft[i] <= 0.0f;
+        tiles.push_back(glm::ivec4(i % SNOW_TILES_PER_SIDE, i / SNOW_TILES_PER_SIDE, lastUpdate, 0));
+    }
+    snow.activeTileCount = (int)tiles.size();
+    if (tiles.empty()) {
+        snow.pendingStamps.clear();
+        return;
+    }
+
+    BeginGpuTimer(snow.timer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, snow.tileBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, tiles.size() * sizeof(glm::ivec4), tiles.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glUseProgram(snow.updateProgram);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, snow.tileBuffer);
+    glBindImageTexture(0, snow.deficitTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R16F);
+    glUniform2fv(glGetUniformLocation(snow.updateProgram, "uBoundsMin"), 1, glm::value_ptr(snow.boundsMin));
+    glUniform2fv(glGetUniformLocation(snow.updateProgram, "uBoundsSize"), 1, glm::value_ptr(snow.boundsSize));
+    glUniform1f(glGetUniformLocation(snow.updateProgram, "uSnowDepth"), snow.snowDepth);
+
+    // Refill once per frame, stamps in batches of SNOW_MAX_STAMPS
+    float refill = std::exp(-deltaTime / std::max(settings.refillTime, 0.1f));
+    size_t stampIndex = 0;
+    do {
+        size_t count = std::min(snow.pendingStamps.size() - stampIndex, (size_t)SNOW_MAX_STAMPS);
+        glm::vec4 segments[SNOW_MAX_STAMPS];
+        glm::vec2 shapes[SNOW_MAX_STAMPS];
+        for (size_t i = 0; i < count; ++i) {
+            const SnowStamp& stamp = snow.pendingStamps[stampIndex + i];
+            segments[i] = glm::vec4(stamp.from, stamp.to);
+            shapes[i] = glm::vec2(stamp.radius, stamp.depth);
+        }
+        glUniform4fv(glGetUniformLocation(snow.updateProgram, "uStampSegments"), (GLsizei)count, glm::value_ptr(segments[0]));
+        glUniform2fv(glGetUniformLocation(snow.updateProgram, "uStampShapes"), (GLsizei)count, glm::value_ptr(shapes[0]));
+        glUniform1i(glGetUniformLocation(snow.updateProgram, "uStampCount"), (GLint)count);
+        glUniform1f(glGetUniformLocation(snow.updateProgram, "uRefill"), stampIndex == 0 ? refill : 1.0f);
+        // Each 32x32 tile is covered by 4x4 groups of 8x8 texels
+        glDispatchCompute((GLuint)tiles.size(), (SNOW_TILE_SIZE / 8) * (SNOW_TILE_SIZE / 8), 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        stampIndex += count;
+    } while (stampIndex < snow.pendingStamps.size());
+
+    snow.pendingStamps.clear();
+    EndGpuTimer(snow.timer);
+}
+
+void BindSnowSurface(const SnowSurface& snow, GLuint program, int unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, snow.deficitTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program, "uSnowDeficit"), unit);
+    glUniform4f(glGetUniformLocation(program, "uSnowBounds"), snow.boundsMin.x, snow.boundsMin.y, 1.0f / snow.boundsSize.x, 1.0f / snow.boundsSize.y);
+    glUniform1f(glGetUniformLocation(program, "uSnowDepth"), snow.snowDepth);
+}
+
+void DrawSnowSurface(const SnowSurface& snow) {
+    glBindVertexArray(snow.gridVAO);
+    glDrawElements(GL_TRIANGLES, snow.gridIndexCount, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
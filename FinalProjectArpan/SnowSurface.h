@@ -0,0 +1,79 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "GpuTimer.h"
+#include "Mesh.h"
+
+// Deformable snow over the snow_grass ground.
+// The ground is redrawn as a finer grid (assumed flat, in the ground's model space) displaced in
+// the vertex stage by the snow depth. Falling snow raises the undisturbed depth everywhere
+// through a single uniform, and the texture only stores how far each texel has been pressed below
+// that level. Stamps (footprints, tracks) mark the 32x32 tiles they touch; only those tiles are
+// updated by the compute pass, and they stay in the update list while the dent slowly refills.
+const int SNOW_HEIGHTFIELD_SIZE = 1024;
+const int SNOW_TILE_SIZE = 32;
+const int SNOW_TILES_PER_SIDE = SNOW_HEIGHTFIELD_SIZE / SNOW_TILE_SIZE;
+const int SNOW_MAX_STAMPS = 16;   // Per dispatch, more are handled in further batches
+const int SNOW_GRID_RESOLUTION = 256;
+
+struct SnowSurfaceSettings {
+    bool enabled = true;
+    float initialDepth = 0.05f;
+    float maxDepth = 0.3f;
+    float accumulationRate = 0.002f;  // Depth added per second while it snows
+    float refillTime = 20.0f;         // Seconds for a dent to lose ~63% of its depth
+    float footprintRadius = 0.12f;
+    float footprintDepth = 0.06f;
+    float strideLength = 0.6f;
+};
+
+// A capsule from 'from' to 'to' (ground model space xz). Positive depth presses the snow down,
+// negative depth piles it up.
+struct SnowStamp {
+    glm::vec2 from, to;
+    float radius;
+    float depth;
+};
+
+struct SnowSurface {
+    glm::vec2 boundsMin = glm::vec2(0.0f);
+    glm::vec2 boundsSize = glm::vec2(1.0f);
+    float groundHeight = 0.0f;
+    float snowDepth = 0.0f;            // Undisturbed depth
+
+    GLuint deficitTexture = 0;         // R16F depth pressed below snowDepth per texel
+    GLuint tileBuffer = 0;             // ivec4 per active tile: tile x, tile y, last update, unused
+    GLuint updateProgram = 0;
+
+    GLuint gridVAO = 0, gridVBO = 0, gridEBO = 0;
+    GLsizei gridIndexCount = 0;
+
+    std::vector<float> tileTimeLeft;   // Seconds each tile stays in the update list
+    std::vector<SnowStamp> pendingStamps;
+    int activeTileCount = 0;
+
+    glm::vec2 lastFootprint = glm::vec2(0.0f);
+    bool hasFootprint = false;
+    int footprintSide = 1;
+
+    GpuTimer timer;
+};
+
+// Builds the grid over the ground mesh bounds, with texture coordinates fitted to the mesh's own
+// by least squares, so the snow texture lines up with the ground it replaces
+bool InitSnowSurface(SnowSurface& snow, const Mesh& ground, const SnowSurfaceSettings& settings);
+void DestroySnowSurface(SnowSurface& snow);
+
+void StampSnow(SnowSurface& snow, const SnowStamp& stamp);
+
+// Leaves alternating footprints every stride along the path of a walker (ground model space)
+void UpdateFootprints(SnowSurface& snow, const SnowSurfaceSettings& settings, const glm::vec3& walkerPosition);
+
+// Applies this frame's stamps and refill to the dirty tiles only
+void UpdateSnowSurface(SnowSurface& snow, const SnowSurfaceSettings& settings, float deltaTime, bool snowing);
+
+// Sets the displacement uniforms of a scene program and binds the deficit texture to 'unit'
+void BindSnowSurface(const SnowSurface& snow, GLuint program, int unit);
+void DrawSnowSurface(const SnowSurface& snow);
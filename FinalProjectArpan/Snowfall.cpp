@@ -0,0 +1,100 @@
+#include "Snowfall.h"
+#include "Shader.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+
+bool InitSnowfall(Snowfall& snow) {
+    glGenBuffers(1, &snow.positionBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, snow.positionBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, SNOW_MAX_PARTICLES * sizeof(glm::vec4), nullptr, GL_DYNAMIC_COPY);
+    glGenBuffers(1, &snow.velocityBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, snow.velocityBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, SNOW_MAX_PARTICLES * sizeof(glm::vec4), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Sprites are built from gl_VertexID and gl_InstanceID, so the VAO has no attributes
+    glGenVertexArrays(1, &snow.vao);
+
+    snow.updateProgram = LoadShaderProgram("shaders/snow_update.glsl");
+    snow.renderProgram = LoadShaderProgram("shaders/snow_render.glsl");
+    snow.needsReset = true;
+    InitGpuTimer(snow.timer);
+    return snow.updateProgram && snow.renderProgram;
+}
+
+void DestroySnowfall(Snowfall& snow) {
+    glDeleteBuffers(1, &snow.positionBuffer);
+    glDeleteBuffers(1, &snow.velocityBuffer);
+    glDeleteVertexArrays(1, &snow.vao);
+    glDeleteProgram(snow.updateProgram);
+    glDeleteProgram(snow.renderProgram);
+    DestroyGpuTimer(snow.timer);
+}
+
+void RenderSnowfall(Snowfall& snow, const SnowfallSettings& settings, const PostProcess& pp,
+    const glm::mat4& view, const glm::mat4& projection, float deltaTime, float time,
+    const VolumetricFog& fog, const VolumetricFogSettings& fogSettings, OffscreenParticles& offscreen,
+    const WindField& wind, const WindSettings& windSettings) {
+    if (!settings.enabled) {
+        return;
+    }
+    BeginGpuTimer(snow.timer);
+
+    int count = std::clamp(settings.particleCount, 0, SNOW_MAX_PARTICLES);
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(view)[3]);
+    glm::mat4 viewProjection = projection * view;
+
+    // 1. Simulation, one thread per flake
+    glUseProgram(snow.updateProgram);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, snow.positionBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, snow.velocityBuffer);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pp.depthTexture);
+    glUniform1i(glGetUniformLocation(snow.updateProgram, "uDepth"), 0);
+    glUniformMatrix4fv(glGetUniformLocation(snow.updateProgram, "uViewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+    glUniform2f(glGetUniformLocation(snow.updateProgram, "uDepthParams"), projection[2][2], projection[3][2]);
+    glUniform3fv(glGetUniformLocation(snow.updateProgram, "uEmitterCenter"), 1, glm::value_ptr(cameraPosition));
+    glUniform3fv(glGetUniformLocation(snow.updateProgram, "uEmitterExtent"), 1, glm::value_ptr(settings.emitterExtent));
+    glUniform1f(glGetUniformLocation(snow.updateProgram, "uWindDrag"), settings.windDrag);
+    BindWindField(wind, windSettings, snow.updateProgram, 4);
+    glUniform1f(glGetUniformLocation(snow.updateProgram, "uFallSpeed"), settings.fallSpeed);
+    glUniform1f(glGetUniformLocation(snow.updateProgram, "uTurbulence"), settings.turbulence);
+    glUniform1f(glGetUniformLocation(snow.updateProgram, "uRestTime"), settings.restTime);
+    glUniform1f(glGetUniformLocation(snow.updateProgram, "uCollisionThickness"), settings.collisionThickness);
+    glUniform1f(glGetUniformLocation(snow.updateProgram, "uDeltaTime"), std::min(deltaTime, 0.1f));
+    glUniform1f(glGetUniformLocation(snow.updateProgram, "uTime"), time);
+    glUniform1ui(glGetUniformLocation(snow.updateProgram, "uCount"), (GLuint)count);
+    glUniform1ui(glGetUniformLocation(snow.updateProgram, "uFrame"), snow.frame++);
+    glUniform1i(glGetUniformLocation(snow.updateProgram, "uReset"), snow.needsReset);
+    glDispatchCompute((count + 255) / 256, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    snow.needsReset = false;
+
+    // 2. Instanced sprites: opaque into the HDR color at full resolution, otherwise blended
+    // into the low resolution target and composited back
+    bool lowResolution = settings.resolutionDivisor > 1;
+    if (lowResolution) {
+        BeginOffscreenParticles(offscreen, pp, settings.resolutionDivisor);
+    }
+    else {
+        glBindFramebuffer(GL_FRAMEBUFFER, pp.hdrFBO);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        glViewport(0, 0, pp.width, pp.height);
+        glEnable(GL_DEPTH_TEST);
+    }
+    glUseProgram(snow.renderProgram);
+    glUniform1i(glGetUniformLocation(snow.renderProgram, "uPremultiplied"), lowResolution);
+    glUniformMatrix4fv(glGetUniformLocation(snow.renderProgram, "uView"), 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(glGetUniformLocation(snow.renderProgram, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
+    glUniform1f(glGetUniformLocation(snow.renderProgram, "uSize"), settings.flakeSize);
+    glUniform3fv(glGetUniformLocation(snow.renderProgram, "uColor"), 1, glm::value_ptr(settings.color));
+    BindVolumetricFog(fog, fogSettings, snow.renderProgram, 2);
+    glBindVertexArray(snow.vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+    glBindVertexArray(0);
+    if (lowResolution) {
+        CompositeOffscreenParticles(offscreen, pp, projection);
+    }
+
+    EndGpuTimer(snow.timer);
+}
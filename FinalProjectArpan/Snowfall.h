@@ -0,0 +1,54 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "GpuTimer.h"
+#include "PostProcess.h"
+#include "VolumetricFog.h"
+#include "OffscreenParticles.h"
+#include "WindField.h"
+
+// GPU snowfall.
+// Flakes live in structure-of-arrays storage buffers (one for positions, one for velocities)
+// and are simulated by a compute shader in a box that follows the camera, drifting with the
+// shared wind field. Each flake tests
+// itself against the scene depth buffer and rests where it lands before respawning at the
+// top of the box. They are drawn as instanced camera-facing sprites straight from the buffers,
+// so the CPU does no per-particle work. With resolutionDivisor 2 or 4 the sprites are drawn
+// as soft premultiplied discs into a low resolution offscreen target to save fill rate.
+const int SNOW_MAX_PARTICLES = 1 << 20;
+
+struct SnowfallSettings {
+    bool enabled = true;
+    int particleCount = SNOW_MAX_PARTICLES;
+    glm::vec3 emitterExtent = glm::vec3(25.0f, 12.0f, 25.0f);  // Half size of the box around the camera
+    float fallSpeed = 1.2f;
+    float windDrag = 2.0f;            // How fast flakes take on the wind field, per second
+    float turbulence = 0.35f;
+    float restTime = 6.0f;            // Seconds a flake stays where it landed
+    float collisionThickness = 0.3f;  // How far behind the depth buffer still counts as a hit
+    float flakeSize = 0.025f;
+    glm::vec3 color = glm::vec3(1.6f, 1.65f, 1.8f);
+    int resolutionDivisor = 1;        // 1: full resolution, 2: half, 4: quarter (offscreen)
+};
+
+struct Snowfall {
+    GLuint positionBuffer = 0;   // vec4: position, random seed
+    GLuint velocityBuffer = 0;   // vec4: velocity, seconds left resting (negative while falling)
+    GLuint vao = 0;
+    GLuint updateProgram = 0;
+    GLuint renderProgram = 0;
+    bool needsReset = true;
+    unsigned int frame = 0;
+    GpuTimer timer;
+};
+
+bool InitSnowfall(Snowfall& snow);
+void DestroySnowfall(Snowfall& snow);
+
+// Simulates against the scene depth in 'pp' and draws the flakes into its HDR color, through
+// 'offscreen' when the divisor asks for it. Call after the opaque scene has been drawn.
+void RenderSnowfall(Snowfall& snow, const SnowfallSettings& settings, const PostProcess& pp,
+    const glm::mat4& view, const glm::mat4& projection, float deltaTime, float time,
+    const VolumetricFog& fog, const VolumetricFogSettings& fogSettings, OffscreenParticles& offscreen,
+    const WindField& wind, const WindSettings& windSettings);
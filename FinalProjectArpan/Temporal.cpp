@@ -0,0 +1,113 @@
+#include "Temporal.h"
+#include "Shader.h"
+#include <iostream>
+#include <algorithm>
+
+bool InitTemporal(Temporal& temporal) {
+    temporal.resolveProgram = LoadShaderProgram("shaders/temporal_resolve.glsl");
+    return temporal.resolveProgram != 0;
+}
+
+void DestroyTemporal(Temporal& temporal) {
+    glDeleteProgram(temporal.resolveProgram);
+}
+
+void BeginTemporalFrame(Temporal& temporal, const glm::mat4& view, const glm::mat4& projection) {
+    if (temporal.frameIndex > 0) {
+        temporal.prevView = temporal.view;
+        temporal.prevProjection = temporal.projection;
+        temporal.hasPrevious = true;
+    }
+    else {
+        temporal.prevView = view;
+        temporal.prevProjection = projection;
+    }
+    temporal.view = view;
+    temporal.projection = projection;
+    temporal.frameIndex++;
+}
+
+void EnsureTemporalHistory(TemporalHistory& history, int width, int height) {
+    if (history.width == width && history.height == height) {
+        return;
+    }
+    DestroyTemporalHistory(history);
+    history.width = width;
+    history.height = height;
+
+    glGenTextures(2, history.texture);
+    glGenFramebuffers(2, history.fbo);
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, history.texture[i]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, history.fbo[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, history.texture[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "ERROR::FRAMEBUFFER::TEMPORAL_HISTORY_INCOMPLETE" << std::endl;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    history.current = 0;
+    history.valid = false;
+}
+
+void DestroyTemporalHistory(TemporalHistory& history) {
+    glDeleteFramebuffers(2, history.fbo);
+    glDeleteTextures(2, history.texture);
+    history.fbo[0] = history.fbo[1] = history.texture[0] = history.texture[1] = 0;
+    history.width = history.height = 0;
+    history.valid = false;
+}
+
+glm::ivec2 TemporalPackedSize(TemporalPattern pattern, int width, int height) {
+    if (pattern == TEMPORAL_CHECKERBOARD) {
+        return glm::ivec2((width + 1) / 2, height);
+    }
+    if (pattern == TEMPORAL_QUARTER) {
+        return glm::ivec2((width + 1) / 2, (height + 1) / 2);
+    }
+    return glm::ivec2(width, height);
+}
+
+void SetTemporalUniforms(GLuint program, const Temporal& temporal, TemporalPattern pattern) {
+    glUniform1i(glGetUniformLocation(program, "uTemporalPattern"), (int)pattern);
+    glUniform1i(glGetUniformLocation(program, "uTemporalFrame"), (int)(temporal.frameIndex & 0xffff));
+}
+
+GLuint ResolveTemporal(const Temporal& temporal, const TemporalSettings& settings, TemporalHistory& history,
+    TemporalPattern pattern, GLuint current, GLuint linearDepth, const PostProcess& pp) {
+    int previous = history.current;
+    int next = 1 - history.current;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, history.fbo[next]);
+    glViewport(0, 0, history.width, history.height);
+    glUseProgram(temporal.resolveProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, current);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, history.texture[previous]);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, linearDepth);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, pp.motionTexture);
+    glUniform1i(glGetUniformLocation(temporal.resolveProgram, "uCurrent"), 0);
+    glUniform1i(glGetUniformLocation(temporal.resolveProgram, "uHistory"), 1);
+    glUniform1i(glGetUniformLocation(temporal.resolveProgram, "uDepth"), 2);
+    glUniform1i(glGetUniformLocation(temporal.resolveProgram, "uMotion"), 3);
+    glUniform1i(glGetUniformLocation(temporal.resolveProgram, "uHistoryValid"), history.valid && temporal.hasPrevious);
+    glUniform1f(glGetUniformLocation(temporal.resolveProgram, "uFreshWeight"), settings.freshWeight);
+    glUniform1f(glGetUniformLocation(temporal.resolveProgram, "uDepthTolerance"), settings.depthTolerance);
+    SetTemporalUniforms(temporal.resolveProgram, temporal, pattern);
+    DrawFullscreenTriangle(pp);
+
+    glActiveTexture(GL_TEXTURE0);
+    history.current = next;
+    history.valid = true;
+    return history.texture[next];
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "PostProcess.h"
+
+// Temporal reprojection service shared by screen-space effects.
+// The scene pass writes motion vectors from the current and previous uModel/uView/uProjection.
+// An effect keeps a TemporalHistory and calls ResolveTemporal to blend its new result with the
+// reprojected history, rejecting disoccluded pixels by depth. Effects can also render only a
+// checkerboard or a quarter of their pixels per frame and let the resolve fill in the rest.
+enum TemporalPattern {
+    TEMPORAL_FULL = 0,
+    TEMPORAL_CHECKERBOARD = 1,
+    TEMPORAL_QUARTER = 2
+};
+
+struct TemporalSettings {
+    float freshWeight = 0.2f;      // Weight of a newly rendered pixel against its history
+    float depthTolerance = 0.05f;  // Relative depth mismatch that counts as a disocclusion
+};
+
+struct Temporal {
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::mat4 prevView = glm::mat4(1.0f);
+    glm::mat4 prevProjection = glm::mat4(1.0f);
+    unsigned int frameIndex = 0;
+    bool hasPrevious = false;
+
+    GLuint resolveProgram = 0;
+};
+
+struct TemporalHistory {
+    int width = 0, height = 0;
+    GLuint texture[2] = {};   // RGBA16F: effect value in rgb, linear depth in alpha
+    GLuint fbo[2] = {};
+    int current = 0;          // Index of the most recently resolved texture
+    bool valid = false;
+};
+
+bool InitTemporal(Temporal& temporal);
+void DestroyTemporal(Temporal& temporal);
+
+// Call once per frame after the camera is known; keeps the previous frame's matrices
+void BeginTemporalFrame(Temporal& temporal, const glm::mat4& view, const glm::mat4& projection);
+
+void EnsureTemporalHistory(TemporalHistory& history, int width, int height);
+void DestroyTemporalHistory(TemporalHistory& history);
+
+// Size of the packed target an effect renders into when it only draws a subset of pixels
+glm::ivec2 TemporalPackedSize(TemporalPattern pattern, int width, int height);
+
+// Sets the uniforms declared in temporal_common.glsl
+void SetTemporalUniforms(GLuint program, const Temporal& temporal, TemporalPattern pattern);
+
+// Blends 'current' (packed for 'pattern') with the reprojected history at the effect's
+// resolution and returns the resolved texture. 'linearDepth' is view depth at that resolution.
+GLuint ResolveTemporal(const Temporal& temporal, const TemporalSettings& settings, TemporalHistory& history,
+    TemporalPattern pattern, GLuint current, GLuint linearDepth, const PostProcess& pp);
@@ -0,0 +1,290 @@
+#include "Terrain.h"
+#include "Shader.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static int Wrap(int coordinate) {
+    return ((coordinate % CLIPMAP_TEXTURE_SIZE) + CLIPMAP_TEXTURE_SIZE) % CLIPMAP_TEXTURE_SIZE;
+}
+
+static float Hash(int x, int z) {
+    unsigned int h = (unsigned int)x * 374761393u + (unsigned int)z * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return (float)((h ^ (h >> 16)) & 0xffffu) / 65535.0f;
+}
+
+static float ValueNoise(float x, float z) {
+    int xi = (int)std::floor(x), zi = (int)std::floor(z);
+    float fx = x - xi, fz = z - zi;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fz = fz * fz * (3.0f - 2.0f * fz);
+    float a = Hash(xi, zi) + (Hash(xi + 1, zi) - Hash(xi, zi)) * fx;
+    float b = Hash(xi, zi + 1) + (Hash(xi + 1, zi + 1) - Hash(xi, zi + 1)) * fx;
+    return a + (b - a) * fz;
+}
+
+// Stand-in for the heightmap file: rolling hills with sharper peaks, 0..1
+static float ProceduralHeight(float x, float z) {
+    float height = 0.0f, amplitude = 0.5f, frequency = 1.0f / 400.0f;
+    for (int octave = 0; octave < 7; ++octave) {
+        height += amplitude * ValueNoise(x * frequency, z * frequency);
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+    return height * height;
+}
+
+// Fills terrain.uploadBuffer with the heights of a region of one level's grid. Levels point sample
+// the heightmap at their own spacing, reading one contiguous span of the file per row.
+static void FetchHeights(Terrain& terrain, const TerrainSettings& settings, int level, glm::ivec2 start, glm::ivec2 size) {
+    int stride = 1 << level;
+    float spacing = settings.sampleSpacing * stride;
+    int half = settings.heightmapSize / 2;
+    terrain.uploadBuffer.resize((size_t)size.x * size.y);
+
+    for (int z = 0; z < size.y; ++z) {
+        float* row = &terrain.uploadBuffer[(size_t)z * size.x];
+        if (terrain.heightmap.is_open()) {
+            int sampleZ = std::clamp((start.y + z) * stride + half, 0, settings.heightmapSize - 1);
+            int first = std::clamp(start.x * stride + half, 0, settings.heightmapSize - 1);
+            int last = std::clamp((start.x + size.x - 1) * stride + half, 0, settings.heightmapSize - 1);
+            terrain.rowBuffer.resize(last - first + 1);
+            terrain.heightmap.seekg(((std::streamoff)sampleZ * settings.heightmapSize + first) * sizeof(unsigned short));
+            if (terrain.heightmap.read((char*)terrain.rowBuffer.data(), terrain.rowBuffer.size() * sizeof(unsigned short))) {
+                for (int x = 0; x < size.x; ++x) {
+                    int sampleX = std::clamp((start.x + x) * stride + half, first, last);
+                    row[x] = terrain.rowBuffer[sampleX - first] / 65535.0f;
+                }
+            }
+            else {
+                std::cerr << "WARNING::Terrain heightmap read failed, using procedural heights" << std::endl;
+                terrain.heightmap.close();
+            }
+        }
+        if (!terrain.heightmap.is_open()) {
+            for (int x = 0; x < size.x; ++x) {
+                row[x] = ProceduralHeight((start.x + x) * spacing, (start.y + z) * spacing);
+            }
+        }
+        // Flatten around the scene so its own ground stays on top
+        for (int x = 0; x < size.x; ++x) {
+            float distance = glm::length(glm::vec2(start.x + x, start.y + z) * spacing);
+            float t = std::clamp((distance - settings.flatRadius) / settings.flatRadius, 0.0f, 1.0f);
+            row[x] = settings.baseHeight + row[x] * settings.heightScale * t * t * (3.0f - 2.0f * t);
+        }
+    }
+}
+
+// Streams a region of grid coordinates into a level's layer, split where it wraps around the texture
+static void StreamRegion(Terrain& terrain, const TerrainSettings& settings, int level, glm::ivec2 start, glm::ivec2 size) {
+    for (int z = 0; z < size.y;) {
+        int texelZ = Wrap(start.y + z);
+        int rows = std::min(size.y - z, CLIPMAP_TEXTURE_SIZE - texelZ);
+        for (int x = 0; x < size.x;) {
+            int texelX = Wrap(start.x + x);
+            int columns = std::min(size.x - x, CLIPMAP_TEXTURE_SIZE - texelX);
+            FetchHeights(terrain, settings, level, start + glm::ivec2(x, z), glm::ivec2(columns, rows));
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, texelX, texelZ, level, columns, rows, 1, GL_RED, GL_FLOAT, terrain.uploadBuffer.data());
+            terrain.uploadedTexels += columns * rows;
+            x += columns;
+        }
+        z += rows;
+    }
+}
+
+bool InitTerrain(Terrain& terrain, const TerrainSettings& settings) {
+    terrain.heightmap.open(settings.heightmapPath, std::ios::binary | std::ios::ate);
+    if (!terrain.heightmap.is_open()) {
+        std::cout << "Terrain heightmap " << settings.heightmapPath << " not found, using procedural heights" << std::endl;
+    }
+    else if ((std::streamoff)terrain.heightmap.tellg() != (std::streamoff)settings.heightmapSize * settings.heightmapSize * (std::streamoff)sizeof(unsigned short)) {
+        std::cerr << "WARNING::Terrain heightmap " << settings.heightmapPath << " is not " << settings.heightmapSize << "x" << settings.heightmapSize
+            << " 16-bit samples, using procedural heights" << std::endl;
+        terrain.heightmap.close();
+    }
+
+    glGenTextures(1, &terrain.heightTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, terrain.heightTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, CLIPMAP_TEXTURE_SIZE, CLIPMAP_TEXTURE_SIZE, CLIPMAP_LEVELS, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // One grid shared by all levels, in cells around the level center
+    const int half = CLIPMAP_GRID / 2;
+    const int side = CLIPMAP_GRID + 1;
+    std::vector<glm::vec2> vertices;
+    vertices.reserve(side * side);
+    for (int j = -half; j <= half; ++j) {
+        for (int i = -half; i <= half; ++i) {
+            vertices.push_back(glm::vec2(i, j));
+        }
+    }
+    std::vector<unsigned int> ring, center;
+    for (int j = -half; j < half; ++j) {
+        for (int i = -half; i < half; ++i) {
+            unsigned int a = (j + half) * side + (i + half);
+            unsigned int b = a + side;
+            bool inHole = i >= -CLIPMAP_HOLE && i < CLIPMAP_HOLE && j >= -CLIPMAP_HOLE && j < CLIPMAP_HOLE;
+            std::vector<unsigned int>& target = inHole ? center : ring;
+            target.insert(target.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    terrain.ringIndexCount = (GLsizei)ring.size();
+    terrain.centerIndexCount = (GLsizei)center.size();
+    ring.insert(ring.end(), center.begin(), center.end());
+
+    glGenVertexArrays(1, &terrain.gridVAO);
+    glGenBuffers(1, &terrain.gridVBO);
+    glGenBuffers(1, &terrain.gridEBO);
+    glBindVertexArray(terrain.gridVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, terrain.gridVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrain.gridEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, ring.size() * sizeof(unsigned int), ring.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+    glBindVertexArray(0);
+
+    for (int level = 0; level < CLIPMAP_LEVELS; ++level) {
+        terrain.windowValid[level] = false;
+    }
+    terrain.program = LoadShaderProgram("shaders/terrain.glsl");
+    InitGpuTimer(terrain.timer);
+    return terrain.program != 0;
+}
+
+void DestroyTerrain(Terrain& terrain) {
+    glDeleteTextures(1, &terrain.heightTexture);
+    glDeleteVertexArrays(1, &terrain.gridVAO);
+    glDeleteBuffers(1, &terrain.gridVBO);
+    glDeleteBuffers(1, &terrain.gridEBO);
+    glDeleteProgram(terrain.program);
+    terrain.heightmap.close();
+    DestroyGpuTimer(terrain.timer);
+}
+
+void UpdateTerrain(Terrain& terrain, const TerrainSettings& settings, const glm::vec3& cameraPosition) {
+    terrain.uploadedTexels = 0;
+    terrain.cameraXZ = glm::vec2(cameraPosition.x, cameraPosition.z);
+    if (!settings.enabled) {
+        return;
+    }
+
+    const int size = CLIPMAP_TEXTURE_SIZE;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, terrain.heightTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    bool streaming = terrain.heightmap.is_open();
+    for (int level = 0; level < CLIPMAP_LEVELS; ++level) {
+        // Centers snap to every other vertex so each level lines up with the next coarser one
+        float spacing = settings.sampleSpacing * (1 << level);
+        glm::ivec2 center = 2 * glm::ivec2(glm::round(terrain.cameraXZ / (2.0f * spacing)));
+        glm::ivec2 start = center - size / 2;
+        glm::ivec2 previous = terrain.windowStart[level];
+        glm::ivec2 moved = start - previous;
+        terrain.center[level] = center;
+        terrain.windowStart[level] = start;
+
+        if (!terrain.windowValid[level] || std::abs(moved.x) >= size || std::abs(moved.y) >= size) {
+            StreamRegion(terrain, settings, level, start, glm::ivec2(size));
+            terrain.windowValid[level] = true;
+            continue;
+        }
+        // Newly exposed columns over the whole new window, then newly exposed rows over the
+        // columns that were already there
+        int keptStart = start.x, keptWidth = size;
+        if (moved.x > 0) {
+            StreamRegion(terrain, settings, level, glm::ivec2(previous.x + size, start.y), glm::ivec2(moved.x, size));
+            keptWidth = size - moved.x;
+        }
+        else if (moved.x < 0) {
+            StreamRegion(terrain, settings, level, start, glm::ivec2(-moved.x, size));
+            keptStart = previous.x;
+            keptWidth = size + moved.x;
+        }
+        if (moved.y > 0) {
+            StreamRegion(terrain, settings, level, glm::ivec2(keptStart, previous.y + size), glm::ivec2(keptWidth, moved.y));
+        }
+        else if (moved.y < 0) {
+            StreamRegion(terrain, settings, level, glm::ivec2(keptStart, start.y), glm::ivec2(keptWidth, -moved.y));
+        }
+    }
+    // A failed read switched to procedural heights midway; stream every level again next frame
+    if (streaming && !terrain.heightmap.is_open()) {
+        std::fill(std::begin(terrain.windowValid), std::end(terrain.windowValid), false);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+float SampleTerrainHeight(Terrain& terrain, const TerrainSettings& settings, glm::vec2 position) {
+    glm::vec2 grid = position / settings.sampleSpacing;
+    glm::ivec2 cell = glm::ivec2(glm::floor(grid));
+    glm::vec2 f = grid - glm::vec2(cell);
+    FetchHeights(terrain, settings, 0, cell, glm::ivec2(2));
+    const std::vector<float>& h = terrain.uploadBuffer;
+    return glm::mix(glm::mix(h[0], h[1], f.x), glm::mix(h[2], h[3], f.x), f.y);
+}
+
+void BuildTerrainHeightCache(TerrainHeightCache& cache, Terrain& terrain, const TerrainSettings& settings, float extent, int size) {
+    cache.size = size;
+    cache.extent = extent;
+    cache.spacing = 2.0f * extent / (size - 1);
+    cache.heights.resize(size * size);
+    for (int j = 0; j < size; ++j) {
+        for (int i = 0; i < size; ++i) {
+            glm::vec2 position = glm::vec2(i, j) * cache.spacing - extent;
+            cache.heights[j * size + i] = SampleTerrainHeight(terrain, settings, position);
+        }
+    }
+}
+
+void DrawTerrain(Terrain& terrain, const TerrainSettings& settings, const glm::mat4& view, const glm::mat4& projection,
+    const glm::mat4& prevViewProjection, const VolumetricFog& fog, const VolumetricFogSettings& fogSettings) {
+    if (!settings.enabled) {
+        return;
+    }
+    BeginGpuTimer(terrain.timer);
+
+    glUseProgram(terrain.program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, terrain.heightTexture);
+    glUniform1i(glGetUniformLocation(terrain.program, "uHeights"), 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, terrain.surfaceTexture);
+    glUniform1i(glGetUniformLocation(terrain.program, "uSurface"), 1);
+    glActiveTexture(GL_TEXTURE0);
+    BindVolumetricFog(fog, fogSettings, terrain.program, 2);
+
+    glm::mat4 viewProjection = projection * view;
+    glUniformMatrix4fv(glGetUniformLocation(terrain.program, "uViewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+    glUniformMatrix4fv(glGetUniformLocation(terrain.program, "uPrevViewProjection"), 1, GL_FALSE, glm::value_ptr(prevViewProjection));
+    glUniform1f(glGetUniformLocation(terrain.program, "uTextureScale"), settings.textureScale);
+
+    glBindVertexArray(terrain.gridVAO);
+    for (int level = 0; level < CLIPMAP_LEVELS; ++level) {
+        float spacing = settings.sampleSpacing * (1 << level);
+        glUniform1i(glGetUniformLocation(terrain.program, "uLevel"), level);
+        glUniform1f(glGetUniformLocation(terrain.program, "uSpacing"), spacing);
+        glUniform2i(glGetUniformLocation(terrain.program, "uCenter"), terrain.center[level].x, terrain.center[level].y);
+        glUniform2fv(glGetUniformLocation(terrain.program, "uCameraGrid"), 1, glm::value_ptr(terrain.cameraXZ / spacing));
+
+        // The ring's leftover overlap with the finer level is discarded per fragment
+        glUniform1i(glGetUniformLocation(terrain.program, "uHasFiner"), level > 0);
+        if (level > 0) {
+            float finerSpacing = spacing * 0.5f;
+            glm::vec2 finerCenter = glm::vec2(terrain.center[level - 1]) * finerSpacing;
+            float finerHalf = CLIPMAP_GRID / 2 * finerSpacing;
+            glUniform4f(glGetUniformLocation(terrain.program, "uFinerBounds"),
+                finerCenter.x - finerHalf, finerCenter.y - finerHalf, finerCenter.x + finerHalf, finerCenter.y + finerHalf);
+        }
+        GLsizei count = level == 0 ? terrain.ringIndexCount + terrain.centerIndexCount : terrain.ringIndexCount;
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, 0);
+    }
+    glBindVertexArray(0);
+
+    EndGpuTimer(terrain.timer);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "GpuTimer.h"
+#include "VolumetricFog.h"
+
+// Geometry clipmap terrain (Losasso & Hoppe 2004).
+// Every level draws the same grid around the camera at twice the spacing of the one inside it,
+// with its heights in one layer of a texture array. Each layer is addressed toroidally (grid
+// coordinate mod size), so when the camera moves only the newly exposed rows and columns are
+// read from the heightmap and uploaded. Memory and vertex count depend on the level count only.
+const int CLIPMAP_LEVELS = 7;
+const int CLIPMAP_TEXTURE_SIZE = 256;   // Texels per layer side
+const int CLIPMAP_GRID = 252;           // Cells per level side; a multiple of 4 so inner levels land on outer vertices
+const int CLIPMAP_HOLE = CLIPMAP_GRID / 4 - 1;  // Half width, in cells, of the ring's hole that the next finer level always covers
+
+struct TerrainSettings {
+    bool enabled = true;
+    std::string heightmapPath = "assets/terrain.r16";  // Square raw 16-bit little endian heights
+    int heightmapSize = 16384;       // Samples per side of the file
+    float sampleSpacing = 0.5f;      // World units between heightmap samples, also the finest grid spacing
+    float heightScale = 120.0f;      // World height of the largest sample value
+    float baseHeight = -0.05f;       // Sits just below the scene's own ground
+    float flatRadius = 20.0f;        // Terrain is flattened to baseHeight inside this radius around the scene
+    float textureScale = 0.25f;      // Surface texture repeats per world unit
+};
+
+struct Terrain {
+    GLuint heightTexture = 0;        // R32F array, one toroidal layer per level
+    GLuint gridVAO = 0, gridVBO = 0, gridEBO = 0;
+    GLsizei ringIndexCount = 0;      // The ring comes first in the index buffer, the center patch after it
+    GLsizei centerIndexCount = 0;
+    GLuint program = 0;
+    GLuint surfaceTexture = 0;
+
+    glm::ivec2 center[CLIPMAP_LEVELS];       // Grid coordinate under the camera, snapped to even
+    glm::ivec2 windowStart[CLIPMAP_LEVELS];  // First grid coordinate held by each layer
+    bool windowValid[CLIPMAP_LEVELS] = {};
+    std::ifstream heightmap;         // Falls back to procedural heights when the file is missing
+    std::vector<unsigned short> rowBuffer;
+    std::vector<float> uploadBuffer;
+    int uploadedTexels = 0;          // This frame, for the GUI
+    glm::vec2 cameraXZ = glm::vec2(0.0f);
+
+    GpuTimer timer;
+};
+
+// Terrain heights cached on a regular grid over a square around the origin, for CPU code that
+// samples the ground every frame and shouldn't go through the streaming source
+struct TerrainHeightCache {
+    std::vector<float> heights;
+    int size = 0;                    // Samples per side
+    float extent = 0.0f;             // Half width of the square
+    float spacing = 1.0f;
+};
+
+bool InitTerrain(Terrain& terrain, const TerrainSettings& settings);
+void DestroyTerrain(Terrain& terrain);
+
+// Moves every level's window to the camera, streaming in only the strips it has not seen
+void UpdateTerrain(Terrain& terrain, const TerrainSettings& settings, const glm::vec3& cameraPosition);
+
+// Height of the terrain at a world xz, read from the same source the clipmap streams from
+float SampleTerrainHeight(Terrain& terrain, const TerrainSettings& settings, glm::vec2 position);
+
+void BuildTerrainHeightCache(TerrainHeightCache& cache, Terrain& terrain, const TerrainSettings& settings, float extent, int size);
+
+// Bilinear; positions outside the square clamp to its edge
+inline float SampleTerrainHeightCache(const TerrainHeightCache& cache, float x, float z) {
+    glm::vec2 grid = glm::clamp((glm::vec2(x, z) + cache.extent) / cache.spacing, 0.0f, cache.size - 1.001f);
+    glm::ivec2 cell = glm::ivec2(grid);
+    glm::vec2 f = grid - glm::vec2(cell);
+    const float* row = &cache.heights[cell.y * cache.size + cell.x];
+    return glm::mix(glm::mix(row[0], row[1], f.x), glm::mix(row[cache.size], row[cache.size + 1], f.x), f.y);
+}
+
+// Draws into the bound scene target; prevViewProjection gives the motion vectors
+void DrawTerrain(Terrain& terrain, const TerrainSettings& settings, const glm::mat4& view, const glm::mat4& projection,
+    const glm::mat4& prevViewProjection, const VolumetricFog& fog, const VolumetricFogSettings& fogSettings);
@@ -0,0 +1,79 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+static void RunChunks(ThreadPool& pool) {
+    for (;;) {
+        int begin = pool.next.fetch_add(pool.grain);
+        if (begin >= pool.count) {
+            return;
+        }
+        pool.body(begin, std::min(begin + pool.grain, pool.count));
+    }
+}
+
+static void WorkerLoop(ThreadPool& pool) {
+    unsigned int seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(pool.mutex);
+            pool.wake.wait(lock, [&] { return pool.quit || pool.generation != seen; });
+            if (pool.quit) {
+                return;
+            }
+            seen = pool.generation;
+        }
+        RunChunks(pool);
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.busyWorkers--;
+        }
+        pool.finished.notify_one();
+    }
+}
+
+void InitThreadPool(ThreadPool& pool, int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+    }
+    pool.quit = false;
+    for (int i = 0; i < threadCount; ++i) {
+        pool.workers.emplace_back(WorkerLoop, std::ref(pool));
+    }
+}
+
+void DestroyThreadPool(ThreadPool& pool) {
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.quit = true;
+    }
+    pool.wake.notify_all();
+    for (std::thread& worker : pool.workers) {
+        worker.join();
+    }
+    pool.workers.clear();
+}
+
+void ParallelFor(ThreadPool& pool, int count, int grain, const std::function<void(int, int)>& body) {
+    if (count <= 0) {
+        return;
+    }
+    grain = std::max(grain, 1);
+    // Not worth waking anyone for a single chunk
+    if (pool.workers.empty() || count <= grain) {
+        body(0, count);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.body = body;
+        pool.count = count;
+        pool.grain = grain;
+        pool.next = 0;
+        pool.busyWorkers = (int)pool.workers.size();
+        pool.generation++;
+    }
+    pool.wake.notify_all();
+    RunChunks(pool);
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.finished.wait(lock, [&] { return pool.busyWorkers == 0; });
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. ParallelFor hands out index ranges of
+// 'grain' items from a shared counter; the calling thread works too and returns once every
+// range is done. One loop runs at a time.
+struct ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::function<void(int, int)> body;
+    int count = 0;
+    int grain = 1;
+    std::atomic<int> next{ 0 };
+    int busyWorkers = 0;
+    unsigned int generation = 0;
+    bool quit = false;
+};
+
+// threadCount 0 uses one worker per hardware thread besides the caller
+void InitThreadPool(ThreadPool& pool, int threadCount = 0);
+void DestroyThreadPool(ThreadPool& pool);
+
+// Calls body(begin, end) over [0, count) in chunks of at most 'grain'
+void ParallelFor(ThreadPool& pool, int count, int grain, const std::function<void(int, int)>& body);
@@ -0,0 +1,95 @@
+#include "VertexAnimation.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+bool BakeVertexAnimation(const SkinnedModel& model, const glm::mat4& root, float framesPerSecond, VertexAnimation& animation) {
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    int vertexCount = (int)model.vertices.size();
+    if (vertexCount == 0 || vertexCount > maxTextureSize || model.clips.empty() || model.clips.size() > VAT_MAX_CLIPS) {
+        std::cerr << "ERROR::VAT::UNSUPPORTED_MODEL: " << vertexCount << " vertices, " << model.clips.size() << " clips" << std::endl;
+        return false;
+    }
+
+    animation.vertexCount = vertexCount;
+    animation.frameCount = 0;
+    animation.clips.clear();
+    for (const AnimationClip& clip : model.clips) {
+        VertexAnimationClip baked;
+        baked.name = clip.name;
+        baked.firstFrame = animation.frameCount;
+        baked.frameCount = std::max((int)std::round(clip.duration * framesPerSecond), 1);
+        baked.duration = clip.duration;
+        animation.frameCount += baked.frameCount;
+        animation.clips.push_back(baked);
+    }
+    if (animation.frameCount > maxTextureSize) {
+        std::cerr << "ERROR::VAT::TOO_MANY_FRAMES: " << animation.frameCount << std::endl;
+        return false;
+    }
+
+    // Skin every frame on the CPU once; rows hold position, normal pairs like SkinVertices writes them
+    std::vector<glm::vec4> rest;
+    for (const Vertex& v : model.vertices) {
+        rest.push_back(glm::vec4(v.Position[0], v.Position[1], v.Position[2], 1.0f));
+        rest.push_back(glm::vec4(v.Normal[0], v.Normal[1], v.Normal[2], 0.0f));
+    }
+    std::vector<glm::vec4> skinned(rest.size());
+    std::vector<glm::vec4> positions((size_t)vertexCount * animation.frameCount);
+    std::vector<glm::vec4> normals(positions.size());
+    std::vector<glm::mat4> world, palette(model.skeleton.parents.size());
+    Pose pose;
+    for (size_t c = 0; c < model.clips.size(); ++c) {
+        const VertexAnimationClip& baked = animation.clips[c];
+        for (int f = 0; f < baked.frameCount; ++f) {
+            SampleClip(model.clips[c], model.skeleton, baked.duration * f / baked.frameCount, pose);
+            ComputeSkinningMatrices(model.skeleton, pose, root, world, palette.data());
+            SkinVertices(palette.data(), model.skin.data(), rest.data(), skinned.data(), 0, vertexCount);
+            size_t row = (size_t)(baked.firstFrame + f) * vertexCount;
+            for (int v = 0; v < vertexCount; ++v) {
+                positions[row + v] = skinned[v * 2];
+                normals[row + v] = glm::vec4(glm::normalize(glm::vec3(skinned[v * 2 + 1])), 0.0f);
+            }
+        }
+    }
+
+    glGenTextures(1, &animation.positionTexture);
+    glBindTexture(GL_TEXTURE_2D, animation.positionTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, vertexCount, animation.frameCount, 0, GL_RGBA, GL_FLOAT, positions.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenTextures(1, &animation.normalTexture);
+    glBindTexture(GL_TEXTURE_2D, animation.normalTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8_SNORM, vertexCount, animation.frameCount, 0, GL_RGBA, GL_FLOAT, normals.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return true;
+}
+
+void DestroyVertexAnimation(VertexAnimation& animation) {
+    glDeleteTextures(1, &animation.positionTexture);
+    glDeleteTextures(1, &animation.normalTexture);
+    animation.positionTexture = animation.normalTexture = 0;
+}
+
+void BindVertexAnimation(const VertexAnimation& animation, GLuint program, int unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, animation.positionTexture);
+    glActiveTexture(GL_TEXTURE0 + unit + 1);
+    glBindTexture(GL_TEXTURE_2D, animation.normalTexture);
+    glUniform1i(glGetUniformLocation(program, "uVatPositions"), unit);
+    glUniform1i(glGetUniformLocation(program, "uVatNormals"), unit + 1);
+
+    GLint frames[VAT_MAX_CLIPS * 2] = {};
+    float durations[VAT_MAX_CLIPS] = {};
+    for (size_t i = 0; i < animation.clips.size(); ++i) {
+        frames[i * 2] = animation.clips[i].firstFrame;
+        frames[i * 2 + 1] = animation.clips[i].frameCount;
+        durations[i] = animation.clips[i].duration;
+    }
+    glUniform2iv(glGetUniformLocation(program, "uVatClipFrames"), VAT_MAX_CLIPS, frames);
+    glUniform1fv(glGetUniformLocation(program, "uVatClipDurations"), VAT_MAX_CLIPS, durations);
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "Animation.h"
+
+// Vertex animation textures (VAT).
+// Every clip of a skinned model is sampled at a fixed frame rate when loading, and the skinned
+// vertices are written to two textures with one texel per vertex (x) per frame (y): object space
+// position and normal. An instance then plays a clip in the vertex shader by fetching its
+// vertex in the two frames around its clip time and interpolating, so animating it costs no
+// CPU work at all. Memory grows with vertices times frames, so this suits small, short loops.
+const int VAT_MAX_CLIPS = 8;
+
+struct VertexAnimationClip {
+    std::string name;
+    int firstFrame = 0;        // Row of the clip's first frame
+    int frameCount = 1;        // Frames loop: the last one interpolates back to the first
+    float duration = 1.0f;     // Seconds
+};
+
+struct VertexAnimation {
+    GLuint positionTexture = 0;  // RGBA16F object space position
+    GLuint normalTexture = 0;    // RGBA8_SNORM object space normal
+    int vertexCount = 0;
+    int frameCount = 0;          // Rows over all clips
+    std::vector<VertexAnimationClip> clips;
+};
+
+// Bakes every clip under the 'root' transform; fails if the model has too many vertices or clips
+bool BakeVertexAnimation(const SkinnedModel& model, const glm::mat4& root, float framesPerSecond, VertexAnimation& animation);
+void DestroyVertexAnimation(VertexAnimation& animation);
+
+// Binds the textures to 'unit' and 'unit' + 1 and sets the vat_common.glsl uniforms
+void BindVertexAnimation(const VertexAnimation& animation, GLuint program, int unit);
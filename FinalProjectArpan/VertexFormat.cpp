@@ -0,0 +1,161 @@
+#include "VertexFormat.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+static unsigned short Unorm16(float value) {
+    return (unsigned short)std::lround(glm::clamp(value, 0.0f, 1.0f) * 65535.0f);
+}
+
+static glm::vec3 OctahedralDecode(glm::vec2 e) {
+    glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+// Of the four roundings around the exact encoding, keeps the one that decodes closest to n
+template <typename T>
+static void OctahedralEncode(glm::vec3 n, T out[2]) {
+    const float steps = (float)std::numeric_limits<T>::max();
+    out[0] = out[1] = 0;
+    if (glm::dot(n, n) == 0.0f) {
+        return;
+    }
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f) {
+        e = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    glm::vec2 base = glm::floor(glm::clamp(e, -1.0f, 1.0f) * steps);
+    float best = -2.0f;
+    for (int corner = 0; corner < 4; ++corner) {
+        glm::vec2 candidate = glm::clamp(base + glm::vec2(corner & 1, corner >> 1), -steps, steps);
+        float cosine = glm::dot(OctahedralDecode(candidate / steps), n / glm::length(n));
+        if (cosine > best) {
+            best = cosine;
+            out[0] = (T)candidate.x;
+            out[1] = (T)candidate.y;
+        }
+    }
+}
+
+static void PackVertex(const Vertex& v, const Mesh&, Vertex& out) {
+    out = v;
+}
+
+template <typename Packed>
+static void PackCompactVertex(const Vertex& v, const Mesh& mesh, Packed& out) {
+    for (int i = 0; i < 3; ++i) {
+        out.position[i] = Unorm16((v.Position[i] - mesh.positionOffset[i]) / mesh.positionScale[i]);
+    }
+    for (int i = 0; i < 2; ++i) {
+        out.texCoords[i] = Unorm16((v.TexCoords[i] - mesh.texCoordOffset[i]) / mesh.texCoordScale[i]);
+    }
+    OctahedralEncode(glm::vec3(v.Normal[0], v.Normal[1], v.Normal[2]), out.normal);
+}
+
+static void PackVertex(const Vertex& v, const Mesh& mesh, Compact16Vertex& out) {
+    PackCompactVertex(v, mesh, out);
+    out.position[3] = 0;
+}
+
+static void PackVertex(const Vertex& v, const Mesh& mesh, Compact12Vertex& out) {
+    PackCompactVertex(v, mesh, out);
+}
+
+template <typename Layout>
+static void UploadVertices(const Mesh& mesh) {
+    std::vector<typename Layout::Packed> packed(mesh.vertices.size());
+    for (size_t i = 0; i < packed.size(); ++i) {
+        PackVertex(mesh.vertices[i], mesh, packed[i]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(typename Layout::Packed), packed.data(), GL_STATIC_DRAW);
+    SetupVertexAttributes<Layout>();
+}
+
+void UploadMeshBuffers(Mesh& mesh, int format, bool shortIndices) {
+    if (mesh.VAO == 0) {
+        glGenVertexArrays(1, &mesh.VAO);
+        glGenBuffers(1, &mesh.VBO);
+        glGenBuffers(1, &mesh.EBO);
+    }
+    mesh.vertexFormat = format;
+    mesh.indexType = shortIndices && mesh.vertices.size() <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+    // Quantization spans the mesh's own bounds; float vertices decode with the identity
+    glm::vec3 positionMin(0.0f), positionMax(1.0f);
+    glm::vec2 texCoordMin(0.0f), texCoordMax(1.0f);
+    if (VERTEX_FORMATS[format].quantized && !mesh.vertices.empty()) {
+        positionMin = glm::vec3(1e30f);
+        positionMax = glm::vec3(-1e30f);
+        texCoordMin = glm::vec2(1e30f);
+        texCoordMax = glm::vec2(-1e30f);
+        for (const Vertex& v : mesh.vertices) {
+            positionMin = glm::min(positionMin, glm::vec3(v.Position[0], v.Position[1], v.Position[2]));
+            positionMax = glm::max(positionMax, glm::vec3(v.Position[0], v.Position[1], v.Position[2]));
+            texCoordMin = glm::min(texCoordMin, glm::vec2(v.TexCoords[0], v.TexCoords[1]));
+            texCoordMax = glm::max(texCoordMax, glm::vec2(v.TexCoords[0], v.TexCoords[1]));
+        }
+    }
+    mesh.positionOffset = positionMin;
+    mesh.positionScale = glm::max(positionMax - positionMin, glm::vec3(1e-6f));
+    mesh.texCoordOffset = texCoordMin;
+    mesh.texCoordScale = glm::max(texCoordMax - texCoordMin, glm::vec2(1e-6f));
+
+    glBindVertexArray(mesh.VAO);
+    switch (format) {
+    case VERTEX_FORMAT_COMPACT16:
+        UploadVertices<Compact16VertexLayout>(mesh);
+        break;
+    case VERTEX_FORMAT_COMPACT12:
+        UploadVertices<Compact12VertexLayout>(mesh);
+        break;
+    default:
+        UploadVertices<FloatVertexLayout>(mesh);
+        break;
+    }
+    glBindVertexArray(0);
+    UploadMeshIndices(mesh);
+}
+
+void UploadMeshIndices(Mesh& mesh) {
+    // The VAO keeps the element buffer binding, so write it through the VAO
+    glBindVertexArray(mesh.VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    if (mesh.indexType == GL_UNSIGNED_SHORT) {
+        std::vector<unsigned short> shortIndices(mesh.indices.begin(), mesh.indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+    }
+    else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+    }
+    glBindVertexArray(0);
+}
+
+void BindVertexDecode(GLuint program, const Mesh& mesh) {
+    glUniform3fv(glGetUniformLocation(program, "uPositionOffset"), 1, &mesh.positionOffset[0]);
+    glUniform3fv(glGetUniformLocation(program, "uPositionScale"), 1, &mesh.positionScale[0]);
+    glUniform2fv(glGetUniformLocation(program, "uTexCoordOffset"), 1, &mesh.texCoordOffset[0]);
+    glUniform2fv(glGetUniformLocation(program, "uTexCoordScale"), 1, &mesh.texCoordScale[0]);
+    glUniform1i(glGetUniformLocation(program, "uOctahedralNormals"), VERTEX_FORMATS[mesh.vertexFormat].octahedralNormals);
+}
+
+void BindFloatVertexDecode(GLuint program) {
+    glUniform3f(glGetUniformLocation(program, "uPositionOffset"), 0.0f, 0.0f, 0.0f);
+    glUniform3f(glGetUniformLocation(program, "uPositionScale"), 1.0f, 1.0f, 1.0f);
+    glUniform2f(glGetUniformLocation(program, "uTexCoordOffset"), 0.0f, 0.0f);
+    glUniform2f(glGetUniformLocation(program, "uTexCoordScale"), 1.0f, 1.0f);
+    glUniform1i(glGetUniformLocation(program, "uOctahedralNormals"), false);
+}
+
+size_t MeshVertexBytes(const Mesh& mesh) {
+    return mesh.vertices.size() * VERTEX_FORMATS[mesh.vertexFormat].stride;
+}
+
+size_t MeshIndexBytes(const Mesh& mesh) {
+    return mesh.indices.size() * (mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int));
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include "Mesh.h"
+
+// GPU vertex formats for the scene meshes.
+// Meshes keep their float vertices on the CPU (ray casts, collision, baking) and upload one of
+// these layouts. The compact ones store positions and texture coordinates as 16-bit unorm
+// relative to the mesh's bounds, and normals as two snorm components on an octahedron
+// (Cigolle et al. 2014). Each layout is a compile-time descriptor: its attribute list drives the
+// glVertexAttribPointer setup, and its flags pick the decode the vertex shader applies through
+// the uniforms in shaders/vertex_decode.glsl. Indices drop to 16 bits when every vertex fits.
+enum VertexFormat {
+    VERTEX_FORMAT_FLOAT,        // 32 bytes, as imported
+    VERTEX_FORMAT_COMPACT16,    // 16 bytes, 16-bit normals
+    VERTEX_FORMAT_COMPACT12,    // 12 bytes, 8-bit normals
+    VERTEX_FORMAT_COUNT
+};
+
+struct VertexFormatSettings {
+    int format = VERTEX_FORMAT_COMPACT16;
+    bool shortIndices = true;
+};
+
+struct VertexAttribute {
+    GLuint location;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+};
+
+struct FloatVertexLayout {
+    using Packed = Vertex;
+    static constexpr const char* name = "Float (32 bytes)";
+    static constexpr bool quantized = false;
+    static constexpr bool octahedralNormals = false;
+    static constexpr VertexAttribute attributes[] = {
+        { 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position) },
+        { 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal) },
+        { 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoords) },
+    };
+};
+
+struct Compact16Vertex {
+    unsigned short position[4];   // w pads to 4 byte alignment
+    short normal[2];
+    unsigned short texCoords[2];
+};
+static_assert(sizeof(Compact16Vertex) == 16, "Compact16Vertex must stay tightly packed");
+
+struct Compact16VertexLayout {
+    using Packed = Compact16Vertex;
+    static constexpr const char* name = "Compact (16 bytes)";
+    static constexpr bool quantized = true;
+    static constexpr bool octahedralNormals = true;
+    static constexpr VertexAttribute attributes[] = {
+        { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(Compact16Vertex, position) },
+        { 1, 2, GL_SHORT, GL_TRUE, offsetof(Compact16Vertex, normal) },
+        { 2, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(Compact16Vertex, texCoords) },
+    };
+};
+
+struct Compact12Vertex {
+    unsigned short position[3];
+    signed char normal[2];
+    unsigned short texCoords[2];
+};
+static_assert(sizeof(Compact12Vertex) == 12, "Compact12Vertex must stay tightly packed");
+
+struct Compact12VertexLayout {
+    using Packed = Compact12Vertex;
+    static constexpr const char* name = "Compact (12 bytes)";
+    static constexpr bool quantized = true;
+    static constexpr bool octahedralNormals = true;
+    static constexpr VertexAttribute attributes[] = {
+        { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(Compact12Vertex, position) },
+        { 1, 2, GL_BYTE, GL_TRUE, offsetof(Compact12Vertex, normal) },
+        { 2, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(Compact12Vertex, texCoords) },
+    };
+};
+
+struct VertexFormatInfo {
+    const char* name;
+    GLsizei stride;
+    bool quantized;
+    bool octahedralNormals;
+};
+
+template <typename Layout>
+constexpr VertexFormatInfo DescribeVertexFormat() {
+    return { Layout::name, (GLsizei)sizeof(typename Layout::Packed), Layout::quantized, Layout::octahedralNormals };
+}
+
+// Indexed by VertexFormat
+constexpr VertexFormatInfo VERTEX_FORMATS[VERTEX_FORMAT_COUNT] = {
+    DescribeVertexFormat<FloatVertexLayout>(),
+    DescribeVertexFormat<Compact16VertexLayout>(),
+    DescribeVertexFormat<Compact12VertexLayout>(),
+};
+
+// Points the bound VAO's attributes at the bound array buffer
+template <typename Layout>
+void SetupVertexAttributes() {
+    for (const VertexAttribute& attribute : Layout::attributes) {
+        glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized,
+            (GLsizei)sizeof(typename Layout::Packed), (void*)attribute.offset);
+        glEnableVertexAttribArray(attribute.location);
+    }
+}
+
+// (Re)creates the mesh's buffers from its CPU vertices and indices in the given format
+void UploadMeshBuffers(Mesh& mesh, int format, bool shortIndices);
+
+// Rewrites the element buffer from mesh.indices, in the mesh's index type
+void UploadMeshIndices(Mesh& mesh);
+
+// Decode uniforms for a mesh drawn with the scene shader, or the identity for float vertices
+void BindVertexDecode(GLuint program, const Mesh& mesh);
+void BindFloatVertexDecode(GLuint program);
+
+size_t MeshVertexBytes(const Mesh& mesh);
+size_t MeshIndexBytes(const Mesh& mesh);
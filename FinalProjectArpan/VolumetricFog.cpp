@@ -0,0 +1,97 @@
+#include "VolumetricFog.h"
+#include "Shader.h"
+#include <glm/gtc/type_ptr.hpp>
+
+const float FOG_NEAR = 0.1f;
+
+static GLuint CreateVolume() {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_3D, texture);
+    glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA16F, FOG_GRID_WIDTH, FOG_GRID_HEIGHT, FOG_GRID_DEPTH);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    return texture;
+}
+
+bool InitVolumetricFog(VolumetricFog& fog) {
+    fog.scatteringTexture = CreateVolume();
+    fog.integratedTexture = CreateVolume();
+
+    // Start fully transparent so a disabled fog leaves the scene untouched
+    const GLfloat clear[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    glClearTexImage(fog.integratedTexture, 0, GL_RGBA, GL_FLOAT, clear);
+
+    fog.injectProgram = LoadShaderProgram("shaders/fog_inject.glsl");
+    fog.integrateProgram = LoadShaderProgram("shaders/fog_integrate.glsl");
+    InitGpuTimer(fog.timer);
+    return fog.injectProgram && fog.integrateProgram;
+}
+
+void DestroyVolumetricFog(VolumetricFog& fog) {
+    glDeleteTextures(1, &fog.scatteringTexture);
+    glDeleteTextures(1, &fog.integratedTexture);
+    glDeleteProgram(fog.injectProgram);
+    glDeleteProgram(fog.integrateProgram);
+    DestroyGpuTimer(fog.timer);
+}
+
+void UpdateVolumetricFog(VolumetricFog& fog, const VolumetricFogSettings& settings, const glm::mat4& view, const glm::mat4& projection, float time) {
+    if (!settings.enabled) {
+        return;
+    }
+    BeginGpuTimer(fog.timer);
+
+    glm::mat4 inverseView = glm::inverse(view);
+    glm::vec2 projectionScale(projection[0][0], projection[1][1]);
+    glm::vec3 lightDirection = glm::normalize(settings.lightDirection);
+
+    // 1. Density and lighting per froxel
+    glUseProgram(fog.injectProgram);
+    glBindImageTexture(0, fog.scatteringTexture, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glUniformMatrix4fv(glGetUniformLocation(fog.injectProgram, "uInverseView"), 1, GL_FALSE, glm::value_ptr(inverseView));
+    glUniform2fv(glGetUniformLocation(fog.injectProgram, "uProjectionScale"), 1, glm::value_ptr(projectionScale));
+    glUniform2f(glGetUniformLocation(fog.injectProgram, "uFogRange"), FOG_NEAR, settings.range);
+    glUniform1f(glGetUniformLocation(fog.injectProgram, "uDensity"), settings.density);
+    glUniform1f(glGetUniformLocation(fog.injectProgram, "uHeightFalloff"), settings.heightFalloff);
+    glUniform1f(glGetUniformLocation(fog.injectProgram, "uBaseHeight"), settings.baseHeight);
+    glUniform3fv(glGetUniformLocation(fog.injectProgram, "uAlbedo"), 1, glm::value_ptr(settings.albedo));
+    glUniform3fv(glGetUniformLocation(fog.injectProgram, "uLightDirection"), 1, glm::value_ptr(lightDirection));
+    glUniform3fv(glGetUniformLocation(fog.injectProgram, "uLightColor"), 1, glm::value_ptr(settings.lightColor));
+    glUniform3fv(glGetUniformLocation(fog.injectProgram, "uAmbientColor"), 1, glm::value_ptr(settings.ambientColor));
+    glUniform1f(glGetUniformLocation(fog.injectProgram, "uAnisotropy"), settings.anisotropy);
+    glUniform1f(glGetUniformLocation(fog.injectProgram, "uSnowAmount"), settings.snowAmount);
+    glUniform1f(glGetUniformLocation(fog.injectProgram, "uSnowScale"), settings.snowScale);
+    glUniform1f(glGetUniformLocation(fog.injectProgram, "uSnowFallSpeed"), settings.snowFallSpeed);
+    glUniform1f(glGetUniformLocation(fog.injectProgram, "uTime"), time);
+    glDispatchCompute((FOG_GRID_WIDTH + 7) / 8, (FOG_GRID_HEIGHT + 7) / 8, FOG_GRID_DEPTH);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    // 2. Front to back integration, one thread per froxel column
+    glUseProgram(fog.integrateProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, fog.scatteringTexture);
+    glBindImageTexture(0, fog.integratedTexture, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glUniform1i(glGetUniformLocation(fog.integrateProgram, "uScattering"), 0);
+    glUniform2fv(glGetUniformLocation(fog.integrateProgram, "uProjectionScale"), 1, glm::value_ptr(projectionScale));
+    glUniform2f(glGetUniformLocation(fog.integrateProgram, "uFogRange"), FOG_NEAR, settings.range);
+    glDispatchCompute((FOG_GRID_WIDTH + 7) / 8, (FOG_GRID_HEIGHT + 7) / 8, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    EndGpuTimer(fog.timer);
+}
+
+void BindVolumetricFog(const VolumetricFog& fog, const VolumetricFogSettings& settings, GLuint program, int unit) {
+    // The sampler always gets its own unit, even when fog is off, so it never aliases texture1
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_3D, fog.integratedTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program, "uFogVolume"), unit);
+    glUniform1i(glGetUniformLocation(program, "uFog"), settings.enabled);
+    glUniform2f(glGetUniformLocation(program, "uFogRange"), FOG_NEAR, settings.range);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "GpuTimer.h"
+
+// Froxel volumetric fog.
+// A camera-aligned 3D grid is filled with density and lighting by one compute pass, then
+// integrated front to back by a second. shader_final.glsl applies the result with a single
+// 3D texture lookup per pixel, so the cost is set by the grid and not the screen resolution.
+const int FOG_GRID_WIDTH = 160;
+const int FOG_GRID_HEIGHT = 90;
+const int FOG_GRID_DEPTH = 64;
+
+struct VolumetricFogSettings {
+    bool enabled = true;
+    float density = 0.02f;
+    float heightFalloff = 0.25f;   // Density halves every ~2.8 units above baseHeight
+    float baseHeight = 0.0f;
+    float range = 80.0f;           // View depth covered by the grid; anything further gets the last slice
+    float anisotropy = 0.4f;       // Henyey-Greenstein g, positive scatters forward
+    glm::vec3 albedo = glm::vec3(0.9f, 0.95f, 1.0f);
+    glm::vec3 lightDirection = glm::vec3(-0.4f, 0.5f, -0.75f);  // Towards the moon
+    glm::vec3 lightColor = glm::vec3(2.0f, 2.1f, 2.4f);
+    glm::vec3 ambientColor = glm::vec3(0.15f, 0.18f, 0.28f);
+    float snowAmount = 0.5f;       // Extra density from falling snow
+    float snowScale = 1.5f;
+    float snowFallSpeed = 1.0f;
+};
+
+struct VolumetricFog {
+    GLuint scatteringTexture = 0;  // RGBA16F in-scattered light and extinction per froxel
+    GLuint integratedTexture = 0;  // RGBA16F accumulated light and transmittance from the camera
+    GLuint injectProgram = 0;
+    GLuint integrateProgram = 0;
+    GpuTimer timer;
+};
+
+bool InitVolumetricFog(VolumetricFog& fog);
+void DestroyVolumetricFog(VolumetricFog& fog);
+
+// Rebuilds the volume for this frame's camera; call before the scene is drawn
+void UpdateVolumetricFog(VolumetricFog& fog, const VolumetricFogSettings& settings, const glm::mat4& view, const glm::mat4& projection, float time);
+
+// Binds the integrated volume to 'unit' and sets the fog uniforms of a scene program
+void BindVolumetricFog(const VolumetricFog& fog, const VolumetricFogSettings& settings, GLuint program, int unit);
@@ -0,0 +1,111 @@
+#include "WindField.h"
+#include "Shader.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+
+bool InitWindField(WindField& wind) {
+    glGenTextures(2, wind.texture);
+    for (GLuint texture : wind.texture) {
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA16F, WIND_GRID_X, WIND_GRID_Y, WIND_GRID_Z);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    // Storage starts undefined; a NaN there would survive the reset blend and spread by advection
+    const GLfloat still[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (GLuint texture : wind.texture) {
+        glClearTexImage(texture, 0, GL_RGBA, GL_FLOAT, still);
+    }
+    wind.valid = false;
+    wind.updateProgram = LoadShaderProgram("shaders/wind_update.glsl");
+    InitGpuTimer(wind.timer);
+    return wind.updateProgram != 0;
+}
+
+void DestroyWindField(WindField& wind) {
+    glDeleteTextures(2, wind.texture);
+    glDeleteProgram(wind.updateProgram);
+    DestroyGpuTimer(wind.timer);
+}
+
+static void RunUpdate(WindField& wind, const WindSettings& settings, const glm::vec3& cameraPosition, float step, bool reset) {
+    // The volume snaps to whole cells so a moving camera doesn't smear the field
+    glm::vec3 cell = settings.extent / glm::vec3(WIND_GRID_X, WIND_GRID_Y, WIND_GRID_Z);
+    glm::vec3 origin = glm::floor((cameraPosition - settings.extent * glm::vec3(0.5f, 0.25f, 0.5f)) / cell) * cell;
+    int previous = wind.current;
+    int next = 1 - wind.current;
+
+    glUseProgram(wind.updateProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, wind.texture[previous]);
+    glUniform1i(glGetUniformLocation(wind.updateProgram, "uPrevious"), 0);
+    glBindImageTexture(0, wind.texture[next], 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glUniform3fv(glGetUniformLocation(wind.updateProgram, "uOrigin"), 1, glm::value_ptr(origin));
+    glUniform3fv(glGetUniformLocation(wind.updateProgram, "uPreviousOrigin"), 1, glm::value_ptr(wind.origin[previous]));
+    glUniform3fv(glGetUniformLocation(wind.updateProgram, "uExtent"), 1, glm::value_ptr(settings.extent));
+    glUniform3fv(glGetUniformLocation(wind.updateProgram, "uBaseVelocity"), 1, glm::value_ptr(settings.baseVelocity));
+    glUniform1f(glGetUniformLocation(wind.updateProgram, "uGustStrength"), settings.gustStrength);
+    glUniform1f(glGetUniformLocation(wind.updateProgram, "uGustScale"), std::max(settings.gustScale, 1.0f));
+    glUniform1f(glGetUniformLocation(wind.updateProgram, "uDeltaTime"), step);
+    glUniform1f(glGetUniformLocation(wind.updateProgram, "uRelax"), reset ? 1.0f : 1.0f - std::exp(-step / std::max(settings.relaxTime, 0.01f)));
+    glUniform1f(glGetUniformLocation(wind.updateProgram, "uTime"), wind.time);
+    glDispatchCompute(WIND_GRID_X / 4, WIND_GRID_Y / 4, WIND_GRID_Z / 4);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    wind.origin[next] = origin;
+    wind.current = next;
+    wind.updatesThisSecond++;
+}
+
+void UpdateWindField(WindField& wind, const WindSettings& settings, const glm::vec3& cameraPosition, float deltaTime) {
+    if (!settings.enabled) {
+        return;
+    }
+    float interval = 1.0f / std::max(settings.updateRate, 1.0f);
+    wind.time += deltaTime;
+    wind.accumulator += deltaTime;
+    wind.secondTimer += deltaTime;
+    if (wind.secondTimer >= 1.0f) {
+        wind.updatesPerSecond = wind.updatesThisSecond;
+        wind.updatesThisSecond = 0;
+        wind.secondTimer -= 1.0f;
+    }
+
+    BeginGpuTimer(wind.timer);
+    if (!wind.valid) {
+        // Fill both textures so the first blend has two states to work with
+        RunUpdate(wind, settings, cameraPosition, interval, true);
+        RunUpdate(wind, settings, cameraPosition, interval, true);
+        wind.valid = true;
+        wind.accumulator = 0.0f;
+    }
+    // Long stalls only run one catch-up step rather than a burst
+    if (wind.accumulator >= interval) {
+        RunUpdate(wind, settings, cameraPosition, interval, false);
+        wind.accumulator = std::min(wind.accumulator - interval, interval);
+    }
+    EndGpuTimer(wind.timer);
+}
+
+void BindWindField(const WindField& wind, const WindSettings& settings, GLuint program, int unit) {
+    int previous = 1 - wind.current;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_3D, wind.texture[wind.current]);
+    glActiveTexture(GL_TEXTURE0 + unit + 1);
+    glBindTexture(GL_TEXTURE_3D, wind.texture[previous]);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program, "uWindCurrent"), unit);
+    glUniform1i(glGetUniformLocation(program, "uWindPrevious"), unit + 1);
+    glUniform1i(glGetUniformLocation(program, "uWindEnabled"), settings.enabled && wind.valid);
+    glUniform3fv(glGetUniformLocation(program, "uWindOrigin"), 1, glm::value_ptr(wind.origin[wind.current]));
+    glUniform3fv(glGetUniformLocation(program, "uWindPreviousOrigin"), 1, glm::value_ptr(wind.origin[previous]));
+    glUniform3fv(glGetUniformLocation(program, "uWindExtent"), 1, glm::value_ptr(settings.extent));
+    glUniform1f(glGetUniformLocation(program, "uWindBlend"), std::clamp(wind.accumulator * settings.updateRate, 0.0f, 1.0f));
+    glUniform1f(glGetUniformLocation(program, "uWindTime"), wind.time);
+}
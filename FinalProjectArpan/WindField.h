@@ -0,0 +1,47 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "GpuTimer.h"
+
+// Shared wind velocity field.
+// A coarse 3D velocity grid follows the camera and is advected through itself by a compute
+// pass a fixed number of times per second. Each update also relaxes the field toward the base
+// wind plus travelling gust noise. Consumers sample it with wind_common.glsl, which blends the
+// last two updates so motion stays smooth between them. The cost depends on the grid size only,
+// not on how many trees or flakes read it.
+const int WIND_GRID_X = 32;
+const int WIND_GRID_Y = 16;
+const int WIND_GRID_Z = 32;
+
+struct WindSettings {
+    bool enabled = true;
+    glm::vec3 baseVelocity = glm::vec3(1.5f, 0.0f, 0.5f);
+    float gustStrength = 2.0f;
+    float gustScale = 40.0f;          // World size of a gust
+    float relaxTime = 1.5f;           // Seconds for the field to settle toward base wind plus gusts
+    float updateRate = 15.0f;         // Field updates per second
+    glm::vec3 extent = glm::vec3(256.0f, 64.0f, 256.0f);  // World size of the volume around the camera
+};
+
+struct WindField {
+    GLuint texture[2] = {};           // RGBA16F velocity, ping-ponged between updates
+    glm::vec3 origin[2] = {};         // World position of each texture's corner
+    int current = 0;
+    bool valid = false;
+    float accumulator = 0.0f;         // Seconds since the last update
+    float time = 0.0f;
+    int updatesThisSecond = 0, updatesPerSecond = 0;
+    float secondTimer = 0.0f;
+    GLuint updateProgram = 0;
+    GpuTimer timer;
+};
+
+bool InitWindField(WindField& wind);
+void DestroyWindField(WindField& wind);
+
+// Runs the field updates due after deltaTime
+void UpdateWindField(WindField& wind, const WindSettings& settings, const glm::vec3& cameraPosition, float deltaTime);
+
+// Binds the last two updates to 'unit' and 'unit' + 1 and sets the wind_common.glsl uniforms
+void BindWindField(const WindField& wind, const WindSettings& settings, GLuint program, int unit);
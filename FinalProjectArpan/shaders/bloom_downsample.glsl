@@ -0,0 +1,129 @@
+#shader compute
+#version 430 core
+
+// Single-pass bloom downsampler in the style of AMD's SPD.
+// Each 256-thread group reads a 64x64 tile of the HDR scene and writes bloom mips 0-5
+// through shared memory. The last group to finish (tracked by a global atomic counter)
+// reduces the whole of mip 5 into mips 6 and 7, so the pyramid needs one dispatch.
+layout(local_size_x = 256) in;
+
+layout(binding = 0) uniform sampler2D uSource;      // HDR scene color
+layout(r11f_g11f_b10f, binding = 0) coherent uniform image2D uMips[8];
+
+layout(std430, binding = 0) coherent buffer SpdCounter {
+    uint uGlobalCounter;
+};
+
+uniform ivec2 uSourceSize;
+uniform int uMipCount;       // Levels allocated in the bloom texture
+uniform uint uNumWorkGroups;
+uniform vec4 uThreshold;     // x: threshold, y: threshold - knee, z: 2 * knee, w: 0.25 / knee
+
+shared vec3 sTile[32][32];
+shared bool sIsLastGroup;
+
+float Luma(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Soft-knee threshold so bloom fades in instead of popping at the cutoff
+vec3 Prefilter(vec3 c) {
+    float brightness = max(c.r, max(c.g, c.b));
+    float soft = clamp(brightness - uThreshold.y, 0.0, uThreshold.z);
+    soft = soft * soft * uThreshold.w;
+    float contribution = max(soft, brightness - uThreshold.x) / max(brightness, 1e-4);
+    return c * contribution;
+}
+
+// Mip 0: four bilinear taps cover a 4x4 source footprint. Karis weighting keeps single
+// very bright pixels (the emissive material, specular sparkles) from flickering.
+vec3 DownsampleSource(ivec2 p) {
+    vec2 texel = 1.0 / vec2(uSourceSize);
+    vec2 uv = (vec2(p) * 2.0 + 1.0) * texel;
+    vec3 a = textureLod(uSource, uv + vec2(-texel.x, -texel.y), 0.0).rgb;
+    vec3 b = textureLod(uSource, uv + vec2( texel.x, -texel.y), 0.0).rgb;
+    vec3 c = textureLod(uSource, uv + vec2(-texel.x,  texel.y), 0.0).rgb;
+    vec3 d = textureLod(uSource, uv + vec2( texel.x,  texel.y), 0.0).rgb;
+    float wa = 1.0 / (1.0 + Luma(a));
+    float wb = 1.0 / (1.0 + Luma(b));
+    float wc = 1.0 / (1.0 + Luma(c));
+    float wd = 1.0 / (1.0 + Luma(d));
+    vec3 color = (a * wa + b * wb + c * wc + d * wd) / (wa + wb + wc + wd);
+    return Prefilter(min(color, vec3(65000.0)));
+}
+
+// Reduces the tile in shared memory from 'size' to 'size / 2' texels per side, repeatedly,
+// writing each level to its mip starting at 'firstMip'
+void ReduceTile(int size, int firstMip, int lastMip, ivec2 tileOrigin) {
+    uint t = gl_LocalInvocationIndex;
+    for (int mip = firstMip; mip <= lastMip; mip++) {
+        size /= 2;
+        bool isActive = t < uint(size * size);
+        ivec2 p = ivec2(int(t) % max(size, 1), int(t) / max(size, 1));
+        vec3 v = vec3(0.0);
+        if (isActive) {
+            v = 0.25 * (sTile[2 * p.y][2 * p.x] + sTile[2 * p.y][2 * p.x + 1] +
+                        sTile[2 * p.y + 1][2 * p.x] + sTile[2 * p.y + 1][2 * p.x + 1]);
+        }
+        barrier();
+        if (isActive) {
+            sTile[p.y][p.x] = v;
+            if (mip < uMipCount) {
+                imageStore(uMips[mip], tileOrigin * size + p, vec4(v, 1.0));
+            }
+        }
+        barrier();
+    }
+}
+
+void main() {
+    uint t = gl_LocalInvocationIndex;
+    ivec2 group = ivec2(gl_WorkGroupID.xy);
+
+    // Mip 0: 32x32 texels per group, four per thread
+    for (int i = 0; i < 4; i++) {
+        int index = int(t) + i * 256;
+        ivec2 p = ivec2(index % 32, index / 32);
+        vec3 v = DownsampleSource(group * 32 + p);
+        sTile[p.y][p.x] = v;
+        imageStore(uMips[0], group * 32 + p, vec4(v, 1.0));
+    }
+    barrier();
+
+    // Mips 1-5 stay inside the group
+    ReduceTile(32, 1, 5, group);
+
+    if (uMipCount <= 6) {
+        return;
+    }
+
+    // Publish this group's mip 5 texel and find out whether we are the last group
+    memoryBarrierImage();
+    barrier();
+    if (t == 0u) {
+        sIsLastGroup = atomicAdd(uGlobalCounter, 1u) == uNumWorkGroups - 1u;
+    }
+    barrier();
+    if (!sIsLastGroup) {
+        return;
+    }
+    if (t == 0u) {
+        uGlobalCounter = 0u;
+    }
+
+    // Mip 6 from the whole of mip 5 (up to 64x64 texels, enough for 4K scenes)
+    ivec2 last = imageSize(uMips[5]) - 1;
+    for (int i = 0; i < 4; i++) {
+        int index = int(t) + i * 256;
+        ivec2 p = ivec2(index % 32, index / 32);
+        vec3 v = 0.25 * (imageLoad(uMips[5], min(p * 2, last)).rgb +
+                         imageLoad(uMips[5], min(p * 2 + ivec2(1, 0), last)).rgb +
+                         imageLoad(uMips[5], min(p * 2 + ivec2(0, 1), last)).rgb +
+                         imageLoad(uMips[5], min(p * 2 + ivec2(1, 1), last)).rgb);
+        sTile[p.y][p.x] = v;
+        imageStore(uMips[6], p, vec4(v, 1.0));
+    }
+    barrier();
+
+    ReduceTile(32, 7, 7, ivec2(0));
+}
@@ -0,0 +1,37 @@
+#shader compute
+#version 430 core
+
+// Adds a 3x3 tent-filtered copy of bloom mip uSourceMip onto mip uSourceMip - 1.
+// Run from the smallest mip up; mip 0 then holds the combined bloom of every level.
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler2D uBloom;
+layout(r11f_g11f_b10f, binding = 0) uniform image2D uTarget;  // Level uSourceMip - 1
+
+uniform int uSourceMip;
+uniform float uRadius;
+
+void main() {
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(uTarget);
+    if (p.x >= size.x || p.y >= size.y) {
+        return;
+    }
+
+    vec2 uv = (vec2(p) + 0.5) / vec2(size);
+    vec2 d = uRadius / vec2(textureSize(uBloom, uSourceMip));
+    float lod = float(uSourceMip);
+
+    vec3 up = textureLod(uBloom, uv, lod).rgb * 4.0;
+    up += (textureLod(uBloom, uv + vec2(-d.x, 0.0), lod).rgb +
+           textureLod(uBloom, uv + vec2( d.x, 0.0), lod).rgb +
+           textureLod(uBloom, uv + vec2(0.0, -d.y), lod).rgb +
+           textureLod(uBloom, uv + vec2(0.0,  d.y), lod).rgb) * 2.0;
+    up += textureLod(uBloom, uv + vec2(-d.x, -d.y), lod).rgb +
+          textureLod(uBloom, uv + vec2( d.x, -d.y), lod).rgb +
+          textureLod(uBloom, uv + vec2(-d.x,  d.y), lod).rgb +
+          textureLod(uBloom, uv + vec2( d.x,  d.y), lod).rgb;
+    up *= 1.0 / 16.0;
+
+    imageStore(uTarget, p, vec4(imageLoad(uTarget, p).rgb + up, 1.0));
+}
@@ -0,0 +1,102 @@
+#shader vertex
+#version 430 core
+
+// Vertex-animated crowd: each instance plays its own clip from the vertex animation textures
+layout(location = 2) in vec2 aTexCoords;
+
+#include "vat_common.glsl"
+
+struct CrowdInstance {
+    vec4 placement;        // Position, heading
+    uint clip;
+    float timeOffset;
+    float playbackRate;
+    float scale;
+};
+
+layout(std430, binding = 0) readonly buffer Instances { CrowdInstance instances[]; };
+layout(std430, binding = 1) readonly buffer PrevInstances { CrowdInstance prevInstances[]; };
+
+uniform mat4 uViewProjection;
+uniform mat4 uPrevViewProjection;
+uniform float uTime;
+uniform float uPrevTime;
+
+out vec3 vNormal;
+out vec2 vTexCoords;
+out vec4 vClipPosition;
+out vec4 vPrevClipPosition;
+
+vec3 RotateHeading(vec3 v, float heading) {
+    float c = cos(heading), s = sin(heading);
+    return vec3(c * v.x + s * v.z, v.y, -s * v.x + c * v.z);
+}
+
+vec3 Place(CrowdInstance instance, vec3 p) {
+    return instance.placement.xyz + RotateHeading(p, instance.placement.w) * instance.scale;
+}
+
+void main() {
+    CrowdInstance instance = instances[gl_InstanceID];
+    vec3 position, normal, prevPosition, prevNormal;
+    SampleVertexAnimation(gl_VertexID, instance.clip, uTime * instance.playbackRate + instance.timeOffset, position, normal);
+    SampleVertexAnimation(gl_VertexID, instance.clip, uPrevTime * instance.playbackRate + instance.timeOffset, prevPosition, prevNormal);
+
+    vNormal = RotateHeading(normal, instance.placement.w);
+    vTexCoords = aTexCoords;
+    gl_Position = uViewProjection * vec4(Place(instance, position), 1.0);
+    vClipPosition = gl_Position;
+    vPrevClipPosition = uPrevViewProjection * vec4(Place(prevInstances[gl_InstanceID], prevPosition), 1.0);
+}
+
+
+#shader fragment
+#version 430 core
+
+in vec3 vNormal;
+in vec2 vTexCoords;
+in vec4 vClipPosition;
+in vec4 vPrevClipPosition;
+
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 FragNormal;
+layout(location = 2) out vec4 FragMotion;
+
+uniform sampler2D uAlbedo;
+
+#include "fog_common.glsl"
+uniform sampler3D uFogVolume;
+uniform bool uFog;
+
+const vec3 SUN_DIRECTION = vec3(-0.4, 0.5, -0.75);
+
+void main() {
+    vec3 normal = normalize(vNormal);
+
+    // u beyond 1 selects a flat material, see BuildProceduralSnowman
+    vec3 albedo;
+    if (vTexCoords.x >= 6.0) {
+        albedo = vec3(0.25, 0.15, 0.07);
+    }
+    else if (vTexCoords.x >= 4.0) {
+        albedo = vec3(0.03);
+    }
+    else if (vTexCoords.x >= 2.0) {
+        albedo = vec3(0.9, 0.35, 0.05);
+    }
+    else {
+        albedo = texture(uAlbedo, vTexCoords).rgb;
+    }
+    vec3 sun = normalize(SUN_DIRECTION);
+    vec3 color = albedo * (0.35 + 0.65 * max(dot(normal, sun), 0.0));
+    if (uFog) {
+        vec2 screenUV = vClipPosition.xy / vClipPosition.w * 0.5 + 0.5;
+        vec4 fog = texture(uFogVolume, FogVolumeCoord(screenUV, vClipPosition.w, float(textureSize(uFogVolume, 0).z)));
+        color = color * fog.a + fog.rgb;
+    }
+    FragColor = vec4(color, 1.0);
+    FragNormal = vec4(normal * 0.5 + 0.5, 1.0);
+    vec2 currentNdc = vClipPosition.xy / vClipPosition.w;
+    vec2 previousNdc = vPrevClipPosition.xy / vPrevClipPosition.w;
+    FragMotion = vec4((currentNdc - previousNdc) * 0.5, vPrevClipPosition.w - vClipPosition.w, 0.0);
+}
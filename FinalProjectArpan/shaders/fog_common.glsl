@@ -0,0 +1,19 @@
+// Depth slicing of the froxel fog volume, shared by the fog compute passes and shader_final.glsl
+// (included, not a program). Slices are spaced exponentially between the near and far range.
+
+uniform vec2 uFogRange;   // View depth covered by the volume: near, far
+
+// Normalized volume depth (0..1) of a view depth
+float FogDepthToSlice(float depth) {
+    return log(max(depth, uFogRange.x) / uFogRange.x) / log(uFogRange.y / uFogRange.x);
+}
+
+float FogSliceToDepth(float slice) {
+    return uFogRange.x * pow(uFogRange.y / uFogRange.x, slice);
+}
+
+// Volume coordinate for a screen uv and view depth. Integrated slice k holds the fog up to the
+// far edge of the slice, so shift back half a slice to sample it at that edge.
+vec3 FogVolumeCoord(vec2 uv, float depth, float sliceCount) {
+    return vec3(uv, FogDepthToSlice(depth) - 0.5 / sliceCount);
+}
@@ -0,0 +1,73 @@
+#shader compute
+#version 430 core
+
+// Fills every froxel with its in-scattered light (rgb) and extinction (a). Density is a height
+// fog plus a drifting noise term for falling snow; lighting is one directional light and an ambient sky term.
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+layout(rgba16f, binding = 0) uniform writeonly image3D uScattering;
+
+#include "fog_common.glsl"
+
+uniform mat4 uInverseView;
+uniform vec2 uProjectionScale;  // P[0][0], P[1][1]
+
+uniform float uDensity;
+uniform float uHeightFalloff;
+uniform float uBaseHeight;
+uniform vec3 uAlbedo;
+uniform vec3 uLightDirection;   // Towards the light
+uniform vec3 uLightColor;
+uniform vec3 uAmbientColor;
+uniform float uAnisotropy;
+
+uniform float uSnowAmount;
+uniform float uSnowScale;
+uniform float uSnowFallSpeed;
+uniform float uTime;
+
+const float PI = 3.14159265;
+
+float Hash(vec3 p) {
+    p = fract(p * 0.3183099 + 0.1);
+    p *= 17.0;
+    return fract(p.x * p.y * p.z * (p.x + p.y + p.z));
+}
+
+float ValueNoise(vec3 x) {
+    vec3 i = floor(x);
+    vec3 f = fract(x);
+    f = f * f * (3.0 - 2.0 * f);
+    return mix(mix(mix(Hash(i + vec3(0, 0, 0)), Hash(i + vec3(1, 0, 0)), f.x),
+                   mix(Hash(i + vec3(0, 1, 0)), Hash(i + vec3(1, 1, 0)), f.x), f.y),
+               mix(mix(Hash(i + vec3(0, 0, 1)), Hash(i + vec3(1, 0, 1)), f.x),
+                   mix(Hash(i + vec3(0, 1, 1)), Hash(i + vec3(1, 1, 1)), f.x), f.y), f.z);
+}
+
+float HenyeyGreenstein(float cosTheta, float g) {
+    float g2 = g * g;
+    return (1.0 - g2) / (4.0 * PI * pow(1.0 + g2 - 2.0 * g * cosTheta, 1.5));
+}
+
+void main() {
+    ivec3 p = ivec3(gl_GlobalInvocationID);
+    ivec3 size = imageSize(uScattering);
+    if (any(greaterThanEqual(p, size))) {
+        return;
+    }
+
+    // Froxel center in world space
+    vec2 uv = (vec2(p.xy) + 0.5) / vec2(size.xy);
+    float depth = FogSliceToDepth((float(p.z) + 0.5) / float(size.z));
+    vec3 viewPosition = vec3((uv * 2.0 - 1.0) / uProjectionScale * depth, -depth);
+    vec3 worldPosition = (uInverseView * vec4(viewPosition, 1.0)).xyz;
+    vec3 viewDirection = normalize(worldPosition - uInverseView[3].xyz);
+
+    float density = uDensity * exp(-uHeightFalloff * max(worldPosition.y - uBaseHeight, 0.0));
+    // Snow haze: clumps of noise stretched vertically and scrolling down over time
+    vec3 snowPosition = vec3(worldPosition.x, worldPosition.y * 0.5 + uTime * uSnowFallSpeed, worldPosition.z) * uSnowScale;
+    density *= 1.0 + uSnowAmount * 4.0 * smoothstep(0.45, 1.0, ValueNoise(snowPosition));
+
+    vec3 light = uLightColor * HenyeyGreenstein(dot(viewDirection, uLightDirection), uAnisotropy) + uAmbientColor;
+    imageStore(uScattering, p, vec4(light * uAlbedo * density, density));
+}
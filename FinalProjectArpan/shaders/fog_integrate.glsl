@@ -0,0 +1,39 @@
+#shader compute
+#version 430 core
+
+// Walks each froxel column front to back once, turning per-froxel scattering and extinction
+// into in-scattered light (rgb) and transmittance (a) from the camera to every slice
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler3D uScattering;
+layout(rgba16f, binding = 0) uniform writeonly image3D uIntegrated;
+
+#include "fog_common.glsl"
+
+uniform vec2 uProjectionScale;  // P[0][0], P[1][1]
+
+void main() {
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    ivec3 size = imageSize(uIntegrated);
+    if (p.x >= size.x || p.y >= size.y) {
+        return;
+    }
+
+    // Slices are spaced in view depth; the ray through this column is longer by this factor
+    vec2 uv = (vec2(p) + 0.5) / vec2(size.xy);
+    float rayScale = length(vec3((uv * 2.0 - 1.0) / uProjectionScale, 1.0));
+
+    vec3 scattering = vec3(0.0);
+    float transmittance = 1.0;
+    for (int z = 0; z < size.z; z++) {
+        vec4 froxel = texelFetch(uScattering, ivec3(p, z), 0);
+        float thickness = (FogSliceToDepth(float(z + 1) / float(size.z)) - FogSliceToDepth(float(z) / float(size.z))) * rayScale;
+        float extinction = max(froxel.a, 1e-6);
+        float sliceTransmittance = exp(-extinction * thickness);
+
+        // Energy-conserving integration over the slice (Hillaire 2015)
+        scattering += transmittance * (froxel.rgb - froxel.rgb * sliceTransmittance) / extinction;
+        transmittance *= sliceTransmittance;
+        imageStore(uIntegrated, ivec3(p, z), vec4(scattering, transmittance));
+    }
+}
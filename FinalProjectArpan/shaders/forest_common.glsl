@@ -0,0 +1,65 @@
+// Shared by the forest programs (included, not a program). Include wind_common.glsl first.
+
+layout(std430, binding = 0) readonly buffer Trees {
+    vec4 trees[];            // Position, scale
+};
+
+layout(std430, binding = 1) readonly buffer Instances {
+    uvec2 instances[];       // Tree index, mesh fade (float bits) written by forest_cull.glsl
+};
+
+const vec3 SUN_DIRECTION = vec3(-0.4, 0.5, -0.75);
+
+uniform float uSway;
+
+// Horizontal bend of a point at relative height 'height' (0 at the base, ~1 at the tip) of a
+// tree, from the wind at its crown plus a little flutter of its own
+vec3 TreeSway(vec4 tree, uint index, float height) {
+    vec3 wind = SampleWind(tree.xyz + vec3(0.0, 0.7 * tree.w, 0.0));
+    float flutter = 1.0 + 0.15 * sin(uWindTime * 2.3 + float(index & 1023u));
+    return vec3(wind.x, 0.0, wind.z) * (uSway * tree.w * height * height * flutter);
+}
+
+// Fixed random yaw per tree
+float TreeAngle(uint index) {
+    uint h = index * 2654435761u;
+    h = (h ^ (h >> 15u)) * 2246822519u;
+    return float(h >> 8u) * (6.2831853 / 16777216.0);
+}
+
+vec3 RotateY(vec3 v, float angle) {
+    float c = cos(angle), s = sin(angle);
+    return vec3(c * v.x + s * v.z, v.y, -s * v.x + c * v.z);
+}
+
+// Screen-space threshold for the dithered cross-fade; the mesh keeps pixels below the fade and
+// the impostor the rest, so together they always cover the tree exactly once
+float FadeNoise(vec2 pixel) {
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+// Same slope shading as the terrain: flat ground at full brightness
+float ForestShade(vec3 normal) {
+    vec3 sun = normalize(SUN_DIRECTION);
+    return clamp(0.4 + 0.6 * dot(normal, sun) / sun.y, 0.45, 1.2);
+}
+
+// Hemi-octahedral mapping of upper hemisphere directions to [0,1]^2
+vec2 HemiOctEncode(vec3 direction) {
+    direction.y = max(direction.y, 0.0);
+    direction /= abs(direction.x) + abs(direction.y) + abs(direction.z);
+    return vec2(direction.x + direction.z, direction.x - direction.z) * 0.5 + 0.5;
+}
+
+vec3 HemiOctDecode(vec2 uv) {
+    vec2 e = uv * 2.0 - 1.0;
+    vec2 p = vec2(e.x + e.y, e.x - e.y) * 0.5;
+    return normalize(vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y));
+}
+
+// Image plane axes of an impostor frame seen from 'direction', as glm::lookAt builds them
+void FrameBasis(vec3 direction, out vec3 right, out vec3 up) {
+    vec3 worldUp = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, -1.0) : vec3(0.0, 1.0, 0.0);
+    right = normalize(cross(worldUp, direction));
+    up = cross(direction, right);
+}
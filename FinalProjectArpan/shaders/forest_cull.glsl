@@ -0,0 +1,91 @@
+#shader compute
+#version 430 core
+
+// One thread per tree: frustum test on the bounding sphere, then against the CPU occlusion
+// pyramid, then distance LOD. Trees inside the fade band go to both lists; the instance counts
+// of the two indirect commands are bumped atomically so the draws need no CPU readback.
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) readonly buffer Trees { vec4 trees[]; };
+layout(std430, binding = 1) writeonly buffer MeshInstances { uvec2 meshInstances[]; };
+layout(std430, binding = 2) writeonly buffer ImpostorInstances { uvec2 impostorInstances[]; };
+layout(std430, binding = 3) buffer Commands {
+    uint commands[10];       // Two DrawElementsIndirectCommand; instanceCount at 1 and 6
+};
+
+uniform vec4 uFrustum[6];
+uniform vec3 uCameraPosition;
+uniform vec3 uBoundsCenter;
+uniform float uBoundsRadius;
+uniform float uMeshDistance;
+uniform float uFadeRange;
+uniform float uMaxDistance;
+uniform uint uCount;
+
+// Farthest occluder 1/w per texel, mip levels halving down (see OcclusionCulling.h)
+uniform sampler2D uHiZ;
+uniform bool uOcclusion;
+uniform int uHiZLevels;
+uniform mat4 uOcclusionViewProjection;
+
+// True when the sphere's bounding box lies entirely behind the occluders
+bool Occluded(vec3 center, float radius) {
+    vec2 minimum = vec2(1e30), maximum = vec2(-1e30);
+    float nearestW = 1e30;
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = uOcclusionViewProjection * vec4(corner, 1.0);
+        if (clip.z < -clip.w) {
+            return false;
+        }
+        minimum = min(minimum, clip.xy / clip.w);
+        maximum = max(maximum, clip.xy / clip.w);
+        nearestW = min(nearestW, clip.w);
+    }
+    ivec2 size = textureSize(uHiZ, 0);
+    ivec2 low = clamp(ivec2((minimum * 0.5 + 0.5) * vec2(size)), ivec2(0), size - 1);
+    ivec2 high = clamp(ivec2((maximum * 0.5 + 0.5) * vec2(size)), ivec2(0), size - 1);
+    int level = 0;
+    while (level + 1 < uHiZLevels && any(greaterThan((high >> level) - (low >> level), ivec2(1)))) {
+        level++;
+    }
+    float farthest = 1e30;
+    for (int y = low.y >> level; y <= high.y >> level; y++) {
+        for (int x = low.x >> level; x <= high.x >> level; x++) {
+            farthest = min(farthest, texelFetch(uHiZ, ivec2(x, y), level).r);
+        }
+    }
+    return 1.0 / nearestW < farthest;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= uCount) {
+        return;
+    }
+    vec4 tree = trees[index];
+    vec3 center = tree.xyz + uBoundsCenter * tree.w;
+    float radius = uBoundsRadius * tree.w;
+    for (int i = 0; i < 6; i++) {
+        if (dot(uFrustum[i].xyz, center) + uFrustum[i].w < -radius) {
+            return;
+        }
+    }
+    float distance = length(center - uCameraPosition);
+    if (distance - radius > uMaxDistance) {
+        return;
+    }
+    if (uOcclusion && Occluded(center, radius)) {
+        return;
+    }
+
+    // 1 inside the mesh range, 0 beyond the band
+    float fade = clamp((uMeshDistance + 0.5 * uFadeRange - distance) / uFadeRange, 0.0, 1.0);
+    uvec2 instance = uvec2(index, floatBitsToUint(fade));
+    if (fade > 0.0) {
+        meshInstances[atomicAdd(commands[1], 1u)] = instance;
+    }
+    if (fade < 1.0) {
+        impostorInstances[atomicAdd(commands[6], 1u)] = instance;
+    }
+}
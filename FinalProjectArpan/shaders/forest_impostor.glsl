@@ -0,0 +1,117 @@
+#shader vertex
+#version 430 core
+
+// Camera-facing quad per far tree. The view direction in tree space picks a cell of the
+// hemi-octahedral frame grid; the three frames at that cell's triangle are blended, each read
+// by projecting the quad point onto that frame's image plane.
+#include "wind_common.glsl"
+#include "forest_common.glsl"
+
+uniform mat4 uViewProjection;
+uniform mat4 uPrevViewProjection;
+uniform vec3 uCameraPosition;
+uniform vec3 uBoundsCenter;
+uniform float uBoundsRadius;
+uniform int uFrames;
+
+out vec2 vAtlasCoord[3];
+flat out vec3 vWeights;
+flat out float vFade;
+flat out float vAngle;
+out vec4 vClipPosition;
+out vec4 vPrevClipPosition;
+
+void main() {
+    uvec2 instance = instances[gl_InstanceID];
+    vec4 tree = trees[instance.x];
+    float angle = TreeAngle(instance.x);
+    vec3 center = tree.xyz + uBoundsCenter * tree.w;
+    vec3 toCamera = RotateY(normalize(uCameraPosition - center), -angle);
+
+    float last = float(uFrames - 1);
+    vec2 grid = HemiOctEncode(toCamera) * last;
+    vec2 cell = min(floor(grid), vec2(last - 1.0));
+    vec2 f = grid - cell;
+    vec2 frames[3];
+    if (f.x + f.y < 1.0) {
+        frames[0] = cell; frames[1] = cell + vec2(1.0, 0.0); frames[2] = cell + vec2(0.0, 1.0);
+        vWeights = vec3(1.0 - f.x - f.y, f.x, f.y);
+    }
+    else {
+        frames[0] = cell + vec2(1.0); frames[1] = cell + vec2(1.0, 0.0); frames[2] = cell + vec2(0.0, 1.0);
+        vWeights = vec3(f.x + f.y - 1.0, 1.0 - f.y, 1.0 - f.x);
+    }
+
+    vec3 right, up;
+    FrameBasis(toCamera, right, up);
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec3 offset = (right * corner.x + up * corner.y) * uBoundsRadius;   // Tree space, unscaled
+    for (int i = 0; i < 3; i++) {
+        vec3 frameRight, frameUp;
+        FrameBasis(HemiOctDecode(frames[i] / last), frameRight, frameUp);
+        vec2 uv = vec2(dot(offset, frameRight), dot(offset, frameUp)) / uBoundsRadius * 0.5 + 0.5;
+        vAtlasCoord[i] = (frames[i] + uv) / float(uFrames);
+    }
+
+    float height = (uBoundsCenter.y + offset.y) / (2.0 * uBoundsCenter.y);
+    vec3 position = center + RotateY(offset, angle) * tree.w + TreeSway(tree, instance.x, max(height, 0.0));
+    vFade = uintBitsToFloat(instance.y);
+    vAngle = angle;
+    gl_Position = uViewProjection * vec4(position, 1.0);
+    vClipPosition = gl_Position;
+    vPrevClipPosition = uPrevViewProjection * vec4(position, 1.0);
+}
+
+
+#shader fragment
+#version 430 core
+
+in vec2 vAtlasCoord[3];
+flat in vec3 vWeights;
+flat in float vFade;
+flat in float vAngle;
+in vec4 vClipPosition;
+in vec4 vPrevClipPosition;
+
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 FragNormal;
+layout(location = 2) out vec4 FragMotion;
+
+uniform sampler2D uAlbedoAtlas;
+uniform sampler2D uNormalAtlas;
+
+#include "wind_common.glsl"
+#include "forest_common.glsl"
+#include "fog_common.glsl"
+uniform sampler3D uFogVolume;
+uniform bool uFog;
+
+void main() {
+    if (FadeNoise(gl_FragCoord.xy) < vFade) {
+        discard;
+    }
+    vec4 albedo = vec4(0.0);
+    vec3 normal = vec3(0.0);
+    for (int i = 0; i < 3; i++) {
+        vec4 sampleAlbedo = texture(uAlbedoAtlas, vAtlasCoord[i]);
+        albedo += vec4(sampleAlbedo.rgb * sampleAlbedo.a, sampleAlbedo.a) * vWeights[i];
+        normal += (texture(uNormalAtlas, vAtlasCoord[i]).xyz * 2.0 - 1.0) * sampleAlbedo.a * vWeights[i];
+    }
+    if (albedo.a < 0.5) {
+        discard;
+    }
+    albedo.rgb /= albedo.a;
+    normal = RotateY(normalize(normal + vec3(0.0, 1e-4, 0.0)), vAngle);
+
+    vec3 color = albedo.rgb * ForestShade(normal);
+    if (uFog) {
+        vec2 screenUV = vClipPosition.xy / vClipPosition.w * 0.5 + 0.5;
+        vec4 fog = texture(uFogVolume, FogVolumeCoord(screenUV, vClipPosition.w, float(textureSize(uFogVolume, 0).z)));
+        color = color * fog.a + fog.rgb;
+    }
+    FragColor = vec4(color, 1.0);
+    FragNormal = vec4(normal * 0.5 + 0.5, 1.0);
+    vec2 currentNdc = vClipPosition.xy / vClipPosition.w;
+    vec2 previousNdc = vPrevClipPosition.xy / vPrevClipPosition.w;
+    FragMotion = vec4((currentNdc - previousNdc) * 0.5, vPrevClipPosition.w - vClipPosition.w, 0.0);
+}
@@ -0,0 +1,97 @@
+#shader vertex
+#version 430 core
+
+// Instanced pine mesh. In bake mode the prototype is drawn on its own, in tree space, to fill
+// the impostor atlases.
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;   // u >= 2 marks foliage
+
+#include "wind_common.glsl"
+#include "forest_common.glsl"
+
+uniform bool uBake;
+uniform mat4 uViewProjection;
+uniform mat4 uPrevViewProjection;
+
+out vec3 vNormal;
+out vec2 vTexCoords;
+out float vFade;
+out vec4 vClipPosition;
+out vec4 vPrevClipPosition;
+
+void main() {
+    vec3 position = aPosition;
+    vec3 normal = aNormal;
+    vFade = 1.0;
+    if (!uBake) {
+        uvec2 instance = instances[gl_InstanceID];
+        vec4 tree = trees[instance.x];
+        float angle = TreeAngle(instance.x);
+        position = tree.xyz + RotateY(aPosition, angle) * tree.w + TreeSway(tree, instance.x, max(aPosition.y, 0.0));
+        normal = RotateY(aNormal, angle);
+        vFade = uintBitsToFloat(instance.y);
+    }
+    vNormal = normal;
+    vTexCoords = aTexCoords;
+    gl_Position = uViewProjection * vec4(position, 1.0);
+    vClipPosition = gl_Position;
+    vPrevClipPosition = uPrevViewProjection * vec4(position, 1.0);
+}
+
+
+#shader fragment
+#version 430 core
+
+in vec3 vNormal;
+in vec2 vTexCoords;
+in float vFade;
+in vec4 vClipPosition;
+in vec4 vPrevClipPosition;
+
+layout(location = 0) out vec4 FragColor;   // Bake: albedo
+layout(location = 1) out vec4 FragNormal;  // Bake: tree space normal
+layout(location = 2) out vec4 FragMotion;
+
+uniform sampler2D uBark;
+uniform bool uBake;
+
+#include "wind_common.glsl"
+#include "forest_common.glsl"
+#include "fog_common.glsl"
+uniform sampler3D uFogVolume;
+uniform bool uFog;
+
+void main() {
+    if (FadeNoise(gl_FragCoord.xy) >= vFade) {
+        discard;
+    }
+    vec3 normal = normalize(vNormal);
+
+    // Foliage reuses the bark detail, tinted pine green and snowed on from above
+    vec3 bark = texture(uBark, vTexCoords).rgb;
+    vec3 albedo = bark;
+    if (vTexCoords.x >= 2.0) {
+        float detail = dot(bark, vec3(0.299, 0.587, 0.114));
+        albedo = vec3(0.07, 0.17, 0.09) * (0.6 + 0.8 * detail);
+        albedo = mix(albedo, vec3(0.92, 0.95, 1.0), smoothstep(0.55, 0.85, normal.y) * 0.8);
+    }
+
+    if (uBake) {
+        FragColor = vec4(albedo, 1.0);
+        FragNormal = vec4(normal * 0.5 + 0.5, 1.0);
+        return;
+    }
+
+    vec3 color = albedo * ForestShade(normal);
+    if (uFog) {
+        vec2 screenUV = vClipPosition.xy / vClipPosition.w * 0.5 + 0.5;
+        vec4 fog = texture(uFogVolume, FogVolumeCoord(screenUV, vClipPosition.w, float(textureSize(uFogVolume, 0).z)));
+        color = color * fog.a + fog.rgb;
+    }
+    FragColor = vec4(color, 1.0);
+    FragNormal = vec4(normal * 0.5 + 0.5, 1.0);
+    vec2 currentNdc = vClipPosition.xy / vClipPosition.w;
+    vec2 previousNdc = vPrevClipPosition.xy / vPrevClipPosition.w;
+    FragMotion = vec4((currentNdc - previousNdc) * 0.5, vPrevClipPosition.w - vClipPosition.w, 0.0);
+}
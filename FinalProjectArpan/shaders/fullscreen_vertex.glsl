@@ -0,0 +1,10 @@
+// Vertex stage of the fullscreen passes (included, not a program): one triangle generated from
+// gl_VertexID covering the viewport, no vertex buffer needed. vTexCoords runs 0..1 over the screen.
+
+out vec2 vTexCoords;
+
+void main() {
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    vTexCoords = p;
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,126 @@
+#shader vertex
+#version 330 core
+
+#include "fullscreen_vertex.glsl"
+
+
+#shader fragment
+#version 330 core
+
+// FXAA 3.11 style edge search on the tonemapped image (luma stored in alpha)
+
+in vec2 vTexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D uColor;
+uniform vec2 uInvResolution;
+
+const float EDGE_THRESHOLD = 0.125;
+const float EDGE_THRESHOLD_MIN = 0.0312;
+const float SUBPIXEL_BLENDING = 0.75;
+const int SEARCH_STEPS = 10;
+const float STEP_SIZES[SEARCH_STEPS] = float[](1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0, 4.0, 8.0);
+
+float LumaAt(vec2 uv) {
+    return textureLod(uColor, uv, 0.0).a;
+}
+
+void main() {
+    vec2 uv = vTexCoords;
+    vec4 colorM = textureLod(uColor, uv, 0.0);
+    float lumaM = colorM.a;
+    float lumaN = textureLodOffset(uColor, uv, 0.0, ivec2( 0,  1)).a;
+    float lumaS = textureLodOffset(uColor, uv, 0.0, ivec2( 0, -1)).a;
+    float lumaE = textureLodOffset(uColor, uv, 0.0, ivec2( 1,  0)).a;
+    float lumaW = textureLodOffset(uColor, uv, 0.0, ivec2(-1,  0)).a;
+
+    float lumaMax = max(lumaM, max(max(lumaN, lumaS), max(lumaE, lumaW)));
+    float lumaMin = min(lumaM, min(min(lumaN, lumaS), min(lumaE, lumaW)));
+    float range = lumaMax - lumaMin;
+    if (range < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD)) {
+        FragColor = vec4(colorM.rgb, 1.0);
+        return;
+    }
+
+    float lumaNE = textureLodOffset(uColor, uv, 0.0, ivec2( 1,  1)).a;
+    float lumaNW = textureLodOffset(uColor, uv, 0.0, ivec2(-1,  1)).a;
+    float lumaSE = textureLodOffset(uColor, uv, 0.0, ivec2( 1, -1)).a;
+    float lumaSW = textureLodOffset(uColor, uv, 0.0, ivec2(-1, -1)).a;
+
+    // Sub-pixel aliasing: how much the center differs from its neighbourhood average
+    float lumaAverage = (2.0 * (lumaN + lumaS + lumaE + lumaW) + lumaNE + lumaNW + lumaSE + lumaSW) / 12.0;
+    float subpixel = smoothstep(0.0, 1.0, clamp(abs(lumaAverage - lumaM) / range, 0.0, 1.0));
+    float subpixelBlend = subpixel * subpixel * SUBPIXEL_BLENDING;
+
+    // Edge orientation and which side of the pixel it lies on
+    float horizontal = 2.0 * abs(lumaN + lumaS - 2.0 * lumaM) + abs(lumaNE + lumaSE - 2.0 * lumaE) + abs(lumaNW + lumaSW - 2.0 * lumaW);
+    float vertical = 2.0 * abs(lumaE + lumaW - 2.0 * lumaM) + abs(lumaNE + lumaNW - 2.0 * lumaN) + abs(lumaSE + lumaSW - 2.0 * lumaS);
+    bool isHorizontal = horizontal >= vertical;
+
+    float pLuma = isHorizontal ? lumaN : lumaE;
+    float nLuma = isHorizontal ? lumaS : lumaW;
+    float pGradient = abs(pLuma - lumaM);
+    float nGradient = abs(nLuma - lumaM);
+
+    float pixelStep = isHorizontal ? uInvResolution.y : uInvResolution.x;
+    float oppositeLuma = pLuma;
+    float gradient = pGradient;
+    if (pGradient < nGradient) {
+        pixelStep = -pixelStep;
+        oppositeLuma = nLuma;
+        gradient = nGradient;
+    }
+
+    // Walk along the edge in both directions until the luma pair changes
+    vec2 uvEdge = uv;
+    vec2 edgeStep;
+    if (isHorizontal) {
+        uvEdge.y += pixelStep * 0.5;
+        edgeStep = vec2(uInvResolution.x, 0.0);
+    }
+    else {
+        uvEdge.x += pixelStep * 0.5;
+        edgeStep = vec2(0.0, uInvResolution.y);
+    }
+    float edgeLuma = (lumaM + oppositeLuma) * 0.5;
+    float gradientThreshold = gradient * 0.25;
+
+    vec2 puv = uvEdge + edgeStep * STEP_SIZES[0];
+    float pLumaDelta = LumaAt(puv) - edgeLuma;
+    bool pAtEnd = abs(pLumaDelta) >= gradientThreshold;
+    for (int i = 1; i < SEARCH_STEPS && !pAtEnd; i++) {
+        puv += edgeStep * STEP_SIZES[i];
+        pLumaDelta = LumaAt(puv) - edgeLuma;
+        pAtEnd = abs(pLumaDelta) >= gradientThreshold;
+    }
+
+    vec2 nuv = uvEdge - edgeStep * STEP_SIZES[0];
+    float nLumaDelta = LumaAt(nuv) - edgeLuma;
+    bool nAtEnd = abs(nLumaDelta) >= gradientThreshold;
+    for (int i = 1; i < SEARCH_STEPS && !nAtEnd; i++) {
+        nuv -= edgeStep * STEP_SIZES[i];
+        nLumaDelta = LumaAt(nuv) - edgeLuma;
+        nAtEnd = abs(nLumaDelta) >= gradientThreshold;
+    }
+
+    float pDistance = isHorizontal ? puv.x - uv.x : puv.y - uv.y;
+    float nDistance = isHorizontal ? uv.x - nuv.x : uv.y - nuv.y;
+    float shortestDistance = pDistance <= nDistance ? pDistance : nDistance;
+    bool deltaSign = pDistance <= nDistance ? pLumaDelta >= 0.0 : nLumaDelta >= 0.0;
+
+    // Only blend when we are on the side of the edge that moves toward the end point
+    float edgeBlend = 0.0;
+    if (deltaSign != (lumaM - edgeLuma >= 0.0)) {
+        edgeBlend = 0.5 - shortestDistance / (pDistance + nDistance);
+    }
+
+    float finalBlend = max(subpixelBlend, edgeBlend);
+    if (isHorizontal) {
+        uv.y += pixelStep * finalBlend;
+    }
+    else {
+        uv.x += pixelStep * finalBlend;
+    }
+    FragColor = vec4(textureLod(uColor, uv, 0.0).rgb, 1.0);
+}
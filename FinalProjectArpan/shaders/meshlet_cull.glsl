@@ -0,0 +1,85 @@
+#shader compute
+#version 430 core
+
+// One thread per meshlet, in mesh space: frustum test on the bounding sphere, then the normal
+// cone. The meshlet is back facing when, for every normal in the cone and every point in the
+// sphere, the eye is behind the plane: |v| cos(phi + theta) > radius, with v from the eye to the
+// center, phi its angle to the cone axis and theta the cone's half angle. Survivors append a draw
+// command to their mesh's range, or with uCompact off fill their own slot, culled ones with no instances.
+layout(local_size_x = 64) in;
+
+struct Meshlet {
+    vec4 sphere;
+    vec4 cone;
+    uint firstIndex;
+    uint indexCount;
+    uint mesh;
+    uint firstCommand;
+};
+
+layout(std430, binding = 0) readonly buffer Meshlets { Meshlet meshlets[]; };
+layout(std430, binding = 1) writeonly buffer Commands { uint commands[]; };   // Five per DrawElementsIndirectCommand
+layout(std430, binding = 2) buffer Counters { uint counters[]; };             // Commands, triangles per mesh
+
+uniform vec4 uFrustum[6];
+uniform vec3 uEye;
+uniform bool uFrustumCulling;
+uniform bool uConeCulling;
+uniform bool uCompact;
+uniform uint uCount;
+
+bool Visible(Meshlet meshlet) {
+    vec3 center = meshlet.sphere.xyz;
+    float radius = meshlet.sphere.w;
+    if (uFrustumCulling) {
+        for (int i = 0; i < 6; i++) {
+            if (dot(uFrustum[i].xyz, center) + uFrustum[i].w < -radius) {
+                return false;
+            }
+        }
+    }
+    float cosTheta = meshlet.cone.w;
+    if (uConeCulling && cosTheta > 0.0) {
+        vec3 v = center - uEye;
+        float distance = length(v);
+        if (distance > radius) {
+            float cosPhi = dot(v, meshlet.cone.xyz) / distance;
+            float sinPhi = sqrt(max(1.0 - cosPhi * cosPhi, 0.0));
+            float sinTheta = sqrt(max(1.0 - cosTheta * cosTheta, 0.0));
+            if (distance * (cosPhi * cosTheta - sinPhi * sinTheta) > radius) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= uCount) {
+        return;
+    }
+    Meshlet meshlet = meshlets[index];
+    bool visible = Visible(meshlet);
+    uint slot;
+    if (uCompact) {
+        if (!visible) {
+            return;
+        }
+        slot = meshlet.firstCommand + atomicAdd(counters[2u * meshlet.mesh], 1u);
+    }
+    else {
+        slot = index;
+        if (visible) {
+            atomicAdd(counters[2u * meshlet.mesh], 1u);
+        }
+    }
+    if (visible) {
+        atomicAdd(counters[2u * meshlet.mesh + 1u], meshlet.indexCount / 3u);
+    }
+    commands[slot * 5u + 0u] = meshlet.indexCount;
+    commands[slot * 5u + 1u] = visible ? 1u : 0u;
+    commands[slot * 5u + 2u] = meshlet.firstIndex;
+    commands[slot * 5u + 3u] = 0u;
+    commands[slot * 5u + 4u] = 0u;
+}
@@ -0,0 +1,20 @@
+#shader vertex
+#version 330 core
+
+// A mesh's bounding box for an occlusion query; corner i has its x, y, z picked by bits 0, 1, 2
+uniform mat4 uModelViewProjection;
+uniform vec3 uBoundsMin;
+uniform vec3 uBoundsMax;
+
+void main() {
+    vec3 corner = vec3(gl_VertexID & 1, (gl_VertexID >> 1) & 1, (gl_VertexID >> 2) & 1);
+    gl_Position = uModelViewProjection * vec4(mix(uBoundsMin, uBoundsMax, corner), 1.0);
+}
+
+
+#shader fragment
+#version 330 core
+
+// Only the samples passing the depth test matter; color writes are masked off
+void main() {
+}
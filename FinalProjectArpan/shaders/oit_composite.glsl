@@ -0,0 +1,30 @@
+#shader vertex
+#version 330 core
+
+#include "fullscreen_vertex.glsl"
+
+
+#shader fragment
+#version 330 core
+
+// Resolves weighted blended transparency: the weighted average color covers the opaque
+// scene by (1 - revealage), blended with SRC_ALPHA / ONE_MINUS_SRC_ALPHA
+
+out vec4 FragColor;
+
+uniform sampler2D uAccum;
+uniform sampler2D uReveal;
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    float revealage = texelFetch(uReveal, p, 0).r;
+    if (revealage >= 0.999) {
+        discard;   // Nothing transparent here
+    }
+    vec4 accum = texelFetch(uAccum, p, 0);
+    // Keep the average finite when a huge weight overflowed the half float target
+    if (isinf(accum.a) || isinf(max(max(accum.r, accum.g), accum.b))) {
+        accum.rgb = vec3(accum.a);
+    }
+    FragColor = vec4(accum.rgb / max(accum.a, 1e-5), 1.0 - revealage);
+}
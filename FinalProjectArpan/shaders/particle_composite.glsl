@@ -0,0 +1,59 @@
+#shader vertex
+#version 330 core
+
+#include "fullscreen_vertex.glsl"
+
+
+#shader fragment
+#version 330 core
+
+// Nearest-depth upsample of low resolution particles. Where the four nearest low resolution
+// depths all agree with the full resolution depth a plain bilinear fetch is used; on edges the
+// texel whose depth is closest wins, so particles behind a silhouette do not bleed over it.
+// Output is premultiplied (blend GL_ONE, GL_ONE_MINUS_SRC_ALPHA).
+
+out vec4 FragColor;
+
+uniform sampler2D uParticles;
+uniform sampler2D uLowDepth;
+uniform sampler2D uDepth;
+uniform int uDivisor;
+uniform vec2 uDepthParams;   // P[2][2], P[3][2]
+
+float LinearizeDepth(float depth) {
+    return uDepthParams.y / ((depth * 2.0 - 1.0) + uDepthParams.x);
+}
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 lowSize = textureSize(uParticles, 0);
+    float depth = LinearizeDepth(texelFetch(uDepth, p, 0).r);
+
+    vec2 lowCoord = (vec2(p) + 0.5) / float(uDivisor) - 0.5;
+    ivec2 base = ivec2(floor(lowCoord));
+    vec2 f = lowCoord - vec2(base);
+
+    vec4 bilinear = vec4(0.0);
+    vec4 nearest = vec4(0.0);
+    float nearestDifference = 1e30;
+    float largestDifference = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 c = clamp(base + offset, ivec2(0), lowSize - 1);
+        vec4 particles = texelFetch(uParticles, c, 0);
+        float difference = abs(LinearizeDepth(texelFetch(uLowDepth, c, 0).r) - depth);
+        float w = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+        bilinear += particles * w;
+        if (difference < nearestDifference) {
+            nearestDifference = difference;
+            nearest = particles;
+        }
+        largestDifference = max(largestDifference, difference);
+    }
+
+    vec4 result = largestDifference < 0.05 * depth ? bilinear : nearest;
+    if (result.a <= 0.0) {
+        discard;
+    }
+    FragColor = result;
+}
@@ -0,0 +1,27 @@
+#shader vertex
+#version 330 core
+
+#include "fullscreen_vertex.glsl"
+
+
+#shader fragment
+#version 330 core
+
+// Writes the farthest scene depth of each uDivisor x uDivisor block, so low resolution
+// particles are never hidden by geometry that only covers part of the block.
+// The composite pass fixes the edges where this lets particles overlap a silhouette.
+
+uniform sampler2D uDepth;
+uniform int uDivisor;
+
+void main() {
+    ivec2 base = ivec2(gl_FragCoord.xy) * uDivisor;
+    ivec2 limit = textureSize(uDepth, 0) - 1;
+    float farthest = 0.0;
+    for (int y = 0; y < uDivisor; y++) {
+        for (int x = 0; x < uDivisor; x++) {
+            farthest = max(farthest, texelFetch(uDepth, min(base + ivec2(x, y), limit), 0).r);
+        }
+    }
+    gl_FragDepth = farthest;
+}
@@ -0,0 +1,68 @@
+#shader vertex
+#version 430 core
+
+// Rigid bodies, one instanced draw per shape. This frame's interpolated transforms come first
+// in the buffer and last frame's follow at uPrevOffset, in the same order.
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+
+layout(std430, binding = 0) readonly buffer Transforms { mat4 transforms[]; };
+
+uniform int uFirstInstance;
+uniform int uPrevOffset;
+uniform mat4 uViewProjection;
+uniform mat4 uPrevViewProjection;
+
+out vec3 vNormal;
+out vec2 vTexCoords;
+out vec4 vClipPosition;
+out vec4 vPrevClipPosition;
+
+void main() {
+    int instance = uFirstInstance + gl_InstanceID;
+    mat4 model = transforms[instance];
+    vNormal = mat3(model) * aNormal;   // Rotation and uniform scale only
+    vTexCoords = aTexCoords;
+    gl_Position = uViewProjection * model * vec4(aPosition, 1.0);
+    vClipPosition = gl_Position;
+    vPrevClipPosition = uPrevViewProjection * transforms[uPrevOffset + instance] * vec4(aPosition, 1.0);
+}
+
+
+#shader fragment
+#version 430 core
+
+in vec3 vNormal;
+in vec2 vTexCoords;
+in vec4 vClipPosition;
+in vec4 vPrevClipPosition;
+
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 FragNormal;
+layout(location = 2) out vec4 FragMotion;
+
+uniform sampler2D uAlbedo;
+
+#include "fog_common.glsl"
+uniform sampler3D uFogVolume;
+uniform bool uFog;
+
+const vec3 SUN_DIRECTION = vec3(-0.4, 0.5, -0.75);
+
+void main() {
+    vec3 normal = normalize(vNormal);
+    vec3 albedo = texture(uAlbedo, vTexCoords).rgb;
+    vec3 sun = normalize(SUN_DIRECTION);
+    vec3 color = albedo * (0.35 + 0.65 * max(dot(normal, sun), 0.0));
+    if (uFog) {
+        vec2 screenUV = vClipPosition.xy / vClipPosition.w * 0.5 + 0.5;
+        vec4 fog = texture(uFogVolume, FogVolumeCoord(screenUV, vClipPosition.w, float(textureSize(uFogVolume, 0).z)));
+        color = color * fog.a + fog.rgb;
+    }
+    FragColor = vec4(color, 1.0);
+    FragNormal = vec4(normal * 0.5 + 0.5, 1.0);
+    vec2 currentNdc = vClipPosition.xy / vClipPosition.w;
+    vec2 previousNdc = vPrevClipPosition.xy / vPrevClipPosition.w;
+    FragMotion = vec4((currentNdc - previousNdc) * 0.5, vPrevClipPosition.w - vClipPosition.w, 0.0);
+}
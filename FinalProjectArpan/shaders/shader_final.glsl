@@ -8,22 +8,61 @@ layout(location = 2) in vec2 aTexCoords; // Vertex texture coordinates
 out vec3 vNormal;         // Normal for fragment shader
 out vec2 vTexCoords;      // Texture coordinates for fragment shader
 out vec3 TexCoords;       // Skybox texture coordinates
+out vec4 vClipPosition;     // Clip position this frame, for motion vectors
+out vec4 vPrevClipPosition; // Clip position last frame
+out float vSnowShade;       // Darkens pressed snow a little so tracks read without lighting
 
 uniform mat4 uModel;      // Model matrix
 uniform mat4 uView;       // View matrix
 uniform mat4 uProjection; // Projection matrix
+uniform mat4 uPrevModel;      // Previous frame's matrices
+uniform mat4 uPrevView;
+uniform mat4 uPrevProjection;
 
 uniform bool isSkybox;    // Toggle for skybox rendering
 
+uniform bool uSnowSurface;      // Deformable snow grid, displaced by the snow depth
+uniform sampler2D uSnowDeficit; // Depth pressed below the undisturbed level
+uniform vec4 uSnowBounds;       // xz min, 1 / xz size (ground model space)
+uniform float uSnowDepth;       // Undisturbed snow depth
+
+#include "vertex_decode.glsl"
+
+float SnowDeficit(vec2 xz) {
+    return textureLod(uSnowDeficit, (xz - uSnowBounds.xy) * uSnowBounds.zw, 0.0).r;
+}
+
+float SnowHeight(vec2 xz) {
+    return max(uSnowDepth - SnowDeficit(xz), 0.0);
+}
+
 void main() {
+    vSnowShade = 1.0;
     if (isSkybox) {
         TexCoords = aPosition;
         gl_Position = uProjection * uView * vec4(aPosition, 1.0);
+        vPrevClipPosition = uPrevProjection * uPrevView * vec4(aPosition, 1.0);
     } else {
-        vNormal = mat3(transpose(inverse(uModel))) * aNormal; // Normal in world space
-        vTexCoords = aTexCoords;                             // Pass texture coordinates
-        gl_Position = uProjection * uView * uModel * vec4(aPosition, 1.0);
+        vec3 position = DecodePosition(aPosition);
+        vec3 normal = DecodeNormal(aNormal);
+        if (uSnowSurface) {
+            // Central differences one texel apart give the displaced normal
+            vec2 texel = 1.0 / (vec2(textureSize(uSnowDeficit, 0)) * uSnowBounds.zw);
+            float left = SnowHeight(position.xz - vec2(texel.x, 0.0));
+            float right = SnowHeight(position.xz + vec2(texel.x, 0.0));
+            float back = SnowHeight(position.xz - vec2(0.0, texel.y));
+            float front = SnowHeight(position.xz + vec2(0.0, texel.y));
+            normal = normalize(vec3((left - right) / (2.0 * texel.x), 1.0, (back - front) / (2.0 * texel.y)));
+            float deficit = SnowDeficit(position.xz);
+            position.y += max(uSnowDepth - deficit, 0.0);
+            vSnowShade = 1.0 - 0.25 * clamp(deficit / max(uSnowDepth, 1e-4), 0.0, 1.0);
+        }
+        vNormal = mat3(transpose(inverse(uModel))) * normal; // Normal in world space
+        vTexCoords = DecodeTexCoords(aTexCoords);            // Pass texture coordinates
+        gl_Position = uProjection * uView * uModel * vec4(position, 1.0);
+        vPrevClipPosition = uPrevProjection * uPrevView * uPrevModel * vec4(position, 1.0);
     }
+    vClipPosition = gl_Position;
 }
 
 
@@ -33,29 +72,73 @@ void main() {
 in vec3 vNormal;          // Normal vector
 in vec2 vTexCoords;       // Texture coordinates
 in vec3 TexCoords;        // Skybox texture coordinates
+in vec4 vClipPosition;
+in vec4 vPrevClipPosition;
+in float vSnowShade;
 
-out vec4 FragColor;       // Output fragment color
+layout(location = 0) out vec4 FragColor;  // Output fragment color
+layout(location = 1) out vec4 FragNormal; // World space normal for screen-space effects
+layout(location = 2) out vec4 FragMotion; // Screen motion since last frame, for temporal reprojection
 
 uniform vec3 uLightPos;   // Light position
 uniform vec3 uViewPos;    // Camera position
 uniform vec3 uLightColor; // Light color
 uniform vec3 uObjectColor; // Object color
+uniform vec3 uEmissive;   // Material emission (MTL Ke), can exceed 1.0 for bloom
+uniform float uOpacity;   // Material dissolve (MTL d)
+uniform bool uTransparent; // Weighted blended OIT pass: locations 0/1 are accumulation and revealage
 
 uniform sampler2D texture1; // Texture sampler for meshes
 uniform samplerCube skybox; // Skybox cubemap sampler
 
 uniform bool isSkybox;    // Toggle for skybox rendering
 
+#include "fog_common.glsl"
+uniform sampler3D uFogVolume; // Integrated froxel fog: in-scattered light, transmittance
+uniform bool uFog;
+
+// Attenuates by the fog in front of this fragment and adds the light it scatters toward the camera
+vec3 ApplyFog(vec3 color) {
+    if (!uFog) {
+        return color;
+    }
+    vec2 screenUV = vClipPosition.xy / vClipPosition.w * 0.5 + 0.5;
+    vec4 fog = texture(uFogVolume, FogVolumeCoord(screenUV, vClipPosition.w, float(textureSize(uFogVolume, 0).z)));
+    return color * fog.a + fog.rgb;
+}
+
 void main() {
     if (isSkybox) {
         // Skybox rendering: no blending, just use the cubemap
         //FragColor = vec4(1.0f);
         FragColor = texture(skybox, TexCoords);
+        FragColor.rgb = ApplyFog(FragColor.rgb);
+        FragNormal = vec4(0.5, 0.5, 0.5, 0.0);
     } else {
         // Mesh rendering: sample the mesh texture
         vec4 textureColor = texture(texture1, vTexCoords);
         
         // Blending the mesh color over the skybox (no lighting)
         FragColor = textureColor; // This will blend the mesh normally over the background
+        FragColor.rgb *= vSnowShade;
+        FragColor.rgb += textureColor.rgb * uEmissive; // Emissive surfaces glow in the HDR target
+        FragColor.rgb = ApplyFog(FragColor.rgb);
+        FragNormal = vec4(normalize(vNormal) * 0.5 + 0.5, 1.0);
+
+        if (uTransparent) {
+            // Depth weight (McGuire & Bavoil 2013, eq. 9) lets nearer surfaces dominate the average
+            float alpha = textureColor.a * uOpacity;
+            float z = vClipPosition.w;
+            float weight = clamp(10.0 / (1e-5 + pow(z / 5.0, 2.0) + pow(z / 200.0, 6.0)), 1e-2, 3e3) * alpha;
+            FragColor = vec4(FragColor.rgb * alpha, alpha) * weight;
+            FragNormal = vec4(alpha);
+            FragMotion = vec4(0.0);
+            return;
+        }
     }
+
+    // uv delta from last frame to this one, and how much the view depth (clip w) changed
+    vec2 currentNdc = vClipPosition.xy / vClipPosition.w;
+    vec2 previousNdc = vPrevClipPosition.xy / vPrevClipPosition.w;
+    FragMotion = vec4((currentNdc - previousNdc) * 0.5, vPrevClipPosition.w - vClipPosition.w, 0.0);
 }
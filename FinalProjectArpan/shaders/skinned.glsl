@@ -0,0 +1,99 @@
+#shader vertex
+#version 430 core
+
+// Instanced skinned characters. With GPU skinning each vertex blends its four bone matrices;
+// with CPU skinning the vertices arrive skinned in world space and are looked up by instance
+// and vertex index instead.
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+layout(location = 3) in uvec4 aJoints;
+layout(location = 4) in vec4 aWeights;
+
+struct SkinnedVertex {
+    vec4 position;
+    vec4 normal;
+};
+
+layout(std430, binding = 0) readonly buffer Bones { mat4 bones[]; };
+layout(std430, binding = 1) readonly buffer PrevBones { mat4 prevBones[]; };
+layout(std430, binding = 2) readonly buffer Skinned { SkinnedVertex skinned[]; };
+layout(std430, binding = 3) readonly buffer PrevSkinned { SkinnedVertex prevSkinned[]; };
+
+uniform bool uCpuSkinning;
+uniform int uJointCount;
+uniform int uVertexCount;
+uniform mat4 uViewProjection;
+uniform mat4 uPrevViewProjection;
+
+out vec3 vNormal;
+out vec2 vTexCoords;
+out vec3 vTint;
+out vec4 vClipPosition;
+out vec4 vPrevClipPosition;
+
+void main() {
+    vec3 position, prevPosition, normal;
+    if (uCpuSkinning) {
+        int index = gl_InstanceID * uVertexCount + gl_VertexID;
+        position = skinned[index].position.xyz;
+        normal = skinned[index].normal.xyz;
+        prevPosition = prevSkinned[index].position.xyz;
+    }
+    else {
+        int base = gl_InstanceID * uJointCount;
+        ivec4 joints = ivec4(aJoints) + base;
+        mat4 skin = bones[joints.x] * aWeights.x + bones[joints.y] * aWeights.y + bones[joints.z] * aWeights.z + bones[joints.w] * aWeights.w;
+        mat4 prevSkin = prevBones[joints.x] * aWeights.x + prevBones[joints.y] * aWeights.y + prevBones[joints.z] * aWeights.z + prevBones[joints.w] * aWeights.w;
+        position = (skin * vec4(aPosition, 1.0)).xyz;
+        normal = mat3(skin) * aNormal;
+        prevPosition = (prevSkin * vec4(aPosition, 1.0)).xyz;
+    }
+
+    // A little color variation across the crowd
+    vTint = 0.7 + 0.6 * fract(sin(float(gl_InstanceID) * vec3(12.9898, 78.233, 37.719)) * 43758.5453);
+    vNormal = normal;
+    vTexCoords = aTexCoords;
+    gl_Position = uViewProjection * vec4(position, 1.0);
+    vClipPosition = gl_Position;
+    vPrevClipPosition = uPrevViewProjection * vec4(prevPosition, 1.0);
+}
+
+
+#shader fragment
+#version 430 core
+
+in vec3 vNormal;
+in vec2 vTexCoords;
+in vec3 vTint;
+in vec4 vClipPosition;
+in vec4 vPrevClipPosition;
+
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 FragNormal;
+layout(location = 2) out vec4 FragMotion;
+
+uniform sampler2D uAlbedo;
+
+#include "fog_common.glsl"
+uniform sampler3D uFogVolume;
+uniform bool uFog;
+
+const vec3 SUN_DIRECTION = vec3(-0.4, 0.5, -0.75);
+
+void main() {
+    vec3 normal = normalize(vNormal);
+    vec3 albedo = texture(uAlbedo, vTexCoords).rgb * vTint;
+    vec3 sun = normalize(SUN_DIRECTION);
+    vec3 color = albedo * (0.35 + 0.65 * max(dot(normal, sun), 0.0));
+    if (uFog) {
+        vec2 screenUV = vClipPosition.xy / vClipPosition.w * 0.5 + 0.5;
+        vec4 fog = texture(uFogVolume, FogVolumeCoord(screenUV, vClipPosition.w, float(textureSize(uFogVolume, 0).z)));
+        color = color * fog.a + fog.rgb;
+    }
+    FragColor = vec4(color, 1.0);
+    FragNormal = vec4(normal * 0.5 + 0.5, 1.0);
+    vec2 currentNdc = vClipPosition.xy / vClipPosition.w;
+    vec2 previousNdc = vPrevClipPosition.xy / vPrevClipPosition.w;
+    FragMotion = vec4((currentNdc - previousNdc) * 0.5, vPrevClipPosition.w - vClipPosition.w, 0.0);
+}
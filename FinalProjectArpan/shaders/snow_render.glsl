@@ -0,0 +1,60 @@
+#shader vertex
+#version 430 core
+
+// One camera-facing quad per flake, expanded from gl_VertexID (triangle strip) and read
+// straight from the simulation buffer by gl_InstanceID
+
+layout(std430, binding = 0) readonly buffer Positions { vec4 positions[]; };
+
+uniform mat4 uView;
+uniform mat4 uProjection;
+uniform float uSize;
+
+out vec2 vCorner;
+out vec4 vClipPosition;
+
+void main() {
+    vec4 particle = positions[gl_InstanceID];
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec4 viewPosition = uView * vec4(particle.xyz, 1.0);
+    viewPosition.xy += corner * uSize * (0.6 + 0.8 * fract(particle.w * 7.31));
+    gl_Position = uProjection * viewPosition;
+    vCorner = corner;
+    vClipPosition = gl_Position;
+}
+
+
+#shader fragment
+#version 430 core
+
+in vec2 vCorner;
+in vec4 vClipPosition;
+
+layout(location = 0) out vec4 FragColor;
+
+uniform vec3 uColor;
+uniform bool uPremultiplied;   // Soft blended discs for the low resolution target, else opaque
+
+#include "fog_common.glsl"
+uniform sampler3D uFogVolume;
+uniform bool uFog;
+
+void main() {
+    float r2 = dot(vCorner, vCorner);
+    if (r2 > 1.0) {
+        discard;
+    }
+    vec3 color = uColor * (1.0 - 0.5 * r2);
+    if (uFog) {
+        vec2 screenUV = vClipPosition.xy / vClipPosition.w * 0.5 + 0.5;
+        vec4 fog = texture(uFogVolume, FogVolumeCoord(screenUV, vClipPosition.w, float(textureSize(uFogVolume, 0).z)));
+        color = color * fog.a + fog.rgb;
+    }
+    if (uPremultiplied) {
+        float coverage = 1.0 - smoothstep(0.5, 1.0, r2);
+        FragColor = vec4(color * coverage, coverage);
+    }
+    else {
+        FragColor = vec4(color, 1.0);
+    }
+}
@@ -0,0 +1,59 @@
+#shader compute
+#version 430 core
+
+// Updates the dirty tiles of the snow deficit (depth pressed below the undisturbed snow level):
+// exponential refill toward zero, then this batch of capsule stamps
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r16f, binding = 0) uniform image2D uDeficit;
+
+// x, y: tile, z: last update before the tile leaves the list
+layout(std430, binding = 0) readonly buffer Tiles {
+    ivec4 tiles[];
+};
+
+const int MAX_STAMPS = 16;
+uniform vec4 uStampSegments[MAX_STAMPS]; // xz from, xz to (ground model space)
+uniform vec2 uStampShapes[MAX_STAMPS];   // radius, depth (negative piles snow up)
+uniform int uStampCount;
+
+uniform vec2 uBoundsMin;
+uniform vec2 uBoundsSize;
+uniform float uSnowDepth;
+uniform float uRefill;   // exp(-dt / refill time), 1 for later batches in a frame
+
+void main() {
+    ivec4 tile = tiles[gl_WorkGroupID.x];
+    ivec2 block = ivec2(gl_WorkGroupID.y % 4u, gl_WorkGroupID.y / 4u);
+    ivec2 texel = tile.xy * 32 + block * 8 + ivec2(gl_LocalInvocationID.xy);
+    ivec2 size = imageSize(uDeficit);
+    if (texel.x >= size.x || texel.y >= size.y) {
+        return;
+    }
+
+    float deficit = imageLoad(uDeficit, texel).r * uRefill;
+    if (tile.z != 0) {
+        deficit = 0.0;
+    }
+
+    vec2 position = uBoundsMin + (vec2(texel) + 0.5) / vec2(size) * uBoundsSize;
+    for (int i = 0; i < uStampCount; i++) {
+        vec2 a = uStampSegments[i].xy;
+        vec2 b = uStampSegments[i].zw;
+        vec2 ab = b - a;
+        float t = clamp(dot(position - a, ab) / max(dot(ab, ab), 1e-8), 0.0, 1.0);
+        float distance = length(position - (a + ab * t));
+        float radius = uStampShapes[i].x;
+        float profile = uStampShapes[i].y * (1.0 - smoothstep(radius * 0.6, radius, distance));
+        // Pressing keeps the deepest dent, piling keeps the highest mound
+        if (profile > 0.0) {
+            deficit = max(deficit, profile);
+        }
+        else if (profile < 0.0) {
+            deficit = min(deficit, profile);
+        }
+    }
+
+    // A dent can't go below the ground
+    imageStore(uDeficit, texel, vec4(min(deficit, uSnowDepth)));
+}
@@ -0,0 +1,103 @@
+#shader compute
+#version 430 core
+
+// Moves every flake and collides it with the scene depth buffer. A flake that crosses behind
+// the visible surface by less than uCollisionThickness has landed: it stays put for a while,
+// then respawns at the top of the emitter box around the camera.
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) buffer Positions { vec4 positions[]; };    // xyz, w: random seed
+layout(std430, binding = 1) buffer Velocities { vec4 velocities[]; };  // xyz, w: seconds left resting, < 0 while falling
+
+uniform sampler2D uDepth;
+uniform mat4 uViewProjection;
+uniform vec2 uDepthParams;      // P[2][2], P[3][2] to linearize depth
+
+uniform vec3 uEmitterCenter;
+uniform vec3 uEmitterExtent;
+uniform float uWindDrag;        // How fast a flake takes on the local wind, per second
+uniform float uFallSpeed;
+uniform float uTurbulence;
+uniform float uRestTime;
+uniform float uCollisionThickness;
+uniform float uDeltaTime;
+uniform float uTime;
+uniform uint uCount;
+uniform uint uFrame;
+uniform bool uReset;
+
+#include "wind_common.glsl"
+
+// PCG hash to a float in [0, 1)
+float Random(uint seed) {
+    uint state = seed * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return float((word >> 22u) ^ word) / 4294967296.0;
+}
+
+void Respawn(uint i, bool anywhere) {
+    uint seed = i * 4u + uFrame * 0x9E3779B9u;
+    vec3 r = vec3(Random(seed), Random(seed + 1u), Random(seed + 2u));
+    vec3 position = uEmitterCenter + (r * 2.0 - 1.0) * uEmitterExtent;
+    if (!anywhere) {
+        position.y = uEmitterCenter.y + uEmitterExtent.y;
+    }
+    float fallSpeed = uFallSpeed * (0.7 + 0.6 * Random(seed + 3u));
+    positions[i] = vec4(position, Random(i));
+    vec3 wind = SampleWind(position);
+    velocities[i] = vec4(wind.x, -fallSpeed, wind.z, -1.0);
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= uCount) {
+        return;
+    }
+    if (uReset) {
+        Respawn(i, true);
+        return;
+    }
+
+    vec4 position = positions[i];
+    vec4 velocity = velocities[i];
+    if (velocity.w >= 0.0) {
+        velocity.w -= uDeltaTime;
+        if (velocity.w < 0.0) {
+            Respawn(i, false);
+        }
+        else {
+            velocities[i].w = velocity.w;
+        }
+        return;
+    }
+
+    // Constant fall speed per flake; the horizontal velocity is dragged toward the local wind
+    // and its updraft is added on top, with a little sway per flake
+    vec3 wind = SampleWind(position.xyz);
+    velocity.xz = mix(velocity.xz, wind.xz, 1.0 - exp(-uWindDrag * uDeltaTime));
+    velocities[i].xz = velocity.xz;
+    float seed = position.w * 100.0;
+    vec3 sway = vec3(sin(uTime * 1.3 + seed), 0.0, cos(uTime * 1.1 + seed * 1.7)) * uTurbulence;
+    vec3 next = position.xyz + (velocity.xyz + vec3(0.0, wind.y, 0.0) + sway) * uDeltaTime;
+
+    vec4 clip = uViewProjection * vec4(next, 1.0);
+    if (clip.w > 0.0 && all(lessThan(abs(clip.xy), vec2(clip.w)))) {
+        vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+        float sceneNdc = texelFetch(uDepth, ivec2(uv * vec2(textureSize(uDepth, 0))), 0).r * 2.0 - 1.0;
+        float sceneDepth = uDepthParams.y / (sceneNdc + uDepthParams.x);
+        if (clip.w > sceneDepth && clip.w < sceneDepth + uCollisionThickness) {
+            // Landed: stay at the last position in front of the surface
+            velocities[i].w = uRestTime * (0.5 + Random(i + uFrame));
+            return;
+        }
+    }
+
+    // Drop out of the bottom of the box and start again at the top; wrap around the sides
+    vec3 local = next - uEmitterCenter;
+    if (local.y < -uEmitterExtent.y) {
+        Respawn(i, false);
+        return;
+    }
+    local.xz = mod(local.xz + uEmitterExtent.xz, 2.0 * uEmitterExtent.xz) - uEmitterExtent.xz;
+    positions[i].xyz = uEmitterCenter + local;
+}
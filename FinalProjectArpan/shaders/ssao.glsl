@@ -0,0 +1,82 @@
+#shader vertex
+#version 330 core
+
+#include "fullscreen_vertex.glsl"
+
+
+#shader fragment
+#version 330 core
+
+// Normal-oriented hemisphere SSAO, evaluated at the reduced resolution.
+// With temporal accumulation it only shades the pixels of the current sparse pattern.
+
+#include "temporal_common.glsl"
+
+out vec4 FragAO;
+
+uniform sampler2D uLinearDepth;
+uniform sampler2D uNormals;
+uniform vec4 uProjectionInfo;  // P[0][0], P[1][1], P[2][2], P[3][2]
+
+uniform float uRadius;         // World units
+uniform int uSampleCount;
+uniform float uIntensity;
+uniform float uBias;
+
+const float GOLDEN_ANGLE = 2.39996323;
+
+vec3 ViewPosition(vec2 uv, float depth) {
+    vec2 ndc = uv * 2.0 - 1.0;
+    return vec3(ndc.x * depth / uProjectionInfo.x, ndc.y * depth / uProjectionInfo.y, -depth);
+}
+
+void main() {
+    ivec2 p = TemporalUnpackPixel(ivec2(gl_FragCoord.xy));
+    vec2 size = vec2(textureSize(uLinearDepth, 0));
+    if (any(greaterThanEqual(vec2(p), size))) {
+        FragAO = vec4(1.0);
+        return;
+    }
+    vec4 normal = texelFetch(uNormals, p, 0);
+    if (normal.a < 0.5) {
+        FragAO = vec4(1.0);
+        return;
+    }
+
+    float depth = texelFetch(uLinearDepth, p, 0).r;
+    vec3 position = ViewPosition((vec2(p) + 0.5) / size, depth);
+    vec3 n = normalize(normal.xyz * 2.0 - 1.0);
+
+    // Kernel rotation from a 4x4 ordered pattern; the blur pass averages it back out.
+    // Stepping it each frame lets temporal accumulation see every rotation too.
+    int pattern = ((p.x & 3) + (p.y & 3) * 4 + uTemporalFrame * 7) & 15;
+    float rotation = float(pattern) * (6.28318530 / 16.0);
+    vec3 randomVector = vec3(cos(rotation), sin(rotation), 0.0);
+    vec3 tangent = randomVector - n * dot(randomVector, n);
+    tangent = length(tangent) > 1e-3 ? normalize(tangent) : normalize(cross(n, vec3(0.0, 0.0, 1.0)));
+    vec3 bitangent = cross(n, tangent);
+
+    float occlusion = 0.0;
+    for (int i = 0; i < uSampleCount; i++) {
+        // Cosine-weighted spiral over the hemisphere, packed more densely near the center
+        float t = (float(i) + 0.5) / float(uSampleCount);
+        float phi = float(i) * GOLDEN_ANGLE;
+        float r = sqrt(t);
+        vec3 direction = vec3(r * cos(phi), r * sin(phi), sqrt(1.0 - t));
+        float scale = mix(0.1, 1.0, t * t);
+        vec3 samplePosition = position + (tangent * direction.x + bitangent * direction.y + n * direction.z) * uRadius * scale;
+
+        vec2 sampleNdc = vec2(samplePosition.x * uProjectionInfo.x, samplePosition.y * uProjectionInfo.y) / -samplePosition.z;
+        vec2 sampleUV = sampleNdc * 0.5 + 0.5;
+        if (any(lessThan(sampleUV, vec2(0.0))) || any(greaterThan(sampleUV, vec2(1.0)))) {
+            continue;
+        }
+
+        float sceneDepth = textureLod(uLinearDepth, sampleUV, 0.0).r;
+        float rangeCheck = smoothstep(0.0, 1.0, uRadius / max(abs(depth - sceneDepth), 1e-4));
+        occlusion += (sceneDepth <= -samplePosition.z - uBias ? 1.0 : 0.0) * rangeCheck;
+    }
+
+    float ao = 1.0 - occlusion / float(max(uSampleCount, 1));
+    FragAO = vec4(pow(clamp(ao, 0.0, 1.0), uIntensity));
+}
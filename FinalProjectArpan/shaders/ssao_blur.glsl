@@ -0,0 +1,34 @@
+#shader vertex
+#version 330 core
+
+#include "fullscreen_vertex.glsl"
+
+
+#shader fragment
+#version 330 core
+
+// 4x4 depth-aware box blur matching the SSAO kernel rotation pattern
+
+out vec4 FragAO;
+
+uniform sampler2D uAO;
+uniform sampler2D uLinearDepth;
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 limit = textureSize(uAO, 0) - 1;
+    float centerDepth = texelFetch(uLinearDepth, p, 0).r;
+
+    float sum = 0.0;
+    float weightSum = 0.0;
+    for (int y = -2; y < 2; y++) {
+        for (int x = -2; x < 2; x++) {
+            ivec2 c = clamp(p + ivec2(x, y), ivec2(0), limit);
+            float d = texelFetch(uLinearDepth, c, 0).r;
+            float w = max(0.0, 1.0 - abs(d - centerDepth) / (0.05 * centerDepth));
+            sum += texelFetch(uAO, c, 0).r * w;
+            weightSum += w;
+        }
+    }
+    FragAO = vec4(weightSum > 0.0 ? sum / weightSum : texelFetch(uAO, p, 0).r);
+}
@@ -0,0 +1,49 @@
+#shader vertex
+#version 330 core
+
+#include "fullscreen_vertex.glsl"
+
+
+#shader fragment
+#version 330 core
+
+// Reduces full resolution depth and normals to the SSAO resolution.
+// Alternating min/max depth in a checkerboard keeps both sides of silhouettes represented,
+// and the normal is taken from the same texel as the chosen depth.
+
+layout(location = 0) out float LinearDepth;  // Positive view space depth
+layout(location = 1) out vec4 ViewNormal;    // View space normal * 0.5 + 0.5, alpha 0 for sky
+
+uniform sampler2D uDepth;
+uniform sampler2D uNormals;   // World space
+uniform int uDivisor;
+uniform vec4 uProjectionInfo; // P[0][0], P[1][1], P[2][2], P[3][2]
+uniform mat4 uView;
+
+float LinearizeDepth(float depth) {
+    return uProjectionInfo.w / ((depth * 2.0 - 1.0) + uProjectionInfo.z);
+}
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 base = p * uDivisor + ivec2(uDivisor / 2 - 1);
+    ivec2 limit = textureSize(uDepth, 0) - 1;
+
+    ivec2 coords[4] = ivec2[](base, base + ivec2(1, 0), base + ivec2(0, 1), base + ivec2(1, 1));
+    bool pickFarthest = ((p.x + p.y) & 1) == 1;
+    ivec2 chosen = min(coords[0], limit);
+    float chosenDepth = texelFetch(uDepth, chosen, 0).r;
+    for (int i = 1; i < 4; i++) {
+        ivec2 c = min(coords[i], limit);
+        float d = texelFetch(uDepth, c, 0).r;
+        if (pickFarthest ? d > chosenDepth : d < chosenDepth) {
+            chosenDepth = d;
+            chosen = c;
+        }
+    }
+
+    LinearDepth = LinearizeDepth(chosenDepth);
+    vec4 normal = texelFetch(uNormals, chosen, 0);
+    vec3 n = normalize(mat3(uView) * (normal.xyz * 2.0 - 1.0));
+    ViewNormal = vec4(n * 0.5 + 0.5, normal.a);
+}
@@ -0,0 +1,74 @@
+#shader vertex
+#version 330 core
+
+#include "fullscreen_vertex.glsl"
+
+
+#shader fragment
+#version 330 core
+
+// Joint bilateral upsample of the reduced resolution AO. The four nearest low resolution
+// texels are weighted bilinearly and by how well their depth and normal match the full
+// resolution pixel, so occlusion does not bleed across silhouettes.
+// Output is multiplied into the scene color (blend GL_ZERO, GL_SRC_COLOR).
+
+out vec4 FragColor;
+
+uniform sampler2D uAO;
+uniform sampler2D uLowDepth;
+uniform sampler2D uLowNormals;  // View space
+uniform sampler2D uDepth;
+uniform sampler2D uNormals;     // World space
+uniform int uDivisor;
+uniform vec4 uProjectionInfo;   // P[0][0], P[1][1], P[2][2], P[3][2]
+uniform mat4 uView;
+
+float LinearizeDepth(float depth) {
+    return uProjectionInfo.w / ((depth * 2.0 - 1.0) + uProjectionInfo.z);
+}
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    vec4 normal = texelFetch(uNormals, p, 0);
+    if (normal.a < 0.5) {
+        FragColor = vec4(1.0);
+        return;
+    }
+    float depth = LinearizeDepth(texelFetch(uDepth, p, 0).r);
+    vec3 n = normalize(mat3(uView) * (normal.xyz * 2.0 - 1.0));
+
+    vec2 lowPosition = (vec2(p) + 0.5) / float(uDivisor) - 0.5;
+    ivec2 base = ivec2(floor(lowPosition));
+    vec2 f = lowPosition - vec2(base);
+    ivec2 limit = textureSize(uAO, 0) - 1;
+
+    float bilinear[4] = float[]((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+    ivec2 offsets[4] = ivec2[](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(1, 1));
+
+    float sum = 0.0;
+    float weightSum = 0.0;
+    float nearestAO = 1.0;
+    float nearestDifference = 1e20;
+    for (int i = 0; i < 4; i++) {
+        ivec2 c = clamp(base + offsets[i], ivec2(0), limit);
+        float ao = texelFetch(uAO, c, 0).r;
+        float lowDepth = texelFetch(uLowDepth, c, 0).r;
+        vec3 lowNormal = normalize(texelFetch(uLowNormals, c, 0).xyz * 2.0 - 1.0);
+
+        float depthDifference = abs(lowDepth - depth) / depth;
+        float depthWeight = 1.0 / (1e-3 + depthDifference * 50.0);
+        float normalWeight = pow(max(dot(lowNormal, n), 0.0), 8.0);
+        float w = bilinear[i] * depthWeight * normalWeight;
+        sum += ao * w;
+        weightSum += w;
+
+        if (depthDifference < nearestDifference) {
+            nearestDifference = depthDifference;
+            nearestAO = ao;
+        }
+    }
+
+    // No compatible neighbour (thin features): fall back to the closest depth match
+    float result = weightSum > 1e-4 ? sum / weightSum : nearestAO;
+    FragColor = vec4(vec3(result), 1.0);
+}
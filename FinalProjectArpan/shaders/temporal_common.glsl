@@ -0,0 +1,39 @@
+// Sparse rendering patterns shared by temporal effects and temporal_resolve.glsl (included, not a program).
+// 0: every pixel each frame, 1: checkerboard (half the pixels), 2: one pixel of each 2x2 quad.
+// An effect renders into a packed target; TemporalUnpackPixel maps a packed texel to the pixel it covers.
+
+uniform int uTemporalPattern;
+uniform int uTemporalFrame;
+
+const ivec2 TEMPORAL_QUARTER_OFFSETS[4] = ivec2[4](ivec2(0, 0), ivec2(1, 1), ivec2(1, 0), ivec2(0, 1));
+
+ivec2 TemporalUnpackPixel(ivec2 q) {
+    if (uTemporalPattern == 1) {
+        return ivec2(q.x * 2 + ((q.y + uTemporalFrame) & 1), q.y);
+    }
+    if (uTemporalPattern == 2) {
+        return q * 2 + TEMPORAL_QUARTER_OFFSETS[uTemporalFrame & 3];
+    }
+    return q;
+}
+
+ivec2 TemporalPackPixel(ivec2 p) {
+    if (uTemporalPattern == 1) {
+        return ivec2(p.x / 2, p.y);
+    }
+    if (uTemporalPattern == 2) {
+        return p / 2;
+    }
+    return p;
+}
+
+// True when pixel p was rendered this frame
+bool TemporalIsFresh(ivec2 p) {
+    if (uTemporalPattern == 1) {
+        return ((p.x + p.y + uTemporalFrame) & 1) == 0;
+    }
+    if (uTemporalPattern == 2) {
+        return (p & 1) == TEMPORAL_QUARTER_OFFSETS[uTemporalFrame & 3];
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+#shader vertex
+#version 330 core
+
+#include "fullscreen_vertex.glsl"
+
+
+#shader fragment
+#version 330 core
+
+// Blends an effect's sparse result for this frame with its reprojected history.
+// History texels whose stored depth does not match the reprojected depth are disocclusions and
+// get rejected; pixels that were not rendered this frame are then filled from fresh neighbours.
+
+#include "temporal_common.glsl"
+
+out vec4 FragHistory;           // rgb: resolved value, a: linear depth for next frame's rejection
+
+uniform sampler2D uCurrent;     // Packed result rendered this frame
+uniform sampler2D uHistory;     // Last resolved history
+uniform sampler2D uDepth;       // Linear view depth at the effect resolution
+uniform sampler2D uMotion;      // Full resolution motion vectors from the scene pass
+
+uniform bool uHistoryValid;
+uniform float uFreshWeight;
+uniform float uDepthTolerance;
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(uDepth, 0);
+    vec2 uv = (vec2(p) + 0.5) / vec2(size);
+    float depth = texelFetch(uDepth, p, 0).r;
+    vec3 motion = textureLod(uMotion, uv, 0.0).xyz;
+
+    // Bilinear history fetch where each tap has to pass the depth test on its own
+    vec2 prevUV = uv - motion.xy;
+    float expectedDepth = depth + motion.z;
+    vec2 texel = prevUV * vec2(size) - 0.5;
+    ivec2 base = ivec2(floor(texel));
+    vec2 f = fract(texel);
+    vec3 history = vec3(0.0);
+    float historyWeight = 0.0;
+    if (uHistoryValid && all(greaterThanEqual(prevUV, vec2(0.0))) && all(lessThanEqual(prevUV, vec2(1.0)))) {
+        for (int i = 0; i < 4; i++) {
+            ivec2 offset = ivec2(i & 1, i >> 1);
+            ivec2 c = clamp(base + offset, ivec2(0), size - 1);
+            vec4 tap = texelFetch(uHistory, c, 0);
+            float w = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+            w *= abs(tap.a - expectedDepth) <= uDepthTolerance * expectedDepth ? 1.0 : 0.0;
+            history += tap.rgb * w;
+            historyWeight += w;
+        }
+    }
+    bool historyAccepted = historyWeight > 0.01;
+    history /= max(historyWeight, 1e-4);
+
+    vec3 result;
+    if (TemporalIsFresh(p)) {
+        vec3 fresh = texelFetch(uCurrent, TemporalPackPixel(p), 0).rgb;
+        result = historyAccepted ? mix(history, fresh, uFreshWeight) : fresh;
+    }
+    else {
+        // Fresh pixels around this one bound the history and stand in for it on a disocclusion
+        vec3 minimum = vec3(1e9);
+        vec3 maximum = vec3(-1e9);
+        vec3 sum = vec3(0.0);
+        float weightSum = 0.0;
+        for (int y = -1; y <= 1; y++) {
+            for (int x = -1; x <= 1; x++) {
+                ivec2 c = p + ivec2(x, y);
+                if (any(lessThan(c, ivec2(0))) || any(greaterThanEqual(c, size)) || !TemporalIsFresh(c)) {
+                    continue;
+                }
+                vec3 value = texelFetch(uCurrent, TemporalPackPixel(c), 0).rgb;
+                float w = max(0.0, 1.0 - abs(texelFetch(uDepth, c, 0).r - depth) / (uDepthTolerance * depth)) + 1e-3;
+                minimum = min(minimum, value);
+                maximum = max(maximum, value);
+                sum += value * w;
+                weightSum += w;
+            }
+        }
+        vec3 spatial = weightSum > 0.0 ? sum / weightSum : history;
+        result = historyAccepted && weightSum > 0.0 ? clamp(history, minimum, maximum) : spatial;
+    }
+    FragHistory = vec4(result, depth);
+}
@@ -0,0 +1,97 @@
+#shader vertex
+#version 330 core
+
+// One clipmap level: the shared grid placed around the level center, heights fetched from the
+// level's toroidal layer. Near the outer edge vertices morph onto the next coarser level's grid
+// so neighbouring levels meet without cracks or popping.
+layout(location = 0) in vec2 aGrid;  // Cell offset from the level center
+
+uniform sampler2DArray uHeights;
+uniform int uLevel;
+uniform float uSpacing;      // World units per cell at this level
+uniform ivec2 uCenter;       // Level center in grid coordinates
+uniform vec2 uCameraGrid;    // Camera xz in grid coordinates
+uniform mat4 uViewProjection;
+uniform mat4 uPrevViewProjection;
+
+out vec3 vWorldPosition;
+out vec3 vNormal;
+out vec4 vClipPosition;
+out vec4 vPrevClipPosition;
+
+const int TEXTURE_SIZE = 256;
+const float MORPH_START = 96.0;  // Cells from the camera where morphing begins
+const float MORPH_RANGE = 24.0;  // Fully coarse well before the level edge at 126
+
+float Height(ivec2 grid) {
+    // Two's complement makes & a positive modulo for negative coordinates
+    return texelFetch(uHeights, ivec3(grid & (TEXTURE_SIZE - 1), uLevel), 0).r;
+}
+
+void main() {
+    vec2 grid = vec2(uCenter) + aGrid;
+    vec2 distance = abs(grid - uCameraGrid);
+    float morph = clamp((max(distance.x, distance.y) - MORPH_START) / MORPH_RANGE, 0.0, 1.0);
+    vec2 position = grid - mod(grid, 2.0) * morph;
+
+    ivec2 cell = ivec2(floor(position));
+    vec2 f = position - vec2(cell);
+    float height = mix(mix(Height(cell), Height(cell + ivec2(1, 0)), f.x),
+                       mix(Height(cell + ivec2(0, 1)), Height(cell + ivec2(1, 1)), f.x), f.y);
+    float dx = Height(cell + ivec2(1, 0)) - Height(cell - ivec2(1, 0));
+    float dz = Height(cell + ivec2(0, 1)) - Height(cell - ivec2(0, 1));
+    vNormal = normalize(vec3(-dx, 2.0 * uSpacing, -dz));
+
+    vWorldPosition = vec3(position.x * uSpacing, height, position.y * uSpacing);
+    gl_Position = uViewProjection * vec4(vWorldPosition, 1.0);
+    vClipPosition = gl_Position;
+    vPrevClipPosition = uPrevViewProjection * vec4(vWorldPosition, 1.0);
+}
+
+
+#shader fragment
+#version 330 core
+
+in vec3 vWorldPosition;
+in vec3 vNormal;
+in vec4 vClipPosition;
+in vec4 vPrevClipPosition;
+
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 FragNormal;
+layout(location = 2) out vec4 FragMotion;
+
+uniform sampler2D uSurface;
+uniform float uTextureScale;
+uniform bool uHasFiner;
+uniform vec4 uFinerBounds;   // World xz min, max covered by the next finer level
+
+#include "fog_common.glsl"
+uniform sampler3D uFogVolume;
+uniform bool uFog;
+
+const vec3 SUN_DIRECTION = vec3(-0.4, 0.5, -0.75);
+
+void main() {
+    if (uHasFiner && all(greaterThan(vWorldPosition.xz, uFinerBounds.xy)) && all(lessThan(vWorldPosition.xz, uFinerBounds.zw))) {
+        discard;
+    }
+
+    // The scene is unlit, so only slopes are shaded, with flat ground left at full brightness
+    vec3 normal = normalize(vNormal);
+    vec3 sun = normalize(SUN_DIRECTION);
+    float shade = clamp(0.4 + 0.6 * dot(normal, sun) / sun.y, 0.3, 1.2);
+    vec3 color = texture(uSurface, vWorldPosition.xz * uTextureScale).rgb * shade;
+
+    if (uFog) {
+        vec2 screenUV = vClipPosition.xy / vClipPosition.w * 0.5 + 0.5;
+        vec4 fog = texture(uFogVolume, FogVolumeCoord(screenUV, vClipPosition.w, float(textureSize(uFogVolume, 0).z)));
+        color = color * fog.a + fog.rgb;
+    }
+    FragColor = vec4(color, 1.0);
+    FragNormal = vec4(normal * 0.5 + 0.5, 1.0);
+
+    vec2 currentNdc = vClipPosition.xy / vClipPosition.w;
+    vec2 previousNdc = vPrevClipPosition.xy / vPrevClipPosition.w;
+    FragMotion = vec4((currentNdc - previousNdc) * 0.5, vPrevClipPosition.w - vClipPosition.w, 0.0);
+}
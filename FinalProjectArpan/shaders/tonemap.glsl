@@ -0,0 +1,45 @@
+#shader vertex
+#version 330 core
+
+#include "fullscreen_vertex.glsl"
+
+
+#shader fragment
+#version 330 core
+
+in vec2 vTexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D uScene;   // HDR scene color
+uniform sampler2D uBloom;   // Bloom pyramid, mip 0 holds the combined result
+
+uniform float uBloomIntensity;
+uniform float uExposure;
+uniform int uTonemapper;    // 0: clamp, 1: Reinhard, 2: ACES
+
+// Narkowicz's fit of the ACES filmic curve
+vec3 ACESFilm(vec3 x) {
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main() {
+    vec3 color = texture(uScene, vTexCoords).rgb;
+    if (uBloomIntensity > 0.0) {
+        color += textureLod(uBloom, vTexCoords, 0.0).rgb * uBloomIntensity;
+    }
+
+    // The scene is lit and blended in linear space; textures are decoded from sRGB when sampled
+    color = max(color, vec3(0.0)) * uExposure;
+
+    if (uTonemapper == 1) {
+        color = color / (1.0 + color);
+    }
+    else if (uTonemapper == 2) {
+        color = ACESFilm(color);
+    }
+    color = pow(clamp(color, 0.0, 1.0), vec3(1.0 / 2.2));
+
+    // Luma in alpha for FXAA
+    FragColor = vec4(color, dot(color, vec3(0.299, 0.587, 0.114)));
+}
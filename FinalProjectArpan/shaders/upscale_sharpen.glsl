@@ -0,0 +1,37 @@
+#shader vertex
+#version 330 core
+
+#include "fullscreen_vertex.glsl"
+
+
+#shader fragment
+#version 330 core
+
+// Bilinear upscale from the dynamic render resolution to the window, with contrast adaptive
+// sharpening on a source-texel cross to recover some of the detail the lower resolution lost
+
+out vec4 FragColor;
+
+uniform sampler2D uSource;     // Post-processed scene at render resolution
+uniform vec2 uOutputSize;
+uniform float uSharpness;      // 0: mild, 1: strong
+
+void main() {
+    vec2 uv = gl_FragCoord.xy / uOutputSize;
+    vec2 texel = 1.0 / vec2(textureSize(uSource, 0));
+
+    vec3 c = textureLod(uSource, uv, 0.0).rgb;
+    vec3 n = textureLod(uSource, uv + vec2(0.0, texel.y), 0.0).rgb;
+    vec3 s = textureLod(uSource, uv - vec2(0.0, texel.y), 0.0).rgb;
+    vec3 e = textureLod(uSource, uv + vec2(texel.x, 0.0), 0.0).rgb;
+    vec3 w = textureLod(uSource, uv - vec2(texel.x, 0.0), 0.0).rgb;
+
+    // Back off where the neighbourhood is already high contrast so edges do not ring
+    vec3 minimum = min(c, min(min(n, s), min(e, w)));
+    vec3 maximum = max(c, max(max(n, s), max(e, w)));
+    vec3 amount = sqrt(clamp(min(minimum, 1.0 - maximum) / max(maximum, vec3(1e-4)), 0.0, 1.0));
+    vec3 weight = -amount / mix(8.0, 5.0, uSharpness);
+
+    vec3 result = (c + (n + s + e + w) * weight) / (1.0 + 4.0 * weight);
+    FragColor = vec4(clamp(result, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,22 @@
+// Vertex animation texture playback, shared by instanced vertex shaders (included, not a program).
+// Rows are frames, columns are vertices; see VertexAnimation.h.
+
+#define VAT_MAX_CLIPS 8
+
+uniform sampler2D uVatPositions;
+uniform sampler2D uVatNormals;
+uniform ivec2 uVatClipFrames[VAT_MAX_CLIPS];    // First row, frame count
+uniform float uVatClipDurations[VAT_MAX_CLIPS];
+
+// Object space position and normal of 'vertex' at 'time' seconds into a looping clip
+void SampleVertexAnimation(int vertex, uint clip, float time, out vec3 position, out vec3 normal) {
+    ivec2 frames = uVatClipFrames[clip];
+    float frame = fract(time / uVatClipDurations[clip]) * float(frames.y);
+    int first = min(int(frame), frames.y - 1);
+    int second = (first + 1) % frames.y;
+    float t = frame - float(first);
+    position = mix(texelFetch(uVatPositions, ivec2(vertex, frames.x + first), 0).xyz,
+        texelFetch(uVatPositions, ivec2(vertex, frames.x + second), 0).xyz, t);
+    normal = normalize(mix(texelFetch(uVatNormals, ivec2(vertex, frames.x + first), 0).xyz,
+        texelFetch(uVatNormals, ivec2(vertex, frames.x + second), 0).xyz, t));
+}
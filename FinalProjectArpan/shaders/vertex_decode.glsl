@@ -0,0 +1,26 @@
+// Decode of the scene meshes' vertex formats (included, not a program). See VertexFormat.h.
+
+uniform vec3 uPositionOffset;      // Quantized attributes decode as offset + scale * stored;
+uniform vec3 uPositionScale;       // float vertices use 0 and 1
+uniform vec2 uTexCoordOffset;
+uniform vec2 uTexCoordScale;
+uniform bool uOctahedralNormals;   // The normal's xy hold an octahedral encoding
+
+vec3 DecodePosition(vec3 stored) {
+    return uPositionOffset + uPositionScale * stored;
+}
+
+vec2 DecodeTexCoords(vec2 stored) {
+    return uTexCoordOffset + uTexCoordScale * stored;
+}
+
+vec3 DecodeNormal(vec3 stored) {
+    if (!uOctahedralNormals) {
+        return stored;
+    }
+    vec3 n = vec3(stored.xy, 1.0 - abs(stored.x) - abs(stored.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
@@ -0,0 +1,20 @@
+// Sampling of the shared wind field (included, not a program). See WindField.h.
+
+uniform sampler3D uWindCurrent;
+uniform sampler3D uWindPrevious;
+uniform bool uWindEnabled;
+uniform vec3 uWindOrigin;          // World corner of the current volume
+uniform vec3 uWindPreviousOrigin;
+uniform vec3 uWindExtent;
+uniform float uWindBlend;          // 0 at the last update, 1 when the next one is due
+uniform float uWindTime;
+
+// World space wind velocity; outside the volume the nearest boundary value is used
+vec3 SampleWind(vec3 position) {
+    if (!uWindEnabled) {
+        return vec3(0.0);
+    }
+    vec3 previous = texture(uWindPrevious, (position - uWindPreviousOrigin) / uWindExtent).xyz;
+    vec3 current = texture(uWindCurrent, (position - uWindOrigin) / uWindExtent).xyz;
+    return mix(previous, current, uWindBlend);
+}
@@ -0,0 +1,61 @@
+#shader compute
+#version 430 core
+
+// One step of the wind field: semi-Lagrangian self-advection of the previous state, then
+// relaxation toward the base wind plus gust noise that drifts downwind
+layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+
+uniform sampler3D uPrevious;
+layout(rgba16f, binding = 0) uniform writeonly image3D uCurrent;
+
+uniform vec3 uOrigin;
+uniform vec3 uPreviousOrigin;
+uniform vec3 uExtent;
+uniform vec3 uBaseVelocity;
+uniform float uGustStrength;
+uniform float uGustScale;
+uniform float uDeltaTime;
+uniform float uRelax;        // Fraction of the way to the target this step
+uniform float uTime;
+
+float Hash(vec3 p) {
+    p = fract(p * vec3(0.1031, 0.1030, 0.0973));
+    p += dot(p, p.yxz + 33.33);
+    return fract((p.x + p.y) * p.z);
+}
+
+float ValueNoise(vec3 p) {
+    vec3 i = floor(p);
+    vec3 f = p - i;
+    f = f * f * (3.0 - 2.0 * f);
+    return mix(mix(mix(Hash(i), Hash(i + vec3(1, 0, 0)), f.x),
+                   mix(Hash(i + vec3(0, 1, 0)), Hash(i + vec3(1, 1, 0)), f.x), f.y),
+               mix(mix(Hash(i + vec3(0, 0, 1)), Hash(i + vec3(1, 0, 1)), f.x),
+                   mix(Hash(i + vec3(0, 1, 1)), Hash(i + vec3(1, 1, 1)), f.x), f.y), f.z);
+}
+
+vec3 SamplePrevious(vec3 position) {
+    return texture(uPrevious, (position - uPreviousOrigin) / uExtent).xyz;
+}
+
+void main() {
+    ivec3 cell = ivec3(gl_GlobalInvocationID);
+    ivec3 size = imageSize(uCurrent);
+    if (any(greaterThanEqual(cell, size))) {
+        return;
+    }
+    vec3 position = uOrigin + (vec3(cell) + 0.5) / vec3(size) * uExtent;
+
+    // Trace back along the local velocity and take the value found there
+    vec3 velocity = SamplePrevious(position);
+    velocity = SamplePrevious(position - velocity * uDeltaTime);
+
+    // Gusts: noise carried along by the base wind, mostly horizontal
+    vec3 p = (position - uBaseVelocity * uTime) / uGustScale;
+    vec3 gust = vec3(ValueNoise(p), ValueNoise(p + 17.3), ValueNoise(p + 41.7)) * 2.0 - 1.0;
+    gust *= vec3(1.0, 0.25, 1.0) * uGustStrength;
+    gust += normalize(uBaseVelocity + vec3(1e-4)) * max(ValueNoise(p * 0.5 + 7.1) * 2.0 - 0.8, 0.0) * uGustStrength;
+
+    velocity = mix(velocity, uBaseVelocity + gust, uRelax);
+    imageStore(uCurrent, cell, vec4(velocity, 0.0));
+}